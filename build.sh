@@ -10,6 +10,8 @@ OPT_CLEAN=false
 OPT_ANALYZE=false
 OPT_QUIET=false
 OPT_TEST=false
+OPT_BENCH=false
+OPT_BENCH_BASELINE=false
 USAGE_EXIT_CODE=0
 
 # parse args
@@ -20,6 +22,8 @@ while [[ $# -gt 0 ]]; do
   -clean|--clean)         OPT_CLEAN=true; shift ;;
   -a|-analyze|--analyze)  OPT_ANALYZE=true; shift ;;
   -t|-test|--test)        OPT_TEST=true; shift ;;
+  -b|-bench|--bench)      OPT_BENCH=true; shift ;;
+  -bench-baseline|--bench-baseline) OPT_BENCH=true; OPT_BENCH_BASELINE=true; shift ;;
   -q|-quiet|--quiet)      OPT_QUIET=true; shift ;;
   -g)                     OPT_G=true; shift ;;
   *)
@@ -37,6 +41,10 @@ if $OPT_HELP; then
   echo "  -g            Build debug build instead of release build."
   echo "  -a, -analyze  Run static analyzer (Infer https://fbinfer.com) on sources."
   echo "  -t, -test     Run tests, including code coverage analysis."
+  echo "  -b, -bench    Build and run benchmarks. Results are written to build/bench.json"
+  echo "                and compared with build/bench-baseline.json, if it exists."
+  echo "  -bench-baseline"
+  echo "                Build and run benchmarks and save results as the baseline."
   echo "  -q, -quiet    Only print errors."
   exit $USAGE_EXIT_CODE
 fi
@@ -212,12 +220,25 @@ _test() {
   fi
 }
 
+_bench() {
+  _ninja bench
+  W_BENCH_JSON=build/bench.json ./build/wp.bench
+  if $OPT_BENCH_BASELINE; then
+    cp build/bench.json build/bench-baseline.json
+    echo "Saved baseline build/bench-baseline.json"
+  elif [ -f build/bench-baseline.json ]; then
+    python3 misc/bench_compare.py build/bench-baseline.json build/bench.json
+  fi
+}
+
 $OPT_CLEAN && _clean
 _config
 if $OPT_ANALYZE; then
   _analyze
 elif $OPT_TEST; then
   _test
+elif $OPT_BENCH; then
+  _bench
 elif $OPT_G; then
   _ninja debug
 else
@@ -9,9 +9,10 @@ done
 # <name>:<executable>
 # Each name should have corresponding $cflags_<name> and $lflags_<name> defined in build.in.ninja
 products=( \
-  opt:wp       \
-  dev:wp.g     \
-  test:wp.test \
+  opt:wp         \
+  dev:wp.g       \
+  test:wp.test   \
+  bench:wp.bench \
 )
 
 builddir=build
@@ -37,6 +38,11 @@ for product in ${products[@]}; do
       continue
     fi
 
+    # only include *_bench.c files in the "bench" target
+    if [[ "$srcfile" == *"_bench.c" ]] && [[ "$name" != "bench" ]]; then
+      continue
+    fi
+
     objfile=$(dirname "$srcfile")/$(basename "$srcfile" .c).o
     objfile=\$builddir/obj/${name}/${objfile//src\//}
     objects+=( "$\n  ${objfile}" )
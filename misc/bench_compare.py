@@ -0,0 +1,69 @@
+#
+# This script compares two sets of benchmark results written by wp.bench with
+# W_BENCH_JSON=<file>, e.g. a saved baseline and the current results.
+#
+# Usage: bench_compare.py <baseline.json> <current.json>
+#
+# For each benchmark in both files, prints the time per operation of each and the change
+# in percent. Changes larger than the threshold (default 5%, set with -threshold <percent>)
+# are marked with "+" (slower) or "-" (faster.)
+#
+import sys, os, os.path, json
+
+def err(msg):
+  print(msg, file=sys.stderr)
+  sys.exit(1)
+
+
+def load(filename):
+  try:
+    with open(filename, "r") as f:
+      return { b["name"]: b for b in json.load(f)["benchmarks"] }
+  except (OSError, ValueError, KeyError) as e:
+    err("%s: %s" % (filename, e))
+
+
+def fmtns(ns):
+  if ns >= 1e9: return "%.2fs" % (ns / 1e9)
+  if ns >= 1e6: return "%.2fms" % (ns / 1e6)
+  if ns >= 1e3: return "%.2fus" % (ns / 1e3)
+  return "%.1fns" % ns
+
+
+def main(argv):
+  threshold = 5.0
+  args = argv[1:]
+  if len(args) > 1 and args[0] == "-threshold":
+    threshold = float(args[1])
+    args = args[2:]
+  if len(args) != 2:
+    err("usage: %s [-threshold <percent>] <baseline.json> <current.json>" %
+      os.path.relpath(__file__))
+  base = load(args[0])
+  curr = load(args[1])
+
+  print("%-34s %12s %12s %9s" % ("name", "baseline", "current", "delta"))
+  nslower = 0
+  for name, c in curr.items():
+    b = base.get(name)
+    if b is None:
+      print("%-34s %12s %12s" % (name, "-", fmtns(c["ns_per_op"])))
+      continue
+    delta = (c["ns_per_op"] - b["ns_per_op"]) * 100.0 / b["ns_per_op"]
+    mark = ""
+    if delta > threshold:
+      mark = " +"
+      nslower += 1
+    elif delta < -threshold:
+      mark = " -"
+    print("%-34s %12s %12s %+8.1f%%%s" % (
+      name, fmtns(b["ns_per_op"]), fmtns(c["ns_per_op"]), delta, mark))
+  for name in base:
+    if name not in curr:
+      print("%-34s %12s %12s" % (name, fmtns(base[name]["ns_per_op"]), "-"))
+  if nslower > 0:
+    print("%d benchmark%s slower by more than %g%%" % (
+      nslower, "" if nslower == 1 else "s", threshold))
+
+
+main(sys.argv)
@@ -0,0 +1,208 @@
+#
+# This script generates synthetic source files for benchmarking the scanner, parser,
+# resolvers and IR builder. See src/pipeline_bench.c
+#
+# Usage:
+#   gen_corpus.py [-size <bytes>[k|M]] [-seed <n>] -dir <dir>
+#     Write one file per shape to <dir>/<shape>.w
+#   gen_corpus.py [-size <bytes>[k|M]] [-seed <n>] -shape <shape> [-o <file>]
+#     Write one file with the given shape to <file> or stdout
+#
+# Shapes:
+#   deep      functions which each return a deeply-nested expression
+#   funs      many small functions which call each other
+#   names     long identifiers
+#   comments  more comments than code
+#   unicode   identifiers with non-ASCII letters
+#
+# The programs only use what all compiler passes currently support: functions with int
+# parameters, let bindings, arithmetic and calls (whose results are not used in arithmetic.)
+# Every shape produces a program which passes all stages without errors.
+#
+import sys, os, os.path, random
+
+DEFAULT_SIZE = 1024 * 1024
+
+def err(msg):
+  print(msg, file=sys.stderr)
+  sys.exit(1)
+
+
+class Gen:
+  def __init__(self, rng, shape):
+    self.rng = rng
+    self.shape = shape
+    self.funs = []  # (name, nparams) of functions defined so far
+    self.out = []
+    self.size = 0
+    self.nameseq = 0
+
+  def write(self, s):
+    self.out.append(s)
+    self.size += len(s.encode("utf8"))
+
+  def newname(self, base):
+    self.nameseq += 1
+    rng = self.rng
+    if self.shape == "names":
+      words = [ "accumulated", "intermediate", "temporary", "result", "value", "scaled",
+                "normalized", "offset", "count", "index", "factor", "adjusted", "total" ]
+      parts = [ rng.choice(words) for _ in range(rng.randint(3, 6)) ]
+      return "%s_%s_%d" % (base, "_".join(parts), self.nameseq)
+    if self.shape == "unicode":
+      words = [ "größe", "länge", "höhe", "αβγ", "δέλτα", "λάμδα", "значение", "сумма",
+                "値", "合計", "ñandú", "çarpan", "𝑥𝑦𝑧" ]
+      return "%s_%s%d" % (rng.choice(words), base, self.nameseq)
+    return "%s%d" % (base, self.nameseq)
+
+  def comment(self, indent):
+    if self.shape == "comments":
+      text = [ "this computes the next intermediate value from the parameters",
+               "note: the order of operations here matters for overflow",
+               "TODO: find a closed-form expression for this sequence",
+               "scale by the factor before adding the offset" ]
+      for _ in range(self.rng.randint(1, 4)):
+        self.write("%s# %s\n" % (indent, self.rng.choice(text)))
+
+  # expr returns an arithmetic expression over vars of at most the given depth.
+  # Every operation has at least one operand which is a variable, which keeps
+  # the expression typed (untyped constant expressions are not supported by the IR builder.)
+  def expr(self, vars, depth):
+    rng = self.rng
+    if depth <= 0 or rng.random() < 0.2:
+      return rng.choice(vars)
+    op = rng.choice("+-*/")
+    left = self.expr(vars, depth - 1)
+    if rng.random() < 0.3:
+      right = str(rng.randint(1, 1000))
+    else:
+      right = self.expr(vars, depth - 1)
+    if rng.random() < 0.5:
+      left, right = right, left
+    return "(%s %s %s)" % (left, op, right)
+
+  # deepexpr returns an expression nested exactly depth levels
+  def deepexpr(self, vars, depth):
+    rng = self.rng
+    e = rng.choice(vars)
+    for _ in range(depth):
+      op = rng.choice("+-*/")
+      if rng.random() < 0.5:
+        e = "(%s %s %s)" % (e, op, rng.choice(vars))
+      else:
+        e = "(%s %s %d)" % (e, op, rng.randint(1, 1000))
+    return e
+
+  def call(self, vars):
+    rng = self.rng
+    name, nparams = rng.choice(self.funs[-20:])
+    args = [ self.expr(vars, 1) for _ in range(nparams) ]
+    return "%s(%s)" % (name, ", ".join(args))
+
+  def fun(self):
+    rng = self.rng
+    nparams = rng.randint(1, 4)
+    params = [ self.newname("p") for _ in range(nparams) ]
+    name = self.newname("f")
+    self.comment("")
+    self.write("fun %s (%s int) int {\n" % (name, ", ".join(params)))
+    vars = params[:]
+    if self.shape == "deep":
+      nlets = rng.randint(0, 2)
+    elif self.shape == "funs":
+      nlets = rng.randint(0, 1)
+    else:
+      nlets = rng.randint(2, 8)
+    for _ in range(nlets):
+      v = self.newname("v")
+      self.comment("  ")
+      if self.shape == "deep":
+        e = self.deepexpr(vars, rng.randint(20, 60))
+      else:
+        e = self.expr(vars, 3)
+      trailing = "  # " + v if self.shape == "comments" else ""
+      self.write("  %s = %s%s\n" % (v, e, trailing))
+      vars.append(v)
+    self.comment("  ")
+    if self.funs and rng.random() < 0.5:
+      e = self.call(vars)
+    elif self.shape == "deep":
+      e = self.deepexpr(vars, rng.randint(20, 60))
+    else:
+      e = self.expr(vars, 2)
+    self.write("  %s\n}\n\n" % e)
+    self.funs.append((name, nparams))
+
+
+def gencorpus(shape, size, seed):
+  g = Gen(random.Random("%s%d" % (shape, seed)), shape)
+  g.write("# generated by misc/gen_corpus.py -shape %s -size %d -seed %d\n\n" % (
+    shape, size, seed))
+  while g.size < size:
+    g.fun()
+  return "".join(g.out)
+
+
+SHAPES = [ "deep", "funs", "names", "comments", "unicode" ]
+
+
+def parsesize(s):
+  mul = 1
+  if s[-1] in "kK":
+    mul = 1024
+  elif s[-1] in "mM":
+    mul = 1024 * 1024
+  if mul != 1:
+    s = s[:-1]
+  try:
+    return int(s) * mul
+  except ValueError:
+    err("invalid size %r" % s)
+
+
+def main(argv):
+  size = DEFAULT_SIZE
+  seed = 1
+  shape = None
+  outfile = None
+  outdir = None
+  args = argv[1:]
+  while args:
+    arg = args.pop(0)
+    if arg in ("-h", "-help", "--help"):
+      print("usage: %s [-size <bytes>[k|M]] [-seed <n>] (-dir <dir> | -shape <shape> [-o <file>])"
+        % os.path.relpath(__file__))
+      print("shapes: %s" % " ".join(SHAPES))
+      return
+    if not args:
+      err("missing value for %s" % arg)
+    val = args.pop(0)
+    if arg == "-size":   size = parsesize(val)
+    elif arg == "-seed": seed = int(val)
+    elif arg == "-shape":
+      if val not in SHAPES:
+        err("unknown shape %r (expected one of: %s)" % (val, " ".join(SHAPES)))
+      shape = val
+    elif arg == "-o":    outfile = val
+    elif arg == "-dir":  outdir = val
+    else:
+      err("unknown option %s" % arg)
+
+  if outdir is not None:
+    os.makedirs(outdir, exist_ok=True)
+    for shape in SHAPES:
+      filename = os.path.join(outdir, shape + ".w")
+      with open(filename, "w", encoding="utf8") as f:
+        f.write(gencorpus(shape, size, seed))
+    return
+  if shape is None:
+    err("missing -dir or -shape")
+  source = gencorpus(shape, size, seed)
+  if outfile is None:
+    sys.stdout.write(source)
+  else:
+    with open(outfile, "w", encoding="utf8") as f:
+      f.write(source)
+
+
+main(sys.argv)
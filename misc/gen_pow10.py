@@ -0,0 +1,58 @@
+#
+# This script generates the table of 128-bit powers of ten in src/parse/parsefloat.c
+#
+import sys, os, os.path
+
+def err(msg):
+  print(msg)
+  sys.exit(1)
+
+srcdir = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+os.chdir(srcdir)
+
+sourcefilename = "src/parse/parsefloat.c"
+
+# Range of exponents. Must match POW10_MIN_EXP10 and POW10_MAX_EXP10 in parsefloat.c.
+# Any double with a 19-digit decimal mantissa has an exponent in this range.
+MIN_EXP10 = -348
+MAX_EXP10 = 347
+
+# Each entry is the 128 most significant bits of 10^e, rounded down, as {hi, lo}.
+# For negative e, this is 2^k / 10^-e for a k which puts the top bit of hi at bit 63.
+def pow10bits(e):
+  if e >= 0:
+    v = 10 ** e
+    n = v.bit_length()
+    return v >> (n - 128) if n > 128 else v << (128 - n)
+  d = 10 ** -e
+  return (1 << (d.bit_length() + 127)) // d
+
+with open(sourcefilename, "r") as f:
+  source = f.read()
+
+output = [
+  '// automatically generated by %s; do not edit' % os.path.relpath(__file__),
+  'static const u64 pow10tab[%d][2] = {' % (MAX_EXP10 - MIN_EXP10 + 1),
+]
+for e in range(MIN_EXP10, MAX_EXP10 + 1):
+  v = pow10bits(e)
+  assert v >> 127 == 1
+  output.append("  {0x%016X, 0x%016X}, // 1e%d" % (v >> 64, v & 0xFFFFFFFFFFFFFFFF, e))
+output.append("};")
+output = "\n".join(output)
+
+startstr = '//POW10_TABLE_BEGIN\n'
+endstr   = '\n//POW10_TABLE_END'
+start = source.find(startstr)
+end   = source.find(endstr, start)
+if start == -1:
+  err("can not find %r in %s" % (startstr, sourcefilename))
+if end == -1:
+  err("can not find %r in %s" % (endstr, sourcefilename))
+
+source2 = source[:start + len(startstr)] + output + source[end:]
+
+if source2 != source:
+  print("write", sourcefilename)
+  with open(sourcefilename, "w") as f:
+    f.write(source2)
@@ -17,8 +17,11 @@ typedef struct {
   Memory        mem; // memory used only during compilation, like AST nodes
 } CCtx;
 
-// initialize and/or recycle a CCtx
-void CCtxInit(
+// initialize and/or recycle a CCtx.
+// The CCtx must be zero-initialized before the first call (e.g. CCtx cc = {0}), since the
+// source and memory of a CCtx which has them are recycled (cc->src.name and cc->mem.)
+// Returns false if there is no room for the positions of the source (see SourceInit.)
+bool CCtxInit(
   CCtx*,
   ErrorHandler* errh,
   void*         userdata,
@@ -26,5 +29,10 @@ void CCtxInit(
   const u8*     srcbuf,  // caller owns
   size_t        srclen
 );
+// initialize and/or recycle a CCtx with a source file which is memory-mapped.
+// Like with CCtxInit, the CCtx must be zero-initialized before the first call.
+// The mapping is owned by the CCtx and released by CCtxFree or the next call to CCtxInit*.
+// Returns false if the file can not be opened or positioned (errno is set.)
+bool CCtxInitFile(CCtx*, ErrorHandler* errh, void* userdata, Str filename);
 void CCtxFree(CCtx*);
-void CCtxErrorf(const CCtx* cc, SrcPos pos, const char* format, ...);
+void CCtxErrorf(const CCtx* cc, Pos pos, const char* format, ...);
@@ -1,8 +1,18 @@
 // CCtx compilation context
 #include "build.h"
 
+static void initctx(CCtx* cc, ErrorHandler* errh, void* userdata) {
+  if (cc->mem != NULL) {
+    MemoryRecycle(&cc->mem); // keeps the memory pages of the previous compilation
+  } else {
+    cc->mem = MemoryNewArena(0);
+  }
+  cc->errh = errh;
+  cc->userdata = userdata;
+}
+
 // reset and/or initialize a compilation context
-void CCtxInit(
+bool CCtxInit(
   CCtx*         cc,
   ErrorHandler* errh,
   void*         userdata,
@@ -10,32 +20,35 @@ void CCtxInit(
   const u8*     srcbuf,
   size_t        srclen
 ) {
-  // Disabled since srcbuf is owned by caller
-  // if (cc->src.buf != NULL) {
-  //   free((void*)cc->src.buf);
-  //   cc->src.buf = NULL;
-  // }
+  if (cc->src.name != NULL) {
+    SourceFree(&cc->src); // unmaps buf if it was opened by CCtxInitFile
+  }
+  bool ok = SourceInit(&cc->src, srcname, srcbuf, srclen);
+  initctx(cc, errh, userdata);
+  return ok;
+}
+
+
+bool CCtxInitFile(CCtx* cc, ErrorHandler* errh, void* userdata, Str filename) {
   if (cc->src.name != NULL) {
     SourceFree(&cc->src);
   }
-  SourceInit(&cc->src, srcname, srcbuf, srclen);
-  cc->mem = MemoryNew(0);
-  cc->errh = errh;
-  cc->userdata = userdata;
+  if (!SourceOpen(&cc->src, filename)) {
+    return false;
+  }
+  initctx(cc, errh, userdata);
+  return true;
 }
 
 
 void CCtxFree(CCtx* cc) {
-  // if (cc->src.buf != NULL) {
-  //   free((void*)cc->src.buf);
-  //   cc->src.buf = NULL;
-  // }
   SourceFree(&cc->src);
   MemoryFree(cc->mem);
+  cc->mem = NULL;
 }
 
 
-void CCtxErrorf(const CCtx* cc, SrcPos pos, const char* format, ...) {
+void CCtxErrorf(const CCtx* cc, Pos pos, const char* format, ...) {
   if (cc->errh == NULL) {
     return;
   }
@@ -47,6 +60,6 @@ void CCtxErrorf(const CCtx* cc, SrcPos pos, const char* format, ...) {
     assert(sdslen(msg) > 0); // format may contain %S which is not supported by sdscatvprintf
   }
   va_end(ap);
-  cc->errh(&cc->src, pos, msg, cc->userdata);
+  cc->errh(&cc->src, PosSrcPos(pos), msg, cc->userdata);
   sdsfree(msg);
 }
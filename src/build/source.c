@@ -1,48 +1,428 @@
 #include "build.h"
+#include "../common/os.h"
 #include "../common/tstyle.h"
+#include "../common/simd.h"
+#include "../common/test.h"
+#include "../common/unicode.h"
+#include <stdatomic.h>
 
+// The position table holds the ranges of positions (see Pos) of all live sources, sorted by
+// base. It is only accessed with posTabLock held. Position 0 is NoPos, so ranges start at 1.
+typedef struct PosRange {
+  u32     base;
+  u32     size;
+  Source* src;
+} PosRange;
 
-void SourceInit(Source* s, Str name, const u8* buf, size_t len) {
+static PosRange*   posTab;
+static u32         posTabLen, posTabCap;
+static u64         posTabNext = 1; // where posRangeAdd starts looking for free positions
+static atomic_flag posTabLock = ATOMIC_FLAG_INIT;
+
+#define POS_SPACE ((u64)1 << 32) // end of the position space
+
+static void posTabAcquire() {
+  while (atomic_flag_test_and_set_explicit(&posTabLock, memory_order_acquire)) {
+  }
+}
+
+static void posTabRelease() {
+  atomic_flag_clear_explicit(&posTabLock, memory_order_release);
+}
+
+// posTabFind returns the index of the range which contains p, or posTabLen if there is none
+static u32 posTabFind(Pos p) {
+  u32 lo = 0, hi = posTabLen;
+  while (lo < hi) {
+    u32 i = (lo + hi) / 2;
+    if (posTab[i].base > p) {
+      hi = i;
+    } else if (p - posTab[i].base >= posTab[i].size) {
+      lo = i + 1;
+    } else {
+      return i;
+    }
+  }
+  return posTabLen;
+}
+
+// posRangeAdd reserves size positions for s and returns their base, or 0 if there is no room.
+// Free positions are used "next fit", so that positions are not reused right after they are
+// released and stale positions are more likely to map to no source than to the wrong one.
+static u32 posRangeAdd(Source* s, u64 size) {
+  u64 base = 0;
+  u32 i = 0;
+  for (int pass = 0; pass < 2 && base == 0; pass++) {
+    u64 min = pass == 0 ? posTabNext : 1;
+    u64 gapstart = 1;
+    for (i = 0; i <= posTabLen; i++) {
+      u64 gapend = i < posTabLen ? posTab[i].base : POS_SPACE;
+      u64 start = max(gapstart, min);
+      if (start < gapend && gapend - start >= size) {
+        base = start;
+        break;
+      }
+      if (i < posTabLen) {
+        gapstart = (u64)posTab[i].base + posTab[i].size;
+      }
+    }
+  }
+  if (base == 0) {
+    return 0;
+  }
+  if (posTabLen == posTabCap) {
+    posTabCap = max(16u, posTabCap * 2);
+    posTab = (PosRange*)memrealloc(NULL, posTab, sizeof(PosRange) * posTabCap);
+  }
+  memmove(&posTab[i + 1], &posTab[i], sizeof(PosRange) * (posTabLen - i));
+  posTab[i].base = (u32)base;
+  posTab[i].size = (u32)size;
+  posTab[i].src = s;
+  posTabLen++;
+  posTabNext = base + size;
+  return (u32)base;
+}
+
+static void posRangeRemove(Source* s) {
+  u32 i = posTabFind(s->posbase);
+  assert(i < posTabLen && posTab[i].src == s);
+  posTabLen--;
+  memmove(&posTab[i], &posTab[i + 1], sizeof(PosRange) * (posTabLen - i));
+}
+
+// sourceReserve reserves positions for s, with room for len bytes, and sets s->posbase.
+// Returns false with errno set to EFBIG if there is no room.
+static bool sourceReserve(Source* s, size_t len) {
+  s->posbase = 0;
+  s->_possize = 0;
+  if (len < POS_SPACE - 1) {
+    posTabAcquire();
+    s->posbase = posRangeAdd(s, len + 1);
+    posTabRelease();
+  }
+  if (s->posbase == 0) {
+    errno = EFBIG;
+    return false;
+  }
+  s->_possize = (u32)len + 1;
+  return true;
+}
+
+
+Source* PosSource(Pos p) {
+  Source* s = NULL;
+  posTabAcquire();
+  u32 i = posTabFind(p);
+  if (i < posTabLen) {
+    s = posTab[i].src;
+  }
+  posTabRelease();
+  return s;
+}
+
+
+SrcPos PosSrcPos(Pos p) {
+  SrcPos pos = { PosSource(p), 0, 0 };
+  if (pos.src != NULL) {
+    pos.offs = PosOffs(p, pos.src);
+    if (pos.offs < pos.src->len) {
+      pos.span = SourceSpan(pos.src, pos.offs);
+    } else if (pos.offs > 0) {
+      pos.offs--; // end of the source; show its last byte
+    }
+  }
+  return pos;
+}
+
+
+bool SourceInit(Source* s, Str name, const u8* buf, size_t len) {
   s->name = sdsdup(name);
   s->buf = buf;
   s->len = len;
+  s->_mapped = false;
+  s->_utf8 = SourceUTF8Unknown;
+  s->_utf8err = 0;
   s->_lineoffsets = NULL;
   s->_linecount = 0;
+  s->_linecap = 0;
+  s->_lineend = 0;
+  bool ok = sourceReserve(s, len);
+  s->_prevposbase = s->posbase;
+  s->_prevpossize = s->_possize;
+  return ok;
+}
+
+
+bool SourceOpen(Source* s, Str name) {
+  size_t len = 0;
+  auto buf = os_mmapfile(name, &len);
+  if (!buf) {
+    return false;
+  }
+  bool ok = SourceInit(s, name, buf, len);
+  s->_mapped = true;
+  if (!ok) {
+    SourceFree(s); // unmaps buf
+    errno = EFBIG;
+  }
+  return ok;
+}
+
+
+bool SourceReplace(Source* s, const u8* buf, size_t len) {
+  if (s->_mapped) {
+    os_unmapfile(s->buf, s->len);
+    s->_mapped = false;
+  }
+  s->buf = buf;
+  s->len = len;
+  s->_utf8 = SourceUTF8Unknown;
+  s->_linecount = 0;
+  s->_lineend = 0;
+  if (s->_lineoffsets) {
+    s->_lineoffsets[0] = 0;
+    s->_linecount = 1;
+  }
+
+  // the positions of the source must cover len+1 offsets
+  s->_prevposbase = s->posbase;
+  s->_prevpossize = s->_possize;
+  if (s->posbase != 0 && len < s->_possize) {
+    return true;
+  }
+  bool ok = true;
+  posTabAcquire();
+  if (s->posbase != 0) {
+    // extend the range in place if the positions after it are free
+    u32 i = posTabFind(s->posbase);
+    u64 end = i + 1 < posTabLen ? posTab[i + 1].base : POS_SPACE;
+    if (len < end - s->posbase) {
+      posTab[i].size = (u32)len + 1;
+      s->_possize = (u32)len + 1;
+      posTabNext = max(posTabNext, (u64)s->posbase + s->_possize);
+      posTabRelease();
+      return true;
+    }
+    posRangeRemove(s);
+    s->posbase = 0;
+    s->_possize = 0;
+  }
+  if (len < POS_SPACE - 1) {
+    // leave room for the source to grow some more without moving again
+    u64 size = len + 1;
+    s->posbase = posRangeAdd(s, min(size + size / 2, POS_SPACE - 1));
+    if (s->posbase == 0) {
+      s->posbase = posRangeAdd(s, size);
+    }
+    s->_possize = s->posbase == 0 ? 0 : posTab[posTabFind(s->posbase)].size;
+  }
+  posTabRelease();
+  if (s->posbase == 0) {
+    errno = EFBIG;
+    ok = false;
+  }
+  return ok;
+}
+
+
+SourceUTF8 SourceCheckUTF8(Source* s) {
+  if (s->_utf8 == SourceUTF8Unknown) {
+    bool ascii;
+    size_t n = utf8validate(s->buf, s->len, &ascii);
+    if (n < s->len) {
+      s->_utf8 = SourceUTF8Invalid;
+      s->_utf8err = (u32)n;
+    } else {
+      s->_utf8 = ascii ? SourceUTF8ASCII : SourceUTF8Valid;
+    }
+  }
+  return (SourceUTF8)s->_utf8;
 }
 
 
 void SourceFree(Source* s) {
   sdsfree(s->name);
   s->name = NULL;
+  if (s->_mapped) {
+    os_unmapfile(s->buf, s->len);
+    s->buf = NULL;
+    s->len = 0;
+    s->_mapped = false;
+  }
   if (s->_lineoffsets) {
     memfree(NULL, s->_lineoffsets);
     s->_lineoffsets = NULL;
+    s->_linecount = 0;
+    s->_linecap = 0;
+    s->_lineend = 0;
+  }
+  if (s->posbase != 0) {
+    posTabAcquire();
+    posRangeRemove(s);
+    posTabRelease();
+    s->posbase = 0;
+    s->_possize = 0;
   }
 }
 
 
-static void computeLineOffsets(Source* s) {
-  assert(s->_lineoffsets == NULL);
+// namelen returns the length of the name at p: ASCII identifier characters (see charflags in
+// scan.c, which include "+", "-" and ".") and any non-ASCII bytes.
+static u32 namelen(const u8* p, const u8* end) {
+  const u8* start = p;
+  while (p < end && (
+    *p >= 0x80 || *p == '_' || (*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') ||
+    (*p >= '0' && *p <= '9') || *p == '+' || *p == '-' || *p == '.' ))
+  {
+    p++;
+  }
+  return (u32)(p - start);
+}
 
-  size_t cap = 256; // best guess for common line numbers, to allocate up-front
-  s->_lineoffsets = (u32*)memalloc(NULL, sizeof(u32) * cap);
-  s->_lineoffsets[0] = 0;
+inline static bool isdigitc(u8 c) { return (u8)(c - '0') < 10; }
+inline static bool ishexdigitc(u8 c) { return isdigitc(c) || (u8)((c | 0x20) - 'a') < 6; }
 
-  u32 linecount = 1;
-  u32 i = 0;
-  while (i < s->len) {
-    if (s->buf[i++] == '\n') {
-      if (linecount == cap) {
-        // more lines
-        cap = cap * 2;
-        s->_lineoffsets = (u32*)memrealloc(NULL, s->_lineoffsets, sizeof(u32) * cap);
+// numberlen returns the length of the number literal at p, like snumber in scan.c
+static u32 numberlen(const u8* p, const u8* end) {
+  const u8* start = p;
+  if (*p == '0' && end - p > 1) {
+    u8 c = p[1] | 0x20;
+    if (c == 'x' || c == 'o' || c == 'b') {
+      p += 2;
+      while (p < end && (*p == '_' || (c == 'x' ? ishexdigitc(*p) : isdigitc(*p)))) {
+        p++;
+      }
+      return (u32)(p - start);
+    }
+  }
+  while (p < end && (isdigitc(*p) || *p == '_')) {
+    p++;
+  }
+  if (end - p > 1 && *p == '.' && isdigitc(p[1])) {
+    p++;
+    while (p < end && (isdigitc(*p) || *p == '_')) {
+      p++;
+    }
+  }
+  if (p < end && (*p | 0x20) == 'e') {
+    p++;
+    if (p < end && (*p == '+' || *p == '-')) {
+      p++;
+    }
+    while (p < end && isdigitc(*p)) {
+      p++;
+    }
+  }
+  return (u32)(p - start);
+}
+
+
+u32 SourceSpan(const Source* s, u32 offs) {
+  if (offs >= s->len) {
+    return 0;
+  }
+  const u8* p = s->buf + offs;
+  const u8* end = s->buf + s->len;
+  u8 c = *p;
+  u8 c1 = end - p > 1 ? p[1] : 0;
+  u8 c2 = end - p > 2 ? p[2] : 0;
+  switch (c) {
+    case '0'...'9':
+      return numberlen(p, end);
+    case '$':
+      return 1 + namelen(p + 1, end);
+    case '_':
+    case 'A'...'Z':
+    case 'a'...'z':
+      return namelen(p, end);
+    case '<':
+    case '>':
+      return c1 == c ? (c2 == '=' ? 3 : 2) : c1 == '=' ? 2 : 1; // "<<=" "<<" "<=" "<"
+    case '-':
+      return c1 == '>' || c1 == '-' || c1 == '=' ? 2 : 1;
+    case '+':
+    case '&':
+    case '|':
+      return c1 == c || c1 == '=' ? 2 : 1;
+    case '!':
+    case '%':
+    case '*':
+    case '/':
+    case '=':
+    case '^':
+    case '~':
+      return c1 == '=' ? 2 : 1;
+    case '(': case ')': case '{': case '}': case '[': case ']': case ',': case ';':
+      return 1;
+    default:
+      // whitespace, where inserted semicolons are, or an invalid character
+      return c >= 0x80 ? namelen(p, end) : 0;
+  }
+}
+
+
+void _SourceGrowLines(Source* s, u32 addl) {
+  if (s->_lineoffsets == NULL) {
+    // best guess for common line numbers, to allocate up-front
+    s->_linecap = max(256u, addl + 1);
+    s->_lineoffsets = (u32*)memalloc(NULL, sizeof(u32) * s->_linecap);
+    s->_lineoffsets[0] = 0; // first line
+    s->_linecount = 1;
+    if (s->_linecap - s->_linecount >= addl) {
+      return;
+    }
+  }
+  u32 cap = s->_linecap * 2;
+  while (cap - s->_linecount < addl) {
+    cap *= 2;
+  }
+  s->_lineoffsets = (u32*)memrealloc(NULL, s->_lineoffsets, sizeof(u32) * cap);
+  s->_linecap = cap;
+}
+
+
+// extendLineOffsets adds the start of every line in buf[_lineend:endoffs] to the line table.
+// This is only needed for parts of a source not (yet) visited by the scanner, for instance
+// when a position is formatted for a source which has not been scanned.
+static void extendLineOffsets(Source* s, u32 endoffs) {
+  if (s->_lineoffsets == NULL) {
+    _SourceGrowLines(s, 0);
+  }
+  // Extend by at least 64kB at a time so that a series of lookups at increasing offsets
+  // (e.g. errors reported in source order) does not turn into many tiny scans.
+  endoffs = (u32)min((size_t)max(endoffs, s->_lineend + 0x10000), s->len);
+  const u8* p = s->buf + s->_lineend;
+  const u8* end = s->buf + endoffs;
+
+  #ifdef SIMD_WIDTH
+  svec lf = svset1('\n');
+  while (end - p >= SIMD_WIDTH) {
+    u32 m = svmask(sveq(svload(p), lf));
+    if (m) {
+      u32 n = popcount(m);
+      if (s->_linecap - s->_linecount < n) {
+        _SourceGrowLines(s, n);
+      }
+      u32 offs = (u32)(p - s->buf) + 1;
+      do {
+        s->_lineoffsets[s->_linecount++] = offs + __builtin_ctz(m);
+        m &= m - 1; // clear lowest bit
+      } while (m);
+    }
+    p += SIMD_WIDTH;
+  }
+  #endif
+
+  while (p < end) {
+    if (*p++ == '\n') {
+      if (s->_linecount == s->_linecap) {
+        _SourceGrowLines(s, 1);
       }
-      s->_lineoffsets[linecount] = i;
-      linecount++;
+      s->_lineoffsets[s->_linecount++] = (u32)(p - s->buf);
     }
   }
 
-  s->_linecount = linecount;
+  s->_lineend = endoffs;
 }
 
 
@@ -54,17 +434,17 @@ LineCol SrcPosLineCol(SrcPos pos) {
     return lico;
   }
 
-  if (!s->_lineoffsets) {
-    computeLineOffsets(s);
-  }
-
   if (pos.offs >= s->len) { dlog("pos.offs=%u >= s->len=%zu", pos.offs, s->len); }
   assert(pos.offs < s->len);
 
+  if (s->_lineoffsets == NULL || s->_lineend < pos.offs) {
+    extendLineOffsets(s, pos.offs + 1);
+  }
+
+  // binary search for the last line starting at or before pos.offs
   u32 count = s->_linecount;
   u32 line = 0;
-  u32 debug1 = 10;
-  while (count > 0 && debug1--) {
+  while (count > 0) {
     u32 step = count / 2;
     u32 i = line + step;
     if (s->_lineoffsets[i] <= pos.offs) {
@@ -80,9 +460,7 @@ LineCol SrcPosLineCol(SrcPos pos) {
 
 
 static const u8* lineContents(Source* s, u32 line, u32* out_len) {
-  if (!s->_lineoffsets) {
-    computeLineOffsets(s);
-  }
+  // Note: line is expected to come from SrcPosLineCol, so the line table covers its start.
   if (line >= s->_linecount) {
     return NULL;
   }
@@ -92,7 +470,9 @@ static const u8* lineContents(Source* s, u32 line, u32* out_len) {
     if (line + 1 < s->_linecount) {
       *out_len = (s->_lineoffsets[line + 1] - 1) - start;
     } else {
-      *out_len = (s->buf + s->len) - lineptr;
+      // last known line; its end may be beyond _lineend
+      const u8* end = memchr(lineptr, '\n', (s->buf + s->len) - lineptr);
+      *out_len = (end ? end : s->buf + s->len) - lineptr;
     }
   }
   return lineptr;
@@ -141,3 +521,165 @@ Str SrcPosMsg(Str s, SrcPos pos, ConstStr message) {
   return s;
 }
 
+
+
+#if W_UNIT_TEST_ENABLED
+static void test() {
+  // lines of varying length, some longer than a SIMD vector; more than 1024 lines
+  auto text = sdsempty();
+  for (u32 i = 0; i < 2000; i++) {
+    text = sdsgrow(text, sdslen(text) + (i * 7) % 90, 'x');
+    text = sdscatlen(text, "\n", 1);
+  }
+  text = sdscat(text, "last line");
+
+  auto name = sdsnew("lines");
+  Source src;
+  SourceInit(&src, name, (const u8*)text, sdslen(text));
+  u32 line = 0, col = 0;
+  for (u32 offs = 0; offs < src.len; offs++) {
+    SrcPos pos = { &src, offs, 0 };
+    auto l = SrcPosLineCol(pos);
+    asserteq(l.line, line);
+    asserteq(l.col, col);
+    if (src.buf[offs] == '\n') {
+      line++;
+      col = 0;
+    } else {
+      col++;
+    }
+  }
+  asserteq(src._linecount, 2001);
+  asserteq(src._lineend, src.len);
+
+  // lookup at the end before the beginning; contents of a line past _lineend
+  SourceFree(&src);
+  SourceInit(&src, name, (const u8*)text, sdslen(text));
+  SrcPos pos = { &src, (u32)src.len - 1, 0 };
+  asserteq(SrcPosLineCol(pos).line, 2000);
+  pos.offs = 0;
+  asserteq(SrcPosLineCol(pos).line, 0);
+  u32 linelen = 0;
+  lineContents(&src, 1, &linelen);
+  asserteq(linelen, 7);
+
+  SourceFree(&src);
+  sdsfree(name);
+  sdsfree(text);
+}
+W_UNIT_TEST(Source, { test(); })
+
+
+static void test_pos() {
+  const char* text = "x == a1 <= 2.5e3\ny = \xc3\xa5\xc3\xa4 + 1 - _b.c+d + 0x1f";
+  u32 textlen = (u32)strlen(text);
+  auto name = sdsnew("pos");
+  Source src1, src2;
+  assert(SourceInit(&src1, name, (const u8*)text, textlen));
+  assert(SourceInit(&src2, name, (const u8*)text, textlen));
+
+  // positions map back to their source and offset
+  Pos p1 = PosMake(&src1, 5);
+  Pos p2 = PosMake(&src2, 5);
+  assert(p1 != p2);
+  assert(PosSource(p1) == &src1);
+  assert(PosSource(p2) == &src2);
+  assert(PosInSource(p1, &src1) && !PosInSource(p1, &src2));
+  assert(!PosInSource(NoPos, &src1));
+  asserteq(PosOffs(p1, &src1), 5);
+  assert(PosSource(NoPos) == NULL);
+  assert(PosSrcPos(NoPos).src == NULL);
+  SrcPos sp = PosSrcPos(PosMake(&src1, 19));
+  assert(sp.src == &src1);
+  asserteq(sp.offs, 19);
+  asserteq(SrcPosLineCol(sp).line, 1);
+  asserteq(SrcPosLineCol(sp).col, 2);
+
+  // the end of a source has a position of its own, shown at the last byte without a span
+  Pos end = PosMake(&src1, textlen);
+  assert(end != PosMake(&src1, textlen - 1));
+  assert(PosSource(end) == &src1);
+  asserteq(PosSrcPos(end).offs, textlen - 1);
+  asserteq(PosSrcPos(end).span, 0);
+
+  // spans are the lengths of tokens
+  asserteq(SourceSpan(&src1, 0), 1);   // x
+  asserteq(SourceSpan(&src1, 2), 2);   // ==
+  asserteq(SourceSpan(&src1, 5), 2);   // a1
+  asserteq(SourceSpan(&src1, 8), 2);   // <=
+  asserteq(SourceSpan(&src1, 11), 5);  // 2.5e3
+  asserteq(SourceSpan(&src1, 16), 0);  // \n
+  asserteq(SourceSpan(&src1, 21), 4);  // two 2-byte characters
+  asserteq(SourceSpan(&src1, 28), 1);  // 1
+  asserteq(SourceSpan(&src1, 32), 6);  // _b.c+d (names may contain "+", "-" and ".")
+  asserteq(SourceSpan(&src1, 41), 4);  // 0x1f
+  asserteq(SourceSpan(&src1, textlen), 0);
+  asserteq(PosSrcPos(PosMake(&src1, 8)).span, 2);
+
+  // freeing a source releases its positions
+  SourceFree(&src1);
+  assert(PosSource(p1) == NULL);
+  assert(PosSource(p2) == &src2);
+  SourceFree(&src2);
+
+  // Many large sources at once. Offsets past 16 MB and sources past the 255th have distinct
+  // positions. (buf is not read by any of this, so it can be NULL.)
+  const u32 nsrc = 300;
+  const u32 srclen = 12 * 1024 * 1024;
+  auto srcs = (Source*)memalloc(NULL, sizeof(Source) * nsrc);
+  for (u32 i = 0; i < nsrc; i++) {
+    u32 len = i == 0 ? 20 * 1024 * 1024 : srclen;
+    assert(SourceInit(&srcs[i], name, NULL, len));
+  }
+  Pos far1 = PosMake(&srcs[0], 17 * 1024 * 1024);
+  Pos far2 = PosMake(&srcs[0], 17 * 1024 * 1024 + 1);
+  assert(far1 != far2);
+  assert(PosSource(far2) == &srcs[0]);
+  asserteq(PosOffs(far2, &srcs[0]), 17 * 1024 * 1024 + 1);
+  for (u32 i = 1; i < nsrc; i++) {
+    Pos p = PosMake(&srcs[i], srclen);
+    assert(PosSource(p) == &srcs[i]);
+    asserteq(PosOffs(p, &srcs[i]), srclen);
+    assert(PosMake(&srcs[i - 1], 0) != PosMake(&srcs[i], 0));
+  }
+
+  // there is no room for another large source (300 * 12 MB is more than 3.5 GB)
+  Source big;
+  errno = 0;
+  assert(!SourceInit(&big, name, NULL, 512 * 1024 * 1024));
+  asserteq(errno, EFBIG);
+  asserteq(big.posbase, 0);
+  asserteq(PosMake(&big, 1), NoPos);
+  SourceFree(&big);
+
+  // a source which grows past its positions is moved, unless it can be extended in place
+  Source* s = &srcs[nsrc / 2];
+  u32 base = s->posbase;
+  assert(SourceReplace(s, NULL, srclen - 1)); // shrinking keeps the positions
+  asserteq(s->posbase, base);
+  SourceFree(&srcs[nsrc / 2 + 1]);
+  assert(SourceReplace(s, NULL, srclen + 100)); // the next range is free
+  asserteq(s->posbase, base);
+  asserteq(s->_prevposbase, base);
+  assert(PosSource(PosMake(s, srclen + 100)) == s);
+  SourceFree(&srcs[nsrc / 2 + 2]);
+  assert(SourceReplace(s, NULL, 4 * srclen)); // too large to extend; moved
+  assert(s->posbase != base);
+  asserteq(s->_prevposbase, base);
+  assert(PosSource(PosMake(s, 4 * srclen)) == s);
+  assert(PosSource(base) == NULL);
+  errno = 0;
+  assert(!SourceReplace(s, NULL, 1024u * 1024 * 1024)); // no room
+  asserteq(errno, EFBIG);
+  asserteq(s->posbase, 0);
+
+  for (u32 i = 0; i < nsrc; i++) {
+    if (i != nsrc / 2 + 1 && i != nsrc / 2 + 2) {
+      SourceFree(&srcs[i]);
+    }
+  }
+  memfree(NULL, srcs);
+  sdsfree(name);
+}
+W_UNIT_TEST(Pos, { test_pos(); })
+#endif
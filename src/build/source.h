@@ -2,19 +2,38 @@
 #include "../common/defs.h"
 #include "../common/str.h"
 
+// SourceUTF8 describes the text encoding of a Source
+typedef enum SourceUTF8 {
+  SourceUTF8Unknown = 0, // not yet checked
+  SourceUTF8ASCII,       // all bytes are ASCII
+  SourceUTF8Valid,       // valid UTF-8 with some non-ASCII characters
+  SourceUTF8Invalid,     // invalid UTF-8; the first invalid byte is at _utf8err
+} SourceUTF8;
+
 // Source
 typedef struct {
   Str       name;
-  const u8* buf;       // owned by caller
-  size_t    len;       // length of buf
+  const u8* buf;       // owned by caller, unless opened with SourceOpen
+  size_t    len;       // length of buf. Note that buf is not NUL terminated.
+  bool      _mapped;   // buf is a file mapping owned by the Source (see SourceOpen)
+  u8        _utf8;     // SourceUTF8 (see SourceCheckUTF8)
+  u32       _utf8err;  // offset of the first invalid UTF-8 sequence (with SourceUTF8Invalid)
+
+  // line table; _lineoffsets[N] is the offset of the first byte of line N.
+  // Built by the scanner as it goes, or on demand by SrcPosLineCol.
   u32*      _lineoffsets;
-  u32       _linecount;
+  u32       _linecount; // number of entries in _lineoffsets
+  u32       _linecap;   // capacity of _lineoffsets
+  u32       _lineend;   // all lines starting at or before this offset are recorded
+
+  // positions (see Pos); posbase is 0 if the source has no positions
+  u32       posbase;      // Pos of offset 0
+  u32       _possize;     // number of positions reserved, at least len+1
+  u32       _prevposbase; // posbase before the last SourceReplace
+  u32       _prevpossize; // _possize before the last SourceReplace
 } Source;
 
-// SrcPos
-// TODO: considering implementing something like lico and Pos/XPos from go
-//       https://golang.org/src/cmd/internal/src/pos.go
-//       https://golang.org/src/cmd/internal/src/xpos.go
+// SrcPos is a source position expanded for use, in diagnostics for instance
 typedef struct {
   Source* src;   // source
   u32     offs;  // offset into src->buf
@@ -24,11 +43,103 @@ typedef struct {
 // NoSrcPos is the "null" of SrcPos
 #define NoSrcPos (({ SrcPos p = {NULL,0,0}; p; }))
 
+// Pos is a compact source position, stored in AST nodes and IR values. Every live source is
+// given a range of positions [posbase, posbase+len] in a process-wide 32-bit position space,
+// so that every byte of every source (and the end of it) has a distinct Pos, which is
+// posbase + offset. This is like go's PosBase and XPos
+// (https://golang.org/src/cmd/internal/src/xpos.go.) A range is reserved by SourceInit and
+// released by SourceFree, so Pos is only valid while its source is. The ranges of all live
+// sources must fit in the position space, which limits their total size to about 4 GB.
+// Positions do not carry a span; see SourceSpan. PosSrcPos expands a Pos to a SrcPos.
+typedef u32 Pos;
+
+// NoPos is the "null" of Pos. Predefined nodes like Type_int have no position.
+#define NoPos ((Pos)0)
+
 // LineCol
 typedef struct { u32 line; u32 col; } LineCol;
 
-void SourceInit(Source*, Str name, const u8* buf, size_t len);
+// SourceInit initializes a Source and reserves positions for it.
+// Returns false with errno set to EFBIG if there is not room for len+1 positions in the
+// position space (see Pos), in which case the source has no positions (posbase is 0.)
+bool SourceInit(Source*, Str name, const u8* buf, size_t len);
 void SourceFree(Source*);
+
+// SourceOpen initializes a Source with the contents of the file at name, which is mapped
+// into memory rather than copied. The mapping is released by SourceFree.
+// Returns false on error (errno is set; EFBIG as with SourceInit.)
+bool SourceOpen(Source*, Str name);
+
+// SourceReplace changes the contents of a source to buf, which is owned by the caller.
+// The line table is discarded (and rebuilt as needed.) When the source grows past the
+// positions reserved for it, and they can not be extended, the source is given a new range
+// of positions and existing positions in it become invalid. The previous range is recorded
+// in _prevposbase and _prevpossize for ParseEdit, which moves the nodes it keeps.
+// Returns false with errno set to EFBIG if there is no room for the positions of the source,
+// in which case the source has no positions.
+bool SourceReplace(Source*, const u8* buf, size_t len);
+
+// SourceCheckUTF8 validates the text of a source. The result is remembered, so only the
+// first call for a source does any work.
+SourceUTF8 SourceCheckUTF8(Source*);
+
+// SourceAddLine records that a line starts at offs, which must be just after a line feed.
+// Lines must be added in order and only when offs > _lineend. Called by the scanner.
+static void SourceAddLine(Source*, u32 offs);
+
+// SourceSpan returns the length of the token which starts at offs, computed from the text
+// the same way the scanner does, or 0 if there is none (e.g. for the end of the source.)
+// Nodes are positioned at the start of their token, so this is the span of a node.
+u32 SourceSpan(const Source*, u32 offs);
+
 Str SrcPosMsg(Str s, SrcPos, ConstStr message);
 Str SrcPosFmt(Str s, SrcPos pos); // "<file>:<line>:<col>"
 LineCol SrcPosLineCol(SrcPos);
+
+// PosMake returns the position of offs in a source. offs must be <= len; the position of len
+// is the end of the source. Returns NoPos for a source without positions.
+static Pos PosMake(const Source*, u32 offs);
+
+// PosInSource returns true if p is a position in the source
+static bool PosInSource(Pos p, const Source*);
+
+// PosOffs returns the offset of p in the source, which p must be a position in
+static u32 PosOffs(Pos p, const Source*);
+
+// PosSource returns the source of a position, or NULL for NoPos (or an invalid position.)
+// This looks the position up in the table of sources; PosInSource is cheaper when the
+// source is known.
+Source* PosSource(Pos);
+
+// PosSrcPos expands a position, with its span from SourceSpan. The end of a source is
+// expanded to its last byte, with a span of 0.
+SrcPos PosSrcPos(Pos);
+
+// -----------------------------------------------------------------------------------------------
+// inline and internal implementations
+
+void _SourceGrowLines(Source*, u32 addl);
+
+inline static Pos PosMake(const Source* s, u32 offs) {
+  assert(offs <= s->len);
+  return s->posbase == 0 ? NoPos : s->posbase + offs;
+}
+
+inline static bool PosInSource(Pos p, const Source* s) {
+  // (NoPos - posbase) wraps around to at least _possize
+  return p - s->posbase < s->_possize;
+}
+
+inline static u32 PosOffs(Pos p, const Source* s) {
+  assert(PosInSource(p, s));
+  return p - s->posbase;
+}
+
+inline static void SourceAddLine(Source* s, u32 offs) {
+  assert(offs > s->_lineend);
+  if (s->_linecount == s->_linecap) {
+    _SourceGrowLines(s, 1);
+  }
+  s->_lineoffsets[s->_linecount++] = offs;
+  s->_lineend = offs;
+}
@@ -4,6 +4,8 @@
 // ARRAY_CAP_STEP defines a power-of-two which the cap must be aligned to.
 // This is used to round up growth. I.e. grow by 60 with a cap of 32 would increase the cap
 // to 96 (= 32 + (align2(60, ARRAY_CAP_STEP=32) = 64)).
+// Arrays grow by at least their current cap, so that pushing n entries copies O(n) entries.
+// (This also matters for arena memory, where memrealloc can not reuse the old memory.)
 #define ARRAY_CAP_STEP 32
 
 typedef struct SortCtx {
@@ -27,7 +29,7 @@ void ArraySort(Array* a, ArraySortFun* f, void* userdata) {
 
 
 void ArrayGrow(Array* a, size_t addl, Memory mem) {
-  u32 reqcap = a->cap + addl;
+  u32 reqcap = a->cap + max(addl, (size_t)a->cap);
   u32 cap = align2(reqcap, ARRAY_CAP_STEP);
   if (a->onheap || a->v == NULL) {
     a->v = memrealloc(mem, a->v, sizeof(void*) * cap);
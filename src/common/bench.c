@@ -0,0 +1,173 @@
+#include "bench.h"
+#include "os.h"
+
+static Bench* benchHead = NULL;
+static Bench* benchTail = NULL;
+
+
+void BenchRegister(Bench* b) {
+  // keep registration (i.e. source) order
+  if (benchTail) {
+    benchTail->next = b;
+  } else {
+    benchHead = b;
+  }
+  benchTail = b;
+}
+
+
+void BenchStartTimer(Bench* b) {
+  if (!b->timerOn) {
+    b->start = os_nanotime();
+    b->timerOn = true;
+  }
+}
+
+
+void BenchStopTimer(Bench* b) {
+  if (b->timerOn) {
+    b->elapsed += os_nanotime() - b->start;
+    b->timerOn = false;
+  }
+}
+
+
+void BenchResetTimer(Bench* b) {
+  if (b->timerOn) {
+    b->start = os_nanotime();
+  }
+  b->elapsed = 0;
+}
+
+
+void BenchSkip(Bench* b, const char* reason) {
+  BenchStopTimer(b);
+  b->skipped = reason;
+}
+
+
+static void benchRunN(Bench* b, u64 n) {
+  b->N = n;
+  b->elapsed = 0;
+  b->timerOn = false;
+  BenchStartTimer(b);
+  b->fn(b);
+  BenchStopTimer(b);
+}
+
+
+// benchRun runs b with increasing N until it takes at least goalns nanoseconds.
+// Like Go's testing.B, N is predicted from the previous run rather than simply doubled.
+static void benchRun(Bench* b, u64 goalns) {
+  u64 n = 1;
+  benchRunN(b, n);
+  while (b->elapsed < goalns && n < 1000000000 && b->skipped == NULL) {
+    u64 prevn = n;
+    u64 prevns = max(b->elapsed, 1ull);
+    n = (goalns * prevn) / prevns;
+    n += n / 5;             // run 20% more than predicted
+    n = min(n, prevn * 100); // don't grow too fast in case of mispredictions
+    n = max(n, prevn + 1);  // guarantee progress
+    benchRunN(b, n);
+  }
+}
+
+
+// benchRate returns count per second, given nanoseconds per operation
+static double benchRate(u64 count, double nsop) {
+  return (double)count / (nsop / 1e9);
+}
+
+
+static void benchPrint(const Bench* b) {
+  if (b->skipped) {
+    printf("Bench%-28s skipped: %s\n", b->name, b->skipped);
+    return;
+  }
+  double nsop = (double)b->elapsed / (double)b->N;
+  printf("Bench%-28s %10llu %14.0f ns/op", b->name, b->N, nsop);
+  if (b->bytes > 0) {
+    printf(" %10.2f MB/s", benchRate(b->bytes, nsop) / 1000000.0);
+  }
+  if (b->tokens > 0) {
+    printf(" %10.2f Mtokens/s", benchRate(b->tokens, nsop) / 1000000.0);
+  }
+  if (b->nodes > 0) {
+    printf(" %10.2f Mnodes/s", benchRate(b->nodes, nsop) / 1000000.0);
+  }
+  if (b->items > 0) {
+    printf(" %10.2f M%s/s", benchRate(b->items, nsop) / 1000000.0, b->unit ? b->unit : "items");
+  }
+  printf("\n");
+}
+
+
+
+static bool benchMatch(const Bench* b, int argc, char** argv) {
+  if (argc < 2) {
+    return true;
+  }
+  for (int i = 1; i < argc; i++) {
+    if (strstr(b->name, argv[i]) != NULL) {
+      return true;
+    }
+  }
+  return false;
+}
+
+
+// benchWriteJSON writes the results of benchmarks which ran to f, as one object per
+// benchmark. Rates are per second; fields for metrics a benchmark does not report are omitted.
+static void benchWriteJSON(FILE* f, int argc, char** argv) {
+  fprintf(f, "{\n  \"benchmarks\": [");
+  const char* sep = "\n";
+  for (Bench* b = benchHead; b; b = b->next) {
+    if (!benchMatch(b, argc, argv) || b->skipped || b->N == 0) {
+      continue;
+    }
+    double nsop = (double)b->elapsed / (double)b->N;
+    fprintf(f, "%s    {\"name\": \"%s\", \"N\": %llu, \"ns_per_op\": %.1f",
+      sep, b->name, b->N, nsop);
+    if (b->bytes > 0) {
+      fprintf(f, ", \"bytes_per_s\": %.0f", benchRate(b->bytes, nsop));
+    }
+    if (b->tokens > 0) {
+      fprintf(f, ", \"tokens_per_s\": %.0f", benchRate(b->tokens, nsop));
+    }
+    if (b->nodes > 0) {
+      fprintf(f, ", \"nodes_per_s\": %.0f", benchRate(b->nodes, nsop));
+    }
+    if (b->items > 0) {
+      fprintf(f, ", \"%s_per_s\": %.0f", b->unit ? b->unit : "items", benchRate(b->items, nsop));
+    }
+    fprintf(f, "}");
+    sep = ",\n";
+  }
+  fprintf(f, "\n  ]\n}\n");
+}
+
+
+int BenchMain(int argc, char** argv) {
+  u64 goalns = 1000000000; // 1s
+  const char* benchtime = getenv("W_BENCH_TIME");
+  if (benchtime != NULL && atoi(benchtime) > 0) {
+    goalns = (u64)atoi(benchtime) * 1000000;
+  }
+  for (Bench* b = benchHead; b; b = b->next) {
+    if (benchMatch(b, argc, argv)) {
+      benchRun(b, goalns);
+      benchPrint(b);
+    }
+  }
+  const char* jsonfile = getenv("W_BENCH_JSON");
+  if (jsonfile != NULL && *jsonfile != 0) {
+    FILE* f = fopen(jsonfile, "w");
+    if (f == NULL) {
+      logerr("%s: %s", jsonfile, strerror(errno));
+      return 1;
+    }
+    benchWriteJSON(f, argc, argv);
+    fclose(f);
+  }
+  return 0;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include "defs.h"
+//
+// benchmarking
+//
+// Preprocessor macros:
+//   W_BENCH_BUILD is defined for the "bench" target product (but not for "debug" or "test".)
+//   W_BENCHMARK(name, body) defines a benchmark to be run by the "bench" product.
+//
+// Benchmarks live in *_bench.c files which are only compiled into the "bench" product.
+// The body of a benchmark has access to a variable b of type Bench* and should perform
+// its work b->N times. N is picked by the runner so that each benchmark runs for about
+// one second (W_BENCH_TIME=<milliseconds> changes this.) Results are printed on stdout and,
+// when W_BENCH_JSON=<file> is set, also written to file as JSON (see misc/bench_compare.py.)
+// Example:
+//
+//   W_BENCHMARK(Hash, {
+//     b->bytes = sizeof(data); // report MB/s
+//     for (u64 i = 0; i < b->N; i++)
+//       hashFNV1a(data, sizeof(data));
+//   })
+//
+
+typedef struct Bench Bench;
+typedef void(BenchFun)(Bench*);
+
+struct Bench {
+  u64         N;     // number of iterations the body should perform
+  u64         bytes;  // bytes processed per iteration. Set by body to report MB/s.
+  u64         tokens; // tokens processed per iteration. Set by body to report tokens/s.
+  u64         nodes;  // AST nodes processed per iteration. Set by body to report nodes/s.
+  u64         items;  // items processed per iteration. Set by body to report <unit>/s.
+  const char* unit;   // name of items, e.g. "allocs". Defaults to "items".
+
+  // internal
+  const char* name;
+  BenchFun*   fn;
+  Bench*      next;
+  u64         start;   // timer start (os_nanotime)
+  u64         elapsed; // accumulated time in nanoseconds
+  bool        timerOn;
+  const char* skipped; // reason passed to BenchSkip
+};
+
+#ifdef W_BENCH_BUILD
+  #define W_BENCHMARK(NAME, body)                                                \
+    static void bench_##NAME##_fn(Bench* b) body                                 \
+    static Bench bench_##NAME = { .name = #NAME, .fn = bench_##NAME##_fn };      \
+    __attribute__((constructor)) static void bench_##NAME##_init() {             \
+      BenchRegister(&bench_##NAME);                                              \
+    }
+#else
+  #define W_BENCHMARK(NAME, body)
+#endif
+
+// BenchRegister adds a benchmark to the set run by BenchMain. Called by W_BENCHMARK.
+void BenchRegister(Bench*);
+
+// BenchMain runs all registered benchmarks with a name containing any of the strings in
+// argv[1:] (or all if argc < 2) and prints results on stdout. Returns a process exit status.
+int BenchMain(int argc, char** argv);
+
+// BenchStopTimer pauses timing, e.g. during expensive setup that should not be measured.
+void BenchStopTimer(Bench*);
+
+// BenchStartTimer resumes timing after a call to BenchStopTimer.
+void BenchStartTimer(Bench*);
+
+// BenchResetTimer zeroes elapsed time. Does not affect whether the timer is running.
+void BenchResetTimer(Bench*);
+
+// BenchSkip marks the benchmark as skipped, e.g. when its input is not available.
+// The body should return right after calling this. reason is printed in place of results.
+void BenchSkip(Bench*, const char* reason);
@@ -27,12 +27,15 @@
 #define USE_DL_PREFIX 1
 #define MSPACES 1
 #define NO_MALLINFO 1 /* disable mallinfo as we don't need it */
-#if DEBUG
-  // Enable extra checking by placing word-sized "footers" in every allocated chunk.
-  // This adds space and time overhead but does allow dlmalloc to detect errors like
-  // attempt to free a pointer in one mspace which was allocated in another.
-  #define FOOTERS 1
-#endif
+// Compile in locking support. Only mspaces created with locked=1 pay for it; see memory.c
+#define USE_LOCKS 1
+// Place word-sized "footers" in every allocated chunk which identify the chunk's mspace.
+// This adds space and time overhead but makes mspace_free and mspace_realloc operate on
+// the mspace which owns a chunk. The per-thread global memory spaces depend on this, since
+// an object may be freed by another thread than the one which allocated it (see memory.c.)
+// It also allows dlmalloc to detect errors like attempt to free a pointer in one mspace
+// which was allocated in another.
+#define FOOTERS 1
 
 #ifdef __cplusplus
 extern "C" {
@@ -1,4 +1,5 @@
 #include "hash.h"
+#include "test.h"
 
 u32 hashFNV1a(const u8* buf, size_t len) {
   const u32 prime = 0x01000193; // pow(2,24) + pow(2,8) + 0x93
@@ -19,3 +20,40 @@ u64 hashFNV1a64(const u8* buf, size_t len) {
   }
   return hash;
 }
+
+
+#if W_UNIT_TEST_ENABLED
+static void test_hashWY() {
+  // The hashes of predefined symbols are baked into src/sym.c, so hashWY must produce these
+  // exact values on every platform (byte order, with and without 128-bit integers.)
+  #define T(cstr, expect) asserteq(hashWY((const u8*)(cstr), strlen(cstr)), (u32)(expect));
+  T("",            0xE6B487D7)
+  T("a",           0x21008002)
+  T("abc",         0xC9F59DA5)
+  T("fun",         0x7507ACD2)
+  T("hello world", 0x7AB67B30)
+  T("0123456789abcdef",  0xFB783505) // largest input hashed without the 16-byte loop
+  T("0123456789abcdefg", 0xB2F6F966)
+  T("a_rather_long_identifier_in_generated_code_42", 0x8F2EA579)
+  #undef T
+
+  // Only the bytes in [buf,buf+len) affect the hash, at any alignment
+  u8 buf[80];
+  for (u32 len = 0; len <= 48; len++) {
+    for (u32 i = 0; i < sizeof(buf); i++) {
+      buf[i] = (u8)('a' + i % 26);
+    }
+    u32 h = hashWY(buf + 8, len);
+    memmove(buf + 3, buf + 8, len);
+    memset(buf, 0xFF, 3);
+    memset(buf + 3 + len, 0xFF, sizeof(buf) - 3 - len);
+    asserteq(hashWY(buf + 3, len), h);
+    if (len > 0) {
+      buf[3 + len - 1] ^= 1;
+      assert(hashWY(buf + 3, len) != h);
+    }
+  }
+}
+
+W_UNIT_TEST(HashWY, { test_hashWY(); })
+#endif
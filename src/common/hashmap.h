@@ -20,7 +20,7 @@
 #define HASHMAP_IS_INIT(m) ((m)->buckets != NULL)
 
 typedef struct {
-  u32    cap;     // number of buckets
+  u32    cap;     // number of buckets (or slots, depending on implementation)
   u32    len;     // number of key-value entries
   u32    flags;   //
   Memory mem;     // memory allocator. NULL = use global allocator
@@ -31,7 +31,7 @@ typedef struct {
 // Include declarations.
 // Normally these are copy-pasted and hand-converted in the user-level header.
 
-// New creates a new map with initbuckets intial buckets.
+// New creates a new map with room for initbuckets entries.
 HASHMAP_NAME* HM_FUN(New)(u32 initbuckets, Memory)
 
 // Free frees all memory of a map, including the map's memory.
@@ -39,7 +39,7 @@ HASHMAP_NAME* HM_FUN(New)(u32 initbuckets, Memory)
 // Use Dealloc when you manage the memory of the map yourself and used Init.
 void HM_FUN(Free)(HASHMAP_NAME*);
 
-// Init initializes a map structure. initbuckets is the number of initial buckets.
+// Init initializes a map structure with room for initbuckets entries.
 void HM_FUN(Init)(HASHMAP_NAME*, u32 initbuckets, Memory);
 
 // Dealloc frees buckets data (but not the hashmap itself.)
@@ -0,0 +1,126 @@
+#include "bench.h"
+#include "hash.h"
+#include "memory.h"
+
+// Benchmarks of the two hashmap implementations, hashmap.c.h (buckets of 6 entries) and
+// hashmap_swiss.c.h (used by SymMap and PtrMap), with pointer keys as used by PtrMap.
+// Benchmarks are named Map<Op><Impl><Size>, e.g. "MapGetSwiss1K".
+
+#define ptrhash(ptr) ((size_t)hashPtr(ptr)) // same as in ptrmap.c
+
+#define HASHMAP_NAME     BucketMap
+#define HASHMAP_KEY      const void*
+#define HASHMAP_VALUE    void*
+#include "hashmap.h"
+typedef void(BucketMapIterator)(const void* key, void* value, bool* stop, void* userdata);
+#define HASHMAP_KEY_HASH ptrhash
+#include "hashmap.c.h"
+#undef HASHMAP_NAME
+#undef HASHMAP_KEY
+#undef HASHMAP_VALUE
+#undef HASHMAP_KEY_HASH
+
+#define HASHMAP_NAME     SwissMap
+#define HASHMAP_KEY      const void*
+#define HASHMAP_VALUE    void*
+#include "hashmap.h"
+typedef void(SwissMapIterator)(const void* key, void* value, bool* stop, void* userdata);
+#define HASHMAP_KEY_HASH ptrhash
+#include "hashmap_swiss.c.h"
+#undef HASHMAP_NAME
+#undef HASHMAP_KEY
+#undef HASHMAP_VALUE
+#undef HASHMAP_KEY_HASH
+
+
+// benchKeys returns n distinct keys: the addresses of n consecutive 16-byte objects, which
+// is what PtrMap keys usually look like (AST nodes, IR values.)
+static const void** benchKeys(u32 n) {
+  static u8* objects = NULL;
+  static u32 nobjects = 0;
+  if (nobjects < n) {
+    memfree(NULL, objects);
+    objects = (u8*)memalloc(NULL, (size_t)n * 16);
+    nobjects = n;
+  }
+  auto keys = (const void**)memalloc(NULL, sizeof(void*) * n);
+  for (u32 i = 0; i < n; i++) {
+    keys[i] = &objects[(size_t)i * 16];
+  }
+  return keys;
+}
+
+
+// MAP_BENCH defines benchmarks for map implementation IMPL (BucketMap or SwissMap):
+//   Insert: build a map of n entries, starting from the smallest map
+//   Get:    look up all n keys of a map
+//   Miss:   look up n keys which are not in a map of n entries
+#define MAP_BENCH(IMPL, NAME, SIZENAME, n)                                              \
+  W_BENCHMARK(MapInsert##NAME##SIZENAME, {                                              \
+    BenchStopTimer(b);                                                                  \
+    auto keys = benchKeys(n);                                                           \
+    BenchStartTimer(b);                                                                 \
+    for (u64 i = 0; i < b->N; i++) {                                                    \
+      IMPL m = {0};                                                                     \
+      IMPL##Init(&m, 1, NULL);                                                          \
+      for (u32 j = 0; j < n; j++) {                                                     \
+        IMPL##Set(&m, keys[j], (void*)keys[j]);                                         \
+      }                                                                                 \
+      IMPL##Dealloc(&m);                                                                \
+    }                                                                                   \
+    b->items = n;                                                                       \
+    b->unit = "ops";                                                                    \
+    memfree(NULL, keys);                                                                \
+  })                                                                                    \
+  W_BENCHMARK(MapGet##NAME##SIZENAME, {                                                 \
+    BenchStopTimer(b);                                                                  \
+    auto keys = benchKeys(n);                                                           \
+    IMPL m = {0};                                                                       \
+    IMPL##Init(&m, 1, NULL);                                                            \
+    for (u32 j = 0; j < n; j++) {                                                       \
+      IMPL##Set(&m, keys[j], (void*)keys[j]);                                           \
+    }                                                                                   \
+    BenchStartTimer(b);                                                                 \
+    for (u64 i = 0; i < b->N; i++) {                                                    \
+      for (u32 j = 0; j < n; j++) {                                                     \
+        if (IMPL##Get(&m, keys[j]) != keys[j]) {                                        \
+          die("MapGet" #NAME ": missing key");                                          \
+        }                                                                               \
+      }                                                                                 \
+    }                                                                                   \
+    BenchStopTimer(b);                                                                  \
+    b->items = n;                                                                       \
+    b->unit = "ops";                                                                    \
+    IMPL##Dealloc(&m);                                                                  \
+    memfree(NULL, keys);                                                                \
+  })                                                                                    \
+  W_BENCHMARK(MapMiss##NAME##SIZENAME, {                                                \
+    BenchStopTimer(b);                                                                  \
+    auto keys = benchKeys(n * 2);                                                       \
+    IMPL m = {0};                                                                       \
+    IMPL##Init(&m, 1, NULL);                                                            \
+    for (u32 j = 0; j < n; j++) {                                                       \
+      IMPL##Set(&m, keys[j], (void*)keys[j]);                                           \
+    }                                                                                   \
+    BenchStartTimer(b);                                                                 \
+    for (u64 i = 0; i < b->N; i++) {                                                    \
+      for (u32 j = n; j < n * 2; j++) {                                                 \
+        if (IMPL##Get(&m, keys[j]) != NULL) {                                           \
+          die("MapMiss" #NAME ": unexpected key");                                      \
+        }                                                                               \
+      }                                                                                 \
+    }                                                                                   \
+    BenchStopTimer(b);                                                                  \
+    b->items = n;                                                                       \
+    b->unit = "ops";                                                                    \
+    IMPL##Dealloc(&m);                                                                  \
+    memfree(NULL, keys);                                                                \
+  })
+
+#define MAP_BENCH_SIZES(IMPL, NAME)    \
+  MAP_BENCH(IMPL, NAME, 8,  8)         \
+  MAP_BENCH(IMPL, NAME, 1K, 1000)      \
+  MAP_BENCH(IMPL, NAME, 1M, 1000000)
+
+MAP_BENCH_SIZES(BucketMap, Bucket)
+MAP_BENCH_SIZES(SwissMap,  Swiss)
@@ -0,0 +1,347 @@
+// Hash map with open addressing and SIMD probing, in the style of Swiss tables
+// (https://abseil.io/about/design/swisstables). Implements the API of hashmap.h and is a
+// drop-in replacement for the bucket-based implementation in hashmap.c.h.
+//
+// example:
+// #define HASHMAP_NAME     FooMap
+// #define HASHMAP_KEY      Foo
+// #define HASHMAP_KEY_HASH FooHash  // should return an unsigned integer
+// #define HASHMAP_VALUE    char*
+//
+// Entries are stored in one array of slots which is divided into groups of 16. Every slot
+// has a control byte, stored separately from the slots:
+//
+//   0x00     empty
+//   0x01     deleted (a "tombstone")
+//   0x80|h2  full, where h2 is the low 7 bits of the key's hash
+//
+// A key is looked up by probing groups, starting at the group selected by the rest of the
+// hash. The 16 control bytes of a group are compared with h2 at once, and only the slots which
+// match are compared with the key. Since the probe sequence of a key ends at the first group
+// with an empty slot, a deleted slot can be marked empty (rather than deleted) when its group
+// has an empty slot, which is usually the case. At most 7/8 of all slots are full or deleted.
+//
+// The storage ("buckets" in the map struct) is a header, followed by the control bytes,
+// followed by the slots. Memory returned by memalloc is zeroed, which makes all slots empty.
+//
+#ifndef HASHMAP_NAME
+#error "please define HASHMAP_NAME"
+#endif
+#ifndef HASHMAP_KEY
+#error "please define HASHMAP_KEY"
+#endif
+#ifndef HASHMAP_KEY_HASH
+#error "please define HASHMAP_KEY_HASH"
+#endif
+#ifndef HASHMAP_VALUE
+#error "please define HASHMAP_VALUE"
+#endif
+
+#define _HM_MAKE_FN_NAME(a, b) a ## b
+#define _HM_FUN(prefix, name) _HM_MAKE_FN_NAME(prefix, name)
+#define HM_FUN(name) _HM_FUN(HASHMAP_NAME, name)
+#define HM_SLOT _HM_FUN(HASHMAP_NAME, Slot)
+
+// definitions shared by all maps, independent of the template parameters
+#ifndef HMSW_GROUP_SIZE
+#define HMSW_GROUP_SIZE 16
+
+typedef enum HMSwFlag {
+  HMSwFlagNone = 0,
+  HMSwFlagMemoryDense = 1 << 0,  // storage is inside map memory. used by Free
+} HMSwFlag;
+
+enum {
+  HMSwEmpty   = 0x00,
+  HMSwDeleted = 0x01,
+  HMSwFull    = 0x80,
+};
+
+typedef struct HMSwHeader {
+  u32 ndeleted; // number of deleted slots
+  u32 _unused[3];
+} HMSwHeader;
+
+// control bytes of a map's storage
+#define HMSW_CTRL(storage) ((u8*)(storage) + sizeof(HMSwHeader))
+
+// _hmswMatch returns a mask with bit i set for every ctrl[i] == c of a group.
+// _hmswMatchFull returns a mask of the full slots of a group.
+#if defined(__SSE2__)
+  #include <emmintrin.h>
+  inline static u32 _hmswMatch(const u8* ctrl, u8 c) {
+    __m128i g = _mm_loadu_si128((const __m128i*)ctrl);
+    return (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8((char)c)));
+  }
+  inline static u32 _hmswMatchFull(const u8* ctrl) {
+    return (u32)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)ctrl));
+  }
+#else
+  inline static u32 _hmswMatch(const u8* ctrl, u8 c) {
+    u32 mask = 0;
+    for (u32 i = 0; i < HMSW_GROUP_SIZE; i++) {
+      mask |= (u32)(ctrl[i] == c) << i;
+    }
+    return mask;
+  }
+  inline static u32 _hmswMatchFull(const u8* ctrl) {
+    u32 mask = 0;
+    for (u32 i = 0; i < HMSW_GROUP_SIZE; i++) {
+      mask |= (u32)(ctrl[i] >> 7) << i;
+    }
+    return mask;
+  }
+#endif
+
+// _hmswCap returns the number of slots needed to hold n entries (a power of two)
+inline static u32 _hmswCap(u32 n) {
+  u32 cap = HMSW_GROUP_SIZE;
+  while (cap - cap / 8 < n) {
+    cap *= 2;
+  }
+  return cap;
+}
+
+#endif /* HMSW_GROUP_SIZE */
+
+typedef struct {
+  HASHMAP_KEY   key;
+  HASHMAP_VALUE value;
+} HM_SLOT;
+
+inline static size_t HM_FUN(_storageSize)(u32 cap) {
+  return sizeof(HMSwHeader) + cap + cap * sizeof(HM_SLOT);
+}
+
+inline static HM_SLOT* HM_FUN(_slots)(const void* storage, u32 cap) {
+  return (HM_SLOT*)(HMSW_CTRL(storage) + cap);
+}
+
+
+void HM_FUN(Init)(HASHMAP_NAME* m, u32 initbuckets, Memory mem) {
+  m->cap = _hmswCap(initbuckets);
+  m->len = 0;
+  m->flags = HMSwFlagNone;
+  m->mem = mem;
+  m->buckets = memalloc(mem, HM_FUN(_storageSize)(m->cap));
+}
+
+HASHMAP_NAME* HM_FUN(New)(u32 initbuckets, Memory mem) {
+  // new differs from Init in that it allocates space for itself and the initial
+  // storage in one go. This is usually a little bit faster and reduces memory
+  // fragmentation in cases where many hashmaps are created.
+  u32 cap = _hmswCap(initbuckets);
+  char* ptr = memalloc(mem, align2(sizeof(HASHMAP_NAME), 16) + HM_FUN(_storageSize)(cap));
+  auto m = (HASHMAP_NAME*)ptr;
+  m->cap = cap;
+  m->mem = mem;
+  m->flags = HMSwFlagMemoryDense;
+  m->buckets = ptr + align2(sizeof(HASHMAP_NAME), 16);
+  return m;
+}
+
+void HM_FUN(Dealloc)(HASHMAP_NAME* m) {
+  // should never call Dealloc on a map created with New
+  assert(!(m->flags & HMSwFlagMemoryDense));
+
+  memfree(m->mem, m->buckets);
+  #if DEBUG
+  m->buckets = NULL;
+  m->len = 0;
+  m->cap = 0;
+  #endif
+}
+
+void HM_FUN(Free)(HASHMAP_NAME* m) {
+  if (!(m->flags & HMSwFlagMemoryDense)) {
+    memfree(m->mem, m->buckets);
+  }
+  memfree(m->mem, m);
+}
+
+
+// HM_FUN(_find) returns the slot index of key, or -1 if key is not in m
+inline static i64 HM_FUN(_find)(const HASHMAP_NAME* m, HASHMAP_KEY key, size_t hash) {
+  const u8* ctrl = HMSW_CTRL(m->buckets);
+  const HM_SLOT* slots = HM_FUN(_slots)(m->buckets, m->cap);
+  u8 h2 = HMSwFull | (u8)(hash & 0x7F);
+  u32 gmask = m->cap / HMSW_GROUP_SIZE - 1;
+  u32 g = (u32)(hash >> 7) & gmask;
+  for (u32 step = 1; ; step++) {
+    u32 base = g * HMSW_GROUP_SIZE;
+    for (u32 match = _hmswMatch(&ctrl[base], h2); match != 0; match &= match - 1) {
+      u32 i = base + (u32)__builtin_ctz(match);
+      if (slots[i].key == key) {
+        return i;
+      }
+    }
+    if (_hmswMatch(&ctrl[base], HMSwEmpty) != 0) {
+      return -1;
+    }
+    g = (g + step) & gmask; // triangular probing visits every group
+  }
+}
+
+
+// HM_FUN(_findFree) returns the index of the first empty or deleted slot in the probe
+// sequence of hash. There must be at least one such slot.
+inline static u32 HM_FUN(_findFree)(const u8* ctrl, u32 cap, size_t hash) {
+  u32 gmask = cap / HMSW_GROUP_SIZE - 1;
+  u32 g = (u32)(hash >> 7) & gmask;
+  for (u32 step = 1; ; step++) {
+    u32 base = g * HMSW_GROUP_SIZE;
+    u32 avail = ~_hmswMatchFull(&ctrl[base]) & 0xFFFF;
+    if (avail != 0) {
+      return base + (u32)__builtin_ctz(avail);
+    }
+    g = (g + step) & gmask;
+  }
+}
+
+
+// HM_FUN(_resize) moves all entries to new storage with cap slots, dropping deleted slots
+static void HM_FUN(_resize)(HASHMAP_NAME* m, u32 cap) {
+  void* storage = memalloc(m->mem, HM_FUN(_storageSize)(cap));
+  u8* ctrl = HMSW_CTRL(storage);
+  HM_SLOT* slots = HM_FUN(_slots)(storage, cap);
+  if (m->buckets != NULL) {
+    const u8* ctrl0 = HMSW_CTRL(m->buckets);
+    const HM_SLOT* slots0 = HM_FUN(_slots)(m->buckets, m->cap);
+    for (u32 i = 0; i < m->cap; i++) {
+      if (ctrl0[i] & HMSwFull) {
+        size_t hash = (size_t)HASHMAP_KEY_HASH(slots0[i].key);
+        u32 j = HM_FUN(_findFree)(ctrl, cap, hash);
+        ctrl[j] = HMSwFull | (u8)(hash & 0x7F);
+        slots[j] = slots0[i];
+      }
+    }
+    if (!(m->flags & HMSwFlagMemoryDense)) {
+      memfree(m->mem, m->buckets);
+    }
+  }
+  m->buckets = storage;
+  m->cap = cap;
+  m->flags &= ~HMSwFlagMemoryDense;
+}
+
+
+// HM_FUN(Set) inserts key=value into m.
+// Returns replaced value or NULL if key did not exist in map.
+HASHMAP_VALUE HM_FUN(Set)(HASHMAP_NAME* m, HASHMAP_KEY key, HASHMAP_VALUE value) {
+  assert(value != NULL);
+  size_t hash = (size_t)HASHMAP_KEY_HASH(key);
+  u8 h2 = HMSwFull | (u8)(hash & 0x7F);
+  if (m->buckets == NULL) {
+    HM_FUN(_resize)(m, HMSW_GROUP_SIZE);
+  }
+
+  // Look for key, like _find, and remember the first free slot on the way
+  u8* ctrl = HMSW_CTRL(m->buckets);
+  HM_SLOT* slots = HM_FUN(_slots)(m->buckets, m->cap);
+  u32 gmask = m->cap / HMSW_GROUP_SIZE - 1;
+  u32 g = (u32)(hash >> 7) & gmask;
+  i64 i = -1;
+  for (u32 step = 1; ; step++) {
+    u32 base = g * HMSW_GROUP_SIZE;
+    for (u32 match = _hmswMatch(&ctrl[base], h2); match != 0; match &= match - 1) {
+      auto e = &slots[base + (u32)__builtin_ctz(match)];
+      if (e->key == key) {
+        // key already in map -- replace value
+        auto oldval = e->value;
+        e->value = value;
+        return oldval;
+      }
+    }
+    u32 avail = ~_hmswMatchFull(&ctrl[base]) & 0xFFFF;
+    if (i < 0 && avail != 0) {
+      i = base + (u32)__builtin_ctz(avail);
+    }
+    if (_hmswMatch(&ctrl[base], HMSwEmpty) != 0) {
+      break;
+    }
+    g = (g + step) & gmask;
+  }
+
+  auto hp = (HMSwHeader*)m->buckets;
+  if (ctrl[i] == HMSwDeleted) {
+    hp->ndeleted--;
+  } else if (m->len + hp->ndeleted + 1 > m->cap - m->cap / 8) {
+    // Too full. Grow, unless more than half of the full-or-deleted slots are deleted, in
+    // which case dropping them is enough.
+    u32 cap = hp->ndeleted > m->len ? m->cap : m->cap * 2;
+    HM_FUN(_resize)(m, cap);
+    ctrl = HMSW_CTRL(m->buckets);
+    slots = HM_FUN(_slots)(m->buckets, m->cap);
+    i = HM_FUN(_findFree)(ctrl, m->cap, hash);
+  }
+  ctrl[i] = h2;
+  slots[i].key = key;
+  slots[i].value = value;
+  m->len++;
+  return NULL;
+}
+
+
+HASHMAP_VALUE HM_FUN(Del)(HASHMAP_NAME* m, HASHMAP_KEY key) {
+  if (m->buckets == NULL) {
+    return NULL;
+  }
+  i64 i = HM_FUN(_find)(m, key, (size_t)HASHMAP_KEY_HASH(key));
+  if (i < 0) {
+    return NULL;
+  }
+  u8* ctrl = HMSW_CTRL(m->buckets);
+  auto value = HM_FUN(_slots)(m->buckets, m->cap)[i].value;
+  // Lookups which reach this slot's group end there if the group has an empty slot,
+  // in which case this slot can be made empty too.
+  u32 base = (u32)i & ~(u32)(HMSW_GROUP_SIZE - 1);
+  if (_hmswMatch(&ctrl[base], HMSwEmpty) != 0) {
+    ctrl[i] = HMSwEmpty;
+  } else {
+    ctrl[i] = HMSwDeleted;
+    ((HMSwHeader*)m->buckets)->ndeleted++;
+  }
+  m->len--;
+  return value;
+}
+
+
+HASHMAP_VALUE HM_FUN(Get)(const HASHMAP_NAME* m, HASHMAP_KEY key) {
+  if (m->buckets == NULL) {
+    return NULL;
+  }
+  i64 i = HM_FUN(_find)(m, key, (size_t)HASHMAP_KEY_HASH(key));
+  return i < 0 ? NULL : HM_FUN(_slots)(m->buckets, m->cap)[i].value;
+}
+
+
+void HM_FUN(Clear)(HASHMAP_NAME* m) {
+  if (m->buckets != NULL) {
+    memset(m->buckets, 0, sizeof(HMSwHeader) + m->cap); // header and control bytes
+  }
+  m->len = 0;
+}
+
+
+void HM_FUN(Iter)(const HASHMAP_NAME* m, HM_FUN(Iterator)* it, void* userdata) {
+  if (m->buckets == NULL) {
+    return;
+  }
+  bool stop = false;
+  const u8* ctrl = HMSW_CTRL(m->buckets);
+  const HM_SLOT* slots = HM_FUN(_slots)(m->buckets, m->cap);
+  for (u32 base = 0; base < m->cap; base += HMSW_GROUP_SIZE) {
+    for (u32 full = _hmswMatchFull(&ctrl[base]); full != 0; full &= full - 1) {
+      auto e = &slots[base + (u32)__builtin_ctz(full)];
+      it(e->key, e->value, &stop, userdata);
+      if (stop) {
+        return;
+      }
+    }
+  }
+}
+
+#undef _HM_MAKE_FN_NAME
+#undef _HM_FUN
+#undef HM_FUN
+#undef HM_SLOT
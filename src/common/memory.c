@@ -2,10 +2,16 @@
 #include "array.h"
 #include "os.h"
 #include "test.h"
+#include "thread.h"
+#include <stdatomic.h>
 
 
 static size_t memPageSize = 0;
 
+static void memArenaFreeChunks(MemArenaChunk* c);
+static void memArenaReset(MemArena* a);
+static void memStatsResize(MemStats* st, size_t oldsize, size_t newsize);
+
 static void __attribute__((constructor)) init() {
   memPageSize = os_mempagesize();
 }
@@ -18,16 +24,334 @@ Memory MemoryNew(size_t initHint) {
 }
 
 void MemoryRecycle(Memory* memptr) {
-  // TODO: see if there is a way to make dlmalloc reuse msp
+  if (MemoryIsArena(*memptr)) {
+    auto a = _memArena(*memptr);
+    memArenaReset(a);
+    if (a->stats != NULL) {
+      a->stats->live = 0;
+    }
+    return;
+  }
+  // Note: dlmalloc has no way to reset an mspace. Use an arena where recycling matters.
   destroy_mspace(*memptr);
   *memptr = create_mspace(/*capacity*/memPageSize, /*locked*/0);
 }
 
 void MemoryFree(Memory mem) {
+  if (MemoryIsArena(mem)) {
+    auto a = _memArena(mem);
+    memArenaFreeChunks(a->chunks);
+    memArenaFreeChunks(a->spare);
+    if (a->stats != NULL) {
+      memfree(NULL, a->stats);
+    }
+    memfree(NULL, a);
+    return;
+  }
   destroy_mspace(mem);
 }
 
 
+// -----------------------------------------------------------------------------------------------
+// Arena
+//
+// Chunks are allocated from the global allocator, which returns zeroed memory. A chunk
+// starts with a MemArenaChunk header. The chunk list is ordered by allocation time, except
+// for "large" chunks holding a single allocation, which are linked in behind the current
+// chunk so that the rest of the current chunk is not wasted.
+//
+// MemoryRecycle moves chunks to the spare list, up to a->retain bytes, and frees the rest.
+// Chunks are zeroed again up to their high-water mark ("used") when they are retained, so
+// the spare list is ready to be allocated from.
+
+#define MEM_ARENA_CHUNK_MIN  (64 * 1024)
+#define MEM_ARENA_CHUNK_MAX  (1024 * 1024)
+
+struct MemArenaChunk {
+  MemArenaChunk* prev;
+  u8*            end;
+  u8*            used; // end of the memory used, for chunks other than the current one
+};
+
+// offset of the first byte of a chunk's memory
+#define MEM_ARENA_CHUNK_HDR align2(sizeof(MemArenaChunk), MEM_ARENA_ALIGN)
+
+#define MEM_ARENA_CHUNK_DATA(c) ((u8*)(c) + MEM_ARENA_CHUNK_HDR)
+
+
+Memory MemoryNewArena(size_t chunkHint) {
+  auto a = memalloct(NULL, MemArena);
+  a->chunksize = chunkHint == 0 ? MEM_ARENA_CHUNK_MIN : align2(chunkHint, MEM_ARENA_ALIGN);
+  a->retain = (size_t)-1;
+  return (Memory)((size_t)a | 1);
+}
+
+
+void MemorySetRetainLimit(Memory mem, size_t maxbytes) {
+  assert(MemoryIsArena(mem));
+  _memArena(mem)->retain = maxbytes;
+}
+
+
+static void memArenaFreeChunks(MemArenaChunk* c) {
+  while (c) {
+    auto prev = c->prev;
+    memfree(NULL, c);
+    c = prev;
+  }
+}
+
+
+static void memArenaReset(MemArena* a) {
+  if (a->ptr != NULL) {
+    a->chunks->used = a->ptr;
+  }
+  // spare chunks which were not used since the last reset count toward the limit first
+  size_t nretained = 0;
+  MemArenaChunk** cp = &a->spare;
+  while (*cp) {
+    size_t size = (size_t)((*cp)->end - MEM_ARENA_CHUNK_DATA(*cp));
+    if (size > a->retain - nretained) {
+      memArenaFreeChunks(*cp);
+      *cp = NULL;
+      break;
+    }
+    nretained += size;
+    cp = &(*cp)->prev;
+  }
+  auto c = a->chunks;
+  while (c) {
+    auto prev = c->prev;
+    u8* data = MEM_ARENA_CHUNK_DATA(c);
+    size_t size = (size_t)(c->end - data);
+    if (size <= a->retain - nretained) {
+      memset(data, 0, (size_t)(c->used - data));
+      c->used = data;
+      c->prev = a->spare;
+      a->spare = c;
+      nretained += size;
+    } else {
+      memfree(NULL, c);
+    }
+    c = prev;
+  }
+  a->ptr = NULL;
+  a->end = NULL;
+  a->last = NULL;
+  a->chunks = NULL;
+}
+
+
+static u8* memArenaNewChunk(size_t size) {
+  auto c = (MemArenaChunk*)memalloc(NULL, MEM_ARENA_CHUNK_HDR + size);
+  c->end = MEM_ARENA_CHUNK_DATA(c) + size;
+  return MEM_ARENA_CHUNK_DATA(c);
+}
+
+
+void* _memArenaAllocSlow(MemArena* a, size_t size) {
+  size = align2(size, MEM_ARENA_ALIGN);
+  if (size > a->chunksize / 4) {
+    // Large allocation; give it a chunk of its own
+    u8* p = memArenaNewChunk(size);
+    auto c = (MemArenaChunk*)(p - MEM_ARENA_CHUNK_HDR);
+    c->used = c->end;
+    if (a->chunks) {
+      c->prev = a->chunks->prev;
+      a->chunks->prev = c;
+    } else {
+      a->chunks = c;
+    }
+    return p;
+  }
+  if (a->ptr != NULL) {
+    a->chunks->used = a->ptr; // leaving the current chunk
+  }
+  u8* p;
+  auto c = a->spare;
+  if (c != NULL && size <= (size_t)(c->end - MEM_ARENA_CHUNK_DATA(c))) {
+    // reuse a chunk retained by MemoryRecycle
+    a->spare = c->prev;
+    p = MEM_ARENA_CHUNK_DATA(c);
+  } else {
+    p = memArenaNewChunk(a->chunksize);
+    c = (MemArenaChunk*)(p - MEM_ARENA_CHUNK_HDR);
+    if (a->chunksize < MEM_ARENA_CHUNK_MAX) {
+      a->chunksize *= 2;
+    }
+  }
+  c->prev = a->chunks;
+  a->chunks = c;
+  a->end = c->end;
+  a->ptr = p + size;
+  a->last = p;
+  return p;
+}
+
+
+void* _memArenaRealloc(MemArena* a, void* ptr, size_t newsize) {
+  if (ptr == NULL) {
+    return memalloc((Memory)((size_t)a | 1), newsize);
+  }
+  u8* p = (u8*)ptr;
+  if (p == a->last && newsize <= (size_t)(a->end - p)) {
+    // Most recent allocation; grow or shrink in place. Memory past the end of the
+    // allocation must stay zeroed for future allocations.
+    u8* newptr = p + align2(newsize, MEM_ARENA_ALIGN);
+    if (a->stats != NULL) {
+      memStatsResize(a->stats, (size_t)(a->ptr - p), (size_t)(newptr - p));
+    }
+    if (newptr < a->ptr) {
+      memset(newptr, 0, (size_t)(a->ptr - newptr));
+    }
+    a->ptr = newptr;
+    return p;
+  }
+  // The size of the old allocation is unknown; copy up to the end of its chunk.
+  // This may copy bytes from subsequent allocations, which is harmless as memory past
+  // the old size is undefined after realloc. A zero-size allocation may be at the end of
+  // its chunk (but never at the start of another chunk, which begins with a header.)
+  auto c = a->chunks;
+  while (c && !((u8*)c < p && p <= c->end)) {
+    c = c->prev;
+  }
+  assert(c != NULL); // ptr was not allocated in this arena
+  size_t avail = (size_t)(c->end - p);
+  u8* newp = memalloc((Memory)((size_t)a | 1), newsize);
+  memcpy(newp, p, newsize < avail ? newsize : avail);
+  return newp;
+}
+
+
+// -----------------------------------------------------------------------------------------------
+// Accounting
+//
+// Stats are updated with atomic operations since the global allocator is used by all threads.
+
+MemStats* _memGlobalStats = NULL;
+
+static const char* const memTagNames[MemTag_MAX] = {
+  "other", "Node", "NodeList", "Scope", "Sym", "IRValue", "IRBlock", "GC",
+};
+
+
+const char* MemTagName(MemTag tag) {
+  assert(tag >= 0 && tag < MemTag_MAX);
+  return memTagNames[tag];
+}
+
+
+size_t MemStatsClassMax(u32 i) {
+  return i + 1 < MEM_STATS_NCLASSES ? (size_t)16 << i : 0;
+}
+
+
+inline static u32 memStatsClass(size_t size) {
+  if (size <= 16) {
+    return 0;
+  }
+  u32 i = (u32)(64 - __builtin_clzll((u64)size - 1)) - 4; // ceil(log2(size)) - 4
+  return min(i, (u32)MEM_STATS_NCLASSES - 1);
+}
+
+
+// memStatsSub subtracts d from *p. Saturates at zero, since memory allocated before accounting
+// was enabled may be freed (or retagged.)
+static void memStatsSub(u64* p, u64 d) {
+  u64 v = __atomic_load_n(p, __ATOMIC_RELAXED);
+  while (!__atomic_compare_exchange_n(
+    p, &v, v > d ? v - d : 0, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+  {
+  }
+}
+
+
+// memStatsResize changes live bytes from oldsize to newsize
+static void memStatsResize(MemStats* st, size_t oldsize, size_t newsize) {
+  if (newsize >= oldsize) {
+    u64 live = __atomic_add_fetch(&st->live, (u64)(newsize - oldsize), __ATOMIC_RELAXED);
+    u64 peak = __atomic_load_n(&st->peak, __ATOMIC_RELAXED);
+    while (live > peak && !__atomic_compare_exchange_n(
+      &st->peak, &peak, live, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+    }
+  } else {
+    memStatsSub(&st->live, (u64)(oldsize - newsize));
+  }
+}
+
+
+// memStatsRetag attributes an allocation of size bytes which was counted for tag from to tag to
+static void memStatsRetag(MemStats* st, size_t size, MemTag from, MemTag to) {
+  memStatsSub(&st->tags[from].count, 1);
+  memStatsSub(&st->tags[from].bytes, (u64)size);
+  __atomic_add_fetch(&st->tags[to].count, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&st->tags[to].bytes, (u64)size, __ATOMIC_RELAXED);
+}
+
+
+void _memStatsAdd(MemStats* st, size_t size, MemTag tag) {
+  __atomic_add_fetch(&st->count, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&st->classes[memStatsClass(size)], 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&st->tags[tag].count, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&st->tags[tag].bytes, (u64)size, __ATOMIC_RELAXED);
+  memStatsResize(st, 0, size);
+}
+
+
+void* _memGlobalAllocStats(size_t size, MemTag tag) {
+  void* p = mspace_calloc(_GlobalMemory(), 1, size);
+  _memStatsAdd(_memGlobalStats, mspace_usable_size(p), tag);
+  return p;
+}
+
+
+void* _memGlobalReallocStats(void* ptr, size_t newsize) {
+  size_t oldsize = ptr == NULL ? 0 : mspace_usable_size(ptr);
+  void* p = mspace_realloc(_GlobalMemory(), ptr, newsize);
+  if (p == ptr) {
+    memStatsResize(_memGlobalStats, oldsize, mspace_usable_size(p));
+  } else {
+    memStatsResize(_memGlobalStats, oldsize, 0);
+    _memStatsAdd(_memGlobalStats, mspace_usable_size(p), MemTagNone);
+  }
+  return p;
+}
+
+
+void _memGlobalFreeStats(void* ptr) {
+  if (ptr != NULL) {
+    memStatsResize(_memGlobalStats, mspace_usable_size(ptr), 0);
+    mspace_free(_GlobalMemory(), ptr);
+  }
+}
+
+
+MemStats* MemoryEnableStats(Memory mem) {
+  MemStats** stp = &_memGlobalStats;
+  if (mem != NULL) {
+    assert(MemoryIsArena(mem)); // accounting is only supported for arenas and mem=NULL
+    stp = &_memArena(mem)->stats;
+  }
+  if (*stp == NULL) {
+    // Note: counted in the global stats, if enabled
+    auto st = memalloct(NULL, MemStats);
+    __atomic_store_n(stp, st, __ATOMIC_RELEASE);
+  } else {
+    memset(*stp, 0, sizeof(MemStats));
+  }
+  return *stp;
+}
+
+
+const MemStats* MemoryStats(Memory mem) {
+  if (mem == NULL) {
+    return _memGlobalStats;
+  }
+  return MemoryIsArena(mem) ? _memArena(mem)->stats : NULL;
+}
+
+
 char* memallocCStr(Memory mem, const char* pch, size_t len) {
   auto s = (char*)memalloc(mem, len + 1);
   memcpy(s, pch, len);
@@ -80,7 +404,10 @@ char* memsprintf(Memory mem, const char* format, ...) {
   size_t idealsize = (size_t)vsnprintf(buf, bufsize, format, ap);
   if (idealsize >= bufsize) {
     // buf is too small
-    buf = mspace_realloc(mem, buf, idealsize + 1);
+    buf = memrealloc(mem, buf, idealsize + 1);
+    bufsize = idealsize + 1;
+    va_end(ap);
+    va_start(ap, format); // ap was consumed by the first vsnprintf
     idealsize = (size_t)vsnprintf(buf, bufsize, format, ap);
     assert(idealsize < bufsize); // according to libc docs, this should be true
   }
@@ -94,17 +421,84 @@ typedef struct GC {
 } GC;
 
 
-/*__thread*/ Memory _gmem = NULL;
-/*__thread*/ GC tlsGC = { Array_INIT, Array_INIT };
+// Every thread has its own global memory space (_gmem) and GC generations (tlsGC), so
+// threads do not contend for a lock when allocating with memalloc(NULL, ...)
+//
+// Objects may outlive the thread that allocated them or be freed by another thread (e.g.
+// symbols interned while lexing in parallel, or line tables of SLexAllParallel chunks.)
+// This is safe because:
+// - dlmalloc is built with FOOTERS, so mspace_free and mspace_realloc find the space which
+//   owns a chunk from the chunk itself, regardless of the space passed to them.
+// - Thread spaces are locked. A thread taking its own lock is uncontended; the lock only
+//   serializes frees and reallocs from other threads.
+// - A thread's space is not destroyed when the thread exits, since objects allocated in it
+//   may still be in use. Instead it is handed off to a list of orphaned spaces from which
+//   the next thread to need a space takes it.
+static __thread Memory _gmem = NULL;
+static __thread GC tlsGC = { Array_INIT, Array_INIT };
+
+typedef struct MemOrphan MemOrphan;
+struct MemOrphan {
+  Memory     mem;
+  MemOrphan* next;
+};
+
+static atomic_flag memOrphanLock = ATOMIC_FLAG_INIT; // protects memOrphans
+static MemOrphan*  memOrphans = NULL; // spaces of exited threads (allocated in the space)
+static ThreadKey   memThreadKey;      // destructor hands off the thread's space
+static bool        memThreadKeyInit = false;
+
+
+static void memThreadExit(void* mem) {
+  assert(mem == _gmem);
+  // free all pending GC objects and the GC lists themselves
+  memgc_collect();
+  memgc_collect();
+  ArrayFree(&tlsGC.gen1, _gmem);
+  ArrayFree(&tlsGC.gen2, _gmem);
+  auto o = (MemOrphan*)mspace_malloc(mem, sizeof(MemOrphan));
+  o->mem = mem;
+  while (atomic_flag_test_and_set_explicit(&memOrphanLock, memory_order_acquire)) {
+  }
+  o->next = memOrphans;
+  memOrphans = o;
+  atomic_flag_clear_explicit(&memOrphanLock, memory_order_release);
+  _gmem = NULL;
+}
+
+
+static Memory memThreadInit() {
+  while (atomic_flag_test_and_set_explicit(&memOrphanLock, memory_order_acquire)) {
+  }
+  if (!memThreadKeyInit) {
+    if (ThreadKeyCreate(&memThreadKey, memThreadExit) != ThreadSuccess) {
+      die("ThreadKeyCreate failed");
+    }
+    memThreadKeyInit = true;
+  }
+  auto o = memOrphans;
+  if (o != NULL) {
+    memOrphans = o->next;
+  }
+  atomic_flag_clear_explicit(&memOrphanLock, memory_order_release);
+  if (o != NULL) {
+    _gmem = o->mem;
+    mspace_free(_gmem, o);
+  } else {
+    _gmem = create_mspace(0, /*locked*/1);
+  }
+  ThreadKeySet(memThreadKey, _gmem); // note: not called when the main thread exits
+  return _gmem;
+}
 
 
 Memory _GlobalMemory() {
-  return (_gmem == NULL) ? (_gmem = create_mspace(0, 0)) : _gmem;
+  return (_gmem == NULL) ? memThreadInit() : _gmem;
 }
 
 
 void* memgcalloc(size_t size) {
-  void* ptr = mspace_calloc(_GlobalMemory(), 1, size);
+  void* ptr = memalloc(NULL, size);
   _memgc(ptr);
   return ptr;
 }
@@ -122,17 +516,23 @@ void memgc_collect() {
     // increases locality and may increase performance. If we ever decide to performance tune
     // this code, it may be worth considering.
 
-    #if DEBUG
-    size_t unfreed =
-    #endif
-    mspace_bulk_free(_gmem, gc->gen2.v, gc->gen2.len);
+    if (_memGlobalStats != NULL) {
+      size_t nbytes = 0;
+      for (u32 i = 0; i < gc->gen2.len; i++) {
+        nbytes += mspace_usable_size(gc->gen2.v[i]);
+      }
+      memStatsResize(_memGlobalStats, nbytes, 0);
+    }
 
-    #if DEBUG
-    // unfreed is always zero in release builds as dlmalloc footers are only enabled in DEBUG.
-    if (unfreed > 0) {
-      dlog("[gc] warning: collector found %zu elements from a non-global allocator", unfreed);
+    // Pointers allocated by other threads (e.g. sds strings passed to memgcsds) are not
+    // freed by mspace_bulk_free. Free those individually; mspace_free finds their space.
+    size_t unfreed = mspace_bulk_free(_gmem, gc->gen2.v, gc->gen2.len);
+    for (u32 i = 0; unfreed > 0 && i < gc->gen2.len; i++) {
+      if (gc->gen2.v[i] != NULL) {
+        mspace_free(_gmem, gc->gen2.v[i]);
+        unfreed--;
+      }
     }
-    #endif
 
     gc->gen2.len = 0;
   }
@@ -148,6 +548,10 @@ void memgc_collect() {
 void _memgc(void* ptr) {
   assert(_gmem != NULL); // ptr is allocated in the global allocator, so this should not be null
   auto gc = &tlsGC;
+  if (_memGlobalStats != NULL) {
+    // ptr was counted by memalloc (or memrealloc) as MemTagNone; count it as GC instead
+    memStatsRetag(_memGlobalStats, mspace_usable_size(ptr), MemTagNone, MemTagGC);
+  }
   ArrayPush(&gc->gen1, ptr, _gmem);
 }
 
@@ -193,8 +597,8 @@ static void test() {
 
   // test bulk_free to ensure that we get an error message logged in case foreign pointers
   // are added to the GC.
-  // Caution: This depend on FOOTER=1 being defined for dlmalloc, which is only the case
-  // for DEBUG builds.
+  // This depends on FOOTERS=1 being defined for dlmalloc (see dlmalloc.h), which is the
+  // case for all builds since frees of memory of other threads' _gmem rely on it too.
   {
     Memory mem = MemoryNew(0);
     memgc(memalloc(mem, 16));    // add pointer from unrelated mspace to gc
@@ -209,4 +613,221 @@ static void test() {
   // exit(0);
 }
 W_UNIT_TEST(Memory, { test(); }) // W_UNIT_TEST
+
+
+static void test_arena() {
+  auto mem = MemoryNewArena(1024);
+  assert(MemoryIsArena(mem));
+  assert(!MemoryIsArena(NULL));
+
+  // allocations are aligned, zeroed and do not overlap
+  u8* p1 = (u8*)memalloc(mem, 3);
+  u8* p2 = (u8*)memalloc(mem, 40);
+  assert(((size_t)p1 & (MEM_ARENA_ALIGN - 1)) == 0);
+  assert(((size_t)p2 & (MEM_ARENA_ALIGN - 1)) == 0);
+  assert(p2 >= p1 + 3);
+  for (u32 i = 0; i < 40; i++) {
+    assert(p2[i] == 0);
+  }
+  memset(p1, 1, 3);
+  memset(p2, 2, 40);
+
+  // the most recent allocation grows in place
+  u8* p3 = (u8*)memrealloc(mem, p2, 100);
+  assert(p3 == p2);
+  assert(p3[39] == 2);
+
+  // ...and shrinks in place, leaving the released memory zeroed for the next allocation
+  p3 = (u8*)memrealloc(mem, p3, 8);
+  assert(p3 == p2);
+  u8* p4 = (u8*)memalloc(mem, 32);
+  assert(p4 == p3 + MEM_ARENA_ALIGN);
+  for (u32 i = 0; i < 32; i++) {
+    assert(p4[i] == 0);
+  }
+
+  // any other allocation is copied
+  u8* p5 = (u8*)memrealloc(mem, p1, 16);
+  assert(p5 != p1);
+  assert(p5[0] == 1 && p5[2] == 1);
+  memfree(mem, p5); // no-op
+
+  // large allocations and many allocations span several chunks
+  u8* big = (u8*)memalloc(mem, 4000);
+  for (u32 i = 0; i < 4000; i++) {
+    assert(big[i] == 0);
+  }
+  memset(big, 3, 4000);
+  for (u32 i = 0; i < 1000; i++) {
+    u8* p = (u8*)memalloc(mem, 24);
+    assert(p[0] == 0 && p[23] == 0);
+    memset(p, 4, 24);
+  }
+  u8* big2 = (u8*)memrealloc(mem, big, 8000);
+  assert(big2[0] == 3 && big2[3999] == 3);
+
+  // memsprintf grows its buffer
+  char* s = memsprintf(mem, "%s-%s", "abcdefghijklmnopqrstuvwxyz", "0123456789");
+  assert(strcmp(s, "abcdefghijklmnopqrstuvwxyz-0123456789") == 0);
+
+  // a zero-size allocation at the end of a chunk is copied like any other
+  auto a = _memArena(mem);
+  memalloc(mem, (size_t)(a->end - a->ptr)); // fill the current chunk
+  u8* p7 = (u8*)memalloc(mem, 0);
+  assert(p7 == a->end);
+  u8* p8 = (u8*)memrealloc(mem, p7, 16);
+  assert(p8 != p7 && p8[0] == 0 && p8[15] == 0);
+
+  MemoryRecycle(&mem);
+  u8* p6 = (u8*)memalloc(mem, 16);
+  assert(p6[0] == 0 && p6[15] == 0);
+  MemoryFree(mem);
+}
+W_UNIT_TEST(MemoryArena, { test_arena(); })
+
+
+static void test_arena_recycle() {
+  auto mem = MemoryNewArena(1024);
+  auto a = _memArena(mem);
+
+  // fill a few chunks with non-zero data
+  u8* first = NULL;
+  for (u32 i = 0; i < 200; i++) {
+    u8* p = (u8*)memalloc(mem, 100);
+    if (first == NULL) {
+      first = p;
+    }
+    memset(p, 0xff, 100);
+  }
+  u8* big = (u8*)memalloc(mem, 20000); // a chunk of its own
+  memset(big, 0xff, 20000);
+
+  // recycling keeps all chunks; they are reused in the same order and are zeroed
+  MemoryRecycle(&mem);
+  assert(MemoryIsArena(mem) && _memArena(mem) == a);
+  assert(a->chunks == NULL && a->spare != NULL);
+  for (u32 i = 0; i < 200; i++) {
+    u8* p = (u8*)memalloc(mem, 100);
+    if (i == 0) {
+      assert(p == first);
+    }
+    for (u32 j = 0; j < 100; j++) {
+      assert(p[j] == 0);
+    }
+  }
+
+  // with a limit of 0, no chunks are kept
+  MemorySetRetainLimit(mem, 0);
+  MemoryRecycle(&mem);
+  assert(a->chunks == NULL && a->spare == NULL);
+  u8* p = (u8*)memalloc(mem, 100);
+  assert(p[0] == 0 && p[99] == 0);
+
+  MemoryFree(mem);
+}
+W_UNIT_TEST(MemoryArenaRecycle, { test_arena_recycle(); })
+
+
+typedef struct MemThreadTest {
+  void*  objects[100]; // allocated by the thread
+  void*  fromMain;     // allocated by the main thread, freed by the thread
+  Memory mem;          // the thread's global memory
+} MemThreadTest;
+
+static int test_thread_alloc(void* arg) {
+  auto t = (MemThreadTest*)arg;
+  t->mem = _GlobalMemory();
+  for (u32 i = 0; i < countof(t->objects); i++) {
+    t->objects[i] = memalloc(NULL, 32);
+    memset(t->objects[i], (int)i, 32);
+  }
+  memfree(NULL, t->fromMain);
+  memgcalloc(16); // pending gc objects are freed when the thread exits
+  return 0;
+}
+
+static void test_threads() {
+  MemThreadTest t = {0};
+  t.fromMain = memalloc(NULL, 64);
+  Thread th;
+  assert(ThreadStart(&th, test_thread_alloc, &t) == ThreadSuccess);
+  ThreadAwait(th);
+  assert(t.mem != _GlobalMemory());
+
+  // objects outlive the thread and can be resized and freed by this thread
+  for (u32 i = 0; i < countof(t.objects); i++) {
+    u8* p = (u8*)t.objects[i];
+    assert(p[0] == (u8)i && p[31] == (u8)i);
+    if (i % 2) {
+      p = (u8*)memrealloc(NULL, p, 200);
+      assert(p[0] == (u8)i && p[31] == (u8)i);
+    }
+    memfree(NULL, p);
+  }
+
+  // the next thread takes over the memory space of the exited thread
+  Memory mem1 = t.mem;
+  t.fromMain = memalloc(NULL, 64);
+  assert(ThreadStart(&th, test_thread_alloc, &t) == ThreadSuccess);
+  ThreadAwait(th);
+  assert(t.mem == mem1);
+  for (u32 i = 0; i < countof(t.objects); i++) {
+    memfree(NULL, t.objects[i]);
+  }
+}
+W_UNIT_TEST(MemoryThreads, { test_threads(); })
+
+
+static void test_stats() {
+  auto mem = MemoryNewArena(0);
+  assert(MemoryStats(mem) == NULL);
+  auto st = MemoryEnableStats(mem);
+  assert(MemoryStats(mem) == st);
+
+  memalloc(mem, 10);                  // 16 bytes
+  memalloctag(mem, 40, MemTagNode);   // 48 bytes
+  memalloctag(mem, 40, MemTagNode);   // 48 bytes
+  void* p = memalloc(mem, 5000);
+  assert(st->count == 4);
+  assert(st->live == 16 + 48 + 48 + 5008);
+  assert(st->classes[0] == 1 && st->classes[2] == 2 && st->classes[MEM_STATS_NCLASSES - 1] == 1);
+  assert(st->tags[MemTagNode].count == 2 && st->tags[MemTagNode].bytes == 96);
+  assert(st->tags[MemTagNone].count == 2);
+
+  // realloc in place changes live but is not an allocation
+  memrealloc(mem, p, 100);
+  assert(st->count == 4);
+  assert(st->live == 16 + 48 + 48 + 112);
+  assert(st->peak == 16 + 48 + 48 + 5008);
+
+  MemoryRecycle(&mem);
+  assert(st->live == 0 && st->peak == 16 + 48 + 48 + 5008);
+  MemoryFree(mem);
+
+  // global allocator; counts chunk sizes, which may be larger than requested
+  auto prev = _memGlobalStats;
+  _memGlobalStats = NULL;
+  st = MemoryEnableStats(NULL);
+  p = memalloctag(NULL, 100, MemTagSym);
+  assert(st->count == 1 && st->tags[MemTagSym].count == 1);
+  assert(st->live >= 100 && st->live == st->tags[MemTagSym].bytes);
+  p = memrealloc(NULL, p, 10000);
+  assert(st->live >= 10000);
+  memfree(NULL, p);
+  assert(st->live == 0);
+  assert(st->peak >= 10000);
+
+  // an object allocated with memgcalloc is counted once, as GC
+  u64 count = st->count;
+  u64 nonecount = st->tags[MemTagNone].count, nonebytes = st->tags[MemTagNone].bytes;
+  memgcalloc(32);
+  asserteq(st->count, count + 1);
+  asserteq(st->tags[MemTagNone].count, nonecount);
+  asserteq(st->tags[MemTagNone].bytes, nonebytes);
+  asserteq(st->tags[MemTagGC].count, 1);
+  assert(st->tags[MemTagGC].bytes >= 32);
+  _memGlobalStats = prev;
+  memfree(NULL, st);
+}
+W_UNIT_TEST(MemoryStats, { test_stats(); })
 #endif
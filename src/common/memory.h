@@ -6,8 +6,15 @@
 // Memory is an isolated-space memory allocator, useful for allocating many small
 // short-lived fragments of memory, like for example AST nodes.
 //
-// Passing NULL to mangagement functions like memalloc uses a shared global allocator
-// and works the same way as libc malloc, free et al.
+// Passing NULL to mangagement functions like memalloc uses a global allocator and works
+// the same way as libc malloc, free et al. Every thread has its own global memory space, so
+// threads do not contend for a lock. Memory allocated this way may be freed by any thread
+// and remains valid after the thread that allocated it exits.
+//
+// A Memory created with MemoryNewArena is a linear "bump pointer" allocator: memalloc
+// hands out the next bytes of a chunk, memfree does nothing and all memory is released at
+// once by MemoryFree. Arena memory is distinguished from an mspace by the low bit of the
+// pointer, which is set.
 //
 typedef mspace Memory;
 
@@ -59,7 +66,8 @@ static sds memgcsds(sds nonull s) nonull_return;
 // 2. every pointer in gen1 is moved to gen2.
 // Thus, this is NOT a generic "smart" garbage collector.
 // Caution: Calling memgc_collect twice in a row causes all gc objects to be free'd immediately.
-// Always uses the global allocator.
+// Always uses the global allocator. The gc lists are per thread; objects marked by a thread
+// are collected by that thread (or when it exits.)
 void memgc_collect();
 
 
@@ -68,8 +76,79 @@ void memgc_collect();
 
 // Create a new memory space
 Memory MemoryNew(size_t initHint/*=0*/);
-void MemoryRecycle(Memory* memptr); // recycle for reuse
-void MemoryFree(Memory mem);        // free all memory allocated by mem
+void MemoryFree(Memory mem); // free all memory allocated by mem
+
+// MemoryRecycle frees all memory allocated by mem for reuse of the space.
+// An arena keeps its chunks, up to the limit set with MemorySetRetainLimit, so that the next
+// use of the arena does not need to get memory from the system again. An mspace is replaced
+// by a new one; *memptr may change.
+void MemoryRecycle(Memory* memptr);
+
+// Create a new arena. Memory is allocated in chunks, starting with chunkHint bytes
+// (0 for the default, 64kB) and doubling up to 1MB. Chunks are zeroed in bulk when they
+// are allocated, so memalloc does not need to clear memory.
+// memrealloc of the most recent allocation grows or shrinks it in place when possible.
+Memory MemoryNewArena(size_t chunkHint/*=0*/);
+
+// MemoryIsArena returns true if mem was created with MemoryNewArena
+inline static bool MemoryIsArena(Memory nullable mem);
+
+// MemorySetRetainLimit sets the maximum number of bytes which the arena mem keeps when it is
+// recycled. Defaults to no limit, i.e. the high-water mark of the arena's memory usage.
+void MemorySetRetainLimit(Memory mem, size_t maxbytes);
+
+// -----------------------------------------------------------------------------------------------
+// Accounting
+//
+// Accounting is optional and off by default. When enabled for an arena or for the global
+// allocator (mem=NULL, all threads), every allocation is counted. Allocations can be
+// attributed to a MemTag by allocating with memalloctag.
+//
+// Arena memory is live until the arena is recycled or freed, since memfree does nothing.
+// For the global allocator, sizes are those of dlmalloc chunks (memalloc may round up.)
+
+typedef enum MemTag {
+  MemTagNone,     // memalloc
+  MemTagNode,     // AST nodes (NewNode, NodeCopy)
+  MemTagNodeList, // AST node list arrays (NodeListAppend, NodeListAssign)
+  MemTagScope,    // scopes (ScopeNew)
+  MemTagSym,      // interned symbols and the symbol table
+  MemTagIRValue,  // IR values (IRValueNew)
+  MemTagIRBlock,  // IR blocks (IRBlockNew)
+  MemTagGC,       // objects marked for garbage collection (memgcalloc, memgcsds)
+  MemTag_MAX
+} MemTag;
+
+#define MEM_STATS_NCLASSES 10 // size classes <=16, <=32, <=64, ... <=4096, >4096
+
+typedef struct MemTagStats {
+  u64 count; // number of allocations
+  u64 bytes; // total size of allocations
+} MemTagStats;
+
+typedef struct MemStats {
+  u64         live;  // bytes currently allocated
+  u64         peak;  // largest value of live
+  u64         count; // number of allocations, including reallocations which moved
+  u64         classes[MEM_STATS_NCLASSES]; // number of allocations by size class
+  MemTagStats tags[MemTag_MAX];            // allocations by tag (not reduced by free)
+} MemStats;
+
+// memalloctag is like memalloc and attributes the allocation to tag if accounting is enabled
+static void* memalloctag(Memory nullable mem, size_t size, MemTag tag) nonull_return;
+
+// MemoryEnableStats enables accounting for mem, which must be an arena or NULL for the
+// global allocator. Counting starts from zero. Returns the stats, which are owned by mem.
+MemStats* MemoryEnableStats(Memory nullable mem);
+
+// MemoryStats returns the stats of mem, or NULL if accounting is not enabled for mem
+const MemStats* nullable MemoryStats(Memory nullable mem);
+
+// MemStatsClassMax returns the largest size of size class i (0 for the last class)
+size_t MemStatsClassMax(u32 i);
+
+// MemTagName returns a printable name of tag, e.g. "Node"
+const char* MemTagName(MemTag tag);
 
 // -----------------------------------------------------------------------------------------------
 // inline and internal implementations
@@ -77,15 +156,85 @@ void MemoryFree(Memory mem);        // free all memory allocated by mem
 void _memgc(void* nonull ptr);
 Memory _GlobalMemory() nonull_return;
 
-inline static void* memalloc(Memory mem, size_t size) {
+#define MEM_ARENA_ALIGN (2 * sizeof(void*)) // same as dlmalloc
+
+typedef struct MemArenaChunk MemArenaChunk;
+
+typedef struct MemArena {
+  u8*            ptr;       // next free byte of the current chunk
+  u8*            end;       // end of the current chunk
+  u8*            last;      // most recent allocation in the current chunk (or NULL)
+  MemArenaChunk* chunks;    // current chunk, which links to the previous ones
+  MemArenaChunk* spare;     // zeroed chunks for reuse, kept by MemoryRecycle
+  size_t         chunksize; // size of the next chunk
+  size_t         retain;    // max bytes of chunks to keep in spare
+  MemStats*      stats;     // non-NULL when accounting is enabled
+} MemArena;
+
+extern MemStats* _memGlobalStats; // non-NULL when accounting is enabled for mem=NULL
+
+void  _memStatsAdd(MemStats* st, size_t size, MemTag tag);
+void* _memGlobalAllocStats(size_t size, MemTag tag) nonull_return;
+void* _memGlobalReallocStats(void* ptr, size_t newsize) nonull_return;
+void  _memGlobalFreeStats(void* ptr);
+
+void* _memArenaAllocSlow(MemArena* a, size_t size) nonull_return;
+void* _memArenaRealloc(MemArena* a, void* ptr, size_t newsize) nonull_return;
+
+inline static bool MemoryIsArena(Memory mem) {
+  return ((size_t)mem & 1) != 0;
+}
+
+inline static MemArena* _memArena(Memory mem) {
+  return (MemArena*)((size_t)mem & ~(size_t)1);
+}
+
+inline static void* _memArenaAlloc(MemArena* a, size_t size) {
+  u8* p = a->ptr;
+  if (size > (size_t)(a->end - p)) {
+    return _memArenaAllocSlow(a, size);
+  }
+  a->ptr = p + align2(size, MEM_ARENA_ALIGN);
+  a->last = p;
+  return p;
+}
+
+inline static void* memalloctag(Memory mem, size_t size, MemTag tag) {
+  if (MemoryIsArena(mem)) {
+    auto a = _memArena(mem);
+    if (a->stats != NULL) {
+      _memStatsAdd(a->stats, align2(size, MEM_ARENA_ALIGN), tag);
+    }
+    return _memArenaAlloc(a, size);
+  }
+  if (mem == NULL && _memGlobalStats != NULL) {
+    return _memGlobalAllocStats(size, tag);
+  }
   return mspace_calloc(mem == NULL ? _GlobalMemory() : mem, 1, size);
 }
 
+inline static void* memalloc(Memory mem, size_t size) {
+  return memalloctag(mem, size, MemTagNone);
+}
+
 inline static void* memrealloc(Memory mem, void* ptr, size_t newsize) {
+  if (MemoryIsArena(mem)) {
+    return _memArenaRealloc(_memArena(mem), ptr, newsize);
+  }
+  if (mem == NULL && _memGlobalStats != NULL) {
+    return _memGlobalReallocStats(ptr, newsize);
+  }
   return mspace_realloc(mem == NULL ? _GlobalMemory() : mem, ptr, newsize);
 }
 
 inline static void memfree(Memory mem, void* ptr) {
+  if (MemoryIsArena(mem)) {
+    return; // released by MemoryFree
+  }
+  if (mem == NULL && _memGlobalStats != NULL) {
+    _memGlobalFreeStats(ptr);
+    return;
+  }
   mspace_free(mem == NULL ? _GlobalMemory() : mem, ptr);
 }
 
@@ -0,0 +1,87 @@
+#include "bench.h"
+#include "memory.h"
+
+// Benchmarks of memalloc with an mspace (MemoryNew) and an arena (MemoryNewArena.)
+// Each operation allocates MEM_BENCH_COUNT objects of 16-128 bytes, about the size of AST
+// nodes and IR values, in a new memory space which is then freed.
+
+#define MEM_BENCH_COUNT 10000
+
+// memBenchSize returns the size of the i'th allocation
+static size_t memBenchSize(u32 i) {
+  return 16 + (size_t)((i * 2654435761u) >> 27) * 4; // 16..140
+}
+
+static void memBenchAlloc(Bench* b, bool arena) {
+  size_t nbytes = 0;
+  for (u32 i = 0; i < MEM_BENCH_COUNT; i++) {
+    nbytes += memBenchSize(i);
+  }
+  for (u64 i = 0; i < b->N; i++) {
+    auto mem = arena ? MemoryNewArena(0) : MemoryNew(0);
+    for (u32 j = 0; j < MEM_BENCH_COUNT; j++) {
+      u8* p = (u8*)memalloc(mem, memBenchSize(j));
+      p[0] = 1;
+    }
+    MemoryFree(mem);
+  }
+  b->bytes = nbytes;
+  b->items = MEM_BENCH_COUNT;
+  b->unit = "allocs";
+}
+
+W_BENCHMARK(MemAllocSpace, { memBenchAlloc(b, false); })
+W_BENCHMARK(MemAllocArena, { memBenchAlloc(b, true); })
+
+
+// MemRealloc grows an array one element at a time, like TokBuf and NodeList do, with
+// doubling capacity.
+static void memBenchRealloc(Bench* b, bool arena) {
+  for (u64 i = 0; i < b->N; i++) {
+    auto mem = arena ? MemoryNewArena(0) : MemoryNew(0);
+    u32* v = NULL;
+    u32 cap = 0;
+    for (u32 j = 0; j < MEM_BENCH_COUNT; j++) {
+      if (j == cap) {
+        cap = cap == 0 ? 8 : cap * 2;
+        v = (u32*)memrealloc(mem, v, sizeof(u32) * cap);
+      }
+      v[j] = j;
+    }
+    MemoryFree(mem);
+  }
+  b->items = MEM_BENCH_COUNT;
+  b->unit = "elements";
+}
+
+W_BENCHMARK(MemReallocSpace, { memBenchRealloc(b, false); })
+W_BENCHMARK(MemReallocArena, { memBenchRealloc(b, true); })
+
+
+// MemRecycle allocates 4MB in 64-byte objects, like a compilation of a large source file
+// does, and then either recycles the arena (Recycle) or frees it and creates a new one (New.)
+// The first reuses the memory pages of the previous iteration.
+#define MEM_BENCH_RECYCLE_COUNT (4 * 1024 * 1024 / 64)
+
+static void memBenchRecycle(Bench* b, bool recycle) {
+  auto mem = MemoryNewArena(0);
+  for (u64 i = 0; i < b->N; i++) {
+    for (u32 j = 0; j < MEM_BENCH_RECYCLE_COUNT; j++) {
+      u8* p = (u8*)memalloc(mem, 64);
+      p[0] = 1;
+    }
+    if (recycle) {
+      MemoryRecycle(&mem);
+    } else {
+      MemoryFree(mem);
+      mem = MemoryNewArena(0);
+    }
+  }
+  MemoryFree(mem);
+  b->bytes = MEM_BENCH_RECYCLE_COUNT * 64;
+  b->items = MEM_BENCH_RECYCLE_COUNT;
+  b->unit = "allocs";
+}
+
+W_BENCHMARK(MemRecycleArena, { memBenchRecycle(b, true); })
+W_BENCHMARK(MemRecycleNew,   { memBenchRecycle(b, false); })
@@ -1,5 +1,7 @@
 #include <unistd.h> // sysconf
 #include <sys/errno.h>
+#include <sys/mman.h> // mmap
+#include <time.h>   // clock_gettime
 
 #include "defs.h"
 #include "os.h"
@@ -19,6 +21,19 @@ size_t os_mempagesize() {
 }
 
 
+u32 os_ncpu() {
+  auto n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n < 1 ? 1 : (u32)n;
+}
+
+
+u64 os_nanotime() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((u64)ts.tv_sec * 1000000000) + (u64)ts.tv_nsec;
+}
+
+
 u8* os_readfile(const char* filename, size_t* size_inout, Memory mem) {
   assert(size_inout != NULL);
 
@@ -56,6 +71,50 @@ u8* os_readfile(const char* filename, size_t* size_inout, Memory mem) {
 }
 
 
+const u8* os_mmapfile(const char* filename, size_t* size_out) {
+  assert(size_out != NULL);
+  *size_out = 0;
+
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return NULL;
+  }
+
+  size_t size = (size_t)st.st_size;
+  if (size == 0) {
+    // mmap fails with EINVAL for zero-length mappings
+    close(fd);
+    return (const u8*)"";
+  }
+
+  void* ptr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd); // the mapping keeps the file open
+  if (ptr == MAP_FAILED) {
+    return NULL;
+  }
+
+  #ifdef MADV_SEQUENTIAL
+  madvise(ptr, size, MADV_SEQUENTIAL); // just a hint; ignore errors
+  #endif
+
+  *size_out = size;
+  return (const u8*)ptr;
+}
+
+
+void os_unmapfile(const u8* ptr, size_t size) {
+  if (size > 0) {
+    munmap((void*)ptr, size);
+  }
+}
+
+
 bool os_writefile(const char* filename, const void* ptr, size_t size) {
   FILE* fp = fopen(filename, "w");
   if (fp == NULL) {
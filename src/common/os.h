@@ -3,11 +3,21 @@
 
 // os
 size_t os_mempagesize();  // always returns a suitable number
+u64 os_nanotime();        // monotonic clock in nanoseconds
+u32 os_ncpu();            // number of online CPUs; always >= 1
 
 // Read entire file into a heap-allocated buffer.
 // If *size_inout is >0 then it is used as a limit of how much to read from the file.
 // If size_inout is not null, it is set to the size of the returned byte array.
 u8* os_readfile(const char* nonull filename, size_t* nonull size_inout, Memory nullable mem);
 
+// Map entire file into memory, read-only, without copying it.
+// The kernel is advised that the file will be read sequentially.
+// *size_out is set to the size of the file. An empty file yields a non-NULL pointer to
+// zero bytes. Note that the returned bytes are NOT terminated by a NUL byte.
+// Returns NULL on error (errno is set.) Release with os_unmapfile.
+const u8* os_mmapfile(const char* nonull filename, size_t* nonull size_out);
+void os_unmapfile(const u8* nonull ptr, size_t size);
+
 // Write data at ptr of bytes size to file at filename.
 bool os_writefile(const char* nonull filename, const void* nonull ptr, size_t size);
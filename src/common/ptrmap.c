@@ -3,18 +3,13 @@
 #include "test.h"
 
 #include <math.h> /* log2 */
-#include <limits.h> /* *_MAX */
-
-#if ((ULONG_MAX) > (UINT_MAX))
-  // 64-bit address
-  #define ptrhash(ptr) ((size_t)hashFNV1a64((const u8*)&(ptr), 8))
-#else
-  // 32-bit address
-  #define ptrhash(ptr) ((size_t)hashFNV1a((const u8*)&(ptr), 4))
-#endif
+
+// Swiss tables use the low 7 bits of a hash as a tag and the other bits to find a group,
+// so all bits must depend on all bits of the address. hashPtr is a single multiply.
+#define ptrhash(ptr) ((size_t)hashPtr(ptr))
 
 // This is a good and very fast hash function for small sets of sequential pointers,
-// but as the address space grows the distribution worsens quickly compared to FNV1a.
+// but as the address space grows the distribution worsens quickly compared to hashPtr.
 // static size_t ptrhash2(void* p) {
 //   // Note: the log2 call is eliminated and replaced by a constant when compiling
 //   // with optimizations.
@@ -27,7 +22,7 @@
 #define HASHMAP_KEY      const void*
 #define HASHMAP_VALUE    void*
 #define HASHMAP_KEY_HASH ptrhash
-#include "hashmap.c.h"
+#include "hashmap_swiss.c.h"
 #undef HASHMAP_NAME
 #undef HASHMAP_KEY
 #undef HASHMAP_VALUE
@@ -116,3 +111,41 @@ W_UNIT_TEST(PtrMap, {
   PtrMapFree(m);
   MemoryFree(mem);
 }) // W_UNIT_TEST
+
+
+#if W_UNIT_TEST_ENABLED
+static void test_ptrmap_churn() {
+  // Many insertions and deletions must neither lose entries nor grow the map without bound
+  const u32 n = 5000;
+  auto objects = (u8*)memalloc(NULL, n * 2);
+  PtrMap m = {0}; // zero-initialized map allocates on first Set
+  assert(PtrMapGet(&m, objects) == NULL);
+  assert(PtrMapDel(&m, objects) == NULL);
+  for (u32 i = 0; i < n; i++) {
+    assert(PtrMapSet(&m, &objects[i], &objects[i]) == NULL);
+  }
+  asserteq(m.len, n);
+  u32 cap = m.cap;
+  for (u32 round = 0; round < 20; round++) {
+    // move the even keys between the lower and upper half of objects
+    u32 del = round % 2 == 0 ? 0 : n;
+    for (u32 i = del; i < del + n; i += 2) {
+      auto key = &objects[(i + n) % (n * 2)];
+      assert(PtrMapDel(&m, &objects[i]) == &objects[i]);
+      assert(PtrMapSet(&m, key, key) == NULL);
+    }
+    asserteq(m.len, n);
+  }
+  assert(m.cap <= cap * 2);
+  for (u32 i = 0; i < n * 2; i++) {
+    assert(PtrMapGet(&m, &objects[i]) == (i < n ? &objects[i] : NULL));
+  }
+  PtrMapClear(&m);
+  asserteq(m.len, 0);
+  assert(PtrMapGet(&m, &objects[0]) == NULL);
+  PtrMapDealloc(&m);
+  memfree(NULL, objects);
+}
+
+W_UNIT_TEST(PtrMapChurn, { test_ptrmap_churn(); })
+#endif
@@ -10,7 +10,7 @@
 #undef HASHMAP_KEY
 #undef HASHMAP_VALUE
 
-// PtrMapInit initializes a map structure. initbuckets is the number of initial buckets.
+// PtrMapInit initializes a map structure with room for initbuckets entries.
 void PtrMapInit(PtrMap*, u32 initbuckets, Memory mem/*nullable*/);
 
 // bool PtrMapIsInit(PtrMap*)
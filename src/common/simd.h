@@ -0,0 +1,56 @@
+#pragma once
+#include "defs.h"
+//
+// Minimal portable layer over x86 SIMD byte operations.
+//
+// SIMD_WIDTH is defined to the vector size in bytes when SIMD is available: 32 with AVX2
+// (e.g. -mavx2 or -march=native), 16 with SSE2 (always the case on x86_64.) When SIMD_WIDTH
+// is not defined, callers should use a scalar implementation.
+//
+//   svec svload(const u8* p)           load SIMD_WIDTH bytes from p (unaligned)
+//   svec svset1(u8 c)                  all bytes set to c
+//   svec sveq(svec a, svec b)          0xFF in each byte where a==b
+//   svec svor(svec a, svec b)          bitwise or
+//   svec svand(svec a, svec b)         bitwise and
+//   svec svsub(svec a, svec b)         bytewise wrapping subtraction
+//   svec svminu(svec a, svec b)        bytewise unsigned minimum
+//   u32  svmask(svec v)                one bit per byte; the most significant bit of each byte
+//   svec svinrange(svec v, u8 lo, hi)  0xFF in each byte in the range [lo, hi] (unsigned)
+//
+#if defined(__AVX2__)
+  #include <immintrin.h>
+  #define SIMD_WIDTH 32
+  typedef __m256i svec;
+  #define svload(p)    _mm256_loadu_si256((const __m256i*)(p))
+  #define svset1(c)    _mm256_set1_epi8((char)(c))
+  #define sveq(a, b)   _mm256_cmpeq_epi8((a), (b))
+  #define svor(a, b)   _mm256_or_si256((a), (b))
+  #define svand(a, b)  _mm256_and_si256((a), (b))
+  #define svsub(a, b)  _mm256_sub_epi8((a), (b))
+  #define svminu(a, b) _mm256_min_epu8((a), (b))
+  #define svmask(v)    ((u32)_mm256_movemask_epi8(v))
+#elif defined(__SSE2__)
+  #include <emmintrin.h>
+  #define SIMD_WIDTH 16
+  typedef __m128i svec;
+  #define svload(p)    _mm_loadu_si128((const __m128i*)(p))
+  #define svset1(c)    _mm_set1_epi8((char)(c))
+  #define sveq(a, b)   _mm_cmpeq_epi8((a), (b))
+  #define svor(a, b)   _mm_or_si128((a), (b))
+  #define svand(a, b)  _mm_and_si128((a), (b))
+  #define svsub(a, b)  _mm_sub_epi8((a), (b))
+  #define svminu(a, b) _mm_min_epu8((a), (b))
+  #define svmask(v)    ((u32)_mm_movemask_epi8(v))
+#endif
+
+#ifdef SIMD_WIDTH
+
+// all lanes set in a svmask result
+#define SIMD_MASK_ALL ((u32)((1ull << SIMD_WIDTH) - 1))
+
+#define svinrange(v, lo, hi) ({                \
+  svec d__ = svsub((v), svset1(lo));           \
+  sveq(svminu(d__, svset1((hi) - (lo))), d__); \
+})
+
+#endif /* SIMD_WIDTH */
@@ -19,6 +19,16 @@ int ThreadAwait(Thread t) {
 }
 
 
+ThreadStatus ThreadKeyCreate(ThreadKey* key, tss_dtor_t dtor) {
+  return (ThreadStatus)tss_create(key, dtor);
+}
+
+
+ThreadStatus ThreadKeySet(ThreadKey key, void* value) {
+  return (ThreadStatus)tss_set(key, value);
+}
+
+
 Thread ThreadSpawn(thrd_start_t nonull fn, void* nullable arg) nonull_return {
   Thread t;
   if (ThreadStart(&t, fn, arg) != ThreadSuccess) {
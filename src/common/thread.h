@@ -18,3 +18,9 @@ typedef thrd_t Thread;
 ThreadStatus    ThreadStart(Thread* nonull t, thrd_start_t nonull fn, void* nullable arg);
 Thread nullable ThreadSpawn(thrd_start_t nonull fn, void* nullable arg); // null on error
 int             ThreadAwait(Thread t);
+
+// ThreadKey identifies a thread-specific value. When a thread exits (other than the main
+// thread), the key's destructor is called with the thread's value, if it is not NULL.
+typedef tss_t ThreadKey;
+ThreadStatus ThreadKeyCreate(ThreadKey* nonull key, tss_dtor_t nullable dtor);
+ThreadStatus ThreadKeySet(ThreadKey key, void* nullable value);
@@ -1,4 +1,6 @@
 #include "unicode.h"
+#include "simd.h"
+#include "test.h"
 
 Rune utf8decode(const u8* buf, size_t len, u32* out_width) {
   u8 b = *buf;
@@ -28,3 +30,135 @@ Rune utf8decode(const u8* buf, size_t len, u32* out_width) {
   *out_width = 1;
   return RuneErr;
 }
+
+
+// utf8seqlen returns the length of the valid UTF-8 sequence at p, which starts with a byte
+// >= RuneSelf, or 0 if it is invalid. See table 3-7 "Well-Formed UTF-8 Byte Sequences" of
+// the Unicode standard.
+static u32 utf8seqlen(const u8* p, const u8* end) {
+  u8 b = p[0];
+  // range of the second byte, which is narrower than 80..BF for some lead bytes
+  u8 lo = 0x80, hi = 0xBF;
+  u32 n;
+  if (b < 0xC2) {
+    return 0; // continuation byte or overlong 2-byte sequence
+  } else if (b < 0xE0) {
+    n = 2;
+  } else if (b < 0xF0) {
+    n = 3;
+    if (b == 0xE0) { lo = 0xA0; } // overlong
+    if (b == 0xED) { hi = 0x9F; } // surrogates
+  } else if (b < 0xF5) {
+    n = 4;
+    if (b == 0xF0) { lo = 0x90; } // overlong
+    if (b == 0xF4) { hi = 0x8F; } // > U+10FFFF
+  } else {
+    return 0;
+  }
+  if ((size_t)(end - p) < n || p[1] < lo || p[1] > hi) {
+    return 0;
+  }
+  for (u32 i = 2; i < n; i++) {
+    if ((p[i] & 0xC0) != 0x80) {
+      return 0;
+    }
+  }
+  return n;
+}
+
+
+size_t utf8validate(const u8* buf, size_t len, bool* ascii) {
+  const u8* p = buf;
+  const u8* end = buf + len;
+  bool isascii = true;
+  while (p < end) {
+    // skip ASCII, a vector at a time
+    #ifdef SIMD_WIDTH
+    while (end - p >= SIMD_WIDTH) {
+      u32 m = svmask(svload(p)); // bytes with the high bit set
+      if (m) {
+        p += __builtin_ctz(m);
+        break;
+      }
+      p += SIMD_WIDTH;
+    }
+    #else
+    while (end - p >= 8) {
+      u64 w;
+      memcpy(&w, p, 8);
+      if (w & 0x8080808080808080ull) {
+        break;
+      }
+      p += 8;
+    }
+    #endif
+    if (p == end) {
+      break;
+    }
+    if (*p < RuneSelf) {
+      p++; // tail of buf which is shorter than a vector
+      continue;
+    }
+    isascii = false;
+    u32 n = utf8seqlen(p, end);
+    if (n == 0) {
+      if (ascii) {
+        *ascii = false;
+      }
+      return (size_t)(p - buf);
+    }
+    p += n;
+  }
+  if (ascii) {
+    *ascii = isascii;
+  }
+  return len;
+}
+
+
+#if W_UNIT_TEST_ENABLED
+// test_utf8validate checks that s is invalid at offset expect, or valid if expect is -1
+static void test_utf8validate(const char* s, int expect, bool expectascii) {
+  size_t len = strlen(s);
+  if (expect == -1) {
+    expect = (int)len;
+  }
+  // check at each alignment relative to the vector size, and preceded by many ASCII bytes
+  // so that the fast path sees the interesting bytes at every position in a vector
+  u8 buf[256];
+  assert(len + 64 <= sizeof(buf));
+  for (u32 pad = 0; pad < 64; pad++) {
+    memset(buf, 'a', pad);
+    memcpy(buf + pad, s, len);
+    bool ascii = !expectascii;
+    size_t r = utf8validate(buf, pad + len, &ascii);
+    if (r != pad + (size_t)expect || ascii != expectascii) {
+      fprintf(stderr, "utf8validate(\"%s\") pad=%u => %zu %d\n", s, pad, r - pad, ascii);
+    }
+    asserteq(r, pad + (size_t)expect);
+    asserteq(ascii, expectascii);
+  }
+}
+
+static void test() {
+  test_utf8validate("", -1, true);
+  test_utf8validate("hello world, this is a longer line of text with only ASCII", -1, true);
+  test_utf8validate("\xC3\xB1" "and\xC3\xBA", -1, false); // ñandú
+  test_utf8validate("\xE2\x82\xAC", -1, false);           // U+20AC
+  test_utf8validate("\xF0\x9F\x98\x80 x", -1, false);     // U+1F600
+  test_utf8validate("\xEF\xBF\xBD", -1, false);           // U+FFFD
+  test_utf8validate("\xF4\x8F\xBF\xBF", -1, false);       // U+10FFFF
+  test_utf8validate("ab\x80", 2, false);                  // stray continuation byte
+  test_utf8validate("ab\xC0\xAF", 2, false);              // overlong "/"
+  test_utf8validate("ab\xC3", 2, false);                  // truncated
+  test_utf8validate("ab\xE0\x9F\xBF", 2, false);          // overlong 3-byte sequence
+  test_utf8validate("ab\xED\xA0\x80", 2, false);          // surrogate U+D800
+  test_utf8validate("ab\xF0\x8F\xBF\xBF", 2, false);      // overlong 4-byte sequence
+  test_utf8validate("ab\xF4\x90\x80\x80", 2, false);      // U+110000
+  test_utf8validate("ab\xF5\x80\x80\x80", 2, false);      // invalid lead byte
+  test_utf8validate("ab\xE2\x82x", 2, false);             // bad continuation byte
+  test_utf8validate("\xC3\xB1 then a long run of ASCII text which spans vectors \xFF", 53, false);
+}
+
+W_UNIT_TEST(UTF8Validate, { test(); })
+#endif
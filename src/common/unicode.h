@@ -10,3 +10,8 @@ static const Rune RuneSelf = 0x80;
 static const u32 UTF8Max = 4; // Maximum number of bytes of a UTF8-encoded char.
 
 Rune utf8decode(const u8* buf, size_t len, u32* out_width);
+
+// utf8validate checks that buf is valid UTF-8 (no overlong encodings, surrogates or code
+// points above U+10FFFF.) Returns the offset of the first invalid sequence, or len if all of
+// buf is valid. If ascii is not NULL, *ascii is set to true if buf[0:result] is pure ASCII.
+size_t utf8validate(const u8* buf, size_t len, bool* nullable ascii);
@@ -1,15 +1,13 @@
 #include "ir.h"
 
 
-IRBlock* IRBlockNew(IRFun* f, IRBlockKind kind, const SrcPos* pos/*?*/) {
+IRBlock* IRBlockNew(IRFun* f, IRBlockKind kind, Pos pos) {
   assert(f->bid < 0xFFFFFFFF); // too many block IDs generated
-  auto b = memalloct(f->mem, IRBlock);
+  auto b = (IRBlock*)memalloctag(f->mem, sizeof(IRBlock), MemTagIRBlock);
   b->f = f;
   b->id = f->bid++;
   b->kind = kind;
-  if (pos != NULL) {
-    b->pos = *pos;
-  }
+  b->pos = pos;
   ArrayInitWithStorage(&b->values, b->valuesStorage, sizeof(b->valuesStorage)/sizeof(void*));
   ArrayPush(&f->blocks, b, b->f->mem);
   return b;
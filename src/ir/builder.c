@@ -25,7 +25,7 @@ static bool addTopLevel(IRBuilder* u, Node* n);
 
 void IRBuilderInit(IRBuilder* u, IRBuilderFlags flags, const char* pkgname) {
   memset(u, 0, sizeof(IRBuilder));
-  u->mem = MemoryNew(0);
+  u->mem = MemoryNewArena(0);
   u->pkg = IRPkgNew(u->mem, pkgname);
   PtrMapInit(&u->funs, 32, u->mem);
   u->vars = SymMapNew(8, u->mem);
@@ -109,22 +109,24 @@ static void startFun(IRBuilder* u, IRFun* f) {
 static void endFun(IRBuilder* u) {
   assert(u->f != NULL); // no current function
   dlog("endFun %p", u->f);
-  #if DEBUG
   u->f = NULL;
-  #endif
 }
 
 
 static IRValue* TODO_Value(IRBuilder* u) {
-  return IRValueNew(u->f, u->b, OpNil, TypeCode_nil, /*SrcPos*/NULL);
+  return IRValueNew(u->f, u->b, OpNil, TypeCode_nil, NoPos);
 }
 
 
 // ———————————————————————————————————————————————————————————————————————————————————————————————
 // Phi & variables
 
-#define dlogvar(format, ...) \
-  fprintf(stderr, "VAR " format "\t(%s:%d)\n", ##__VA_ARGS__, __FILE__, __LINE__)
+#if DEBUG
+  #define dlogvar(format, ...) \
+    fprintf(stderr, "VAR " format "\t(%s:%d)\n", ##__VA_ARGS__, __FILE__, __LINE__)
+#else
+  #define dlogvar(...) do{}while(0)
+#endif
 
 
 static void writeVariable(IRBuilder* u, Sym name, IRValue* value, IRBlock* b) {
@@ -253,7 +255,7 @@ static IRValue* addTypeCast(IRBuilder* u, Node* n) {
       TypeCodeName(inval->type), TypeCodeName(dstType->t.basic.typeCode));
     return TODO_Value(u);
   }
-  auto v = IRValueNew(u->f, u->b, convop, totype, &n->pos);
+  auto v = IRValueNew(u->f, u->b, convop, totype, n->pos);
   IRValueAddArg(v, inval);
   return v;
 }
@@ -266,7 +268,7 @@ static IRValue* addArg(IRBuilder* u, Node* n) {
     CCtxErrorf(u->cc, n->pos, "invalid argument type %s", fmtnode(n->type));
     return TODO_Value(u);
   }
-  auto v = IRValueNew(u->f, u->b, OpArg, n->type->t.basic.typeCode, &n->pos);
+  auto v = IRValueNew(u->f, u->b, OpArg, n->type->t.basic.typeCode, n->pos);
   v->auxInt = n->field.index;
   return v;
 }
@@ -310,7 +312,7 @@ static IRValue* addBinOp(IRBuilder* u, Node* n) {
   TypeCode restype = n->type->t.basic.typeCode;
   #endif
 
-  auto v = IRValueNew(u->f, u->b, op, restype, &n->pos);
+  auto v = IRValueNew(u->f, u->b, op, restype, n->pos);
   IRValueAddArg(v, left);
   IRValueAddArg(v, right);
   return v;
@@ -387,7 +389,7 @@ static IRValue* addIf(IRBuilder* u, Node* n) {
     // else branch always taken
     if (n->cond.elseb == NULL) {
       dlog("TODO ir/builder produce nil value");
-      return IRValueNew(u->f, u->b, OpNil, TypeCode_nil, &n->pos);
+      return IRValueNew(u->f, u->b, OpNil, TypeCode_nil, n->pos);
     }
     return addExpr(u, n->cond.elseb);
   }
@@ -398,10 +400,10 @@ static IRValue* addIf(IRBuilder* u, Node* n) {
   IRBlockSetControl(ifb, control);
 
   // create blocks for then and else branches
-  auto thenb = IRBlockNew(u->f, IRBlockCont, &n->cond.thenb->pos);
+  auto thenb = IRBlockNew(u->f, IRBlockCont, n->cond.thenb->pos);
   auto elsebIndex = u->f->blocks.len; // may be used later for moving blocks
   auto elseb = IRBlockNew(u->f, IRBlockCont,
-    n->cond.elseb == NULL ? &n->pos : &n->cond.elseb->pos);
+    n->cond.elseb == NULL ? n->pos : n->cond.elseb->pos);
   ifb->succs[0] = thenb;
   ifb->succs[1] = elseb; // if -> then, else
 
@@ -419,7 +421,7 @@ static IRValue* addIf(IRBuilder* u, Node* n) {
 
     // allocate "cont" block; the block following both thenb and elseb
     auto contbIndex = u->f->blocks.len;
-    auto contb = IRBlockNew(u->f, IRBlockCont, &n->pos);
+    auto contb = IRBlockNew(u->f, IRBlockCont, n->pos);
 
     // begin "else" block
     dlog("[if] begin \"else\" block");
@@ -553,7 +555,7 @@ static IRValue* addIf(IRBuilder* u, Node* n) {
   }
 
   // make Phi, joining the two branches together
-  auto phi = IRValueNew(u->f, u->b, OpPhi, thenv->type, &n->pos);
+  auto phi = IRValueNew(u->f, u->b, OpPhi, thenv->type, n->pos);
   assertf(u->b->preds[0] != NULL, "phi in block without predecessors");
   phi->args[0] = thenv;
   phi->args[1] = elsev;
@@ -630,7 +632,7 @@ static IRFun* addFun(IRBuilder* u, Node* n) {
 
   // allocate a new function and its entry block
   f = IRFunNew(u->mem, n);
-  auto entryb = IRBlockNew(f, IRBlockCont, &n->pos);
+  auto entryb = IRBlockNew(f, IRBlockCont, n->pos);
 
   // Since functions can be anonymous and self-referential, short-circuit using a PtrMap
   PtrMapSet(&u->funs, n, f);
@@ -28,7 +28,7 @@ static IRValue* getConst64(IRFun* f, TypeCode t, u64 value) {
     auto op = IROpConstFromAST(t);
     assert(IROpInfo(op)->aux != IRAuxNone);
     // Create const operation and add it to the entry block of function f
-    v = IRValueNew(f, f->blocks.v[0], op, t, /*SrcPos*/NULL);
+    v = IRValueNew(f, f->blocks.v[0], op, t, NoPos);
     v->auxInt = value;
     f->consts = IRConstCacheAdd(f->consts, f->mem, t, value, v, addHint);
     // dlog("getConst64 add new const op=%s value=%llX => v%u", IROpNames[op], value, v->id);
@@ -44,7 +44,7 @@ typedef struct IRValue {
   u32      id;   // unique identifier
   IROp     op;   // operation that computes this value
   TypeCode type;
-  SrcPos   pos;  // source position
+  Pos      pos;  // source position
   IRValue* args[3]; u8 argslen; // arguments
   union {
     i64 auxInt; // floats are stored as reinterpreted bits
@@ -60,7 +60,7 @@ typedef struct IRBlock {
   u32         id;       // block ID
   IRBlockKind kind;     // kind of block
   bool        sealed;   // true if no further predecessors will be added
-  SrcPos      pos;      // source position
+  Pos         pos;      // source position
   const char* comment;  // short comment for IR formatting. May be NULL.
   IRBlock*    succs[2]; // Successor/subsequent blocks (CFG)
   IRBlock*    preds[2]; // Predecessors (CFG)
@@ -81,7 +81,7 @@ typedef struct IRFun {
   Memory   mem; // owning allocator
   Array    blocks; void* blocksStorage[4]; // IRBlock*[]
   Sym      name;   // may be NULL
-  SrcPos   pos;    // source position
+  Pos      pos;    // source position
   u32      nargs;  // number of arguments
   Sym      typeid; // TypeCode encoding
 
@@ -101,12 +101,12 @@ typedef struct IRPkg {
 } IRPkg;
 
 
-IRValue* IRValueNew(IRFun* f, IRBlock* b/*null*/, IROp op, TypeCode type, const SrcPos*/*null*/);
+IRValue* IRValueNew(IRFun* f, IRBlock* b/*null*/, IROp op, TypeCode type, Pos);
 void IRValueAddComment(IRValue* v, Memory, ConstStr comment);
 void IRValueAddArg(IRValue* v, IRValue* arg);
 
 
-IRBlock* IRBlockNew(IRFun* f, IRBlockKind, const SrcPos*/*nullable*/);
+IRBlock* IRBlockNew(IRFun* f, IRBlockKind, Pos);
 void IRBlockDiscard(IRBlock* b); // removes it from b->f and frees memory of b.
 void IRBlockAddValue(IRBlock* b, IRValue* v);
 void IRBlockSetControl(IRBlock* b, IRValue* v/*pass null to clear*/);
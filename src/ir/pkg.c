@@ -12,9 +12,8 @@ IRPkg* IRPkgNew(Memory mem, const char* name) {
   if (name == NULL) {
     pkg->name = "_";
   } else {
-    char* name2 = ((char*)pkg) + namelen;
-    memcpy(name2, name, namelen);
-    name2[namelen] = 0;
+    char* name2 = ((char*)pkg) + sizeof(IRPkg);
+    memcpy(name2, name, namelen); // includes the terminating NUL
     pkg->name = name2;
   }
 
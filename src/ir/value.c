@@ -1,15 +1,13 @@
 #include "ir.h"
 
 
-IRValue* IRValueNew(IRFun* f, IRBlock* b, IROp op, TypeCode type, const SrcPos* pos) {
+IRValue* IRValueNew(IRFun* f, IRBlock* b, IROp op, TypeCode type, Pos pos) {
   assert(f->vid < 0xFFFFFFFF); // too many block IDs generated
-  auto v = (IRValue*)memalloc(f->mem, sizeof(IRValue));
+  auto v = (IRValue*)memalloctag(f->mem, sizeof(IRValue), MemTagIRValue);
   v->id = f->vid++;
   v->op = op;
   v->type = type;
-  if (pos != NULL) {
-    v->pos = *pos;
-  }
+  v->pos = pos;
   if (b != NULL) {
     ArrayPush(&b->values, v, b->f->mem);
   } else {
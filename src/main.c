@@ -1,8 +1,11 @@
 #include "build/build.h"
 #include "parse/parse.h"
+#include "parse/ast_pack.h"
+#include "parse/ast_cache.h"
 #include "ir/builder.h"
 #include "common/os.h"
 #include "common/test.h"
+#include "common/bench.h"
 
 static void errorHandler(const Source* src, SrcPos pos, ConstStr msg, void* userdata) {
   u32* errcount = (u32*)userdata;
@@ -22,6 +25,85 @@ static void printAst(const Node* n) {
 }
 
 
+// fmtbytes formats a byte count like "12.3 kB"
+static sds fmtbytes(sds s, u64 n) {
+  if (n < 1024) {
+    return sdscatprintf(s, "%llu B", (unsigned long long)n);
+  }
+  if (n < 1024 * 1024) {
+    return sdscatprintf(s, "%.1f kB", (double)n / 1024.0);
+  }
+  return sdscatprintf(s, "%.1f MB", (double)n / (1024.0 * 1024.0));
+}
+
+
+static sds reprMemStats(sds s, const char* name, const MemStats* st) {
+  s = sdscatprintf(s, "  %-7s live ", name);
+  s = fmtbytes(s, st->live);
+  s = sdscat(s, ", peak ");
+  s = fmtbytes(s, st->peak);
+  s = sdscatprintf(s, ", %llu allocations\n", (unsigned long long)st->count);
+  s = sdscat(s, "          by tag: ");
+  const char* sep = "";
+  for (u32 i = 0; i < MemTag_MAX; i++) {
+    if (st->tags[i].count > 0) {
+      s = sdscatprintf(s, "%s%s %llu ", sep, MemTagName(i), (unsigned long long)st->tags[i].count);
+      s = fmtbytes(s, st->tags[i].bytes);
+      sep = ", ";
+    }
+  }
+  s = sdscat(s, "\n          by size:");
+  for (u32 i = 0; i < MEM_STATS_NCLASSES; i++) {
+    size_t max = MemStatsClassMax(i);
+    if (max > 0) {
+      s = sdscatprintf(s, " <=%zu:%llu", max, (unsigned long long)st->classes[i]);
+    } else {
+      s = sdscatprintf(s, " >%zu:%llu", MemStatsClassMax(i - 1), (unsigned long long)st->classes[i]);
+    }
+  }
+  return sdscat(s, "\n");
+}
+
+
+// printMemReport writes memory usage after a compilation phase to stderr, if enabled with -mem.
+// "ast" is the compilation context's memory (AST, scopes), "ir" the IR builder's (if any)
+// and "global" is the global allocator (symbols, strings, gc objects.) The size of the AST is
+// compared with the size of its packed form (see AstPack) per byte of source.
+static bool memReport = false;
+
+static void printMemReport(const char* phase, CCtx* cc, const Node* file, Memory irmem) {
+  if (!memReport) {
+    return;
+  }
+  auto s = sdscatprintf(sdsempty(), "memory after %s:\n", phase);
+  auto st = MemoryStats(cc->mem);
+  s = reprMemStats(s, "ast", st);
+  if (irmem != NULL) {
+    s = reprMemStats(s, "ir", MemoryStats(irmem));
+  }
+  s = reprMemStats(s, "global", MemoryStats(NULL));
+
+  AstPack pack;
+  AstPackInit(&pack, &cc->src, NULL);
+  AstPackAdd(&pack, file);
+  u64 astsize = st->tags[MemTagNode].bytes + st->tags[MemTagNodeList].bytes +
+                st->tags[MemTagScope].bytes;
+  double srclen = (double)max(cc->src.len, (size_t)1);
+  s = sdscat(s, "  source  ");
+  s = fmtbytes(s, cc->src.len);
+  s = sdscat(s, ", ast nodes ");
+  s = fmtbytes(s, astsize);
+  s = sdscatprintf(s, " (%.1f B/byte), packed ", (double)astsize / srclen);
+  s = fmtbytes(s, AstPackSize(&pack));
+  s = sdscatprintf(s, " (%.1f B/byte, %u nodes)\n", (double)AstPackSize(&pack) / srclen,
+    pack.nnodes - 1);
+  AstPackFree(&pack);
+
+  fwrite(s, sdslen(s), 1, stderr);
+  sdsfree(s);
+}
+
+
 static void printIR(const IRPkg* pkg) {
   auto s = IRReprPkgStr(pkg, sdsempty());
   s = sdscatlen(s, "\n", 1);
@@ -30,53 +112,88 @@ static void printIR(const IRPkg* pkg) {
 }
 
 
-void parsefile(Str filename, Scope* pkgscope) {
+// cacheDir is the directory of AST cache files, set with -cache. NULL when not caching.
+static const char* cacheDir = NULL;
 
-  // load file contents
-  size_t len = 0;
-  auto buf = os_readfile(filename, &len, NULL);
-  if (!buf) {
-    die("%s: %s", filename, strerror(errno));
-  }
+void parsefile(Str filename, Scope* pkgscope) {
 
   // our userdata is number of errors encountered (incremented by errorHandler)
   u32 errcount = 0;
 
-  // compilation context
-  CCtx cc = {0}; // TODO: share across individual, non-overlapping compile sessions
-  CCtxInit(&cc, errorHandler, &errcount, filename, buf, len);
+  // compilation context, with file contents mapped into memory.
+  // Shared by all files; CCtxInitFile recycles the memory of the previous file.
+  static CCtx cc; // zero-initialized since it's static
+  if (!CCtxInitFile(&cc, errorHandler, &errcount, filename)) {
+    die("%s: %s", filename, strerror(errno));
+  }
+  if (memReport) {
+    MemoryEnableStats(cc.mem);
+  }
 
-  printf("————————————————————————————————————————————————————————————————\n");
-  printf("PARSE\n");
-  // parse input
-  static P parser; // shared parser (zero-initialized since it's static)
-  auto file = Parse(&parser, &cc, ParseComments /*| ParseOpt*/, pkgscope);
-  printAst(file);
-  if (errcount != 0) { goto end; }
-
-  // resolve symbols and types
-  if (parser.unresolved == 0) {
-    dlog("(no unresolved names; not running sym resolver)");
+  // load the resolved AST from the cache, if the source has been compiled before
+  Str cachefile = NULL;
+  Node* file = NULL;
+  if (cacheDir != NULL) {
+    cachefile = AstCachePath(sdsempty(), cacheDir, &cc.src);
+    AstCacheInfo info;
+    file = AstCacheLoad(cachefile, &cc, pkgscope, &info);
+    if (file != NULL && info.stage != AstCacheResolved) {
+      file = NULL;
+    }
+  }
+
+  if (file != NULL) {
+    printf("————————————————————————————————————————————————————————————————\n");
+    printf("LOAD CACHED AST\n");
+    printAst(file);
+    printMemReport("LOAD CACHED AST", &cc, file, NULL);
   } else {
     printf("————————————————————————————————————————————————————————————————\n");
-    printf("RESOLVE NAMES\n");
-    ResolveSym(&cc, parser.s.flags, file, pkgscope);
+    printf("PARSE\n");
+    // parse input
+    static P parser; // shared parser (zero-initialized since it's static)
+    file = Parse(&parser, &cc, ParseComments /*| ParseOpt*/, pkgscope);
     printAst(file);
+    printMemReport("PARSE", &cc, file, NULL);
     if (errcount != 0) { goto end; }
-  }
 
-  printf("————————————————————————————————————————————————————————————————\n");
-  printf("RESOLVE TYPES\n");
-  ResolveType(&cc, file);
-  printAst(file);
-  if (errcount != 0) { goto end; }
+    // resolve symbols and types
+    if (parser.unresolved == 0) {
+      dlog("(no unresolved names; not running sym resolver)");
+    } else {
+      printf("————————————————————————————————————————————————————————————————\n");
+      printf("RESOLVE NAMES\n");
+      ResolveSym(&cc, parser.s.flags, file, pkgscope);
+      printAst(file);
+      printMemReport("RESOLVE NAMES", &cc, file, NULL);
+      if (errcount != 0) { goto end; }
+    }
+
+    printf("————————————————————————————————————————————————————————————————\n");
+    printf("RESOLVE TYPES\n");
+    ResolveType(&cc, file);
+    printAst(file);
+    printMemReport("RESOLVE TYPES", &cc, file, NULL);
+    if (errcount != 0) { goto end; }
+
+    if (cachefile != NULL) {
+      AstCacheInfo info = { AstCacheResolved, parser.unresolved };
+      if (!AstCacheSave(cachefile, &cc, file, pkgscope, info)) {
+        dlog("AST of %s not cached in %s", filename, cachefile);
+      }
+    }
+  }
 
   printf("————————————————————————————————————————————————————————————————\n");
   printf("BUILD IR\n");
   // build some IR
   IRBuilder irbuilder = {};
   IRBuilderInit(&irbuilder, IRBuilderComments /*| IRBuilderOpt*/, "foo"); // start a new package
+  if (memReport) {
+    MemoryEnableStats(irbuilder.mem);
+  }
   IRBuilderAdd(&irbuilder, &cc, file); // add ast to current package
+  printMemReport("BUILD IR", &cc, file, irbuilder.mem);
 
   printf("————————————————————————————————————————————————————————————————\n");
   // print IR SLC
@@ -87,7 +204,9 @@ void parsefile(Str filename, Scope* pkgscope) {
   // AsmELF();
 
   end:
-  CCtxFree(&cc);
+  if (cachefile != NULL) {
+    sdsfree(cachefile);
+  }
   memgc_collect();
 }
 
@@ -97,8 +216,30 @@ int main(int argc, char **argv) {
     return 0;
   }
 
+  #ifdef W_BENCH_BUILD
+  return BenchMain(argc, argv);
+  #endif
+
+  // -mem prints memory usage after every compilation phase.
+  // -cache <dir> stores the AST of every source in dir, and uses it instead of parsing and
+  // resolving the source when it is compiled again (see AstCache.)
+  while (argc > 1 && argv[1][0] == '-') {
+    if (strcmp(argv[1], "-mem") == 0) {
+      memReport = true;
+      MemoryEnableStats(NULL);
+    } else if (strcmp(argv[1], "-cache") == 0 && argc > 2) {
+      cacheDir = argv[2];
+      argv++;
+      argc--;
+    } else {
+      break;
+    }
+    argv++;
+    argc--;
+  }
+
   if (argc < 2) {
-    fprintf(stderr, "usage: %s <input>...\n", argv[0]);
+    fprintf(stderr, "usage: %s [-mem] [-cache <dir>] <input>...\n", argv[0]);
     exit(1);
   }
 
@@ -1,6 +1,8 @@
 #include "ast.h"
+#include <ctype.h>
 #include "../common/ptrmap.h"
 #include "../common/tstyle.h"
+#include "../common/test.h"
 
 // #define DEBUG_LOOKUP
 
@@ -115,7 +117,7 @@ CType NodeIdealCType(const Node* n) {
 
 
 // NBad node
-static const Node _NodeBad = {NBad,{0,0,0},NULL,{0}};
+static const Node _NodeBad = {NBad,NoPos,NULL,{0}};
 const Node* NodeBad = &_NodeBad;
 
 
@@ -489,6 +491,27 @@ Str NodeRepr(const Node* n, Str s) {
 }
 
 
+#if DEBUG
+Str NodeTestRepr(const Node* n, Str s) {
+  size_t start = sdslen(s);
+  s = NodeRepr(n, s);
+  size_t j = start;
+  for (size_t i = start; i < sdslen(s); i++) {
+    s[j++] = s[i];
+    if (s[i] == '0' && i + 1 < sdslen(s) && s[i + 1] == 'x') {
+      s[j++] = s[++i];
+      while (i + 1 < sdslen(s) && isxdigit(s[i + 1])) {
+        i++;
+      }
+    }
+  }
+  sdssetlen(s, j);
+  s[j] = 0;
+  return s;
+}
+#endif
+
+
 static sds _sdscatNodeList(sds s, const NodeList* nodeList) {
   bool isFirst = true;
   NodeListForEach(nodeList, n, {
@@ -676,23 +699,42 @@ ConstStr fmtast(const Node* n) {
 
 
 void NodeListAppend(Memory mem, NodeList* a, Node* n) {
-  auto l = (NodeListLink*)memalloc(mem, sizeof(NodeListLink));
-  l->node = n;
-  if (a->tail == NULL) {
-    a->head = l;
+  if (a->cap == 0 && a->len < NODE_LIST_INLINE) {
+    a->a[a->len++] = n;
+    return;
+  }
+  if (a->cap == 0 || a->len == a->cap) {
+    // Move the items to a new array twice as large (the first time, out of inline storage.)
+    // The old array is not freed since it may be shared with a copy of the node (NodeCopy);
+    // AST memory is usually an arena anyway.
+    u32 cap = max(a->len * 2, (u32)NODE_LIST_INLINE * 2);
+    auto v = (Node**)memalloctag(mem, sizeof(Node*) * cap, MemTagNodeList);
+    memcpy(v, NodeListItems(a), sizeof(Node*) * a->len);
+    a->v = v;
+    a->cap = cap;
+  }
+  a->v[a->len++] = n;
+}
+
+
+void NodeListAssign(Memory mem, NodeList* a, Node* const* v, u32 len) {
+  if (len <= NODE_LIST_INLINE) {
+    memcpy(a->a, v, sizeof(Node*) * len);
+    a->cap = 0;
   } else {
-    a->tail->next = l;
+    a->v = (Node**)memalloctag(mem, sizeof(Node*) * len, MemTagNodeList);
+    memcpy(a->v, v, sizeof(Node*) * len);
+    a->cap = len;
   }
-  a->tail = l;
-  a->len++;
+  a->len = len;
 }
 
 
 Scope* ScopeNew(const Scope* parent, Memory mem) {
-  auto s = (Scope*)memalloc(mem, sizeof(Scope));
+  auto s = (Scope*)memalloctag(mem, sizeof(Scope), MemTagScope);
   s->parent = parent;
-  s->childcount = 0;
-  SymMapInit(&s->bindings, 8, mem);
+  // bindings allocates memory only when it is first used
+  s->bindings.mem = mem;
   return s;
 }
 
@@ -701,7 +743,9 @@ static const Scope* globalScope = NULL;
 
 
 void ScopeFree(Scope* s, Memory mem) {
-  SymMapDealloc(&s->bindings);
+  if (s->bindings.buckets != NULL) {
+    SymMapDealloc(&s->bindings);
+  }
   memfree(mem, s);
 }
 
@@ -710,11 +754,11 @@ const Scope* GetGlobalScope() {
   if (globalScope == NULL) {
     auto s = ScopeNew(NULL, NULL);
 
-    #define X(name) SymMapSet(&s->bindings, sym_##name, (void*)Type_##name);
+    #define X(name) ScopeAssoc(s, sym_##name, Type_##name);
     TYPE_SYMS(X)
     #undef X
 
-    #define X(name, _typ, _val) SymMapSet(&s->bindings, sym_##name, (void*)Const_##name);
+    #define X(name, _typ, _val) ScopeAssoc(s, sym_##name, Const_##name);
     PREDEFINED_CONSTANTS(X)
     #undef X
 
@@ -724,16 +768,77 @@ const Scope* GetGlobalScope() {
 }
 
 
+// scopeIsInline returns true if the bindings of s are stored in s->keys and s->values
+inline static bool scopeIsInline(const Scope* s) {
+  return s->bindings.buckets == NULL;
+}
+
+
 const Node* ScopeAssoc(Scope* s, Sym key, const Node* value) {
-  return SymMapSet(&s->bindings, key, (Node*)value);
+  if (scopeIsInline(s)) {
+    for (u32 i = 0; i < s->nbindings; i++) {
+      if (s->keys[i] == key) {
+        auto oldval = s->values[i];
+        s->values[i] = value;
+        return oldval;
+      }
+    }
+    if (s->nbindings < SCOPE_INLINE_BINDINGS) {
+      s->keys[s->nbindings] = key;
+      s->values[s->nbindings] = value;
+      s->nbindings++;
+      return NULL;
+    }
+    // move inline bindings to the hash map
+    SymMapInit(&s->bindings, SCOPE_INLINE_BINDINGS * 2, s->bindings.mem);
+    for (u32 i = 0; i < s->nbindings; i++) {
+      SymMapSet(&s->bindings, s->keys[i], (void*)s->values[i]);
+    }
+  }
+  auto oldval = (const Node*)SymMapSet(&s->bindings, key, (void*)value);
+  s->nbindings = s->bindings.len;
+  return oldval;
+}
+
+
+const Node* ScopeDel(Scope* s, Sym key) {
+  if (!scopeIsInline(s)) {
+    auto oldval = (const Node*)SymMapDel(&s->bindings, key);
+    s->nbindings = s->bindings.len;
+    return oldval;
+  }
+  for (u32 i = 0; i < s->nbindings; i++) {
+    if (s->keys[i] == key) {
+      // move the last binding into the hole
+      auto oldval = s->values[i];
+      s->nbindings--;
+      s->keys[i] = s->keys[s->nbindings];
+      s->values[i] = s->values[s->nbindings];
+      return oldval;
+    }
+  }
+  return NULL;
+}
+
+
+const Node* ScopeLookupLocal(const Scope* s, Sym key) {
+  if (scopeIsInline(s)) {
+    for (u32 i = 0; i < s->nbindings; i++) {
+      if (s->keys[i] == key) {
+        return s->values[i];
+      }
+    }
+    return NULL;
+  }
+  return (const Node*)SymMapGet(&s->bindings, key);
 }
 
 
 const Node* ScopeLookup(const Scope* scope, Sym s) {
   const Node* n = NULL;
   while (scope && n == NULL) {
-    // dlog("[lookup] %s in scope %p(len=%u)", s, scope, scope->bindings.len);
-    n = SymMapGet(&scope->bindings, s);
+    // dlog("[lookup] %s in scope %p(len=%u)", s, scope, scope->nbindings);
+    n = ScopeLookupLocal(scope, s);
     scope = scope->parent;
   }
   #ifdef DEBUG_LOOKUP
@@ -745,3 +850,56 @@ const Node* ScopeLookup(const Scope* scope, Sym s) {
   #endif
   return n;
 }
+
+
+#if W_UNIT_TEST_ENABLED
+static void test_scope() {
+  auto mem = MemoryNew(0);
+  auto parent = ScopeNew(GetGlobalScope(), mem);
+  auto s = ScopeNew(parent, mem);
+  Node nodes[SCOPE_INLINE_BINDINGS * 3];
+  Sym names[countof(nodes)];
+  char buf[32];
+  for (u32 i = 0; i < countof(nodes); i++) {
+    int len = snprintf(buf, sizeof(buf), "scope_test_%u", i);
+    names[i] = symgeth((const u8*)buf, (size_t)len);
+  }
+
+  ScopeAssoc(parent, names[0], &nodes[0]);
+  assert(ScopeLookup(s, names[0]) == &nodes[0]);
+  assert(ScopeLookupLocal(s, names[0]) == NULL);
+  assert(ScopeLookup(s, sym_int) == Type_int);
+
+  // add bindings, past the number which is stored inline. Each binding shadows one in parent.
+  for (u32 i = 0; i < countof(nodes); i++) {
+    assert(ScopeAssoc(s, names[i], &nodes[(i + 1) % countof(nodes)]) == NULL);
+    asserteq(s->nbindings, i + 1);
+    for (u32 j = 0; j <= i; j++) {
+      assert(ScopeLookup(s, names[j]) == &nodes[(j + 1) % countof(nodes)]);
+    }
+    if (i == SCOPE_INLINE_BINDINGS - 1) {
+      // delete and replace, while stored inline
+      assert(ScopeDel(s, names[0]) == &nodes[1]);
+      assert(ScopeLookup(s, names[0]) == &nodes[0]); // parent's binding
+      assert(ScopeDel(s, names[0]) == NULL);
+      asserteq(s->nbindings, i);
+      assert(ScopeAssoc(s, names[0], &nodes[1]) == NULL);
+      assert(ScopeAssoc(s, names[i], &nodes[0]) == &nodes[i + 1]);
+      assert(ScopeAssoc(s, names[i], &nodes[i + 1]) == &nodes[0]);
+    }
+  }
+
+  // delete and replace, stored in a hash map
+  assert(ScopeDel(s, names[0]) == &nodes[1]);
+  assert(ScopeLookup(s, names[0]) == &nodes[0]);
+  asserteq(s->nbindings, (u32)countof(nodes) - 1);
+  assert(ScopeAssoc(s, names[1], &nodes[0]) == &nodes[2]);
+  assert(ScopeLookupLocal(s, names[1]) == &nodes[0]);
+
+  ScopeFree(s, mem);
+  ScopeFree(parent, mem);
+  MemoryFree(mem);
+}
+
+W_UNIT_TEST(Scope, { test_scope(); })
+#endif
@@ -61,31 +61,43 @@ const char* NodeKindName(NodeKind);
 const char* NodeClassName(NodeClass);
 
 
-// Scope represents a lexical namespace
+// Scope represents a lexical namespace.
+// Most scopes have only a few bindings. These are stored inline, in keys and values, and
+// searched by comparing pointers. When a scope gets more than SCOPE_INLINE_BINDINGS bindings,
+// all of them are moved to the hash map bindings.
+#define SCOPE_INLINE_BINDINGS 4
+typedef struct Node Node;
 typedef struct Scope Scope;
 typedef struct Scope {
   u32          childcount; // number of scopes referencing this scope as parent
+  u32          nbindings;  // number of bindings
   const Scope* parent;
-  SymMap       bindings;
+  Sym          keys[SCOPE_INLINE_BINDINGS];   // inline bindings (unless bindings is used)
+  const Node*  values[SCOPE_INLINE_BINDINGS];
+  SymMap       bindings; // used when there are more than SCOPE_INLINE_BINDINGS bindings
 } Scope;
 
-typedef struct Node Node;
 Scope* ScopeNew(const Scope* parent, Memory);
 void ScopeFree(Scope*, Memory);
 const Node* ScopeAssoc(Scope*, Sym, const Node* value); // Returns replaced value or NULL
-const Node* ScopeLookup(const Scope*, Sym);
+const Node* ScopeDel(Scope*, Sym); // Returns removed value or NULL
+const Node* ScopeLookup(const Scope*, Sym); // looks in scope and its parents
+const Node* ScopeLookupLocal(const Scope*, Sym); // looks only in scope
 const Scope* GetGlobalScope();
 
-// NodeList is a linked list of nodes
-typedef struct NodeListLink NodeListLink;
-typedef struct NodeListLink {
-  Node*         node;
-  NodeListLink* next;
-} NodeListLink;
+// NodeList is a list of nodes. Lists of up to NODE_LIST_INLINE nodes are stored in the list
+// itself and longer lists in an array. NodeListAppend grows the array geometrically while
+// NodeListAssign, which the parser uses when it has read all nodes of a list, allocates an
+// array of exactly the size needed. NODE_LIST_INLINE is 2 so that a NodeList (24 bytes) fits
+// in Node without making it larger.
+#define NODE_LIST_INLINE 2
 typedef struct {
-  NodeListLink* head;
-  NodeListLink* tail;
-  u32           len;   // number of items
+  u32 len; // number of items
+  u32 cap; // capacity of v, or 0 if the items are stored inline (in a)
+  union {
+    Node*  a[NODE_LIST_INLINE];
+    Node** v;
+  };
 } NodeList;
 
 
@@ -100,7 +112,7 @@ typedef struct NVal {
 
 typedef struct Node {
   NodeKind kind;      // kind of node (e.g. NIdent)
-  SrcPos   pos;       // source origin & position
+  Pos      pos;       // source origin & position
   Node*    type;      // value type. null if unknown.
   union {
     void* _never; // for initializers
@@ -166,6 +178,12 @@ typedef struct Node {
 // inline static void NodeFree(Node* _) {}
 Str NodeRepr(const Node* n, Str s); // return human-readable printable text representation
 
+#if DEBUG
+// NodeTestRepr appends NodeRepr(n) to s with the digits of pointers (0x...) left out, so that
+// unit tests can compare trees which are equal but not at the same addresses.
+Str NodeTestRepr(const Node* n, Str s);
+#endif
+
 // fmtast returns an s-expression representation of an AST.
 // Note: The returned string is garbage collected.
 ConstStr fmtast(const Node*);
@@ -209,35 +227,47 @@ const char* NValStr(const NVal* v); // returns a temporary string
 
 #define NodeListForEach(list, nodename, body)               \
   do {                                                      \
-    auto __l = (list)->head;                                \
-    while (__l) {                                           \
-      auto nodename = __l->node;                            \
+    auto __l = (list);                                      \
+    Node** __v = NodeListItems(__l);                        \
+    for (u32 __i = 0; __i < __l->len; __i++) {              \
+      auto nodename = __v[__i];                             \
       body;                                                 \
-      __l = __l->next;                                      \
     }                                                       \
   } while(0)
 
 
 #define NodeListMap(list, nodename, expr)                   \
   do {                                                      \
-    auto __l = (list)->head;                                \
-    while (__l) {                                           \
-      auto nodename = __l->node;                            \
-      __l->node = expr;                                     \
-      __l = __l->next;                                      \
+    auto __l = (list);                                      \
+    Node** __v = NodeListItems(__l);                        \
+    for (u32 __i = 0; __i < __l->len; __i++) {              \
+      auto nodename = __v[__i];                             \
+      __v[__i] = expr;                                      \
     }                                                       \
   } while(0)
 
 
 // Add node to list
 void NodeListAppend(Memory mem, NodeList*, Node*);
+
+// NodeListAssign replaces the items of list with the len nodes at v. Unless they fit inline,
+// the nodes are copied to a new array of exactly len items, allocated in mem.
+void NodeListAssign(Memory mem, NodeList*, Node* const* v, u32 len);
+
+// NodeListItems returns the items of list, which are valid until the list is modified
+static inline Node** NodeListItems(const NodeList* list) {
+  return list->cap == 0 ? (Node**)list->a : list->v;
+}
+static inline Node* NodeListAt(const NodeList* list, u32 index) {
+  assert(index < list->len);
+  return NodeListItems(list)[index];
+}
 static inline u32 NodeListLen(const NodeList* list) {
   return list->len;
 }
+// NodeListClear removes all items from list. Its memory is kept for reuse.
 static inline void NodeListClear(NodeList* list) {
   list->len = 0;
-  list->head = NULL;
-  list->tail = NULL;
 }
 
 
@@ -245,13 +275,13 @@ const Node* NodeBad;  // kind==NBad
 
 // allocate a node from an allocator
 static inline Node* NewNode(Memory mem, NodeKind kind) {
-  Node* n = (Node*)memalloc(mem, sizeof(Node));
+  Node* n = (Node*)memalloctag(mem, sizeof(Node), MemTagNode);
   n->kind = kind;
   return n;
 }
 
 static inline Node* NodeCopy(Memory mem, const Node* src) {
-  Node* n = (Node*)memalloc(mem, sizeof(Node));
+  Node* n = (Node*)memalloctag(mem, sizeof(Node), MemTagNode);
   memcpy(n, src, sizeof(Node));
   return n;
 }
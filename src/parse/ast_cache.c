@@ -0,0 +1,670 @@
+#include "ast_cache.h"
+#include "../common/hash.h"
+#include "../common/os.h"
+#include "../common/test.h"
+
+// sections of a cache file, in order (see ast_cache.h)
+typedef enum {
+  SecNodes,
+  SecChildren,
+  SecExtra,
+  SecScopes,
+  SecBindings,
+  SecExt,
+  SecSymOffs,
+  SecSymHash,
+  SecSymData,
+  Sec_MAX,
+} CacheSection;
+
+// cacheLayout computes the offset of each section of a file with header h.
+// Returns the size of the file.
+static u64 cacheLayout(const AstCacheHeader* h, u64 offs[Sec_MAX]) {
+  const u64 sizes[Sec_MAX] = {
+    [SecNodes]    = (u64)h->nnodes * sizeof(PackedNode),
+    [SecChildren] = (u64)h->nchildren * sizeof(NRef),
+    [SecExtra]    = (u64)h->nextra * sizeof(u32),
+    [SecScopes]   = (u64)h->nscopes * sizeof(PackedScope),
+    [SecBindings] = (u64)h->nbindings * sizeof(PackedBinding),
+    [SecExt]      = (u64)h->next * sizeof(u32),
+    [SecSymOffs]  = ((u64)h->nsyms + 1) * sizeof(u32),
+    [SecSymHash]  = (u64)h->nsyms * sizeof(u32),
+    [SecSymData]  = (u64)h->nsymdata,
+  };
+  u64 size = align2((u64)sizeof(AstCacheHeader), 8llu);
+  for (u32 i = 0; i < Sec_MAX; i++) {
+    offs[i] = size;
+    size = align2(size + sizes[i], 8llu);
+  }
+  return size;
+}
+
+
+// CACHE_MAX_PREDEFINED is the capacity of the array passed to cachePredefined
+#define CACHE_MAX_PREDEFINED 64
+
+// cachePredefined stores the predefined nodes in v and returns their number.
+// The index of a node in v is how cache files refer to it.
+static u32 cachePredefined(const Node** v) {
+  u32 n = 0;
+  v[n++] = NodeBad;
+  #define X(name) v[n++] = Type_##name;
+  TYPE_SYMS(X)
+  #undef X
+  #define X(name, _typ, _val) v[n++] = Const_##name;
+  PREDEFINED_CONSTANTS(X)
+  #undef X
+  v[n++] = Type_nil;
+  v[n++] = Const_nil;
+  v[n++] = Type_ideal;
+  assert(n <= CACHE_MAX_PREDEFINED);
+  return n;
+}
+
+
+u64 AstCacheCompilerId() {
+  const Node* predefined[CACHE_MAX_PREDEFINED];
+  const u32 v[] = {
+    AST_CACHE_VERSION,
+    sizeof(AstCacheHeader), sizeof(PackedNode), sizeof(PackedScope), sizeof(PackedBinding),
+    _NodeKindMax, TMax, TypeCode_MAX, CType_nil, cachePredefined(predefined),
+    hashWY((const u8*)"ideal", 5), // identifies the hash function of symhash
+  };
+  return hashWY64((const u8*)v, sizeof(v));
+}
+
+
+Str AstCachePath(Str s, const char* dir, const Source* src) {
+  const u64 key[2] = { hashWY64(src->buf, src->len), AstCacheCompilerId() };
+  return sdscatprintf(s, "%s/%016llx.wast",
+    dir, (unsigned long long)hashWY64((const u8*)key, sizeof(key)));
+}
+
+
+// -----------------------------------------------------------------------------------------------
+// encoding
+
+// cacheAppend appends size bytes at ptr to buf, followed by zeroes up to an 8-byte boundary
+static void cacheAppend(Buf* buf, size_t start, u64 offs, const void* ptr, size_t size) {
+  assert(buf->len - start == offs);
+  if (size > 0) {
+    BufAppend(buf, ptr, size);
+  }
+  BufAppendFill(buf, 0, align2(buf->len - start, (size_t)8) - (buf->len - start));
+}
+
+
+// cacheExtIndex returns the ext entry of the external node or scope ptr, or false if ptr is
+// not one that a cache file can refer to
+static bool cacheExtIndex(
+  const void* ptr, const Node** predefined, u32 npredefined, const Scope* pkgscope, u32* index)
+{
+  for (u32 i = 0; i < npredefined; i++) {
+    if (ptr == predefined[i]) {
+      *index = i;
+      return true;
+    }
+  }
+  if (ptr == GetGlobalScope()) {
+    *index = AstCacheExtGlobalScope;
+    return true;
+  }
+  if (ptr == pkgscope) {
+    *index = AstCacheExtPkgScope;
+    return true;
+  }
+  return false;
+}
+
+
+static bool cacheEncodePack(
+  Buf* buf, const Source* src, const AstPack* p, NRef root, const Scope* pkgscope,
+  AstCacheInfo info)
+{
+  const Node* predefined[CACHE_MAX_PREDEFINED];
+  u32 npredefined = cachePredefined(predefined);
+  u32* ext = (u32*)memalloc(NULL, sizeof(u32) * max(p->next, 1u));
+  for (u32 i = 0; i < p->next; i++) {
+    if (!cacheExtIndex(p->ext[i], predefined, npredefined, pkgscope, &ext[i])) {
+      memfree(NULL, ext);
+      return false;
+    }
+  }
+
+  // sym string table
+  u32* symoffs = (u32*)memalloc(NULL, sizeof(u32) * (p->nsyms + 1));
+  u32* symhashes = (u32*)memalloc(NULL, sizeof(u32) * max(p->nsyms, 1u));
+  u32 nsymdata = 0;
+  for (u32 i = 0; i < p->nsyms; i++) {
+    symoffs[i] = nsymdata;
+    symhashes[i] = symhash(p->syms[i]);
+    nsymdata += symlen(p->syms[i]);
+  }
+  symoffs[p->nsyms] = nsymdata;
+
+  AstCacheHeader h = {
+    .magic = {'W','A','S','T'},
+    .version = AST_CACHE_VERSION,
+    .compiler = AstCacheCompilerId(),
+    .srchash = hashWY64(src->buf, src->len),
+    .srclen = src->len,
+    .stage = info.stage,
+    .unresolved = info.unresolved,
+    .root = root,
+    .nnodes = p->nnodes,
+    .nchildren = p->nchildren,
+    .nextra = p->nextra,
+    .nscopes = p->nscopes,
+    .nbindings = p->nbindings,
+    .next = p->next,
+    .nsyms = p->nsyms,
+    .nsymdata = nsymdata,
+  };
+  u64 offs[Sec_MAX];
+  h.size = cacheLayout(&h, offs);
+
+  size_t start = buf->len;
+  BufMakeRoomFor(buf, h.size);
+  cacheAppend(buf, start, 0, &h, sizeof(h));
+  cacheAppend(buf, start, offs[SecNodes], p->nodes, sizeof(PackedNode) * p->nnodes);
+  cacheAppend(buf, start, offs[SecChildren], p->children, sizeof(NRef) * p->nchildren);
+  cacheAppend(buf, start, offs[SecExtra], p->extra, sizeof(u32) * p->nextra);
+  cacheAppend(buf, start, offs[SecScopes], p->scopes, sizeof(PackedScope) * p->nscopes);
+  cacheAppend(buf, start, offs[SecBindings], p->bindings, sizeof(PackedBinding) * p->nbindings);
+  cacheAppend(buf, start, offs[SecExt], ext, sizeof(u32) * p->next);
+  cacheAppend(buf, start, offs[SecSymOffs], symoffs, sizeof(u32) * (p->nsyms + 1));
+  cacheAppend(buf, start, offs[SecSymHash], symhashes, sizeof(u32) * p->nsyms);
+  assert(buf->len - start == offs[SecSymData]);
+  for (u32 i = 0; i < p->nsyms; i++) {
+    BufAppend(buf, p->syms[i], symlen(p->syms[i]));
+  }
+  cacheAppend(buf, start, offs[SecSymData] + nsymdata, NULL, 0);
+  asserteq(buf->len - start, h.size);
+
+  memfree(NULL, ext);
+  memfree(NULL, symoffs);
+  memfree(NULL, symhashes);
+  return true;
+}
+
+
+bool AstCacheEncode(
+  Buf* buf, const Source* src, const Node* file, const Scope* pkgscope, AstCacheInfo info)
+{
+  AstPack pack;
+  AstPackInit(&pack, (Source*)src, NULL);
+  NRef root = AstPackAdd(&pack, file);
+  bool ok = cacheEncodePack(buf, src, &pack, root, pkgscope, info);
+  AstPackFree(&pack);
+  return ok;
+}
+
+
+// -----------------------------------------------------------------------------------------------
+// decoding
+
+// cacheHeader returns the header of data if it is a cache file for src, or NULL if not
+static const AstCacheHeader* cacheHeader(const u8* data, size_t len, const Source* src) {
+  if (len < sizeof(AstCacheHeader)) {
+    return NULL;
+  }
+  auto h = (const AstCacheHeader*)data;
+  if (memcmp(h->magic, "WAST", 4) != 0 ||
+      h->version != AST_CACHE_VERSION ||
+      h->compiler != AstCacheCompilerId() ||
+      h->size != len ||
+      (h->stage != AstCacheParsed && h->stage != AstCacheResolved) ||
+      h->srclen != src->len ||
+      h->srchash != hashWY64(src->buf, src->len))
+  {
+    return NULL;
+  }
+  u64 offs[Sec_MAX];
+  if (cacheLayout(h, offs) != len || h->root == 0 || h->root >= h->nnodes) {
+    return NULL;
+  }
+  return h;
+}
+
+
+// CacheCheck is the state of cacheCheckPack
+typedef struct CacheCheck {
+  const AstPack* p;
+  const u32*     ext; // ext entries of the file
+} CacheCheck;
+
+// cacheCheckRef returns true if ref is NULL, a node of the pack or an external node
+static bool cacheCheckRef(const CacheCheck* c, NRef ref) {
+  if (ref & NRefExternal) {
+    u32 i = ref & ~NRefExternal;
+    return i < c->p->next &&
+      c->ext[i] != AstCacheExtGlobalScope && c->ext[i] != AstCacheExtPkgScope;
+  }
+  return ref < c->p->nnodes;
+}
+
+// cacheCheckScope returns true if ref is NULL, an external scope or a scope of the pack no
+// greater than maxref. A scope's parent must come before it, or AstUnpack would not stop.
+static bool cacheCheckScope(const CacheCheck* c, u32 ref, u32 maxref) {
+  if (ref & NRefExternal) {
+    u32 i = ref & ~NRefExternal;
+    return i < c->p->next &&
+      (c->ext[i] == AstCacheExtGlobalScope || c->ext[i] == AstCacheExtPkgScope);
+  }
+  return ref <= maxref;
+}
+
+static bool cacheCheckSym(const CacheCheck* c, u32 sym) {
+  return sym <= c->p->nsyms;
+}
+
+// cacheCheckExtra returns true if extra[index:index+n] is in the pack
+static bool cacheCheckExtra(const CacheCheck* c, u32 index, u32 n) {
+  return index < c->p->nextra && c->p->nextra - index >= n;
+}
+
+static bool cacheCheckList(const CacheCheck* c, u32 list) {
+  const AstPack* p = c->p;
+  if (list >= p->nchildren || p->children[list] > p->nchildren - list - 1) {
+    return false;
+  }
+  for (u32 i = 0; i < p->children[list]; i++) {
+    if (!cacheCheckRef(c, p->children[list + 1 + i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool cacheCheckNode(const CacheCheck* c, const PackedNode* pn) {
+  const AstPack* p = c->p;
+  if (pn->kind >= _NodeKindMax ||
+      (pn->offs != AstPackNoPos && pn->offs > p->src->len) ||
+      !cacheCheckRef(c, pn->type))
+  {
+    return false;
+  }
+  switch ((NodeKind)pn->kind) {
+    case NNone:
+    case NBad:
+    case NNil:
+    case NZeroInit:
+      return true;
+
+    case NBoolLit:
+    case NIntLit:
+    case NFloatLit:
+      return pn->sub <= CType_nil;
+
+    case NComment:
+      return pn->a <= p->src->len && pn->b <= p->src->len - pn->a;
+
+    case NIdent:
+    case NArg:
+    case NField:
+    case NLet:
+      return cacheCheckSym(c, pn->a) && cacheCheckRef(c, pn->b);
+
+    case NAssign:
+    case NBinOp:
+    case NPrefixOp:
+    case NPostfixOp:
+    case NReturn:
+      return pn->aux < TMax && cacheCheckRef(c, pn->a) && cacheCheckRef(c, pn->b);
+
+    case NBlock:
+    case NFile:
+    case NTuple:
+      return cacheCheckList(c, pn->a) && cacheCheckScope(c, pn->b, p->nscopes);
+
+    case NCall:
+    case NTypeCast:
+      return cacheCheckRef(c, pn->a) && cacheCheckRef(c, pn->b);
+
+    case NFun:
+      return cacheCheckRef(c, pn->a) && cacheCheckExtra(c, pn->b, 3) &&
+        cacheCheckSym(c, p->extra[pn->b]) &&
+        cacheCheckRef(c, p->extra[pn->b + 1]) &&
+        cacheCheckScope(c, p->extra[pn->b + 2], p->nscopes);
+
+    case NIf:
+      return cacheCheckRef(c, pn->a) && cacheCheckExtra(c, pn->b, 2) &&
+        cacheCheckRef(c, p->extra[pn->b]) &&
+        cacheCheckRef(c, p->extra[pn->b + 1]);
+
+    case NBasicType:
+      return pn->sub < TypeCode_MAX && cacheCheckSym(c, pn->a) && cacheCheckSym(c, pn->b);
+
+    case NTupleType:
+      return cacheCheckList(c, pn->a) && cacheCheckSym(c, pn->b);
+
+    case NFunType:
+      return cacheCheckRef(c, pn->a) && cacheCheckExtra(c, pn->b, 2) &&
+        cacheCheckRef(c, p->extra[pn->b]) &&
+        cacheCheckSym(c, p->extra[pn->b + 1]);
+
+    case _NodeKindMax:
+      break;
+  }
+  return false;
+}
+
+// cacheCheckPack returns true if all references and indices of the pack are in bounds.
+// AstUnpack only asserts this, so a truncated or corrupted file, or one written by a build
+// with a different layout of the trees, must be rejected before it is unpacked.
+static bool cacheCheckPack(const AstPack* p, const u32* ext) {
+  CacheCheck c = { .p = p, .ext = ext };
+  for (u32 i = 1; i < p->nnodes; i++) {
+    if (!cacheCheckNode(&c, &p->nodes[i])) {
+      return false;
+    }
+  }
+  for (u32 i = 0; i < p->nscopes; i++) {
+    auto ps = &p->scopes[i];
+    if (!cacheCheckScope(&c, ps->parent, i) ||
+        ps->start > p->nbindings || ps->len > p->nbindings - ps->start)
+    {
+      return false;
+    }
+  }
+  for (u32 i = 0; i < p->nbindings; i++) {
+    auto b = &p->bindings[i];
+    if (b->name == 0 || b->value == 0 || !cacheCheckSym(&c, b->name) ||
+        !cacheCheckRef(&c, b->value))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+Node* AstCacheDecode(
+  const u8* data, size_t len, Source* src, Scope* pkgscope, Memory mem, AstCacheInfo* info_out)
+{
+  auto h = cacheHeader(data, len, src);
+  if (h == NULL) {
+    return NULL;
+  }
+  u64 offs[Sec_MAX];
+  cacheLayout(h, offs);
+
+  // The pack refers to the tables of data, except for syms and ext which are resolved to
+  // pointers. AstUnpack only reads the pack.
+  AstPack p = {0};
+  p.src = src;
+  p.nodes = (PackedNode*)(data + offs[SecNodes]);
+  p.nnodes = h->nnodes;
+  p.children = (NRef*)(data + offs[SecChildren]);
+  p.nchildren = h->nchildren;
+  p.extra = (u32*)(data + offs[SecExtra]);
+  p.nextra = h->nextra;
+  p.scopes = (PackedScope*)(data + offs[SecScopes]);
+  p.nscopes = h->nscopes;
+  p.bindings = (PackedBinding*)(data + offs[SecBindings]);
+  p.nbindings = h->nbindings;
+  p.nsyms = h->nsyms;
+
+  const Node* predefined[CACHE_MAX_PREDEFINED];
+  u32 npredefined = cachePredefined(predefined);
+  auto ext = (const u32*)(data + offs[SecExt]);
+  p.ext = (const void**)memalloc(NULL, sizeof(void*) * max(h->next, 1u));
+  p.next = h->next;
+  for (u32 i = 0; i < h->next; i++) {
+    if (ext[i] == AstCacheExtGlobalScope) {
+      p.ext[i] = GetGlobalScope();
+    } else if (ext[i] == AstCacheExtPkgScope) {
+      p.ext[i] = pkgscope;
+    } else if (ext[i] < npredefined) {
+      p.ext[i] = predefined[ext[i]];
+    } else {
+      memfree(NULL, p.ext);
+      return NULL;
+    }
+  }
+
+  if (p.nodes[h->root].kind != NFile || !cacheCheckPack(&p, ext)) {
+    memfree(NULL, p.ext);
+    return NULL;
+  }
+
+  auto symoffs = (const u32*)(data + offs[SecSymOffs]);
+  auto symhashes = (const u32*)(data + offs[SecSymHash]);
+  auto symdata = data + offs[SecSymData];
+  p.syms = (Sym*)memalloc(NULL, sizeof(Sym) * max(h->nsyms, 1u));
+  Node* file = NULL;
+  for (u32 i = 0; i < h->nsyms; i++) {
+    // a sym interned with the wrong hash would stay in the symbol table as a second sym of
+    // the same name, so the hash is checked rather than trusted
+    if (symoffs[i] > symoffs[i + 1] || symoffs[i + 1] > h->nsymdata ||
+        symoffs[i + 1] - symoffs[i] > 0xFFFF ||
+        hashWY(symdata + symoffs[i], symoffs[i + 1] - symoffs[i]) != symhashes[i])
+    {
+      goto end;
+    }
+    p.syms[i] = symget(symdata + symoffs[i], symoffs[i + 1] - symoffs[i], symhashes[i]);
+  }
+
+  file = AstUnpack(&p, h->root, mem);
+  if (info_out) {
+    info_out->stage = (AstCacheStage)h->stage;
+    info_out->unresolved = h->unresolved;
+  }
+
+end:
+  memfree(NULL, p.syms);
+  memfree(NULL, p.ext);
+  return file;
+}
+
+
+// -----------------------------------------------------------------------------------------------
+// files
+
+bool AstCacheSave(const char* filename, CCtx* cc, const Node* file, const Scope* pkgscope,
+  AstCacheInfo info)
+{
+  Buf buf;
+  BufInit(&buf, NULL, 0);
+  bool ok = AstCacheEncode(&buf, &cc->src, file, pkgscope, info);
+  if (ok) {
+    // write to a temporary file which is then renamed, so that a compiler reading the cache
+    // file at the same time never sees a partially written file
+    auto tmpname = sdscatprintf(sdsempty(), "%s.%d.tmp", filename, (int)getpid());
+    ok = os_writefile(tmpname, buf.ptr, buf.len) && rename(tmpname, filename) == 0;
+    if (!ok) {
+      unlink(tmpname);
+    }
+    sdsfree(tmpname);
+  }
+  BufFree(&buf);
+  return ok;
+}
+
+
+Node* AstCacheLoad(const char* filename, CCtx* cc, Scope* pkgscope, AstCacheInfo* info_out) {
+  size_t len = 0;
+  auto data = os_mmapfile(filename, &len);
+  if (data == NULL) {
+    return NULL;
+  }
+  auto file = AstCacheDecode(data, len, &cc->src, pkgscope, cc->mem, info_out);
+  os_unmapfile(data, len);
+  return file;
+}
+
+
+// -----------------------------------------------------------------------------------------------
+// unit test
+
+#if W_UNIT_TEST_ENABLED
+#include "parse.h"
+
+// test_cache_corrupt checks that the cache file buf of a tree with a function, an identifier
+// and a scope is rejected when its tables are changed to refer to something which is not
+// there, and that no change to a single word of the tables or syms makes AstCacheDecode crash
+static void test_cache_corrupt(CCtx* cc, Scope* pkgscope, const Buf* buf) {
+  auto h = (const AstCacheHeader*)buf->ptr;
+  u64 offs[Sec_MAX];
+  cacheLayout(h, offs);
+  auto mem = MemoryNew(0);
+  auto data = (u8*)memalloc(NULL, buf->len);
+  auto nodes = (PackedNode*)(data + offs[SecNodes]);
+  auto children = (NRef*)(data + offs[SecChildren]);
+  auto scopes = (PackedScope*)(data + offs[SecScopes]);
+  auto bindings = (PackedBinding*)(data + offs[SecBindings]);
+  auto symoffs = (u32*)(data + offs[SecSymOffs]);
+  auto symhashes = (u32*)(data + offs[SecSymHash]);
+  auto symdata = data + offs[SecSymData];
+  auto ext = (const u32*)(buf->ptr + offs[SecExt]);
+
+  NRef fun = 0, ident = 0, extscope = 0;
+  for (u32 i = 1; i < h->nnodes; i++) {
+    auto kind = ((const PackedNode*)(buf->ptr + offs[SecNodes]))[i].kind;
+    fun = (kind == NFun && fun == 0) ? i : fun;
+    ident = (kind == NIdent && ident == 0) ? i : ident;
+  }
+  for (u32 i = 0; i < h->next; i++) {
+    extscope = ext[i] == AstCacheExtPkgScope ? (i | NRefExternal) : extscope;
+  }
+  assert(fun != 0 && ident != 0 && extscope != 0 && h->nscopes > 0 && h->nsyms > 0);
+
+  #define CORRUPT(stmt) ({ \
+    memcpy(data, buf->ptr, buf->len); \
+    stmt; \
+    assertf(AstCacheDecode(data, buf->len, &cc->src, pkgscope, mem, NULL) == NULL, "%s", #stmt); \
+  })
+  CORRUPT(nodes[h->root].kind = NBlock);
+  CORRUPT(nodes[fun].kind = _NodeKindMax);
+  CORRUPT(nodes[fun].offs = cc->src.len + 1);
+  CORRUPT(nodes[fun].type = h->nnodes);
+  CORRUPT(nodes[fun].type = h->next | NRefExternal);
+  CORRUPT(nodes[fun].type = extscope);
+  CORRUPT(nodes[fun].b = h->nextra - 2);
+  CORRUPT({ nodes[ident].kind = NComment; nodes[ident].a = 1; nodes[ident].b = cc->src.len; });
+  CORRUPT(nodes[ident].a = h->nsyms + 1);
+  CORRUPT(nodes[h->root].a = h->nchildren);
+  CORRUPT(children[nodes[h->root].a] = h->nchildren);
+  CORRUPT(nodes[h->root].b = h->nscopes + 1);
+  CORRUPT(nodes[h->root].b = h->next | NRefExternal);
+  CORRUPT(scopes[0].parent = 1);
+  CORRUPT(scopes[0].start = h->nbindings);
+  CORRUPT(scopes[0].len = h->nbindings + 1);
+  CORRUPT(bindings[0].name = 0);
+  CORRUPT(bindings[0].value = h->nnodes);
+  CORRUPT(symhashes[0] ^= 1);
+  CORRUPT(symdata[0] ^= 1);
+  CORRUPT(symoffs[1] = h->nsymdata + 1);
+  #undef CORRUPT
+
+  // a name too long for a sym, with the right hash
+  const u32 longlen = 0x10000;
+  size_t len2 = align2(offs[SecSymData] + h->nsymdata + longlen, 8llu);
+  auto data2 = (u8*)memalloc(NULL, len2);
+  memcpy(data2, buf->ptr, buf->len);
+  memset(data2 + offs[SecSymData] + h->nsymdata, 'x', len2 - offs[SecSymData] - h->nsymdata);
+  auto h2 = (AstCacheHeader*)data2;
+  h2->nsymdata += longlen;
+  h2->size = len2;
+  auto symoffs2 = (u32*)(data2 + offs[SecSymOffs]);
+  symoffs2[h->nsyms] += longlen;
+  ((u32*)(data2 + offs[SecSymHash]))[h->nsyms - 1] = hashWY(
+    data2 + offs[SecSymData] + symoffs2[h->nsyms - 1],
+    symoffs2[h->nsyms] - symoffs2[h->nsyms - 1]);
+  assert(AstCacheDecode(data2, len2, &cc->src, pkgscope, mem, NULL) == NULL);
+  memfree(NULL, data2);
+
+  // a corrupted file is a cache miss
+  auto filename = sdscatprintf(sdsempty(), "%s/wast-test-%d.wast",
+    getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp", (int)getpid());
+  memcpy(data, buf->ptr, buf->len);
+  nodes[fun].b = h->nextra;
+  assert(os_writefile(filename, data, buf->len));
+  assert(AstCacheLoad(filename, cc, pkgscope, NULL) == NULL);
+  assert(os_writefile(filename, buf->ptr, buf->len));
+  assert(AstCacheLoad(filename, cc, pkgscope, NULL) != NULL);
+  unlink(filename);
+  sdsfree(filename);
+
+  // any value of any word of the tables and syms, of which the checks above are examples, is
+  // either rejected or unpacked without reading outside of the file
+  u32 rnd = 1;
+  for (u64 offs1 = offs[SecNodes]; offs1 < buf->len; offs1 += 4) {
+    u32 word = *(const u32*)(buf->ptr + offs1);
+    rnd ^= rnd << 13; rnd ^= rnd >> 17; rnd ^= rnd << 5; // xorshift32
+    const u32 values[] = { word + 1, word - 1, word ^ NRefExternal, 0xffffffff, rnd % 256 };
+    for (u32 i = 0; i < countof(values); i++) {
+      memcpy(data, buf->ptr, buf->len);
+      *(u32*)(data + offs1) = values[i];
+      AstCacheDecode(data, buf->len, &cc->src, pkgscope, mem, NULL);
+    }
+  }
+
+  memfree(NULL, data);
+  MemoryFree(mem);
+}
+
+static void test_cache() {
+  const char* text =
+    "fun add(a, b int) int {\n"
+    "  # comment\n"
+    "  a + b\n"
+    "}\n"
+    "fun main() {\n"
+    "  x = add(1, 2)\n"
+    "  y = if x > 2 { x } else { 2 }\n"
+    "  z = (x, true)\n"
+    "}\n";
+  auto pkgscope = ScopeNew(GetGlobalScope(), NULL);
+  CCtx cc = {0};
+  auto name = sdsnew("cache");
+  assert(CCtxInit(&cc, NULL, NULL, name, (const u8*)text, strlen(text)));
+  P p = {0};
+  auto file = Parse(&p, &cc, ParseComments, pkgscope);
+  Buf buf;
+  BufInit(&buf, NULL, 0);
+
+  // a parsed tree
+  AstCacheInfo info = { AstCacheParsed, p.unresolved };
+  assert(AstCacheEncode(&buf, &cc.src, file, pkgscope, info));
+  AstCacheInfo info2 = {0};
+  auto file2 = AstCacheDecode(buf.ptr, buf.len, &cc.src, pkgscope, cc.mem, &info2);
+  assert(file2 != NULL);
+  asserteq(info2.stage, AstCacheParsed);
+  asserteq(info2.unresolved, p.unresolved);
+  auto repr1 = NodeTestRepr(file, sdsempty());
+  auto repr2 = NodeTestRepr(file2, sdsempty());
+  assertf(strcmp(repr1, repr2) == 0, "\n%s\n!=\n%s", repr1, repr2);
+  sdsfree(repr1);
+  sdsfree(repr2);
+  test_cache_corrupt(&cc, pkgscope, &buf);
+
+  // the loaded tree can be resolved, and a resolved tree can be cached
+  file2 = ResolveSym(&cc, p.s.flags, file2, pkgscope);
+  ResolveType(&cc, file2);
+  buf.len = 0;
+  info.stage = AstCacheResolved;
+  assert(AstCacheEncode(&buf, &cc.src, file2, pkgscope, info));
+  auto file3 = AstCacheDecode(buf.ptr, buf.len, &cc.src, pkgscope, cc.mem, &info2);
+  assert(file3 != NULL);
+  asserteq(info2.stage, AstCacheResolved);
+  auto fun = NodeListAt(&file3->array.a, 0);
+  asserteq(fun->kind, NFun);
+  asserteq(ScopeLookupLocal(file3->array.scope, fun->fun.name), fun);
+  asserteq(file3->array.scope->parent, pkgscope);
+  assert(NodeListAt(&fun->fun.params->array.a, 0)->type == Type_int); // predefined node
+
+  // the cache is not used for a different source or for a truncated file
+  assert(AstCacheDecode(buf.ptr, buf.len - 8, &cc.src, pkgscope, cc.mem, NULL) == NULL);
+  Source src2;
+  SourceInit(&src2, name, (const u8*)text, strlen(text) - 1);
+  assert(AstCacheDecode(buf.ptr, buf.len, &src2, pkgscope, cc.mem, NULL) == NULL);
+  SourceFree(&src2);
+
+  BufFree(&buf);
+  CCtxFree(&cc);
+  sdsfree(name);
+}
+
+W_UNIT_TEST(AstCache, { test_cache(); })
+#endif
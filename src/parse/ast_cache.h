@@ -0,0 +1,92 @@
+#pragma once
+#include "ast_pack.h"
+#include "../build/build.h"
+#include "../common/buf.h"
+
+// AstCache stores the AST of a source file in a file, so that a source which has not changed
+// since it was last compiled does not need to be scanned or parsed again.
+//
+// A cache file holds the AstPack of the tree, preceded by an AstCacheHeader. Like AstPack it
+// contains no pointers, only indices and offsets, so it can be mapped into memory and read
+// in place. Its sections are, each starting at an 8-byte aligned offset:
+//
+//   nodes     PackedNode[nnodes]       the node table, including nodes of types
+//   children  NRef[nchildren]          lists of nodes (see AstPack)
+//   extra     u32[nextra]
+//   scopes    PackedScope[nscopes]
+//   bindings  PackedBinding[nbindings]
+//   ext       u32[next]                the predefined nodes and scopes referenced (see below)
+//   symoffs   u32[nsyms + 1]           the sym string table: sym i is
+//   symhash   u32[nsyms]                 symdata[symoffs[i]:symoffs[i+1]] with hash symhash[i]
+//   symdata   u8[symoffs[nsyms]]
+//
+// External references of the pack (AstPack.ext) are stored as the index of a predefined node
+// (Type_int, Const_true, NodeBad, ...) or as one of AstCacheExtGlobalScope and
+// AstCacheExtPkgScope. A tree which refers to any other node outside of it, e.g. a node of
+// another source, can not be cached.
+//
+// A cache file is only used for a source with the same contents (compared by length and
+// hash) compiled by the same version of the compiler (see AstCacheCompilerId.) Positions are
+// offsets in the source.
+
+// AST_CACHE_VERSION is the version of the cache file format. Increment it when the format,
+// AstPack or the trees produced by Parse, ResolveSym or ResolveType change.
+#define AST_CACHE_VERSION 2
+
+// AstCacheStage is the compilation stage of a cached tree
+typedef enum AstCacheStage {
+  AstCacheParsed   = 1, // tree returned by Parse
+  AstCacheResolved = 2, // tree after ResolveSym and ResolveType
+} AstCacheStage;
+
+// AstCacheHeader is the start of a cache file
+typedef struct AstCacheHeader {
+  u8   magic[4];   // "WAST"
+  u32  version;    // AST_CACHE_VERSION
+  u64  compiler;   // AstCacheCompilerId
+  u64  srchash;    // hashWY64 of the source
+  u64  srclen;     // length of the source
+  u64  size;       // size of the file
+  u32  stage;      // AstCacheStage
+  u32  unresolved; // P.unresolved after parsing (with AstCacheParsed)
+  NRef root;       // the file node
+  u32  nnodes, nchildren, nextra, nscopes, nbindings, next, nsyms, nsymdata;
+} AstCacheHeader;
+
+#define AstCacheExtGlobalScope 0xfffffffeu // ext entry for GetGlobalScope()
+#define AstCacheExtPkgScope    0xffffffffu // ext entry for the package scope
+
+// AstCacheInfo describes a tree loaded from a cache file
+typedef struct AstCacheInfo {
+  AstCacheStage stage;
+  u32           unresolved; // P.unresolved after parsing (with AstCacheParsed)
+} AstCacheInfo;
+
+// AstCacheCompilerId identifies the version of the compiler: AST_CACHE_VERSION, the layout
+// of the types stored in cache files and the hash function of the syms stored in them.
+u64 AstCacheCompilerId();
+
+// AstCachePath appends the path of the cache file for src in directory dir to s.
+// The name of the file is a hash of the contents of src and AstCacheCompilerId.
+Str AstCachePath(Str s, const char* dir, const Source* src);
+
+// AstCacheEncode appends a cache file for the tree at file, of source src, to buf.
+// pkgscope is the scope passed to Parse. Returns false if the tree can not be cached.
+bool AstCacheEncode(
+  Buf* buf, const Source* src, const Node* file, const Scope* pkgscope, AstCacheInfo);
+
+// AstCacheDecode returns the tree of the cache file data, allocated in mem, or NULL if data
+// is not a valid cache file for src (e.g. truncated, or with references out of bounds.)
+// pkgscope is the scope to use as the package scope.
+// The tree does not refer to data, which can be released as soon as AstCacheDecode returns.
+Node* AstCacheDecode(
+  const u8* data, size_t len, Source* src, Scope* pkgscope, Memory mem, AstCacheInfo* info_out);
+
+// AstCacheSave writes the tree at file of cc->src to the cache file at filename.
+// Returns false if the tree can not be cached or the file can not be written.
+bool AstCacheSave(const char* filename, CCtx* cc, const Node* file, const Scope* pkgscope,
+  AstCacheInfo);
+
+// AstCacheLoad returns the tree of cc->src from the cache file at filename, allocated in
+// cc->mem, or NULL if there is no valid cache file for cc->src.
+Node* AstCacheLoad(const char* filename, CCtx* cc, Scope* pkgscope, AstCacheInfo* info_out);
@@ -0,0 +1,588 @@
+#include "ast_pack.h"
+#include "../common/test.h"
+
+// packReserve makes room for n more elements of size elemsize in the array *ptr of length len
+static void packReserve(AstPack* p, void** ptr, u32* cap, u32 len, u32 n, size_t elemsize) {
+  if (*cap - len >= n) {
+    return;
+  }
+  u32 newcap = max(*cap * 2, 64u);
+  while (newcap - len < n) {
+    newcap *= 2;
+  }
+  *ptr = memrealloc(p->mem, *ptr, (size_t)newcap * elemsize);
+  *cap = newcap;
+}
+
+// PACK_PUSH(p, field, count) reserves count elements at the end of p->field and returns the index of
+// the first one. The length of field is in p->n##field and its capacity in p->cap##field.
+#define PACK_PUSH(p, field, count) ({                                                 \
+  packReserve((p), (void**)&(p)->field, &(p)->cap##field, (p)->n##field, (count),     \
+              sizeof(*(p)->field));                                                   \
+  u32 __i = (p)->n##field;                                                            \
+  (p)->n##field += (count);                                                           \
+  __i;                                                                                \
+})
+
+
+void AstPackInit(AstPack* p, Source* src, Memory mem) {
+  memset(p, 0, sizeof(AstPack));
+  p->mem = mem;
+  p->src = src;
+  PtrMapInit(&p->_nodemap, 256, NULL);
+  PtrMapInit(&p->_scopemap, 32, NULL);
+  SymMapInit(&p->_symmap, 64, NULL);
+  // nodes[0] stands for NULL
+  PACK_PUSH(p, nodes, 1);
+  memset(&p->nodes[0], 0, sizeof(PackedNode));
+}
+
+
+void AstPackFree(AstPack* p) {
+  void* arrays[] = { p->nodes, p->children, p->extra, p->syms, p->scopes, p->bindings, p->ext };
+  for (u32 i = 0; i < countof(arrays); i++) {
+    if (arrays[i] != NULL) {
+      memfree(p->mem, arrays[i]);
+    }
+  }
+  PtrMapDealloc(&p->_nodemap);
+  PtrMapDealloc(&p->_scopemap);
+  SymMapDealloc(&p->_symmap);
+  memset(p, 0, sizeof(AstPack));
+}
+
+
+size_t AstPackSize(const AstPack* p) {
+  return (size_t)p->nnodes * sizeof(PackedNode)
+       + (size_t)p->nchildren * sizeof(NRef)
+       + (size_t)p->nextra * sizeof(u32)
+       + (size_t)p->nsyms * sizeof(Sym)
+       + (size_t)p->nscopes * sizeof(PackedScope)
+       + (size_t)p->nbindings * sizeof(PackedBinding)
+       + (size_t)p->next * sizeof(void*);
+}
+
+
+// -----------------------------------------------------------------------------------------------
+// Node -> AstPack
+
+static NRef packNode(AstPack* p, const Node* n);
+
+
+// packIsExternal returns true for nodes which are referenced by the pack rather than copied:
+// nodes of other sources and predefined nodes (Type_int, Const_true, NodeBad, ...) which
+// are shared by all files and must keep their identity.
+static bool packIsExternal(const AstPack* p, const Node* n) {
+  if (n->pos != NoPos) {
+    return !PosInSource(n->pos, p->src);
+  }
+  return n->kind == NBasicType || n->kind == NBad || NodeKindIsConst(n->kind);
+}
+
+
+static NRef packExternal(AstPack* p, PtrMap* m, const void* ptr) {
+  u32 i = PACK_PUSH(p, ext, 1);
+  assert(i < NRefExternal);
+  p->ext[i] = ptr;
+  NRef ref = i | NRefExternal;
+  PtrMapSet(m, ptr, (void*)(uintptr_t)ref);
+  return ref;
+}
+
+
+static u32 packSym(AstPack* p, Sym s) {
+  if (s == NULL) {
+    return 0;
+  }
+  u32 ref = (u32)(uintptr_t)SymMapGet(&p->_symmap, s);
+  if (ref == 0) {
+    ref = PACK_PUSH(p, syms, 1) + 1;
+    p->syms[ref - 1] = s;
+    SymMapSet(&p->_symmap, s, (void*)(uintptr_t)ref);
+  }
+  return ref;
+}
+
+
+// packList adds the nodes of list to children and returns the index of the list
+static u32 packList(AstPack* p, const NodeList* list) {
+  u32 start = PACK_PUSH(p, children, list->len + 1);
+  p->children[start] = list->len;
+  u32 i = start + 1;
+  NodeListForEach(list, n, {
+    NRef ref = packNode(p, n); // may move p->children
+    p->children[i++] = ref;
+  });
+  return start;
+}
+
+
+// packScope adds the scope s without its bindings, which are added by packScopeBindings
+// after the nodes of the scope. Scopes which are not in the pack yet are external if they are
+// the parent of another scope (e.g. the package scope), since a node's scope is added before
+// the scopes nested in it.
+static u32 packScope(AstPack* p, const Scope* s, bool isparent) {
+  if (s == NULL) {
+    return 0;
+  }
+  u32 ref = (u32)(uintptr_t)PtrMapGet(&p->_scopemap, s);
+  if (ref != 0) {
+    return ref;
+  }
+  if (isparent) {
+    return packExternal(p, &p->_scopemap, s);
+  }
+  u32 parent = packScope(p, s->parent, true);
+  u32 i = PACK_PUSH(p, scopes, 1);
+  p->scopes[i].parent = parent;
+  p->scopes[i].start = 0;
+  p->scopes[i].len = 0;
+  ref = i + 1;
+  PtrMapSet(&p->_scopemap, s, (void*)(uintptr_t)ref);
+  return ref;
+}
+
+
+static void packBindingValue(Sym name, void* value, bool* stop, void* userdata) {
+  packNode((AstPack*)userdata, (const Node*)value);
+}
+
+
+static void packBinding(Sym name, void* value, bool* stop, void* userdata) {
+  auto p = (AstPack*)userdata;
+  u32 i = PACK_PUSH(p, bindings, 1);
+  p->bindings[i].name = packSym(p, name);
+  p->bindings[i].value = packNode(p, (const Node*)value); // already in the pack
+}
+
+
+static void packScopeIter(const Scope* s, SymMapIterator* f, AstPack* p) {
+  if (s->bindings.buckets == NULL) {
+    for (u32 i = 0; i < s->nbindings; i++) {
+      f(s->keys[i], (void*)s->values[i], NULL, p);
+    }
+  } else {
+    SymMapIter(&s->bindings, f, p);
+  }
+}
+
+
+static void packScopeBindings(AstPack* p, u32 ref, const Scope* s) {
+  if (ref == 0 || (ref & NRefExternal) || p->scopes[ref - 1].len != 0 || s->nbindings == 0) {
+    return;
+  }
+  // Bindings are stored as a group. Values are usually in the pack already; if not, they are
+  // added first so that bindings of their own scopes don't end up in the middle of the group.
+  packScopeIter(s, packBindingValue, p);
+  u32 start = p->nbindings;
+  packScopeIter(s, packBinding, p);
+  p->scopes[ref - 1].start = start;
+  p->scopes[ref - 1].len = p->nbindings - start;
+}
+
+
+static u32 packExtra(AstPack* p, u32 n) {
+  return PACK_PUSH(p, extra, n);
+}
+
+
+static NRef packNode(AstPack* p, const Node* n) {
+  if (n == NULL) {
+    return 0;
+  }
+  NRef ref = (NRef)(uintptr_t)PtrMapGet(&p->_nodemap, n);
+  if (ref != 0) {
+    return ref;
+  }
+  if (packIsExternal(p, n)) {
+    return packExternal(p, &p->_nodemap, n);
+  }
+
+  // Add the node before its children so that nodes are in depth-first order and so that
+  // references back to the node (e.g. from a recursive function's body) find it.
+  ref = PACK_PUSH(p, nodes, 1);
+  assert(ref < NRefExternal);
+  PtrMapSet(&p->_nodemap, n, (void*)(uintptr_t)ref);
+
+  // pn is filled in locally since packing children may move p->nodes
+  PackedNode pn = { .kind = (u8)n->kind };
+  pn.offs = n->pos == NoPos ? AstPackNoPos : PosOffs(n->pos, p->src);
+
+  switch (n->kind) {
+    case NNone:
+    case NBad:
+    case NNil:
+      break;
+
+    case NBoolLit:
+    case NIntLit:
+    case NFloatLit:
+      pn.sub = (u8)n->val.ct;
+      pn.a = (u32)n->val.i;
+      pn.b = (u32)(n->val.i >> 32);
+      break;
+
+    case NComment:
+      assert(n->str.ptr >= p->src->buf && n->str.ptr + n->str.len <= p->src->buf + p->src->len);
+      pn.a = (u32)(n->str.ptr - p->src->buf);
+      pn.b = (u32)n->str.len;
+      break;
+
+    case NIdent:
+      pn.a = packSym(p, n->ref.name);
+      pn.b = packNode(p, n->ref.target);
+      break;
+
+    case NAssign:
+    case NBinOp:
+    case NPrefixOp:
+    case NPostfixOp:
+    case NReturn:
+      assert(n->op.op <= 0xffff);
+      pn.aux = (u16)n->op.op;
+      pn.a = packNode(p, n->op.left);
+      pn.b = packNode(p, n->op.right);
+      break;
+
+    case NArg:
+    case NField:
+    case NLet:
+      assert(n->field.index <= 0xffff);
+      pn.aux = (u16)n->field.index;
+      pn.a = packSym(p, n->field.name);
+      pn.b = packNode(p, n->field.init);
+      break;
+
+    case NBlock:
+    case NFile:
+    case NTuple:
+      pn.b = packScope(p, n->array.scope, false);
+      pn.a = packList(p, &n->array.a);
+      packScopeBindings(p, pn.b, n->array.scope);
+      break;
+
+    case NCall:
+    case NTypeCast:
+      pn.a = packNode(p, n->call.receiver);
+      pn.b = packNode(p, n->call.args);
+      break;
+
+    case NFun: {
+      u32 scope = packScope(p, n->fun.scope, false);
+      pn.a = packNode(p, n->fun.params);
+      NRef body = packNode(p, n->fun.body);
+      packScopeBindings(p, scope, n->fun.scope);
+      pn.b = packExtra(p, 3);
+      p->extra[pn.b] = packSym(p, n->fun.name);
+      p->extra[pn.b + 1] = body;
+      p->extra[pn.b + 2] = scope;
+      break;
+    }
+
+    case NIf: {
+      pn.a = packNode(p, n->cond.cond);
+      NRef thenb = packNode(p, n->cond.thenb);
+      NRef elseb = packNode(p, n->cond.elseb);
+      pn.b = packExtra(p, 2);
+      p->extra[pn.b] = thenb;
+      p->extra[pn.b + 1] = elseb;
+      break;
+    }
+
+    case NBasicType:
+      pn.sub = (u8)n->t.basic.typeCode;
+      pn.a = packSym(p, n->t.basic.name);
+      pn.b = packSym(p, n->t.id);
+      break;
+
+    case NTupleType:
+      pn.a = packList(p, &n->t.tuple);
+      pn.b = packSym(p, n->t.id);
+      break;
+
+    case NFunType: {
+      pn.a = packNode(p, n->t.fun.params);
+      NRef result = packNode(p, n->t.fun.result);
+      pn.b = packExtra(p, 2);
+      p->extra[pn.b] = result;
+      p->extra[pn.b + 1] = packSym(p, n->t.id);
+      break;
+    }
+
+    case NZeroInit:
+    case _NodeKindMax:
+      break;
+  }
+
+  pn.type = packNode(p, n->type);
+  p->nodes[ref] = pn;
+  return ref;
+}
+
+
+NRef AstPackAdd(AstPack* p, const Node* n) {
+  static_assert(TypeCode_MAX <= 0xff, "TypeCode does not fit in PackedNode.sub");
+  static_assert(_NodeKindMax <= 0xff, "NodeKind does not fit in PackedNode.kind");
+  return packNode(p, n);
+}
+
+
+// -----------------------------------------------------------------------------------------------
+// AstPack -> Node
+
+typedef struct Unpacker {
+  const AstPack* p;
+  Memory         mem;
+  Node**         nodes;  // unpacked nodes, by NRef
+  Scope**        scopes; // unpacked scopes, by scope index
+  Node**         stack;  // nodes of the lists being unpacked (see unpackList)
+  u32            nstack, capstack;
+} Unpacker;
+
+static Node* unpackNode(Unpacker* u, NRef ref);
+
+
+static Scope* unpackScope(Unpacker* u, u32 ref) {
+  if (ref == 0) {
+    return NULL;
+  }
+  if (ref & NRefExternal) {
+    return (Scope*)AstPackExternal(u->p, ref);
+  }
+  if (u->scopes[ref - 1] != NULL) {
+    return u->scopes[ref - 1];
+  }
+  auto ps = &u->p->scopes[ref - 1];
+  auto s = ScopeNew(unpackScope(u, ps->parent), u->mem);
+  u->scopes[ref - 1] = s;
+  for (u32 i = ps->start; i < ps->start + ps->len; i++) {
+    auto b = &u->p->bindings[i];
+    ScopeAssoc(s, AstPackSym(u->p, b->name), unpackNode(u, b->value));
+  }
+  return s;
+}
+
+
+// unpackList collects the nodes of a list on u->stack, where the nodes of lists nested in
+// them are collected on top, and then copies them to an exact-size NodeList
+static void unpackList(Unpacker* u, u32 list, NodeList* dst) {
+  u32 len;
+  auto refs = AstPackList(u->p, list, &len);
+  u32 start = u->nstack;
+  if (u->capstack - start < len) {
+    u->capstack = max(u->capstack * 2, start + len);
+    u->stack = (Node**)memrealloc(NULL, u->stack, sizeof(Node*) * u->capstack);
+  }
+  u->nstack += len;
+  for (u32 i = 0; i < len; i++) {
+    auto n = unpackNode(u, refs[i]); // may move u->stack
+    u->stack[start + i] = n;
+  }
+  NodeListAssign(u->mem, dst, &u->stack[start], len);
+  u->nstack = start;
+}
+
+
+static Node* unpackNode(Unpacker* u, NRef ref) {
+  if (ref == 0) {
+    return NULL;
+  }
+  if (ref & NRefExternal) {
+    return (Node*)AstPackExternal(u->p, ref);
+  }
+  if (u->nodes[ref] != NULL) {
+    return u->nodes[ref];
+  }
+  const AstPack* p = u->p;
+  auto pn = AstPackNode(p, ref);
+  auto n = NewNode(u->mem, (NodeKind)pn->kind);
+  u->nodes[ref] = n;
+  if (pn->offs != AstPackNoPos) {
+    n->pos = PosMake(p->src, pn->offs);
+  }
+
+  switch (n->kind) {
+    case NNone:
+    case NBad:
+    case NNil:
+      break;
+
+    case NBoolLit:
+    case NIntLit:
+    case NFloatLit:
+      n->val.ct = (CType)pn->sub;
+      n->val.i = (u64)pn->a | ((u64)pn->b << 32);
+      break;
+
+    case NComment:
+      n->str.ptr = p->src->buf + pn->a;
+      n->str.len = pn->b;
+      break;
+
+    case NIdent:
+      n->ref.name = AstPackSym(p, pn->a);
+      n->ref.target = unpackNode(u, pn->b);
+      break;
+
+    case NAssign:
+    case NBinOp:
+    case NPrefixOp:
+    case NPostfixOp:
+    case NReturn:
+      n->op.op = (Tok)pn->aux;
+      n->op.left = unpackNode(u, pn->a);
+      n->op.right = unpackNode(u, pn->b);
+      break;
+
+    case NArg:
+    case NField:
+    case NLet:
+      n->field.index = pn->aux;
+      n->field.name = AstPackSym(p, pn->a);
+      n->field.init = unpackNode(u, pn->b);
+      break;
+
+    case NBlock:
+    case NFile:
+    case NTuple:
+      n->array.scope = unpackScope(u, pn->b);
+      unpackList(u, pn->a, &n->array.a);
+      break;
+
+    case NCall:
+    case NTypeCast:
+      n->call.receiver = unpackNode(u, pn->a);
+      n->call.args = unpackNode(u, pn->b);
+      break;
+
+    case NFun:
+      n->fun.name = AstPackSym(p, p->extra[pn->b]);
+      n->fun.scope = unpackScope(u, p->extra[pn->b + 2]);
+      n->fun.params = unpackNode(u, pn->a);
+      n->fun.body = unpackNode(u, p->extra[pn->b + 1]);
+      break;
+
+    case NIf:
+      n->cond.cond = unpackNode(u, pn->a);
+      n->cond.thenb = unpackNode(u, p->extra[pn->b]);
+      n->cond.elseb = unpackNode(u, p->extra[pn->b + 1]);
+      break;
+
+    case NBasicType:
+      n->t.basic.typeCode = (TypeCode)pn->sub;
+      n->t.basic.name = AstPackSym(p, pn->a);
+      n->t.id = AstPackSym(p, pn->b);
+      break;
+
+    case NTupleType:
+      unpackList(u, pn->a, &n->t.tuple);
+      n->t.id = AstPackSym(p, pn->b);
+      break;
+
+    case NFunType:
+      n->t.fun.params = unpackNode(u, pn->a);
+      n->t.fun.result = unpackNode(u, p->extra[pn->b]);
+      n->t.id = AstPackSym(p, p->extra[pn->b + 1]);
+      break;
+
+    case NZeroInit:
+    case _NodeKindMax:
+      break;
+  }
+
+  n->type = unpackNode(u, pn->type);
+  return n;
+}
+
+
+Node* AstUnpack(const AstPack* p, NRef ref, Memory mem) {
+  Unpacker u = { .p = p, .mem = mem };
+  u.nodes = (Node**)memalloc(NULL, sizeof(Node*) * p->nnodes);
+  u.scopes = (Scope**)memalloc(NULL, sizeof(Scope*) * max(p->nscopes, 1u));
+  auto n = unpackNode(&u, ref);
+  memfree(NULL, u.nodes);
+  memfree(NULL, u.scopes);
+  if (u.stack != NULL) {
+    memfree(NULL, u.stack);
+  }
+  return n;
+}
+
+
+// -----------------------------------------------------------------------------------------------
+// unit test
+
+#if W_UNIT_TEST_ENABLED
+#include "parse.h"
+
+// packTestRoundtrip packs file, unpacks it and checks that the result is the same as file.
+// Returns the unpacked file.
+static Node* packTestRoundtrip(CCtx* cc, Node* file, Scope* pkgscope) {
+  AstPack pack;
+  AstPackInit(&pack, &cc->src, NULL);
+  NRef ref = AstPackAdd(&pack, file);
+  asserteq(ref, 1); // depth-first order
+  asserteq(AstPackAdd(&pack, file), ref); // already in the pack
+  asserteq(AstPackNode(&pack, ref)->kind, NFile);
+
+  auto file2 = AstUnpack(&pack, ref, cc->mem);
+  assert(file2 != file);
+  assert(file2->array.scope != file->array.scope);
+  asserteq(file2->array.scope->parent, pkgscope);
+  asserteq(file2->array.scope->nbindings, file->array.scope->nbindings);
+  asserteq(file2->array.a.len, file->array.a.len);
+
+  auto repr1 = NodeTestRepr(file, sdsempty());
+  auto repr2 = NodeTestRepr(file2, sdsempty());
+  assertf(strcmp(repr1, repr2) == 0, "\n%s\n!=\n%s", repr1, repr2);
+  sdsfree(repr1);
+  sdsfree(repr2);
+
+  // scope bindings refer to nodes of the unpacked tree
+  auto fun = NodeListAt(&file2->array.a, 0);
+  asserteq(fun->kind, NFun);
+  asserteq(ScopeLookupLocal(file2->array.scope, fun->fun.name), fun);
+
+  AstPackFree(&pack);
+  return file2;
+}
+
+static void test_pack() {
+  const char* text =
+    "fun add(a, b int) int {\n"
+    "  # comment\n"
+    "  a + b\n"
+    "}\n"
+    "fun main() {\n"
+    "  x = add(1, 2)\n"
+    "  y = if x > 2 { x } else { 2 }\n"
+    "  z = (x, true)\n"
+    "}\n";
+  auto pkgscope = ScopeNew(GetGlobalScope(), NULL);
+  CCtx cc = {0};
+  auto name = sdsnew("pack");
+  assert(CCtxInit(&cc, NULL, NULL, name, (const u8*)text, strlen(text)));
+  sdsfree(name);
+  P p = {0};
+  auto file = Parse(&p, &cc, ParseComments, pkgscope);
+
+  // a parsed tree can be unpacked and resolved
+  auto file2 = packTestRoundtrip(&cc, file, pkgscope);
+  file2 = ResolveSym(&cc, p.s.flags, file2, pkgscope);
+  ResolveType(&cc, file2);
+
+  // a resolved tree keeps its types and identifier targets
+  file = ResolveSym(&cc, p.s.flags, file, pkgscope);
+  ResolveType(&cc, file);
+  auto file3 = packTestRoundtrip(&cc, file, pkgscope);
+  auto repr1 = NodeTestRepr(file2, sdsempty());
+  auto repr2 = NodeTestRepr(file3, sdsempty());
+  assertf(strcmp(repr1, repr2) == 0, "\n%s\n!=\n%s", repr1, repr2);
+  sdsfree(repr1);
+  sdsfree(repr2);
+
+  CCtxFree(&cc);
+}
+
+W_UNIT_TEST(AstPack, { test_pack(); })
+#endif
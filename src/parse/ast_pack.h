@@ -0,0 +1,141 @@
+#pragma once
+#include "ast.h"
+#include "../common/ptrmap.h"
+
+// AstPack is a compact, index-based representation of the AST of one source file.
+//
+// All nodes of a file are stored in one array and refer to each other by 32-bit index (NRef)
+// instead of by pointer. A packed node is 20 bytes where a Node is 48. Lists of nodes are
+// stored in a shared children array, and fields which do not fit in a packed node are kept
+// in kind-specific side tables (syms, extra, scopes.)
+//
+// AstPackAdd converts a Node tree to packed form and AstUnpack converts it back, so that
+// passes can move to the packed form one at a time while the others keep using Node.
+// Converting a tree and back yields an equivalent tree: nodes which are referenced from more
+// than one place (types, identifier targets and scope bindings) are still shared, and
+// predefined nodes like Type_int and nodes of other files are referenced, not copied.
+
+// NRef is a reference to a node of an AstPack. 0 is "no node" (NULL).
+// References with NRefExternal set are indices in AstPack.ext (nodes outside the pack.)
+typedef u32 NRef;
+#define NRefExternal 0x80000000u
+
+// PackedNode is a node of an AstPack. The meaning of a and b depends on the kind:
+//
+//   kind                              sub/aux   a                  b
+//   BoolLit IntLit FloatLit           CType     low 32 bits        high 32 bits of NVal
+//   Comment                                     offset in source   length
+//   Ident                                       sym name           NRef target
+//   Assign BinOp Prefix/PostfixOp Ret aux: Tok  NRef left          NRef right
+//   Arg Field Let                     aux: index sym name          NRef init
+//   Block File Tuple                            list               scope
+//   Call TypeCast                               NRef receiver      NRef args
+//   Fun                                         NRef params        extra: name body scope
+//   If                                          NRef cond          extra: thenb elseb
+//   BasicType                         TypeCode  sym name           sym id
+//   TupleType                                   list               sym id
+//   FunType                                     NRef params        extra: result id
+//
+// A "sym" is an index+1 in syms (0 for NULL), a "list" an index in children of a count
+// followed by that many NRefs, "extra" an index in extra of the fields listed and a "scope"
+// an index+1 in scopes (0 for NULL, or with NRefExternal set an index in ext.)
+typedef struct PackedNode {
+  u8   kind;  // NodeKind
+  u8   sub;   // kind-specific (see above)
+  u16  aux;   // kind-specific (see above)
+  u32  offs;  // offset of Node.pos in the source, or AstPackNoPos if the node has none
+  NRef type;  // Node.type
+  u32  a, b;  // kind-specific (see above)
+} PackedNode;
+
+#define AstPackNoPos 0xffffffffu
+
+// PackedScope is a Scope of an AstPack. Its bindings are bindings[start:start+len]
+typedef struct PackedScope {
+  u32 parent; // scope reference (see PackedNode)
+  u32 start;
+  u32 len;
+} PackedScope;
+
+typedef struct PackedBinding {
+  u32  name;  // sym
+  NRef value;
+} PackedBinding;
+
+typedef struct AstPack {
+  Memory         mem;       // memory used for the arrays of the pack
+  Source*        src;       // source of all packed nodes
+  PackedNode*    nodes;     // nodes[0] is unused (NRef 0 is NULL)
+  u32            nnodes, capnodes;
+  NRef*          children;  // lists of nodes
+  u32            nchildren, capchildren;
+  u32*           extra;     // kind-specific fields which do not fit in PackedNode
+  u32            nextra, capextra;
+  Sym*           syms;      // names and type ids
+  u32            nsyms, capsyms;
+  PackedScope*   scopes;
+  u32            nscopes, capscopes;
+  PackedBinding* bindings;
+  u32            nbindings, capbindings;
+  const void**   ext;       // nodes and scopes outside the pack
+  u32            next, capext;
+
+  // used by AstPackAdd to find nodes, scopes and syms which are already in the pack
+  PtrMap         _nodemap;
+  PtrMap         _scopemap;
+  SymMap         _symmap;
+} AstPack;
+
+// AstPackInit initializes a pack for nodes of src, using mem for its memory.
+void AstPackInit(AstPack*, Source* src, Memory mem/*nullable*/);
+
+// AstPackFree frees all memory used by a pack.
+void AstPackFree(AstPack*);
+
+// AstPackAdd adds the tree at n to the pack and returns a reference to n.
+// Nodes which are already in the pack are not added again.
+NRef AstPackAdd(AstPack*, const Node* n);
+
+// AstUnpack returns a Node tree allocated in mem for the node ref of p, including the
+// scopes of the tree. Nodes which are shared inside the tree are shared in the result.
+Node* AstUnpack(const AstPack* p, NRef ref, Memory mem/*nullable*/);
+
+// AstPackSize returns the number of bytes used by the data of a pack, excluding unused
+// capacity of its arrays and the maps used while adding nodes.
+size_t AstPackSize(const AstPack*);
+
+// AstPackNode returns the node ref, which must not be NULL or external
+static const PackedNode* AstPackNode(const AstPack*, NRef ref);
+
+// AstPackExternal returns the node (or scope) of an external reference
+static const void* AstPackExternal(const AstPack*, NRef ref);
+
+// AstPackList returns the nodes of the list at index list in children, and their count in len
+static const NRef* AstPackList(const AstPack*, u32 list, u32* len);
+
+// AstPackSym returns a sym of the pack, or NULL if sym is 0
+static Sym AstPackSym(const AstPack*, u32 sym);
+
+// -----------------------------------------------------------------------------------------------
+// inline implementations
+
+inline static const PackedNode* AstPackNode(const AstPack* p, NRef ref) {
+  assert(ref > 0 && ref < p->nnodes);
+  return &p->nodes[ref];
+}
+
+inline static const void* AstPackExternal(const AstPack* p, NRef ref) {
+  assert((ref & NRefExternal) && (ref & ~NRefExternal) < p->next);
+  return p->ext[ref & ~NRefExternal];
+}
+
+inline static const NRef* AstPackList(const AstPack* p, u32 list, u32* len) {
+  assert(list < p->nchildren);
+  *len = p->children[list];
+  return &p->children[list + 1];
+}
+
+inline static Sym AstPackSym(const AstPack* p, u32 sym) {
+  assert(sym <= p->nsyms);
+  return sym == 0 ? NULL : p->syms[sym - 1];
+}
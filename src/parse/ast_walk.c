@@ -0,0 +1,244 @@
+#include "ast_walk.h"
+#include "../common/test.h"
+
+
+void NodeWalkerInit(NodeWalker* w, void* userdata, Memory mem) {
+  w->userdata = userdata;
+  w->mem = mem;
+  w->frames = w->storage;
+  w->len = 0;
+  w->cap = countof(w->storage);
+}
+
+
+void NodeWalkerFree(NodeWalker* w) {
+  if (w->frames != w->storage) {
+    memfree(w->mem, w->frames);
+    w->frames = w->storage;
+    w->cap = countof(w->storage);
+  }
+}
+
+
+void _NodeWalkGrow(NodeWalker* w) {
+  u32 cap = w->cap * 2;
+  if (w->frames == w->storage) {
+    // moving frames from storage to the heap
+    auto frames = (NodeWalkFrame*)memalloc(w->mem, sizeof(NodeWalkFrame) * cap);
+    memcpy(frames, w->frames, sizeof(NodeWalkFrame) * w->len);
+    w->frames = frames;
+  } else {
+    w->frames = (NodeWalkFrame*)memrealloc(w->mem, w->frames, sizeof(NodeWalkFrame) * cap);
+  }
+  w->cap = cap;
+}
+
+
+Node** NodeChildSlot(Node* n, u32 i) {
+  switch (n->kind) {
+    case NAssign:
+    case NBinOp:
+    case NPrefixOp:
+    case NPostfixOp:
+    case NReturn:
+      return i == 0 ? &n->op.left : i == 1 ? &n->op.right : NULL;
+    case NBlock:
+    case NFile:
+    case NTuple:
+      return i < n->array.a.len ? &NodeListItems(&n->array.a)[i] : NULL;
+    case NFun:
+      return i == 0 ? &n->fun.params : i == 1 ? &n->fun.body : NULL;
+    case NCall:
+    case NTypeCast:
+      return i == 0 ? &n->call.receiver : i == 1 ? &n->call.args : NULL;
+    case NArg:
+    case NField:
+    case NLet:
+      return i == 0 ? &n->field.init : NULL;
+    case NIf:
+      return i == 0 ? &n->cond.cond : i == 1 ? &n->cond.thenb : i == 2 ? &n->cond.elseb : NULL;
+    case NNone:
+    case NBad:
+    case NBoolLit:
+    case NIntLit:
+    case NFloatLit:
+    case NNil:
+    case NComment:
+    case NIdent:
+    case NZeroInit:
+    case NBasicType:
+    case NTupleType:
+    case NFunType:
+    case _NodeKindMax:
+      break;
+  }
+  return NULL;
+}
+
+
+bool NodeWalkNextChild(NodeWalker* w, NodeWalkFrame* f) {
+  Node** slot;
+  while ((slot = NodeChildSlot(f->n, f->state)) != NULL) {
+    f->state++;
+    if (*slot != NULL) {
+      NodeWalkPush(w, slot);
+      return true;
+    }
+  }
+  return false;
+}
+
+
+// -----------------------------------------------------------------------------------------------
+// unit test
+
+#if W_UNIT_TEST_ENABLED
+
+typedef struct WalkTest {
+  Str   s;        // kinds of the nodes entered, each followed by its depth (if not NULL)
+  u32   maxdepth; // depth of the deepest node entered
+  u32   count;    // number of nodes entered
+  Node* nested;   // tree walked by walkTestNestedVisit
+} WalkTest;
+
+// walkTestVisit records the nodes it enters in the WalkTest at w->userdata. f->fl is the
+// depth of the node. Integer literals other than 0 are replaced with f->ptr.
+static Node* walkTestVisit(NodeWalker* w, NodeWalkFrame* f, Node* result) {
+  if (f->state == 0) {
+    auto t = (WalkTest*)w->userdata;
+    if (t->s) {
+      t->s = sdscatfmt(t->s, "%s%u ", NodeKindName(f->n->kind), f->fl);
+    }
+    t->maxdepth = max(t->maxdepth, f->fl);
+    t->count++;
+    f->fl++;
+  }
+  if (NodeWalkNextChild(w, f)) {
+    return NodeWalkPending;
+  }
+  if (f->n->kind == NIntLit && f->n->val.i != 0) {
+    return (Node*)f->ptr;
+  }
+  return f->n;
+}
+
+// walkTestNestedVisit is walkTestVisit, except that an Ident is replaced with the result of
+// a walk of the tree at ((WalkTest*)w->userdata)->nested, with the same walker
+static Node* walkTestNestedVisit(NodeWalker* w, NodeWalkFrame* f, Node* result) {
+  if (f->n->kind == NIdent) {
+    auto t = (WalkTest*)w->userdata;
+    return NodeWalk(w, walkTestVisit, t->nested, f->fl, f->ptr);
+  }
+  return walkTestVisit(w, f, result);
+}
+
+// walkTestChain returns (BinOp (IntLit 1) (BinOp (IntLit 1) ... last)) of depth BinOps
+static Node* walkTestChain(Memory mem, u32 depth, Node* last) {
+  Node* n = last;
+  for (u32 i = 0; i < depth; i++) {
+    auto op = NewNode(mem, NBinOp);
+    op->op.left = NewNode(mem, NIntLit);
+    op->op.left->val.i = 1;
+    op->op.right = n;
+    n = op;
+  }
+  return n;
+}
+
+static void test_walk() {
+  auto mem = MemoryNew(0);
+  auto zero = NewNode(mem, NIntLit);
+
+  // (Block (BinOp (IntLit 1) (Ident x)) (Call (Ident f) (Tuple (IntLit 2))) (IntLit 0))
+  auto binop = NewNode(mem, NBinOp);
+  binop->op.left = NewNode(mem, NIntLit);
+  binop->op.left->val.i = 1;
+  binop->op.right = NewNode(mem, NIdent);
+  auto tuple = NewNode(mem, NTuple);
+  auto two = NewNode(mem, NIntLit);
+  two->val.i = 2;
+  NodeListAppend(mem, &tuple->array.a, two);
+  auto call = NewNode(mem, NCall);
+  call->call.receiver = NewNode(mem, NIdent);
+  call->call.args = tuple;
+  auto block = NewNode(mem, NBlock);
+  NodeListAppend(mem, &block->array.a, binop);
+  NodeListAppend(mem, &block->array.a, call);
+  NodeListAppend(mem, &block->array.a, zero);
+
+  NodeWalker w;
+  WalkTest t = { sdsempty(), 0, 0, NULL };
+  NodeWalkerInit(&w, &t, mem);
+  auto result = NodeWalk(&w, walkTestVisit, block, 0, zero);
+  asserteq(result, block);
+  assertf(strcmp(t.s, "Block0 BinOp1 IntLit2 Ident2 Call1 Ident2 Tuple2 IntLit3 IntLit1 ") == 0,
+    "%s", t.s);
+  asserteq(w.len, 0);
+  asserteq(t.maxdepth, 3);
+  // literals were replaced in place
+  asserteq(binop->op.left, zero);
+  asserteq(NodeListAt(&tuple->array.a, 0), zero);
+  asserteq(NodeListAt(&block->array.a, 2), zero);
+
+  // a tree too deep to be visited recursively with a typical C stack size:
+  // (BinOp (IntLit 1) (BinOp (IntLit 1) ... (IntLit 1)))
+  const u32 depth = 200000;
+  Node* n = NewNode(mem, NIntLit);
+  n->val.i = 1;
+  n = walkTestChain(mem, depth, n);
+  sdsfree(t.s);
+  t.s = NULL;
+  asserteq(NodeWalk(&w, walkTestVisit, n, 0, zero), n);
+  asserteq(t.maxdepth, depth);
+  for (u32 i = 0; i < depth; i++) {
+    asserteq(n->op.left, zero);
+    n = n->op.right;
+  }
+  asserteq(n, zero);
+
+  // a walk started by a visit function, where the frames of the outer walk move while the
+  // inner walk runs: from NodeWalker.storage to the heap (outer walk with less than 32 frames)
+  // or to a larger heap array. The outer tree is (BinOp (IntLit 1) ... (BinOp Ident (IntLit 1)))
+  // so that the frame of the Ident's parent is used after the inner walk.
+  const u32 innerdepth = 300;
+  const u32 outerdepths[] = { 20, 40 };
+  for (u32 k = 0; k < countof(outerdepths); k++) {
+    u32 outerdepth = outerdepths[k];
+    NodeWalkerFree(&w);
+    NodeWalkerInit(&w, &t, mem);
+    auto inner = NewNode(mem, NIntLit);
+    inner->val.i = 1;
+    t.nested = walkTestChain(mem, innerdepth, inner);
+    auto last = NewNode(mem, NBinOp);
+    last->op.left = NewNode(mem, NIdent);
+    last->op.right = NewNode(mem, NIntLit);
+    last->op.right->val.i = 1;
+    auto outer = walkTestChain(mem, outerdepth, last);
+    t.maxdepth = 0;
+    t.count = 0;
+    asserteq(NodeWalk(&w, walkTestNestedVisit, outer, 0, zero), outer);
+    asserteq(w.len, 0);
+    asserteq(t.maxdepth, outerdepth + 1 + innerdepth);
+    asserteq(t.count, (outerdepth + 1) * 2 + innerdepth * 2 + 1); // the Ident is not counted
+    n = outer;
+    for (u32 i = 0; i < outerdepth; i++) {
+      asserteq(n->op.left, zero);
+      n = n->op.right;
+    }
+    asserteq(n, last);
+    asserteq(last->op.left, t.nested); // the Ident was replaced with the result of the walk
+    asserteq(last->op.right, zero);
+    n = t.nested;
+    for (u32 i = 0; i < innerdepth; i++) {
+      asserteq(n->op.left, zero);
+      n = n->op.right;
+    }
+    asserteq(n, zero);
+  }
+
+  NodeWalkerFree(&w);
+  MemoryFree(mem);
+}
+
+W_UNIT_TEST(AstWalk, { test_walk(); })
+#endif
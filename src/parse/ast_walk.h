@@ -0,0 +1,150 @@
+#pragma once
+#include "ast.h"
+
+// NodeWalker traverses a tree of nodes with an explicit stack of frames instead of recursion,
+// so that the depth of a tree is limited only by memory, not by the size of the C stack.
+//
+// A pass is written as a visit function which is called for a frame when the frame is
+// entered (f->state is 0) and then again each time a child visit that it started returns,
+// with the result of that visit. The visit function either starts a child visit, by
+// returning the value of NodeWalkPush or NodeWalkPushNode, or returns the result of the
+// frame. This is the same control flow as a recursive pass, where "x = pass(child)" becomes
+// "return NodeWalkPushNode(w, child)" and x is the result argument of the next call.
+//
+// The first call of a frame is its "pre" hook and the call which returns a result its "post"
+// hook. A child visited with NodeWalkPush has its result stored in the slot it was read from,
+// which replaces nodes in place like NodeListMap does for lists. NodeWalkNextChild visits the
+// children of a node in a fixed order, for passes which don't need a kind-specific order:
+//
+//   static Node* visit(NodeWalker* w, NodeWalkFrame* f, Node* result) {
+//     if (f->state == 0) {
+//       // pre: f->n is entered
+//     }
+//     if (NodeWalkNextChild(w, f))
+//       return NodeWalkPending;
+//     // post: all children of f->n have been visited
+//     return f->n; // or a node to replace f->n with
+//   }
+//
+// Frames have a few fields for the pass to use (fl, ptr and tmp.) A new frame starts out with
+// the fl and ptr of its parent, which makes them suitable for state inherited by subtrees,
+// like the current scope.
+
+typedef struct NodeWalker    NodeWalker;
+typedef struct NodeWalkFrame NodeWalkFrame;
+
+// NodeVisitFn visits frame f of walk w. result is the result of the child visit which just
+// returned, or NULL when the frame is entered.
+// Note that f is invalid after a call to NodeWalkPush, NodeWalkPushNode or NodeWalk, since
+// they may move the frames. The frame is then &w->frames[w->len - 1] (or, after a call to
+// NodeWalkPush*, the frame before it.)
+typedef Node* (NodeVisitFn)(NodeWalker* w, NodeWalkFrame* f, Node* result);
+
+// NodeWalkPending is returned by a visit function which started a child visit
+#define NodeWalkPending ((Node*)(uintptr_t)1)
+
+struct NodeWalkFrame {
+  Node*  n;     // node visited
+  Node** slot;  // where the result of the visit is stored, or NULL
+  void*  ptr;   // for use by the visit function; initially the ptr of the parent frame
+  Node*  tmp;   // for use by the visit function; initially NULL
+  u32    fl;    // for use by the visit function; initially the fl of the parent frame
+  u32    state; // for use by the visit function; initially 0
+};
+
+struct NodeWalker {
+  void*          userdata;
+  Memory         mem;     // memory used for frames
+  NodeWalkFrame* frames;  // frames[len-1] is the frame being visited
+  u32            len, cap;
+  NodeWalkFrame  storage[32];
+};
+
+// NodeWalkerInit initializes a walker
+void NodeWalkerInit(NodeWalker*, void* userdata, Memory mem/*nullable*/);
+
+// NodeWalkerFree frees memory used by a walker
+void NodeWalkerFree(NodeWalker*);
+
+// NodeWalk visits n and its descendants with visit, starting with a frame with fl and ptr,
+// and returns the result of the visit of n. Since NodeWalk is inline, calls to a visit
+// function known at compile time are direct calls.
+// A visit function may call NodeWalk with the same walker, for example to visit a tree
+// which is not a child of f->n, which then uses frames above the frames of the outer walk.
+static Node* NodeWalk(NodeWalker*, NodeVisitFn* visit, Node* n, u32 fl, void* ptr);
+
+// NodeWalkPush starts a visit of *slot. The result of the visit is stored in *slot.
+// Returns NodeWalkPending.
+static Node* NodeWalkPush(NodeWalker*, Node** slot);
+
+// NodeWalkPushNode starts a visit of n. The result is only passed to the visit function.
+// Returns NodeWalkPending.
+static Node* NodeWalkPushNode(NodeWalker*, Node* n);
+
+// NodeWalkNextChild starts a visit of the next child of f->n with NodeWalkPush and returns
+// true, or returns false when all children have been visited. f->state is used as the index
+// of the next child. The children of a node are the nodes which belong to it, in the order
+// they appear in the source; not its type, identifier targets or the nodes of types.
+bool NodeWalkNextChild(NodeWalker*, NodeWalkFrame* f);
+
+// NodeChildSlot returns the address of child i of n (see NodeWalkNextChild), which may be a
+// NULL child, or NULL if n has no more children.
+Node** NodeChildSlot(Node* n, u32 i);
+
+// -----------------------------------------------------------------------------------------------
+// inline implementations
+
+void _NodeWalkGrow(NodeWalker*);
+
+inline static NodeWalkFrame* _NodeWalkEnter(
+  NodeWalker* w, Node* n, Node** slot, u32 fl, void* ptr)
+{
+  assert(n != NULL);
+  if (w->len == w->cap) {
+    _NodeWalkGrow(w);
+  }
+  auto f = &w->frames[w->len++];
+  f->n = n;
+  f->slot = slot;
+  f->ptr = ptr;
+  f->tmp = NULL;
+  f->fl = fl;
+  f->state = 0;
+  return f;
+}
+
+inline static Node* NodeWalkPush(NodeWalker* w, Node** slot) {
+  auto parent = &w->frames[w->len - 1];
+  _NodeWalkEnter(w, *slot, slot, parent->fl, parent->ptr);
+  return NodeWalkPending;
+}
+
+inline static Node* NodeWalkPushNode(NodeWalker* w, Node* n) {
+  auto parent = &w->frames[w->len - 1];
+  _NodeWalkEnter(w, n, NULL, parent->fl, parent->ptr);
+  return NodeWalkPending;
+}
+
+inline static Node* NodeWalk(NodeWalker* w, NodeVisitFn* visit, Node* n, u32 fl, void* ptr) {
+  u32 base = w->len; // NodeWalk may be called by a visit function
+  _NodeWalkEnter(w, n, NULL, fl, ptr);
+  Node* result = NULL;
+  while (1) {
+    Node* r = visit(w, &w->frames[w->len - 1], result);
+    // Frames may have moved during the call, if visit started a child visit or called
+    // NodeWalk, so the frame is looked up again rather than kept across the call.
+    auto f = &w->frames[w->len - 1];
+    if (r == NodeWalkPending) {
+      // visit started a child visit (f)
+      result = NULL;
+      continue;
+    }
+    if (f->slot) {
+      *f->slot = r;
+    }
+    if (--w->len == base) {
+      return r;
+    }
+    result = r;
+  }
+}
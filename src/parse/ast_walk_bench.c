@@ -0,0 +1,126 @@
+#include "../common/bench.h"
+#include "parse.h"
+#include "ast_walk.h"
+
+// Benchmarks of NodeWalker and of the resolvers, which use it, on generated trees:
+//
+//   deep  (BinOp (Ident x) (BinOp (Ident x) ... (Ident x)))  nesting WALK_BENCH_SIZE levels deep
+//   wide  (Block (BinOp (Ident x) (Ident x)) ...)            with WALK_BENCH_SIZE items
+//
+// x is a constant of type int. A new tree is built for every iteration, with the timer stopped,
+// since the resolvers modify the tree. WALK_BENCH_SIZE is small enough for the trees to be
+// resolved recursively too, so that results can be compared with recursive implementations.
+#define WALK_BENCH_SIZE 10000
+
+typedef struct WalkBench {
+  CCtx   cc;
+  Str    name; // name of the source of cc
+  Scope* scope;
+  Node*  let; // binding of x
+  Sym    x;
+} WalkBench;
+
+
+// walkBenchTree (re)initializes wb->cc and builds a deep or wide tree (see above) in its memory
+static Node* walkBenchTree(WalkBench* wb, bool deep) {
+  auto cc = &wb->cc;
+  if (!CCtxInit(cc, NULL, NULL, wb->name, (const u8*)"", 0)) {
+    die("walkBenchTree: CCtxInit: %s", strerror(errno));
+  }
+  auto mem = cc->mem;
+  wb->x = symgeth((const u8*)"x", 1);
+  wb->scope = ScopeNew(GetGlobalScope(), mem);
+  wb->let = NewNode(mem, NLet);
+  wb->let->type = Type_int;
+  wb->let->field.name = wb->x;
+  wb->let->field.init = NewNode(mem, NIntLit);
+  wb->let->field.init->type = Type_int;
+  wb->let->field.init->val.i = 1;
+  ScopeAssoc(wb->scope, wb->x, wb->let);
+
+  Node* n;
+  if (deep) {
+    n = NewNode(mem, NIdent);
+    n->ref.name = wb->x;
+  } else {
+    n = NewNode(mem, NBlock);
+  }
+  for (u32 i = 0; i < WALK_BENCH_SIZE; i++) {
+    auto op = NewNode(mem, NBinOp);
+    op->op.op = TPlus;
+    op->op.left = NewNode(mem, NIdent);
+    op->op.left->ref.name = wb->x;
+    if (deep) {
+      op->op.right = n;
+      n = op;
+    } else {
+      op->op.right = NewNode(mem, NIdent);
+      op->op.right->ref.name = wb->x;
+      NodeListAppend(mem, &n->array.a, op);
+    }
+  }
+  return n;
+}
+
+
+static Node* walkBenchVisit(NodeWalker* w, NodeWalkFrame* f, Node* result) {
+  if (f->state == 0) {
+    (*(u64*)w->userdata)++;
+  }
+  if (NodeWalkNextChild(w, f)) {
+    return NodeWalkPending;
+  }
+  return f->n;
+}
+
+
+typedef enum { WalkBenchWalk, WalkBenchResolveSym, WalkBenchResolveType } WalkBenchPass;
+
+static void walkBench(Bench* b, bool deep, WalkBenchPass pass) {
+  BenchStopTimer(b);
+  WalkBench wb = { .name = sdsnew("walk_bench") };
+  u64 nnodes = 0;
+  for (u64 i = 0; i < b->N; i++) {
+    auto n = walkBenchTree(&wb, deep);
+    if (pass == WalkBenchResolveType) {
+      n = ResolveSym(&wb.cc, ParseFlagsDefault, n, wb.scope);
+    }
+    nnodes = 0;
+    NodeWalker w;
+    NodeWalkerInit(&w, &nnodes, wb.cc.mem);
+    switch (pass) {
+      case WalkBenchWalk:
+        BenchStartTimer(b);
+        NodeWalk(&w, walkBenchVisit, n, 0, NULL);
+        BenchStopTimer(b);
+        break;
+      case WalkBenchResolveSym:
+        BenchStartTimer(b);
+        ResolveSym(&wb.cc, ParseFlagsDefault, n, wb.scope);
+        BenchStopTimer(b);
+        NodeWalk(&w, walkBenchVisit, n, 0, NULL);
+        break;
+      case WalkBenchResolveType:
+        BenchStartTimer(b);
+        ResolveType(&wb.cc, n);
+        BenchStopTimer(b);
+        NodeWalk(&w, walkBenchVisit, n, 0, NULL);
+        if (n->type != Type_int) {
+          die("walkBench: wrong type %s", fmtnode(n->type));
+        }
+        break;
+    }
+    NodeWalkerFree(&w);
+  }
+  CCtxFree(&wb.cc);
+  sdsfree(wb.name);
+  b->nodes = nnodes;
+}
+
+
+W_BENCHMARK(NodeWalkDeepTree,    { walkBench(b, true,  WalkBenchWalk); })
+W_BENCHMARK(NodeWalkWideTree,    { walkBench(b, false, WalkBenchWalk); })
+W_BENCHMARK(ResolveSymDeepTree,  { walkBench(b, true,  WalkBenchResolveSym); })
+W_BENCHMARK(ResolveSymWideTree,  { walkBench(b, false, WalkBenchResolveSym); })
+W_BENCHMARK(ResolveTypeDeepTree, { walkBench(b, true,  WalkBenchResolveType); })
+W_BENCHMARK(ResolveTypeWideTree, { walkBench(b, false, WalkBenchResolveType); })
@@ -1,5 +1,7 @@
 #include "parse.h"
-#include "parseint.h"
+#include "../common/os.h"
+#include "../common/ptrmap.h"
+#include "../common/test.h"
 
 // enable debug messages for pushScope() and popScope()
 // #define DEBUG_SCOPE_PUSH_POP
@@ -54,7 +56,29 @@ typedef struct Parselet {
   Precedence         prec;
 } Parselet;
 
-#define next(p) SNext(&(p)->s)
+// nexttok loads the next token of the pre-lexed token buffer into p->s (ParseTokBuf)
+inline static Tok nexttok(P* p) {
+  auto b = &p->toks;
+  if (p->tokidx + 1 < b->len) {
+    p->tokidx++;
+  } else if (p->s.inp < p->s.inend) {
+    // SLexAll stopped at invalid input; continue after it, like SNext would
+    SLexAll(&p->s, b);
+    p->tokidx++;
+  } // else stay at the terminating TNone
+  u32 i = p->tokidx;
+  p->s.tok = TokUnpack(b->tok[i]);
+  p->s.tokstart = p->s.src->buf + b->start[i];
+  p->s.tokend = p->s.tokstart + b->tlen[i];
+  if (p->s.tok == TIdent || p->s.tok > TKeywordsStart) {
+    p->s.name = b->val[i].name;
+  } else {
+    p->s.val.i = b->val[i].i;
+  }
+  return p->s.tok;
+}
+
+#define next(p) (((p)->s.flags & ParseTokBuf) ? nexttok(p) : SNext(&(p)->s))
 
 
 inline static bool sdshasprefix(sds s, const char* prefix) {
@@ -68,6 +92,7 @@ inline static bool sdshasprefix(sds s, const char* prefix) {
 // If n is not NULL, use source location of n instead of current location.
 //
 static void syntaxerrp(P* p, SrcPos pos, const char* format, ...) {
+  p->nerrors++;
   if (pos.src == null) {
     pos = SSrcPos(&p->s);
   }
@@ -84,7 +109,10 @@ static void syntaxerrp(P* p, SrcPos pos, const char* format, ...) {
   const char* tokname;
   if (p->s.tok == TNone) {
     tokname = "end of input";
-  } else if (p->s.tok == TSemi && p->s.inp > p->s.src->buf && *(p->s.inp - 1) == '\n') {
+  } else if (
+    p->s.tok == TSemi &&
+    p->s.tokstart >= p->s.src->buf && p->s.tokstart < p->s.inend && *p->s.tokstart == '\n'
+  ) {
     tokname = "newline";
   } else {
     tokname = TokName(p->s.tok);
@@ -186,12 +214,40 @@ static void advance(P* p, const Tok* followlist) {
 // allocate a new ast node
 inline static Node* PNewNode(P* p, NodeKind kind) {
   auto n = NewNode(p->cc->mem, kind);
-  n->pos.src = p->s.src;
-  n->pos.offs = p->s.tokstart - p->s.src->buf;
-  n->pos.span = p->s.tokend - p->s.tokstart;  assert(p->s.tokend >= p->s.tokstart);
+  auto src = p->s.src;
+  u32 offs = (u32)(p->s.tokstart - src->buf);
+  assert(p->s.tokend >= p->s.tokstart);
+  if (p->s.tokend == p->s.tokstart && offs + 1 >= src->len) {
+    // The empty token at the end of input (TNone or a semicolon) is positioned at the end of
+    // the source rather than at its last byte, which may start a token of its own.
+    offs = (u32)src->len;
+  }
+  n->pos = PosMake(src, offs);
   return n;
 }
 
+// The nodes of a list are collected in p->listbuf while the list is parsed and are then
+// copied to the NodeList, which only allocates exactly as much memory as it needs. Lists nest,
+// so listbuf is a stack: pListBegin returns the start of a new list in listbuf, pListPush adds
+// a node and pListEnd moves the nodes from start to the top of the stack to a NodeList.
+inline static u32 pListBegin(P* p) {
+  return p->nlistbuf;
+}
+
+static void pListPush(P* p, Node* n) {
+  if (p->nlistbuf == p->listbufcap) {
+    p->listbufcap = max(64u, p->listbufcap * 2);
+    p->listbuf = (Node**)memrealloc(p->cc->mem, p->listbuf, sizeof(Node*) * p->listbufcap);
+  }
+  p->listbuf[p->nlistbuf++] = n;
+}
+
+static void pListEnd(P* p, u32 start, NodeList* list) {
+  assert(start <= p->nlistbuf);
+  NodeListAssign(p->cc->mem, list, &p->listbuf[start], p->nlistbuf - start);
+  p->nlistbuf = start;
+}
+
 // precedence should match the calling parselet's own precedence
 static Node* expr(P* p, int precedence, PFlag fl);
 
@@ -217,14 +273,14 @@ static Scope* popScope(P* p) {
 
   #ifdef DEBUG_SCOPE_PUSH_POP
   dlog("pop scope #%p", s);
-  if (s->bindings.len == 0 && s->childcount == 0) {
+  if (s->nbindings == 0 && s->childcount == 0) {
     dlog("  unused scope (free)");
   } else {
     dlog("  used scope (keep)");
   }
   #endif
 
-  if (s->bindings.len == 0 && s->childcount == 0) {
+  if (s->nbindings == 0 && s->childcount == 0) {
     // the scope is unused and has no dependants; free it and return null
     ScopeFree(s, p->cc->mem);
     return NULL;
@@ -275,9 +331,11 @@ static Node* bad(P* p) {
 // tupleTrailingComma = Expr ("," Expr)* ","?
 static Node* tupleTrailingComma(P* p, int precedence, PFlag fl, Tok stoptok) {
   auto tuple = PNewNode(p, NTuple);
+  u32 start = pListBegin(p);
   do {
-    NodeListAppend(p->cc->mem, &tuple->array.a, expr(p, precedence, fl));
+    pListPush(p, expr(p, precedence, fl));
   } while (got(p, TComma) && p->s.tok != stoptok);
+  pListEnd(p, start, &tuple->array.a);
   return tuple;
 }
 
@@ -342,30 +400,28 @@ static Node* pAssign(P* p, const Parselet* e, PFlag fl, Node* left) {
   // defsym
   if (left->kind == NTuple) {
     if (right->kind != NTuple) {
-      syntaxerrp(p, left->pos, "assignment mismatch: %u targets but 1 value", left->array.a.len);
+      syntaxerrp(p, PosSrcPos(left->pos), "assignment mismatch: %u targets but 1 value", left->array.a.len);
     } else {
       auto lnodes = &left->array.a;
       auto rnodes = &right->array.a;
       if (lnodes->len != rnodes->len) {
-        syntaxerrp(p, left->pos, "assignment mismatch: %u targets but %u values",
+        syntaxerrp(p, PosSrcPos(left->pos), "assignment mismatch: %u targets but %u values",
           lnodes->len, rnodes->len);
       } else {
-        auto l = lnodes->head;
-        auto r = rnodes->head;
-        while (l) {
-          if (l->node->kind == NIdent) {
-            defsym(p, l->node->ref.name, r->node);
+        auto l = NodeListItems(lnodes);
+        auto r = NodeListItems(rnodes);
+        for (u32 i = 0; i < lnodes->len; i++) {
+          if (l[i]->kind == NIdent) {
+            defsym(p, l[i]->ref.name, r[i]);
           } else {
             // e.g. foo.bar = 3
             dlog("TODO pAssign l->node->kind != NIdent");
           }
-          l = l->next;
-          r = r->next;
         }
       }
     }
   } else if (right->kind == NTuple) {
-    syntaxerrp(p, left->pos, "assignment mismatch: 1 target but %u values", right->array.a.len);
+    syntaxerrp(p, PosSrcPos(left->pos), "assignment mismatch: 1 target but %u values", right->array.a.len);
   } else if (left->kind == NIdent) {
     defsym(p, left->ref.name, right);
   }
@@ -458,7 +514,7 @@ static Node* PCall(P* p, const Parselet* e, PFlag fl, Node* receiver) {
   assert(args->kind == NTuple);
   switch (args->array.a.len) {
     case 0:  break; // leave as-is, i.e. n->call.args=NULL
-    case 1:  n->call.args = args->array.a.head->node; break;
+    case 1:  n->call.args = NodeListAt(&args->array.a, 0); break;
     default: n->call.args = args; break;
   }
   if (NodeKindIsType(receiver->kind)) {
@@ -479,12 +535,14 @@ static Node* PBlock(P* p, PFlag fl) {
   // clear rvalue flag; productions of block are lvalue
   fl &= ~PFlagRValue;
 
+  u32 start = pListBegin(p);
   while (p->s.tok != TNone && p->s.tok != TRBrace) {
-    NodeListAppend(p->cc->mem, &n->array.a, exprOrTuple(p, PREC_LOWEST, fl));
+    pListPush(p, exprOrTuple(p, PREC_LOWEST, fl));
     if (!got(p, TSemi)) {
       break;
     }
   }
+  pListEnd(p, start, &n->array.a);
   if (!got(p, TRBrace)) {
     syntaxerr(p, "expecting ; or }");
     next(p);
@@ -529,21 +587,28 @@ static Node* PPostfixOp(P* p, const Parselet* e, PFlag fl, Node* operand) {
   return n;
 }
 
-// IntLit = [0-9]+
+// IntLit = [0-9]+ | "0x" [0-9A-Fa-f]+ | "0o" [0-7]+ | "0b" [01]+
 //!PrefixParselet TIntLit
 static Node* PIntLit(P* p, PFlag fl) {
   auto n = PNewNode(p, NIntLit);
-  size_t len = p->s.tokend - p->s.tokstart;
-  if (!parseint64((const char*)p->s.tokstart, len, /*base*/10, &n->val.i)) {
-    n->val.i = 0;
-    syntaxerrp(p, n->pos, "invalid integer literal");
-  }
+  n->val.i = p->s.val.i; // value computed by the scanner
   next(p);
   n->val.ct = CType_int;
   n->type = Type_ideal;
   return n;
 }
 
+// FloatLit = [0-9]+ ( "." [0-9]+ )? ( [eE] [+-]? [0-9]+ )?
+//!PrefixParselet TFloatLit
+static Node* PFloatLit(P* p, PFlag fl) {
+  auto n = PNewNode(p, NFloatLit);
+  n->val.f = p->s.val.f; // value computed by the scanner
+  next(p);
+  n->val.ct = CType_float;
+  n->type = Type_ideal;
+  return n;
+}
+
 // If = "if" Expr Expr
 //!PrefixParselet TIf
 static Node* PIf(P* p, PFlag fl) {
@@ -593,6 +658,7 @@ static Node* params(P* p) { // => NTuple
   bool hasTypedParam = false; // true when at least one param has type; e.g. "x T"
   NodeList typeq = {0};
   PFlag fl = PFlagRValue;
+  u32 start = pListBegin(p);
 
   while (p->s.tok != TRParen && p->s.tok != TNone) {
     auto field = PNewNode(p, NArg);
@@ -617,7 +683,7 @@ static Node* params(P* p) { // => NTuple
       // definitely just type, e.g. "fun(int)int"
       field->type = expr(p, PREC_LOWEST, fl);
     }
-    NodeListAppend(p->cc->mem, &n->array.a, field);
+    pListPush(p, field);
     if (!got(p, TComma)) {
       if (p->s.tok != TRParen) {
         syntaxerr(p, "expecting comma or )");
@@ -626,6 +692,7 @@ static Node* params(P* p) { // => NTuple
       break;
     }
   }
+  pListEnd(p, start, &n->array.a);
 
   if (hasTypedParam) {
     // name-and-type form; e.g. "(x, y T, z Y)"
@@ -693,7 +760,7 @@ static Node* PFun(P* p, PFlag fl) {
     assert(pa->kind == NTuple);
     switch (pa->array.a.len) {
       case 0:  break; // leave as-is, i.e. n->fun.params=NULL
-      case 1:  n->fun.params = pa->array.a.head->node; break;
+      case 1:  n->fun.params = NodeListAt(&pa->array.a, 0); break;
       default: n->fun.params = pa; break;
     }
   }
@@ -729,6 +796,7 @@ static const Parselet parselets[TMax] = {
   [TMinus] = {PPrefixOp, PInfixOp, PREC_ADD},
   [TExcalm] = {PPrefixOp, NULL, PREC_MEMBER},
   [TIntLit] = {PIntLit, NULL, PREC_MEMBER},
+  [TFloatLit] = {PFloatLit, NULL, PREC_MEMBER},
   [TIf] = {PIf, NULL, PREC_MEMBER},
   [TReturn] = {PReturn, NULL, PREC_MEMBER},
   [TFun] = {PFun, NULL, PREC_MEMBER},
@@ -842,16 +910,18 @@ static Node* exprOrTuple(P* p, int precedence, PFlag fl) {
                        prefixExpr(p, fl) ); // read a prefix expression, like an identifier
   if (got(p, TComma)) {
     auto g = PNewNode(p, fl & PFlagType ? NTupleType : NTuple);
-    NodeListAppend(p->cc->mem, &g->array.a, left);
+    u32 start = pListBegin(p);
+    pListPush(p, left);
     if (fl & PFlagRValue) {
       do {
-        NodeListAppend(p->cc->mem, &g->array.a, expr(p, precedence, fl));
+        pListPush(p, expr(p, precedence, fl));
       } while (got(p, TComma));
     } else {
       do {
-        NodeListAppend(p->cc->mem, &g->array.a, prefixExpr(p, fl));
+        pListPush(p, prefixExpr(p, fl));
       } while (got(p, TComma));
     }
+    pListEnd(p, start, &g->array.a);
     left = g;
   }
   if (fl & PFlagRValue) {
@@ -862,12 +932,48 @@ static Node* exprOrTuple(P* p, int precedence, PFlag fl) {
 }
 
 
+// declendReserve makes room for at least n entries in p->declend
+static void declendReserve(P* p, u32 n) {
+  if (n > p->declcap) {
+    p->declcap = max(max(n, 64u), p->declcap * 2);
+    p->declend = (u32*)memrealloc(p->cc->mem, p->declend, sizeof(u32) * p->declcap);
+  }
+}
+
+
+// TopLevel = Expr (";" | EOF)
+static Node* pTopLevel(P* p) {
+  Node* n = exprOrTuple(p, PREC_LOWEST, PFlagNone);
+  // check that we either got a semicolon or EOF
+  p->openend = p->s.tok == TNone;
+  if (p->s.tok != TNone && !got(p, TSemi)) {
+    syntaxerr(p, "after top level declaration");
+    Tok followlist[] = { TType, TFun, TSemi, 0 };
+    advance(p, followlist);
+  }
+  return n;
+}
+
+
 Node* Parse(P* p, CCtx* cc, ParseFlags fl, Scope* pkgscope) {
   // initialize scanner
   SInit(&p->s, cc->mem, &cc->src, fl, cc->errh, cc->userdata);
   p->fnest = 0;
+  p->nerrors = 0;
   p->scope = pkgscope;
   p->cc = cc;
+  p->listbuf = NULL; // allocated in cc->mem
+  p->nlistbuf = 0;
+  p->listbufcap = 0;
+  if (fl & ParseTokBuf) {
+    // lex the source up front (all of it, unless it contains invalid input)
+    TokBufInit(&p->toks, cc->mem);
+    SLexAllParallel(&p->s, &p->toks, (fl & ParseParallel) ? os_ncpu() : 1);
+    p->tokidx = (u32)-1; // so that the first call to next loads toks[0]
+    p->declend = NULL;
+    p->ndeclend = 0;
+    p->declcap = 0;
+  }
   next(p); // read first token
 
   // TODO: ParseFlags, where one option is PARSE_IMPORTS to parse only imports and then stop.
@@ -875,9 +981,15 @@ Node* Parse(P* p, CCtx* cc, ParseFlags fl, Scope* pkgscope) {
   auto file = PNewNode(p, NFile);
   pushScope(p);
 
+  u32 start = pListBegin(p);
   while (p->s.tok != TNone) {
-    Node* n = exprOrTuple(p, PREC_LOWEST, PFlagNone);
-    NodeListAppend(p->cc->mem, &file->array.a, n);
+    Node* n = pTopLevel(p);
+    pListPush(p, n);
+    if (fl & ParseTokBuf) {
+      // remember where the declaration ended, for ParseEdit
+      declendReserve(p, p->ndeclend + 1);
+      p->declend[p->ndeclend++] = p->tokidx;
+    }
 
     // // print associated comments
     // auto c = p->s.comments;
@@ -891,20 +1003,789 @@ Node* Parse(P* p, CCtx* cc, ParseFlags fl, Scope* pkgscope) {
     // s = sdscatlen(s, "\n", 1);
     // fwrite(s, sdslen(s), 1, stdout);
     // sdsfree(s);
-
-    // check that we either got a semicolon or EOF
-    if (p->s.tok != TNone && !got(p, TSemi)) {
-      syntaxerr(p, "after top level declaration");
-      Tok followlist[] = { TType, TFun, TSemi, 0 };
-      advance(p, followlist);
-    }
   }
+  pListEnd(p, start, &file->array.a);
 
   file->array.scope = popScope(p);
   return file;
 }
 
 
+// ============================================================================================
+// Incremental parsing
+//
+// Parse records the token index after each top-level declaration (P.declend.) The scanner
+// state right after a declaration which ended with a line feed or ";" is always the same (see
+// scan_parallel.c) so scanning can restart there. ParseEdit scans the new source from the end
+// of the last such declaration before the edit until it reaches a semicolon at brace depth 0
+// after the edit which ends an old declaration (at the old offset), where the two token
+// streams become identical again. The tokens in between (the "window") replace the old ones
+// and are parsed to produce new declarations, which replace the old declarations of the
+// window. Sources with syntax errors are always parsed in full, since error recovery may
+// leave declarations misaligned with the brace structure the checks below rely on.
+//
+// Declarations after the window may refer to declarations in the window, by identifier
+// targets or by constants and types substituted for identifiers (see PIdent.) An old
+// declaration with a counterpart in the window (same kind and name) is updated in place, so
+// that references to it stay valid. If a name of the file scope refers to something else
+// after the edit and that name is used after the window, the following declarations could
+// parse differently, and the whole source is parsed again.
+
+typedef void(PEditVisitor)(Node* n, void* userdata);
+
+// editWalk calls f with n and every node reachable from it, except for identifier targets.
+// Nodes which may be shared by several parents are visited only once: constants and types,
+// and any node used as a type (e.g. by parameters in "(x, y int)".)
+static void editWalk(Node* n, PtrMap* seen, PEditVisitor* f, void* userdata, bool shared) {
+  if (n == NULL) {
+    return;
+  }
+  if (shared || !NodeIsExpr(n)) {
+    if (PtrMapGet(seen, n)) {
+      return;
+    }
+    PtrMapSet(seen, n, n);
+  }
+  f(n, userdata);
+  editWalk(n->type, seen, f, userdata, true);
+  switch (n->kind) {
+    case NAssign:
+    case NBinOp:
+    case NPrefixOp:
+    case NPostfixOp:
+    case NReturn:
+      editWalk(n->op.left, seen, f, userdata, false);
+      editWalk(n->op.right, seen, f, userdata, false);
+      break;
+    case NTuple:
+    case NBlock:
+    case NFile:
+      NodeListForEach(&n->array.a, cn, editWalk(cn, seen, f, userdata, false));
+      break;
+    case NFun:
+      editWalk(n->fun.params, seen, f, userdata, false);
+      editWalk(n->fun.body, seen, f, userdata, false);
+      break;
+    case NCall:
+    case NTypeCast:
+      editWalk(n->call.receiver, seen, f, userdata, false);
+      editWalk(n->call.args, seen, f, userdata, false);
+      break;
+    case NArg:
+    case NField:
+    case NLet:
+      editWalk(n->field.init, seen, f, userdata, false);
+      break;
+    case NIf:
+      editWalk(n->cond.cond, seen, f, userdata, false);
+      editWalk(n->cond.thenb, seen, f, userdata, false);
+      editWalk(n->cond.elseb, seen, f, userdata, false);
+      break;
+    case NTupleType:
+      NodeListForEach(&n->t.tuple, cn, editWalk(cn, seen, f, userdata, false));
+      break;
+    case NFunType:
+      editWalk(n->t.fun.params, seen, f, userdata, false);
+      editWalk(n->t.fun.result, seen, f, userdata, false);
+      break;
+    case NNone:
+    case NBad:
+    case NBoolLit:
+    case NIntLit:
+    case NFloatLit:
+    case NNil:
+    case NComment:
+    case NIdent:
+    case NZeroInit:
+    case NBasicType:
+    case _NodeKindMax:
+      break;
+  }
+}
+
+
+// editOldOffs returns the offset of n in src before the edit, or UINT32_MAX if n is not a
+// node of src. The positions of src may have been moved by SourceReplace, and so old nodes are
+// looked up in the positions that src had before it.
+inline static u32 editOldOffs(const Node* n, const Source* src) {
+  u32 offs = n->pos - src->_prevposbase;
+  return offs < src->_prevpossize ? offs : UINT32_MAX;
+}
+
+typedef struct PEditShift {
+  const Source* src;
+  u32           end;   // nodes at or after this offset are moved
+  i64           delta; // by this many bytes
+} PEditShift;
+
+// editShiftVisit gives an old node its position in the edited source
+static void editShiftVisit(Node* n, void* userdata) {
+  auto sh = (PEditShift*)userdata;
+  u32 offs = editOldOffs(n, sh->src);
+  if (offs != UINT32_MAX) {
+    if (offs >= sh->end) {
+      offs = (u32)((i64)offs + sh->delta);
+    }
+    n->pos = PosMake(sh->src, offs);
+  }
+}
+
+// editRedirectVisit makes identifiers which refer to a replaced declaration refer to the
+// updated original declaration instead
+static void editRedirectVisit(Node* n, void* userdata) {
+  if (n->kind == NIdent && n->ref.target) {
+    auto n2 = (Node*)PtrMapGet((PtrMap*)userdata, n->ref.target);
+    if (n2) {
+      n->ref.target = n2;
+    }
+  }
+}
+
+
+typedef struct PEditNames {
+  Scope*        fscope;  // file scope
+  const Scope*  scope;   // scope for lookups; fscope or its parent if there's no file scope
+  PtrMap*       remap;   // new declaration => updated old declaration
+  SymMap*       changed; // names which refer to something different after the edit
+} PEditNames;
+
+static u8 editUnbound; // value of PEditNames names which were not defined before the edit
+
+// editNamesVisit updates a name defined by the window to refer to updated old declarations,
+// and records whether it refers to the same thing as before the edit
+static void editNamesVisit(Sym name, void* before, bool* stop, void* userdata) {
+  auto c = (PEditNames*)userdata;
+  auto after = (Node*)ScopeLookup(c->scope, name);
+  if (after) {
+    auto n2 = (Node*)PtrMapGet(c->remap, after);
+    if (n2) {
+      after = n2;
+      if (c->fscope && ScopeLookupLocal(c->fscope, name)) {
+        ScopeAssoc(c->fscope, name, n2);
+      }
+    }
+  }
+  if ((void*)after != (before == &editUnbound ? NULL : before)) {
+    SymMapSet(c->changed, name, (void*)name);
+  }
+}
+
+inline static Sym editDeclName(const Node* n) {
+  switch (n->kind) {
+    case NFun: return n->fun.name;
+    case NLet: return n->field.name;
+    default:   return NULL;
+  }
+}
+
+// editNodeIn returns true if old node n is at an offset in [start,end) of src
+inline static bool editNodeIn(const Node* n, const Source* src, u32 start, u32 end) {
+  u32 offs = editOldOffs(n, src);
+  return offs >= start && offs < end;
+}
+
+// editAddNames adds the names of identifiers in tokens [start,end) of b to names, mapped to
+// what they refer to. Names outside of blocks, which could be defined in the file scope by
+// the tokens, are also added to defs.
+static void editAddNames(
+  const TokBuf* b, u32 start, u32 end, const Scope* scope, SymMap* names, SymMap* defs)
+{
+  u32 bdepth = 0;
+  for (u32 i = start; i < end; i++) {
+    Tok t = TokUnpack(b->tok[i]);
+    if (t == TLBrace) {
+      bdepth++;
+    } else if (t == TRBrace) {
+      bdepth -= bdepth > 0;
+    } else if (t == TIdent) {
+      Sym name = b->val[i].name;
+      if (!SymMapGet(names, name)) {
+        auto n = ScopeLookup(scope, name);
+        SymMapSet(names, name, n ? (void*)n : &editUnbound);
+      }
+      if (bdepth == 0) {
+        SymMapSet(defs, name, (void*)name);
+      }
+    }
+  }
+}
+
+
+typedef struct PEditBindings {
+  Scope*        fscope;
+  const Source* src;
+  u32           start, end; // old window
+  SymMap*       defs;       // names which the window might define
+  SymMap*       kill;       // names defined by the old window
+  SymMap*       hidden;     // names defined after the window
+  bool          ok;         // false if the edit can't be applied incrementally
+} PEditBindings;
+
+// editBindingsVisit sorts a name which appears in the window by where in the file it's defined
+static void editBindingsVisit(Sym name, void* _, bool* stop, void* userdata) {
+  auto c = (PEditBindings*)userdata;
+  auto n = ScopeLookupLocal(c->fscope, name);
+  if (n == NULL) {
+    return;
+  }
+  if (!NodeIsExpr(n)) {
+    // a constant assigned by a tuple assignment could be defined anywhere
+    c->ok = false;
+  } else if (editNodeIn(n, c->src, c->start, c->end)) {
+    SymMapSet(c->kill, name, (void*)n);
+  } else if (editNodeIn(n, c->src, c->end, UINT32_MAX)) {
+    // A later declaration defines the name, which the window must not see, just like when
+    // parsing from the start. If the window might define it as well, the later definition
+    // might have replaced it.
+    if (SymMapGet(c->defs, name)) {
+      c->ok = false;
+    } else {
+      SymMapSet(c->hidden, name, (void*)n);
+    }
+  }
+  *stop = !c->ok;
+}
+
+static void editDelVisit(Sym name, void* value, bool* stop, void* userdata) {
+  ScopeDel((Scope*)userdata, name);
+}
+
+static void editRestoreVisit(Sym name, void* value, bool* stop, void* userdata) {
+  ScopeAssoc((Scope*)userdata, name, (const Node*)value);
+}
+
+
+static void editErrorHandler(const Source* src, SrcPos pos, ConstStr msg, void* userdata) {
+  (*(u32*)userdata)++;
+}
+
+
+// editSearch returns the index of the first value >= v in sorted array a[lo:hi], or hi
+static u32 editSearch(const u32* a, u32 lo, u32 hi, u32 v) {
+  while (lo < hi) {
+    u32 mid = lo + (hi - lo) / 2;
+    if (a[mid] < v) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+// editDepth updates bracket depth d for token t. Returns false if d would become negative.
+inline static bool editDepth(Tok t, u32* d) {
+  switch (t) {
+    case TLParen: case TLBrace: case TLBrack:
+      (*d)++;
+      return true;
+    case TRParen: case TRBrace: case TRBrack:
+      if (*d == 0) {
+        return false;
+      }
+      (*d)--;
+      return true;
+    default:
+      return true;
+  }
+}
+
+
+Node* ParseEdit(P* p, Node* file, PEdit e) {
+  auto cc = p->cc;
+  auto src = &cc->src;
+  auto buf = src->buf;
+  auto b = &p->toks;
+  auto list = &file->array.a;
+  Scope* pkgscope = p->scope; // Parse leaves the parser in the package scope
+  Scope* fscope = file->array.scope;
+  i64 delta = (i64)e.newlen - (i64)e.len;
+  i64 oldlen = (i64)src->len - delta;
+  Node* result = NULL;
+
+  TokBuf w = {0};
+  Source wsrc = {0};
+  SymMap names = {0};
+  SymMap defs = {0};
+  SymMap kill = {0};
+  SymMap hidden = {0};
+  SymMap changed = {0};
+  PtrMap remap = {0};
+  PtrMap seen = {0};
+  Node** decls = NULL;
+  u32* newends = NULL;
+
+  if ((p->s.flags & ParseTokBuf) == 0 || p->nerrors > 0 || file->kind != NFile || b->len == 0 ||
+      (i64)e.offs + e.len > oldlen || (i64)b->start[b->len - 1] > oldlen)
+  {
+    goto fallback;
+  }
+
+  // Find the last declaration boundary before the edit. The window can start at a boundary
+  // after a semicolon of a line feed or ";", where the scanner state is the same as at the
+  // start of the source. (All bytes before the edit are unchanged.)
+  u32 ndecls = list->len;
+  if (p->ndeclend != ndecls || memchr(b->tok, TokPack(TNone), b->len - 1)) {
+    goto fallback; // the previous parse had scanner errors
+  }
+  u32 k0 = 0; // index of the first declaration in the window
+  u32 hi = ndecls;
+  while (k0 < hi) {
+    u32 k = (k0 + hi + 1) / 2;
+    if (b->start[p->declend[k - 1] - 1] < e.offs) {
+      k0 = k;
+    } else {
+      hi = k - 1;
+    }
+  }
+  while (k0 > 0) {
+    u32 i = p->declend[k0 - 1] - 1; // last token of the previous declaration
+    u32 X = b->start[i];
+    if (b->tok[i] == TokPack(TSemi) && (buf[X] == '\n' || buf[X] == ';') &&
+        (k0 < ndecls || !p->openend))
+    {
+      break;
+    }
+    k0--;
+  }
+  u32 first0 = k0 > 0 ? p->declend[k0 - 1] : 0; // index of the first token of the window
+  u32 R0 = first0 > 0 ? b->start[first0 - 1] + 1 : 0; // source offset of the window
+
+  // Scan the new source from R0 until the token streams are in sync again, which is at a
+  // semicolon after the edit that ended a declaration in the old token stream.
+  // Use a private copy of the source so that the line table is unaffected.
+  u32 nerrors = 0;
+  SourceCheckUTF8(src); // once for the whole source, rather than for the copy
+  wsrc = *src;
+  wsrc._mapped = false;
+  wsrc._lineoffsets = NULL;
+  wsrc._linecount = 0;
+  wsrc._linecap = 0;
+  wsrc._lineend = R0;
+  S s;
+  SInit(&s, cc->mem, &wsrc, p->s.flags & ~ParseComments, editErrorHandler, &nerrors);
+  s.inp = buf + R0;
+  s.inp0 = s.inp;
+  s.linestart = s.inp;
+  TokBufInit(&w, NULL); // scratch memory, freed below
+  u32 editend = e.offs + e.newlen;
+  u32 oi = 0;   // index of the old token after the window
+  u32 nold = 0; // number of old declarations in the window
+  u32 depth = 0;
+  bool synced = false;
+  while (1) {
+    Tok t = SNext(&s);
+    u32 start = s.tokstart > buf ? (u32)(s.tokstart - buf) : 0;
+    TokBufPush(&w, t, start, (u32)(s.tokend - s.tokstart), STokVal(&s));
+    if (t == TNone || nerrors > 0) {
+      break;
+    }
+    if (!editDepth(t, &depth)) {
+      goto fallback;
+    }
+    if (t != TSemi || depth > 0 || start < editend || (buf[start] != '\n' && buf[start] != ';')) {
+      continue;
+    }
+    // look for the same semicolon in the old token stream, at the end of a declaration
+    u32 X = (u32)((i64)start - delta);
+    u32 i = editSearch(b->start, first0, b->len - 1, X);
+    if (i == b->len - 1 || b->start[i] != X || b->tok[i] != TokPack(TSemi)) {
+      continue;
+    }
+    u32 k = editSearch(p->declend, k0, ndecls, i + 1);
+    if (k < ndecls && p->declend[k] == i + 1) {
+      oi = i + 1;
+      nold = k + 1 - k0;
+      synced = true;
+      break;
+    }
+  }
+  if (nerrors > 0) {
+    goto fallback; // report errors as usual
+  }
+  u32 oldend; // source offset where the old window ends
+  if (synced) {
+    oldend = b->start[oi - 1] + 1;
+  } else {
+    // the window extends to the end of the source
+    oi = b->len;
+    oldend = (u32)oldlen + 1;
+    nold = ndecls - k0;
+  }
+
+  // The maps below are scratch data, freed at the end of this function, and so use the
+  // global allocator rather than cc->mem, which may be an arena.
+  // Collect names which appear in the window; only their definitions can be affected.
+  const Scope* scope = fscope ? fscope : pkgscope;
+  SymMapInit(&names, 16, NULL);
+  SymMapInit(&defs, 16, NULL);
+  SymMapInit(&kill, 8, NULL);
+  SymMapInit(&hidden, 8, NULL);
+  editAddNames(b, first0, oi, scope, &names, &defs);
+  editAddNames(&w, 0, w.len, scope, &names, &defs);
+  if (fscope) {
+    PEditBindings bctx = { fscope, src, R0, oldend, &defs, &kill, &hidden, true };
+    SymMapIter(&names, editBindingsVisit, &bctx);
+    if (!bctx.ok) {
+      goto fallback;
+    }
+  }
+
+  // Remove definitions made by the old window from the file scope. If such a name is also
+  // mentioned outside of a block before the window, it might have been defined there too.
+  if (kill.len > 0) {
+    u32 bdepth = 0;
+    for (u32 i = 0; i < first0; i++) {
+      Tok t = TokUnpack(b->tok[i]);
+      if (t == TLBrace) {
+        bdepth++;
+      } else if (t == TRBrace) {
+        bdepth--;
+      } else if (t == TIdent && bdepth == 0 && SymMapGet(&kill, b->val[i].name)) {
+        goto fallback;
+      }
+    }
+    SymMapIter(&kill, editDelVisit, fscope);
+  }
+  // Hide definitions made after the window while parsing it
+  SymMapIter(&hidden, editDelVisit, fscope);
+
+  // Replace the old window's tokens with the new ones
+  u32 ntail = b->len - oi;
+  u32 wend = first0 + w.len; // index of the first token after the window
+  if (wend + ntail > b->cap) {
+    _TokBufResize(b, wend + ntail);
+  }
+  memmove(&b->tok[wend],   &b->tok[oi],   sizeof(u8)  * ntail);
+  memmove(&b->start[wend], &b->start[oi], sizeof(u32) * ntail);
+  memmove(&b->tlen[wend],  &b->tlen[oi],  sizeof(u32) * ntail);
+  memmove(&b->val[wend],   &b->val[oi],   sizeof(TokVal) * ntail);
+  memcpy(&b->tok[first0],   w.tok,   sizeof(u8)  * w.len);
+  memcpy(&b->start[first0], w.start, sizeof(u32) * w.len);
+  memcpy(&b->tlen[first0],  w.tlen,  sizeof(u32) * w.len);
+  memcpy(&b->val[first0],   w.val,   sizeof(TokVal) * w.len);
+  b->len = wend + ntail;
+  for (u32 i = wend; i < b->len; i++) {
+    b->start[i] = (u32)((i64)b->start[i] + delta);
+  }
+
+  // Parse the window
+  p->s.src = src;
+  p->s.inp = buf + src->len; // everything has been scanned
+  p->s.inend = p->s.inp;
+  p->fnest = 0;
+  if (fscope) {
+    p->scope = fscope;
+  } else {
+    pushScope(p);
+  }
+  bool openend = p->openend;
+  auto errh = p->s.errh;
+  p->s.errh = NULL; // errors are reported by a full parse instead
+  p->tokidx = first0 - 1; // so that next loads toks[first0]
+  next(p);
+  u32 newstart = pListBegin(p); // new declarations are p->listbuf[newstart:]
+  u32 nnew = 0;
+  u32 newendscap = 0;
+  while (p->s.tok != TNone && p->tokidx < wend) {
+    pListPush(p, pTopLevel(p));
+    if (++nnew > newendscap) {
+      newendscap = max(8u, newendscap * 2);
+      newends = (u32*)memrealloc(NULL, newends, sizeof(u32) * newendscap);
+    }
+    newends[nnew - 1] = p->tokidx;
+  }
+  if (fscope) {
+    p->scope = pkgscope;
+  } else {
+    fscope = popScope(p);
+    file->array.scope = fscope;
+  }
+  p->s.errh = errh;
+  if (p->nerrors > 0 || (synced ? p->tokidx != wend : p->s.tok != TNone)) {
+    goto fallback; // syntax error or declarations did not end at the end of the window
+  }
+  SymMapIter(&hidden, editRestoreVisit, fscope);
+  if (k0 + nold < ndecls) {
+    p->openend = openend; // the last declaration is after the window
+  } else if (nnew == 0) {
+    p->openend = false; // the last declaration is before the window
+  }
+
+  // Pair new declarations with old ones of the same kind and name and update those in place
+  decls = (Node**)memalloc(NULL, sizeof(Node*) * (nold + nnew + 1));
+  Node** olds = decls;
+  Node** news = decls + nold;
+  Node** items = NodeListItems(list);
+  memcpy(olds, &items[k0], sizeof(Node*) * nold);
+  memcpy(news, &p->listbuf[newstart], sizeof(Node*) * nnew);
+  u32 after = k0 + nold; // index in items of the first declaration after the window
+  PtrMapInit(&remap, 8, NULL);
+  for (u32 j = 0; j < nnew; j++) {
+    auto n = news[j];
+    for (u32 i = 0; i < nold && PosInSource(n->pos, src); i++) {
+      auto old = olds[i];
+      if (old && editOldOffs(old, src) != UINT32_MAX && old->kind == n->kind &&
+          editDeclName(old) == editDeclName(n) &&
+          (editDeclName(n) != NULL || (nold == nnew && i == j)))
+      {
+        *old = *n;
+        PtrMapSet(&remap, n, old);
+        news[j] = old;
+        olds[i] = NULL;
+        break;
+      }
+    }
+  }
+  if (remap.len > 0) {
+    PtrMapInit(&seen, 32, NULL);
+    for (u32 i = 0; i < nnew; i++) {
+      editWalk(news[i], &seen, editRedirectVisit, &remap, false);
+    }
+  }
+
+  // Check whether declarations after the window could be affected
+  SymMapInit(&changed, 8, NULL);
+  PEditNames nctx = { fscope, fscope ? fscope : pkgscope, &remap, &changed };
+  SymMapIter(&names, editNamesVisit, &nctx);
+  if (changed.len > 0) {
+    for (u32 i = wend; i < b->len; i++) {
+      if (b->tok[i] == TokPack(TIdent) && SymMapGet(&changed, b->val[i].name)) {
+        goto fallback;
+      }
+    }
+  }
+
+  // Move the declarations after the window. When SourceReplace moved the positions of the
+  // source, the nodes before the window are moved to the new positions as well.
+  bool moved = src->posbase != src->_prevposbase;
+  if (moved || (delta != 0 && after < ndecls)) {
+    if (PtrMapIsInit(&seen)) {
+      PtrMapClear(&seen);
+    } else {
+      PtrMapInit(&seen, 32, NULL);
+    }
+    PEditShift sh = { src, oldend, delta };
+    if (moved) {
+      editShiftVisit(file, &sh);
+      for (u32 k = 0; k < k0; k++) {
+        editWalk(items[k], &seen, editShiftVisit, &sh, false);
+      }
+    }
+    for (u32 k = after; k < ndecls; k++) {
+      editWalk(items[k], &seen, editShiftVisit, &sh, false);
+    }
+  }
+
+  // Replace the declarations of the window with the new ones
+  p->nlistbuf = newstart;
+  for (u32 k = 0; k < k0; k++) {
+    pListPush(p, items[k]);
+  }
+  for (u32 j = 0; j < nnew; j++) {
+    pListPush(p, news[j]);
+  }
+  for (u32 k = after; k < ndecls; k++) {
+    pListPush(p, items[k]);
+  }
+  pListEnd(p, newstart, list);
+  declendReserve(p, list->len);
+  u32 ktail = k0 + nold;
+  memmove(&p->declend[k0 + nnew], &p->declend[ktail], sizeof(u32) * (ndecls - ktail));
+  memcpy(&p->declend[k0], newends, sizeof(u32) * nnew);
+  for (u32 k = k0 + nnew; k < list->len; k++) {
+    p->declend[k] += wend - oi; // (mod 2^32)
+  }
+  p->ndeclend = list->len;
+  if (first0 == 0 && b->tok[0] != TokPack(TNone)) {
+    // the file is positioned at its first token
+    file->pos = PosMake(src, b->start[0]);
+  }
+
+  // leave the parser at the end of input, like Parse
+  p->tokidx = b->len - 1;
+  p->s.tok = TNone;
+  result = file;
+
+fallback:
+  if (result == NULL) {
+    p->scope = pkgscope;
+    TokBufFree(&p->toks);
+    result = Parse(p, cc, p->s.flags, pkgscope);
+  }
+  TokBufFree(&w);
+  if (wsrc._lineoffsets) {
+    memfree(NULL, wsrc._lineoffsets);
+  }
+  if (decls) {
+    memfree(NULL, decls);
+  }
+  if (newends) {
+    memfree(NULL, newends);
+  }
+  SymMap* symmaps[] = { &names, &defs, &kill, &hidden, &changed };
+  for (u32 i = 0; i < countof(symmaps); i++) {
+    if (symmaps[i]->buckets) {
+      SymMapDealloc(symmaps[i]);
+    }
+  }
+  if (PtrMapIsInit(&remap)) {
+    PtrMapDealloc(&remap);
+  }
+  if (PtrMapIsInit(&seen)) {
+    PtrMapDealloc(&seen);
+  }
+  return result;
+}
+
+
+#if W_UNIT_TEST_ENABLED
+
+static void editTestOffsVisit(Node* n, void* userdata) {
+  if (n->pos != NoPos) {
+    auto s = (Str*)userdata;
+    auto src = PosSource(n->pos);
+    assertf(src != NULL, "%s has an invalid position", NodeKindName(n->kind));
+    *s = sdscatfmt(*s, "%s@%u ", NodeKindName(n->kind), PosOffs(n->pos, src));
+  }
+}
+
+// editTestOffs returns the kind and offset of every node of file, in walk order
+static Str editTestOffs(Node* file) {
+  PtrMap seen = {0};
+  PtrMapInit(&seen, 32, NULL);
+  auto s = sdsempty();
+  editWalk(file, &seen, editTestOffsVisit, &s, false);
+  PtrMapDealloc(&seen);
+  return s;
+}
+
+// test_parse_edit1 replaces len bytes at offs of text with ins and checks that ParseEdit
+// produces the same result as parsing the new text from scratch. incremental is 1 if the
+// edit is expected to be applied incrementally, 0 if not and -1 if it doesn't matter.
+// reused is the number of top-level nodes expected to be kept (if incremental.)
+// If move is true, the positions after those of the source are taken, so that
+// SourceReplace moves the positions of the source if it grows.
+static void test_parse_edit1(
+  const char* text1, u32 offs, u32 len, const char* ins, int incremental, u32 reused,
+  bool move)
+{
+  auto text2 = sdscatlen(sdsnewlen(text1, offs), ins, strlen(ins));
+  text2 = sdscat(text2, text1 + offs + len);
+  auto scope1 = ScopeNew(GetGlobalScope(), NULL);
+  auto scope2 = ScopeNew(GetGlobalScope(), NULL);
+  auto name = sdsnew("edit");
+
+  CCtx cc1 = {0};
+  assert(CCtxInit(&cc1, NULL, NULL, name, (const u8*)text1, strlen(text1)));
+  P p1 = {0};
+  auto file1 = Parse(&p1, &cc1, ParseTokBuf, scope1);
+  u32 nold = file1->array.a.len;
+  Node* olds[nold];
+  u32 i = 0;
+  NodeListForEach(&file1->array.a, n, olds[i++] = n);
+
+  Source blocker = {0};
+  if (move) {
+    SourceInit(&blocker, name, NULL, 0);
+    asserteq(blocker.posbase, cc1.src.posbase + cc1.src._possize);
+  }
+  u32 posbase = cc1.src.posbase;
+  asserteq(SourceReplace(&cc1.src, (const u8*)text2, sdslen(text2)), true);
+  asserteq(cc1.src.posbase != posbase, move && strlen(ins) > len);
+  PEdit e = { offs, len, (u32)strlen(ins) };
+  auto file = ParseEdit(&p1, file1, e);
+  if (incremental != -1) {
+    asserteq(file == file1, incremental == 1);
+  }
+
+  CCtx cc2 = {0};
+  assert(CCtxInit(&cc2, NULL, NULL, name, (const u8*)text2, sdslen(text2)));
+  P p2 = {0};
+  auto file2 = Parse(&p2, &cc2, ParseTokBuf, scope2);
+
+  // same AST, with the same source positions
+  auto repr1 = NodeTestRepr(file, sdsempty());
+  auto repr2 = NodeTestRepr(file2, sdsempty());
+  assertf(strcmp(repr1, repr2) == 0, "\n%s\n!=\n%s", repr1, repr2);
+  auto offs1 = editTestOffs(file);
+  auto offs2 = editTestOffs(file2);
+  assertf(strcmp(offs1, offs2) == 0, "\n%s\n!=\n%s", offs1, offs2);
+  asserteq(file->array.scope ? file->array.scope->nbindings : 0,
+           file2->array.scope ? file2->array.scope->nbindings : 0);
+
+  // same tokens
+  asserteq(p1.toks.len, p2.toks.len);
+  assert(memcmp(p1.toks.tok, p2.toks.tok, p1.toks.len) == 0);
+  assert(memcmp(p1.toks.start, p2.toks.start, sizeof(u32) * p1.toks.len) == 0);
+  assert(memcmp(p1.toks.tlen, p2.toks.tlen, sizeof(u32) * p1.toks.len) == 0);
+  assert(memcmp(p1.toks.val, p2.toks.val, sizeof(TokVal) * p1.toks.len) == 0);
+
+  // untouched declarations are kept
+  if (incremental == 1) {
+    u32 nreused = 0;
+    NodeListForEach(&file->array.a, n, {
+      for (u32 i = 0; i < nold; i++) {
+        nreused += n == olds[i];
+      }
+    });
+    asserteq(nreused, reused);
+  }
+
+  sdsfree(repr1);
+  sdsfree(repr2);
+  sdsfree(offs1);
+  sdsfree(offs2);
+  sdsfree(name);
+  CCtxFree(&cc1);
+  CCtxFree(&cc2);
+  if (move) {
+    SourceFree(&blocker);
+  }
+  sdsfree(text2);
+}
+
+static void test_parse_edit(
+  const char* text1, u32 offs, u32 len, const char* ins, int incremental, u32 reused)
+{
+  test_parse_edit1(text1, offs, len, ins, incremental, reused, false);
+  test_parse_edit1(text1, offs, len, ins, incremental, reused, true);
+}
+
+static void test() {
+  const char* text =
+    "fun add(a, b int) int {\n"
+    "  a + b\n"
+    "}\n"
+    "fun main() {\n"
+    "  x = add(1, 2)\n"
+    "}\n"
+    "y = 3\n";
+  u32 body = (u32)(strstr(text, "a + b") - text);
+  u32 fmain = (u32)(strstr(text, "fun main") - text);
+  u32 y = (u32)(strstr(text, "y = 3") - text);
+
+  // edit inside a function body
+  test_parse_edit(text, body, 5, "a * b + 1", 1, 3);
+  // insert a declaration
+  test_parse_edit(text, y, 0, "z = 5\n", 1, 3);
+  test_parse_edit(text, strlen(text), 0, "z = y\n", 1, 3);
+  // delete a declaration
+  test_parse_edit(text, fmain, y - fmain, "", 1, 2);
+  // change the last declaration, which is not followed by a line feed
+  test_parse_edit("x = 1\ny = 2", 11, 0, " + 3", 1, 2);
+  test_parse_edit("x = 1\ny = 2", 10, 1, "42", 1, 2);
+  // rename a function which is used by a later declaration
+  test_parse_edit(text, 4, 3, "sub", 0, 0);
+  // unbalanced brackets make the rest of the source part of the edit
+  test_parse_edit(text, body, 0, "(", -1, 0);
+  test_parse_edit(text, fmain, 0, "}", -1, 0);
+}
+
+W_UNIT_TEST(ParseEdit, { test(); })
+#endif
+
+
 Node* NodeOptIfCond(Node* n) {
   assert(n->kind == NIf);
   if (n->cond.cond == Const_true) {
@@ -994,7 +1875,7 @@ static Node* pVarMulti(P* p, NodeKind nkind, Node* ident0) {
 
   if (got(p, TComma)) {
     auto extra = ptuple(p, PREC_MEMBER);
-    syntaxerrp(p, extra->pos, "assignment mismatch: %u targets but %u values",
+    syntaxerrp(p, PosSrcPos(extra->pos), "assignment mismatch: %u targets but %u values",
       namecount, namecount + extra->array.a.len);
   }
 
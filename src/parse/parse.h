@@ -14,10 +14,41 @@ typedef struct P {
   S      s;          // scanner
   u32    fnest;      // function nesting level (for error handling)
   u32    unresolved; // number of unresolved identifiers
+  u32    nerrors;    // number of syntax errors reported
   Scope* scope;      // current scope
   CCtx*  cc;         // compilation context
+  TokBuf toks;       // pre-lexed tokens (with ParseTokBuf)
+  u32    tokidx;     // index in toks of the current token (with ParseTokBuf)
+  u32*   declend;    // index in toks after each top-level declaration (with ParseTokBuf)
+  u32    ndeclend;   // number of entries in declend
+  u32    declcap;    // capacity of declend
+  bool   openend;    // the last top-level declaration was ended by the end of input
+  Node** listbuf;    // nodes of the lists being parsed (see pListEnd)
+  u32    nlistbuf;   // number of entries in listbuf
+  u32    listbufcap; // capacity of listbuf
 } P;
 Node* Parse(P*, CCtx*, ParseFlags, Scope* pkgscope);
+
+// PEdit describes a change to a source: len bytes at offs were replaced by newlen bytes
+typedef struct PEdit {
+  u32 offs;   // start of the change, in both the old and the new source
+  u32 len;    // number of bytes removed from the old source
+  u32 newlen; // number of bytes inserted in the new source
+} PEdit;
+
+// ParseEdit updates the AST of file, produced by Parse with ParseTokBuf, after the source
+// p->cc->src was modified by edit (see SourceReplace.) Only the top-level declarations
+// overlapping with the edit are scanned and parsed again; all other nodes are kept and their
+// positions are adjusted. The file must not have been processed by ResolveSym or ResolveType.
+// Falls back to parsing the entire source when the edit can not be applied incrementally (for
+// example when there are syntax errors), in which case a new file node is returned.
+// Returns the file node to use from now on.
+// p->unresolved is an upper bound after an incremental parse.
+Node* ParseEdit(P*, Node* file, PEdit);
+
+// PPeek returns the token n tokens ahead of the current one, or TNone past the end.
+// Lookahead is only available when parsing with ParseTokBuf.
+static Tok PPeek(const P*, u32 n);
 Node* NodeOptIfCond(Node* n); // TODO: move this and parser into a parse.h file
 
 // Symbol resolver
@@ -25,3 +56,12 @@ Node* ResolveSym(CCtx*, ParseFlags, Node*, Scope*);
 
 // Type resolver
 void ResolveType(CCtx*, Node*);
+
+// -----------------------------------------------------------------------------------------------
+// inline and internal implementations
+
+inline static Tok PPeek(const P* p, u32 n) {
+  assert(p->s.flags & ParseTokBuf);
+  u32 i = p->tokidx + n;
+  return i < p->toks.len ? TokUnpack(p->toks.tok[i]) : TNone;
+}
@@ -0,0 +1,7 @@
+#pragma once
+#include "../common/defs.h"
+
+// decimaltof64 sets *result to the double closest to mantissa * 10^exp10, rounding to even.
+// Returns false in the rare cases where the result can not be decided cheaply, in which case
+// the decimal number should be converted with strtod instead.
+bool decimaltof64(u64 mantissa, int exp10, double* result);
@@ -1,5 +1,6 @@
 // Resolve identifiers in an AST. Usuaully run right after parsing.
 #include "parse.h"
+#include "ast_walk.h"
 
 
 typedef struct {
@@ -10,12 +11,16 @@ typedef struct {
 } ResCtx;
 
 
-static Node* resolve(Node* n, Scope* scope, ResCtx* ctx);
+static Node* resolve(NodeWalker* w, NodeWalkFrame* f, Node* result);
 
 
 Node* ResolveSym(CCtx* cc, ParseFlags fl, Node* n, Scope* scope) {
   ResCtx ctx = { cc, fl, 0, 0 };
-  return resolve(n, scope, &ctx);
+  NodeWalker w;
+  NodeWalkerInit(&w, &ctx, cc->mem);
+  n = NodeWalk(&w, resolve, n, 0, scope);
+  NodeWalkerFree(&w);
+  return n;
 }
 
 
@@ -97,22 +102,75 @@ static Node* resolveIdent(Node* n, Scope* scope, ResCtx* ctx) {
   }
 }
 
+// resolveLeaf resolves n if it is a node which can be resolved without visiting other nodes,
+// like an identifier or a literal, and returns the result. Returns NULL for other nodes.
+static Node* resolveLeaf(Node* n, Scope* scope, ResCtx* ctx) {
+  if (n->type != NULL && n->type->kind != NBasicType) {
+    return NULL;
+  }
+  switch (n->kind) {
+    case NIdent:
+      return resolveIdent(n, scope, ctx);
+    case NNone:
+    case NBad:
+    case NBasicType:
+    case NFunType:
+    case NTupleType:
+    case NComment:
+    case NNil:
+    case NBoolLit:
+    case NIntLit:
+    case NFloatLit:
+    case NZeroInit:
+      return n;
+    default:
+      return NULL;
+  }
+}
+
+// resolveChild resolves the node at slot, a child of f->n, and stores the result at slot.
+// Leaves are resolved right away. Other nodes are visited with a new frame, in which case
+// NodeWalkPending is returned and the result is passed to the next call of resolve.
+static Node* resolveChild(NodeWalker* w, NodeWalkFrame* f, Node** slot) {
+  auto r = resolveLeaf(*slot, (Scope*)f->ptr, (ResCtx*)w->userdata);
+  if (r == NULL) {
+    return NodeWalkPush(w, slot);
+  }
+  return *slot = r;
+}
+
+// resolveChildNode is like resolveChild but does not store the result
+static Node* resolveChildNode(NodeWalker* w, NodeWalkFrame* f, Node* n) {
+  auto r = resolveLeaf(n, (Scope*)f->ptr, (ResCtx*)w->userdata);
+  if (r == NULL) {
+    return NodeWalkPushNode(w, n);
+  }
+  return r;
+}
+
 //
 // IMPORTANT: symbol resolution is only run when the parser was unable to resolve all names up-
 // front. So, this code should ONLY RESOLVE stuff and apply any required transformations that the
 // parser applies after resolution, like for example "Foo(3) ; Foo = int" which is parsed as a call
 // to "Foo" ("Foo" is unknown) and must be converted to a TypeCast since Foo denotes a type.
 //
-static Node* resolve(Node* n, Scope* scope, ResCtx* ctx) {
-  // dlog("resolve(%s, scope=%p)", NodeKindName(n->kind), scope);
+// resolve is the visit function of a NodeWalker (see ast_walk.h.) f->ptr is the current scope.
+// f->state is 0 when n is entered, 1 once its type has been resolved and then counts the
+// steps of the kind-specific code below. Children are resolved with resolveChild, which
+// either returns the result right away or NodeWalkPending, which resolve returns to the walker.
+//
+static Node* resolve(NodeWalker* w, NodeWalkFrame* f, Node* result) {
+  ResCtx* ctx = (ResCtx*)w->userdata;
+  Node* n = f->n;
+  // dlog("resolve(%s, scope=%p)", NodeKindName(n->kind), f->ptr);
 
-  if (n->type != NULL && n->type->kind != NBasicType) {
+  if (f->state == 0) {
+    f->state = 1;
     if (n->kind == NFun) {
       ctx->funNest++;
     }
-    n->type = resolve((Node*)n->type, scope, ctx);
-    if (n->kind == NFun) {
-      ctx->funNest--;
+    if (n->type != NULL && n->type->kind != NBasicType) {
+      return NodeWalkPush(w, &n->type);
     }
   }
 
@@ -120,85 +178,127 @@ static Node* resolve(Node* n, Scope* scope, ResCtx* ctx) {
 
   // uses u.ref
   case NIdent: {
-    return resolveIdent(n, scope, ctx);
+    return resolveIdent(n, (Scope*)f->ptr, ctx);
   }
 
   // uses u.array
   case NBlock:
   case NTuple:
   case NFile: {
-    if (n->array.scope) {
-      scope = n->array.scope;
+    if (f->state == 1 && n->array.scope) {
+      f->ptr = n->array.scope;
+    }
+    auto items = NodeListItems(&n->array.a);
+    while (f->state <= n->array.a.len) {
+      u32 i = f->state++ - 1;
+      result = resolveChild(w, f, &items[i]);
+      if (result == NodeWalkPending) {
+        return result;
+      }
     }
-    Node* lastn = NULL;
-    NodeListMap(&n->array.a, n,
-      /* n <= */ lastn = resolve(n, scope, ctx)
-    );
     // simplify blocks with a single expression; (block expr) => expr
-    if (n->kind == NBlock && NodeListLen(&n->array.a) == 1) {
-      return lastn;
+    if (n->kind == NBlock && n->array.a.len == 1) {
+      return result;
     }
     break;
   }
 
   // uses u.fun
   case NFun: {
-    ctx->funNest++;
-    if (n->fun.params) {
-      n->fun.params = resolve(n->fun.params, scope, ctx);
-    }
-    if (n->type) {
-      n->type = resolve(n->type, scope, ctx);
-    }
-    auto body = n->fun.body;
-    if (body) {
-      if (n->fun.scope) {
-        scope = n->fun.scope;
-      }
-      n->fun.body = resolve(body, scope, ctx);
+    switch (f->state) {
+      case 1:
+        f->state = 2;
+        if (n->fun.params) {
+          return NodeWalkPush(w, &n->fun.params);
+        }
+        FALLTHROUGH;
+      case 2:
+        f->state = 3;
+        if (n->type && resolveChild(w, f, &n->type) == NodeWalkPending) {
+          return NodeWalkPending;
+        }
+        FALLTHROUGH;
+      case 3:
+        f->state = 4;
+        if (n->fun.body) {
+          if (n->fun.scope) {
+            f->ptr = n->fun.scope;
+          }
+          return NodeWalkPush(w, &n->fun.body);
+        }
+        FALLTHROUGH;
+      default:
+        ctx->funNest--;
     }
-    ctx->funNest--;
     break;
   }
 
   // uses u.op
   case NAssign: {
-    ctx->assignNest++;
-    resolve(n->op.left, scope, ctx);
-    ctx->assignNest--;
-    assert(n->op.right != NULL);
-    n->op.right = resolve(n->op.right, scope, ctx);
+    switch (f->state) {
+      case 1:
+        f->state = 2;
+        ctx->assignNest++;
+        if (resolveChildNode(w, f, n->op.left) == NodeWalkPending) {
+          return NodeWalkPending;
+        }
+        FALLTHROUGH;
+      case 2:
+        f->state = 3;
+        ctx->assignNest--;
+        assert(n->op.right != NULL);
+        if (resolveChild(w, f, &n->op.right) == NodeWalkPending) {
+          return NodeWalkPending;
+        }
+    }
     break;
   }
   case NBinOp:
   case NPostfixOp:
   case NPrefixOp:
   case NReturn: {
-    auto newleft = resolve(n->op.left, scope, ctx);
-    if (n->op.left->kind != NIdent) {
-      // note: in case of assignment where the left side is an identifier,
-      // avoid replacing the identifier with its value.
-      // This branch is taken in all other cases.
-      n->op.left = newleft;
-    }
-    if (n->op.right) {
-      n->op.right = resolve(n->op.right, scope, ctx);
+    switch (f->state) {
+      case 1:
+        f->state = 2;
+        result = resolveChildNode(w, f, n->op.left);
+        if (result == NodeWalkPending) {
+          return result;
+        }
+        FALLTHROUGH;
+      case 2:
+        f->state = 3;
+        if (n->op.left->kind != NIdent) {
+          // note: in case of assignment where the left side is an identifier,
+          // avoid replacing the identifier with its value.
+          // This branch is taken in all other cases.
+          n->op.left = result;
+        }
+        if (n->op.right && resolveChild(w, f, &n->op.right) == NodeWalkPending) {
+          return NodeWalkPending;
+        }
     }
     break;
   }
 
   // uses u.call
   case NTypeCast:
-    n->call.args = resolve(n->call.args, scope, ctx);
-    n->call.receiver = resolve(n->call.receiver, scope, ctx);
-    break;
-
   case NCall:
-    n->call.args = resolve(n->call.args, scope, ctx);
-    auto recv = resolve(n->call.receiver, scope, ctx);
-    n->call.receiver = recv;
-    if (recv->kind != NFun) {
+    switch (f->state) {
+      case 1:
+        f->state = 2;
+        if (resolveChild(w, f, &n->call.args) == NodeWalkPending) {
+          return NodeWalkPending;
+        }
+        FALLTHROUGH;
+      case 2:
+        f->state = 3;
+        if (resolveChild(w, f, &n->call.receiver) == NodeWalkPending) {
+          return NodeWalkPending;
+        }
+    }
+    if (n->kind == NCall && n->call.receiver->kind != NFun) {
       // convert to type cast, if receiver is a type. e.g. "x = uint8(4)"
+      auto recv = n->call.receiver;
       if (recv->kind == NBasicType) {
         n->kind = NTypeCast;
       } else {
@@ -211,16 +311,30 @@ static Node* resolve(Node* n, Scope* scope, ResCtx* ctx) {
   case NLet:
   case NArg:
   case NField: {
-    if (n->field.init) {
-      n->field.init = resolve(n->field.init, scope, ctx);
+    if (f->state == 1 && n->field.init) {
+      f->state = 2;
+      if (resolveChild(w, f, &n->field.init) == NodeWalkPending) {
+        return NodeWalkPending;
+      }
     }
     break;
   }
 
   // uses u.cond
   case NIf:
-    n->cond.cond = resolve(n->cond.cond, scope, ctx);
-    n->cond.thenb = resolve(n->cond.thenb, scope, ctx);
+    switch (f->state) {
+      case 1:
+        f->state = 2;
+        if (resolveChild(w, f, &n->cond.cond) == NodeWalkPending) {
+          return NodeWalkPending;
+        }
+        FALLTHROUGH;
+      case 2:
+        f->state = 3;
+        if (resolveChild(w, f, &n->cond.thenb) == NodeWalkPending) {
+          return NodeWalkPending;
+        }
+    }
     if (ctx->flags & ParseOpt) {
       n = NodeOptIfCond(n);
     }
@@ -244,4 +358,3 @@ static Node* resolve(Node* n, Scope* scope, ResCtx* ctx) {
 
   return n;
 }
-
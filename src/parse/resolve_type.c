@@ -1,7 +1,9 @@
 // Resolve types in an AST. Usuaully run after Parse() and ResolveSym()
 #include "parse.h"
+#include "ast_walk.h"
 #include "../typeid.h"
 #include "../convlit.h"
+#include "../common/test.h"
 
 // #define DEBUG_MODULE "typeres"
 
@@ -26,7 +28,8 @@ typedef struct {
 } ResCtx;
 
 
-static Node* resolveType(ResCtx* ctx, Node* n, RFlag fl);
+static Node* resolveType(NodeWalker* w, NodeWalkFrame* f, Node* result);
+static Node* resolveIdealType(ResCtx* ctx, Node* n, Node* reqtype, RFlag fl);
 
 void ResolveType(CCtx* cc, Node* n) {
   ResCtx ctx = { cc, {0}, {0}, false };
@@ -34,9 +37,12 @@ void ResolveType(CCtx* cc, Node* n) {
     &ctx.reqestedTypeStack,
     ctx.reqestedTypeStackStorage,
     countof(ctx.reqestedTypeStackStorage));
+  NodeWalker w;
+  NodeWalkerInit(&w, &ctx, cc->mem);
 
-  n->type = resolveType(&ctx, n, RFlagNone);
+  n->type = NodeWalk(&w, resolveType, n, RFlagNone, NULL);
 
+  NodeWalkerFree(&w);
   ArrayFree(&ctx.reqestedTypeStack, cc->mem);
 }
 
@@ -62,31 +68,115 @@ inline static void requestedTypePop(ResCtx* ctx) {
 }
 
 
-static Node* resolveFunType(ResCtx* ctx, Node* n, RFlag fl) {
-  Node* ft = NewNode(ctx->cc->mem, NFunType);
-  auto result = n->type;
-
-  // Important: To avoid an infinite loop when resolving a function which calls itself,
-  // we set the unfinished function type objects ahead of calling resolve.
-  n->type = ft;
-
-  if (n->fun.params) {
-    resolveType(ctx, n->fun.params, fl);
-    ft->t.fun.params = (Node*)n->fun.params->type;
+// resolveKnownType returns the type of n if it is known without visiting n, or NULL.
+// This is the case for types, functions whose type has been resolved and nodes with a type.
+static Node* resolveKnownType(ResCtx* ctx, Node* n, RFlag fl) {
+  if (NodeKindIsType(n->kind)) {
+    dlog_mod("  => %s", fmtnode(n));
+    return n;
   }
+  if (n->kind == NFun) {
+    // type already resolved
+    if (n->type && n->type->kind == NFunType) {
+      dlog_mod("  => %s", fmtnode(n->type));
+      return n->type;
+    }
+  } else if (n->type != NULL) {
+    // Has type already. Constant literals might have ideal type.
+    if (n->type == Type_ideal) {
+      if (fl & RFlagResolveIdeal) {
+        auto reqtype = requestedType(ctx);
+        return resolveIdealType(ctx, n, reqtype, fl);
+      }
+      // else: leave as ideal, for now
+    }
+    dlog_mod("  => %s", fmtnode(n->type));
+    return n->type;
+  }
+  return NULL;
+}
 
-  if (result) {
-    ft->t.fun.result = (Node*)resolveType(ctx, result, fl);
+// resolveChildType resolves the type of n, on behalf of f->n, with the flags f->fl.
+// Known types (see resolveKnownType) and types of identifiers of nodes with known types are
+// returned right away. Otherwise n is visited with a new frame and NodeWalkPending is
+// returned, in which case the type is passed to the next call of resolveType.
+static Node* resolveChildType(NodeWalker* w, NodeWalkFrame* f, Node* n) {
+  ResCtx* ctx = (ResCtx*)w->userdata;
+  auto t = resolveKnownType(ctx, n, f->fl);
+  if (t != NULL) {
+    return t;
+  }
+  if (n->kind == NIdent) {
+    if (n->ref.target == NULL) {
+      // identifier failed to resolve
+      return n->type = Type_nil;
+    }
+    t = resolveKnownType(ctx, n->ref.target, f->fl);
+    if (t != NULL) {
+      return n->type = t;
+    }
   }
+  return NodeWalkPushNode(w, n);
+}
+
+
+// resolveFunType is the part of resolveType for NFun. It returns the function type, or
+// NodeWalkPending while resolving the parameters, result type and body of the function.
+// f->tmp holds the result type of the function, as parsed.
+static Node* resolveFunType(NodeWalker* w, NodeWalkFrame* f, Node* result) {
+  ResCtx* ctx = (ResCtx*)w->userdata;
+  Node* n = f->n;
+  Node* ft = n->type;
+
+  switch (f->state) {
+  case 1:
+    ft = NewNode(ctx->cc->mem, NFunType);
+    f->tmp = n->type;
+
+    // Important: To avoid an infinite loop when resolving a function which calls itself,
+    // we set the unfinished function type objects ahead of calling resolve.
+    n->type = ft;
 
-  if (n->fun.body) {
-    auto bodyType = resolveType(ctx, n->fun.body, fl);
+    f->state = 2;
+    if (n->fun.params && resolveChildType(w, f, n->fun.params) == NodeWalkPending) {
+      return NodeWalkPending;
+    }
+    FALLTHROUGH;
+  case 2:
+    if (n->fun.params) {
+      ft->t.fun.params = (Node*)n->fun.params->type;
+    }
+    f->state = 3;
+    if (f->tmp) {
+      result = resolveChildType(w, f, f->tmp);
+      if (result == NodeWalkPending) {
+        return result;
+      }
+    }
+    FALLTHROUGH;
+  case 3:
+    if (f->tmp) {
+      ft->t.fun.result = result;
+    }
+    f->state = 4;
+    if (n->fun.body == NULL) {
+      break;
+    }
+    result = resolveChildType(w, f, n->fun.body);
+    if (result == NodeWalkPending) {
+      return result;
+    }
+    FALLTHROUGH;
+  case 4: {
+    auto bodyType = result;
     if (ft->t.fun.result == NULL) {
       ft->t.fun.result = bodyType;
     } else if (!TypeEquals(ft->t.fun.result, bodyType)) {
       CCtxErrorf(ctx->cc, n->fun.body->pos, "cannot use type %s as return type %s",
         fmtnode(bodyType), fmtnode(ft->t.fun.result));
     }
+    break;
+  }
   }
 
   n->type = ft;
@@ -108,31 +198,35 @@ static Node* resolveIdealType(
   assert(reqtype == NULL || reqtype->kind == NBasicType);
   dlog_mod("resolveIdealType node %s to reqtype %s", fmtnode(n), fmtnode(reqtype));
 
+  // Let bindings and identifiers get the type of the constant they refer to. Find it.
+  Node* c = n;
+  while (c->kind == NLet || c->kind == NIdent) {
+    if (c->kind == NLet) {
+      assert(c->field.init != NULL);
+      c = c->field.init;
+    } else {
+      assert(c->ref.target != NULL);
+      c = c->ref.target;
+    }
+  }
+
   // It's really only constant literals which are actually of ideal type, so switch on those
   // and lower CType to concrete type.
   // In case n is not a constant literal, we simply continue as the AST at n is a compound
   // which contains one or more untyped constants. I.e. continue to traverse AST.
-  switch (n->kind) {
+  switch (c->kind) {
     case NIntLit:
     case NFloatLit:
       if (reqtype == NULL) {
-        n->type = IdealType(n->val.ct);
+        c->type = IdealType(c->val.ct);
       } else {
-        auto n2 = convlit(ctx->cc, n, reqtype, /*explicit*/(fl & RFlagExplicitTypeCast));
-        if (n2 != n) {
-          memcpy(n, n2, sizeof(Node));
+        auto c2 = convlit(ctx->cc, c, reqtype, /*explicit*/(fl & RFlagExplicitTypeCast));
+        if (c2 != c) {
+          memcpy(c, c2, sizeof(Node));
         }
       }
       break;
 
-    case NLet:
-      assert(n->field.init != NULL);
-      return n->type = resolveIdealType(ctx, n->field.init, reqtype, fl);
-
-    case NIdent:
-      assert(n->ref.target != NULL);
-      return n->type = resolveIdealType(ctx, n->ref.target, reqtype, fl);
-
     case NBoolLit:
       // always typed; should never be ideal
       assertf(0, "NBoolLit with ideal type");
@@ -141,129 +235,163 @@ static Node* resolveIdealType(
     default:
       // IMPORTANT: This relies on resolveType to only call resolveIdealType for constants.
       // If this is not the case, this would create an infinite loop in some cases.
-      assertf(0, "unexpected node type %s", NodeKindName(n->kind));
+      assertf(0, "unexpected node type %s", NodeKindName(c->kind));
       break;
   }
-  return n->type;
-}
 
-
-static Node* resolveType(ResCtx* ctx, Node* n, RFlag fl) {
-  assert(n != NULL);
-
-  dlog_mod("resolveType %s %p (%s class) type %s",
-    NodeKindName(n->kind),
-    n,
-    NodeClassName(NodeClassTable[n->kind]),
-    fmtnode(n->type));
-
-  if (NodeKindIsType(n->kind)) {
-    dlog_mod("  => %s", fmtnode(n));
-    return n;
+  for (; n != c; n = n->kind == NLet ? n->field.init : n->ref.target) {
+    n->type = c->type;
   }
+  return c->type;
+}
 
-  if (n->kind == NFun) {
-    // type already resolved
-    if (n->type && n->type->kind == NFunType) {
-      dlog_mod("  => %s", fmtnode(n->type));
-      return n->type;
+
+// resolveType is the visit function of a NodeWalker (see ast_walk.h) and returns the type of
+// f->n. f->fl holds the RFlag flags. f->state is 0 when n is entered and then counts the steps
+// of the kind-specific code below, which resolves the types of other nodes by visiting them.
+static Node* resolveType(NodeWalker* w, NodeWalkFrame* f, Node* result) {
+  ResCtx* ctx = (ResCtx*)w->userdata;
+  Node* n = f->n;
+  RFlag fl = f->fl;
+
+  if (f->state == 0) {
+    f->state = 1;
+    dlog_mod("resolveType %s %p (%s class) type %s",
+      NodeKindName(n->kind),
+      n,
+      NodeClassName(NodeClassTable[n->kind]),
+      fmtnode(n->type));
+
+    auto t = resolveKnownType(ctx, n, fl);
+    if (t != NULL) {
+      return t;
     }
-  } else if (n->type != NULL) {
-    // Has type already. Constant literals might have ideal type.
-    if (n->type == Type_ideal) {
-      if (fl & RFlagResolveIdeal) {
-        auto reqtype = requestedType(ctx);
-        return resolveIdealType(ctx, n, reqtype, fl);
-      }
-      // else: leave as ideal, for now
+    if (n->kind != NFun) {
+      // Set type to nil here to break any self-referencing cycles.
+      // NFun is special-cased as it stores result type in n->type. Note that resolveFunType
+      // handles breaking of cycles.
+      // A nice side effect of this is that for error cases and nodes without types, the
+      // type "defaults" to nil and we can avoid setting Type_nil in the switch below.
+      n->type = Type_nil;
     }
-    dlog_mod("  => %s", fmtnode(n->type));
-    return n->type;
-  } else {
-    // Set type to nil here to break any self-referencing cycles.
-    // NFun is special-cased as it stores result type in n->type. Note that resolveFunType
-    // handles breaking of cycles.
-    // A nice side effect of this is that for error cases and nodes without types, the
-    // type "defaults" to nil and we can avoid setting Type_nil in the switch below.
-    n->type = Type_nil;
   }
 
   // branch on node kind
   switch (n->kind) {
 
   // uses u.array
-  case NFile:
-    n->type = Type_nil;
-    NodeListForEach(&n->array.a, n,
-      resolveType(ctx, n, fl)
-    );
+  case NFile: {
+    if (f->state == 1) {
+      n->type = Type_nil;
+    }
+    auto items = NodeListItems(&n->array.a);
+    while (f->state <= n->array.a.len) {
+      u32 i = f->state++ - 1;
+      if (resolveChildType(w, f, items[i]) == NodeWalkPending) {
+        return NodeWalkPending;
+      }
+    }
     break;
+  }
 
   case NBlock: {
     // type of a block is the type of the last expression.
-    auto e = n->array.a.head;
-    while (e != NULL) {
-      if (e->next == NULL) {
-        // Last node, in which case we set the flag to resolve literals
-        // so that implicit return values gets properly typed.
-        // This also becomes the type of the block.
-        n->type = resolveType(ctx, e->node, fl | RFlagResolveIdeal);
+    auto items = NodeListItems(&n->array.a);
+    u32 len = n->array.a.len;
+    while (1) {
+      u32 i = f->state - 1; // index of the next item; result is the type of item i-1
+      if (i == len) {
+        if (len > 0) {
+          n->type = result;
+        }
+        // Note: No need to set n->type=Type_nil since that is done already (when n was entered.)
         break;
-      } else {
-        auto t = resolveType(ctx, e->node, fl);
-        if (t == Type_ideal && NodeIsConst(e->node)) {
+      }
+      if (i > 0) {
+        auto e = items[i - 1];
+        if (result == Type_ideal && NodeIsConst(e)) {
           // a lone, unused constant expression, e.g.
           //   { 1  # <- warning: unused expression 1
           //     2
           //   }
           // Resolve its type so that the IR builder doesn't get cranky.
           auto reqtype = requestedType(ctx);
-          resolveIdealType(ctx, e->node, reqtype, fl);
-          CCtxErrorf(ctx->cc, e->node->pos, "warning: unused expression %s", fmtnode(e->node));
+          resolveIdealType(ctx, e, reqtype, fl);
+          CCtxErrorf(ctx->cc, e->pos, "warning: unused expression %s", fmtnode(e));
         }
-        e = e->next;
+      }
+      if (i == len - 1) {
+        // Last node, in which case we set the flag to resolve literals
+        // so that implicit return values gets properly typed.
+        // This also becomes the type of the block.
+        f->fl = fl | RFlagResolveIdeal;
+      }
+      f->state++;
+      result = resolveChildType(w, f, items[i]);
+      if (result == NodeWalkPending) {
+        return result;
       }
     }
-    // Note: No need to set n->type=Type_nil since that is done already (before the switch.)
     break;
   }
 
   case NTuple: {
-    Node* tt = NewNode(ctx->cc->mem, NTupleType);
-    NodeListForEach(&n->array.a, n, {
-      auto t = resolveType(ctx, n, fl);
-      if (!t) {
-        t = (Node*)NodeBad;
-        CCtxErrorf(ctx->cc, n->pos, "unknown type");
+    auto items = NodeListItems(&n->array.a);
+    if (f->state == 1) {
+      f->tmp = NewNode(ctx->cc->mem, NTupleType);
+    }
+    while (1) {
+      u32 i = f->state - 1; // index of the next item; result is the type of item i-1
+      if (i > 0) {
+        auto t = result;
+        if (!t) {
+          t = (Node*)NodeBad;
+          CCtxErrorf(ctx->cc, items[i - 1]->pos, "unknown type");
+        }
+        NodeListAppend(ctx->cc->mem, &f->tmp->t.tuple, t);
       }
-      NodeListAppend(ctx->cc->mem, &tt->t.tuple, t);
-    });
-    n->type = tt;
+      if (i == n->array.a.len) {
+        break;
+      }
+      f->state++;
+      result = resolveChildType(w, f, items[i]);
+      if (result == NodeWalkPending) {
+        return result;
+      }
+    }
+    n->type = f->tmp;
     break;
   }
 
   // uses u.fun
-  case NFun:
-    n->type = resolveFunType(ctx, n, fl);
+  case NFun: {
+    auto t = resolveFunType(w, f, result);
+    if (t == NodeWalkPending) {
+      return t;
+    }
+    n->type = t;
     break;
+  }
 
   // uses u.op
   case NPostfixOp:
-  case NPrefixOp: {
-    n->type = resolveType(ctx, n->op.left, fl);
-    break;
-  }
+  case NPrefixOp:
   case NReturn: {
-    n->type = resolveType(ctx, n->op.left, fl | RFlagResolveIdeal);
+    if (f->state == 1) {
+      f->state = 2;
+      if (n->kind == NReturn) {
+        f->fl = fl | RFlagResolveIdeal;
+      }
+      result = resolveChildType(w, f, n->op.left);
+      if (result == NodeWalkPending) {
+        return result;
+      }
+    }
+    n->type = result;
     break;
   }
   case NBinOp:
   case NAssign: {
-    assert(n->op.right != NULL);
-
-    Node* lt = NULL;
-    Node* rt = NULL;
-
     // This is a bit of a mess, but what's going on here is making sure that untyped
     // operands are requested to become the type of typed operands.
     // For example:
@@ -283,11 +411,27 @@ static Node* resolveType(ResCtx* ctx, Node* n, RFlag fl) {
     // resolve the operand with a concrete type, then set that type as the requested type and
     // finally we resolve the other, untyped, operand in the context of the requested type.
     //
-    auto fl1 = fl; // save fl
-    fl &= ~RFlagResolveIdeal; // clear "resolve ideal" flag
-    lt = resolveType(ctx, n->op.left, fl);
-    rt = resolveType(ctx, n->op.right, fl);
-    fl = fl1; // restore fl
+    switch (f->state) {
+      case 1:
+        assert(n->op.right != NULL);
+        f->state = 2;
+        f->fl = fl & ~RFlagResolveIdeal; // clear "resolve ideal" flag for the operands
+        result = resolveChildType(w, f, n->op.left);
+        if (result == NodeWalkPending) {
+          return result;
+        }
+        FALLTHROUGH;
+      case 2:
+        f->state = 3;
+        f->tmp = result; // type of left operand
+        result = resolveChildType(w, f, n->op.right);
+        if (result == NodeWalkPending) {
+          return result;
+        }
+    }
+    // Note: fl may lack RFlagResolveIdeal here, which resolveIdealType does not use.
+    Node* lt = f->tmp;
+    Node* rt = result;
     //
     // convert operand types as needed. The following code tests all branches:
     //
@@ -330,39 +474,71 @@ static Node* resolveType(ResCtx* ctx, Node* n, RFlag fl) {
 
 
   case NTypeCast: {
-    assert(n->call.receiver != NULL);
-    if (!NodeKindIsType(n->call.receiver->kind)) {
-      CCtxErrorf(ctx->cc, n->pos, "invalid conversion to non-type %s", fmtnode(n->call.receiver));
-      break;
-    }
-
-    fl |= RFlagExplicitTypeCast;
-
-    n->type = resolveType(ctx, n->call.receiver, fl);
-    requestedTypePush(ctx, n->type);
-
-    auto argstype = resolveType(ctx, n->call.args, fl);
-    if (argstype != NULL && TypeEquals(argstype, n->type)) {
-      // eliminate type cast since source is already target type
-      memcpy(n, n->call.args, sizeof(Node));
-    } else {
-      // attempt conversion to eliminate type cast
-      n->call.args = ConvlitExplicit(ctx->cc, n->call.args, n->call.receiver);
-      if (TypeEquals(n->call.args->type, n->type)) {
-        memcpy(n, n->call.args, sizeof(Node));
+    switch (f->state) {
+      case 1:
+        assert(n->call.receiver != NULL);
+        if (!NodeKindIsType(n->call.receiver->kind)) {
+          CCtxErrorf(ctx->cc, n->pos, "invalid conversion to non-type %s",
+            fmtnode(n->call.receiver));
+          break;
+        }
+        f->state = 2;
+        f->fl = fl | RFlagExplicitTypeCast;
+        result = resolveChildType(w, f, n->call.receiver);
+        if (result == NodeWalkPending) {
+          return result;
+        }
+        FALLTHROUGH;
+      case 2:
+        f->state = 3;
+        n->type = result;
+        requestedTypePush(ctx, n->type);
+        result = resolveChildType(w, f, n->call.args);
+        if (result == NodeWalkPending) {
+          return result;
+        }
+        FALLTHROUGH;
+      case 3: {
+        auto argstype = result;
+        if (argstype != NULL && TypeEquals(argstype, n->type)) {
+          // eliminate type cast since source is already target type
+          memcpy(n, n->call.args, sizeof(Node));
+        } else {
+          // attempt conversion to eliminate type cast
+          n->call.args = ConvlitExplicit(ctx->cc, n->call.args, n->call.receiver);
+          if (TypeEquals(n->call.args->type, n->type)) {
+            memcpy(n, n->call.args, sizeof(Node));
+          }
+        }
+        requestedTypePop(ctx);
+        break;
       }
     }
-
-    requestedTypePop(ctx);
     break;
   }
 
 
   case NCall: {
-    auto argstype = resolveType(ctx, n->call.args, fl);
-    // Note: resolveFunType breaks handles cycles where a function calls itself,
-    // making this safe (i.e. will not cause an infinite loop.)
-    auto recvt = resolveType(ctx, n->call.receiver, fl);
+    switch (f->state) {
+      case 1:
+        f->state = 2;
+        result = resolveChildType(w, f, n->call.args);
+        if (result == NodeWalkPending) {
+          return result;
+        }
+        FALLTHROUGH;
+      case 2:
+        // Note: resolveFunType breaks handles cycles where a function calls itself,
+        // making this safe (i.e. will not cause an infinite loop.)
+        f->state = 3;
+        f->tmp = result; // type of arguments
+        result = resolveChildType(w, f, n->call.receiver);
+        if (result == NodeWalkPending) {
+          return result;
+        }
+    }
+    auto argstype = f->tmp;
+    auto recvt = result;
     assert(recvt != NULL);
     if (recvt->kind != NFunType) {
       CCtxErrorf(ctx->cc, n->pos, "cannot call %s", fmtnode(n->call.receiver));
@@ -383,47 +559,87 @@ static Node* resolveType(ResCtx* ctx, Node* n, RFlag fl) {
   case NLet:
   case NArg:
   case NField: {
-    if (n->field.init) {
-      n->type = resolveType(ctx, n->field.init, fl);
-    } else {
-      n->type = Type_nil;
+    if (f->state == 1) {
+      f->state = 2;
+      if (n->field.init == NULL) {
+        n->type = Type_nil;
+        break;
+      }
+      result = resolveChildType(w, f, n->field.init);
+      if (result == NodeWalkPending) {
+        return result;
+      }
     }
+    n->type = result;
     break;
   }
 
   // uses u.cond
   case NIf: {
-    auto cond = n->cond.cond;
-    auto condt = resolveType(ctx, cond, fl);
-    if (condt != Type_bool) {
-      CCtxErrorf(ctx->cc, cond->pos, "non-bool %s (type %s) used as condition",
-        fmtnode(cond), fmtnode(condt));
-    }
-    auto thent = resolveType(ctx, n->cond.thenb, fl);
-    if (n->cond.elseb) {
-      requestedTypePush(ctx, thent);
-      auto elset = resolveType(ctx, n->cond.elseb, fl);
-      requestedTypePop(ctx);
-      // branches must be of the same type
-      if (!TypeEquals(thent, elset)) {
-        // attempt implicit cast. E.g.
-        //
-        // x = 3 as int16 ; y = if true x else 0
-        //                              ^      ^
-        //                            int16   int
-        //
-        n->cond.elseb = ConvlitImplicit(ctx->cc, n->cond.elseb, thent);
-        if (!TypeEquals(thent, n->cond.elseb->type)) {
-          CCtxErrorf(ctx->cc, n->pos, "if..else branches of mixed incompatible types %s %s",
-            fmtnode(thent), fmtnode(elset));
+    switch (f->state) {
+      case 1:
+        f->state = 2;
+        result = resolveChildType(w, f, n->cond.cond);
+        if (result == NodeWalkPending) {
+          return result;
+        }
+        FALLTHROUGH;
+      case 2: {
+        auto cond = n->cond.cond;
+        auto condt = result;
+        if (condt != Type_bool) {
+          CCtxErrorf(ctx->cc, cond->pos, "non-bool %s (type %s) used as condition",
+            fmtnode(cond), fmtnode(condt));
         }
+        f->state = 3;
+        result = resolveChildType(w, f, n->cond.thenb);
+        if (result == NodeWalkPending) {
+          return result;
+        }
+        FALLTHROUGH;
+      }
+      case 3:
+        f->tmp = result; // type of "then" branch
+        if (n->cond.elseb == NULL) {
+          break;
+        }
+        f->state = 4;
+        requestedTypePush(ctx, result);
+        result = resolveChildType(w, f, n->cond.elseb);
+        if (result == NodeWalkPending) {
+          return result;
+        }
+        FALLTHROUGH;
+      case 4: {
+        requestedTypePop(ctx);
+        auto thent = f->tmp;
+        auto elset = result;
+        // branches must be of the same type
+        if (!TypeEquals(thent, elset)) {
+          // attempt implicit cast. E.g.
+          //
+          // x = 3 as int16 ; y = if true x else 0
+          //                              ^      ^
+          //                            int16   int
+          //
+          n->cond.elseb = ConvlitImplicit(ctx->cc, n->cond.elseb, thent);
+          if (!TypeEquals(thent, n->cond.elseb->type)) {
+            CCtxErrorf(ctx->cc, n->pos, "if..else branches of mixed incompatible types %s %s",
+              fmtnode(thent), fmtnode(elset));
+          }
+        }
+        break;
       }
     }
-    n->type = thent;
+    n->type = f->tmp;
     break;
   }
 
   case NIdent: {
+    if (f->state == 2) {
+      n->type = result;
+      break;
+    }
     auto target = n->ref.target;
     if (target == NULL) {
       // identifier failed to resolve
@@ -448,7 +664,12 @@ static Node* resolveType(ResCtx* ctx, Node* n, RFlag fl) {
     //   break;
     // }
 
-    n->type = resolveType(ctx, target, fl);
+    f->state = 2;
+    result = resolveChildType(w, f, target);
+    if (result == NodeWalkPending) {
+      return result;
+    }
+    n->type = result;
     break;
   }
 
@@ -489,3 +710,55 @@ static Node* resolveType(ResCtx* ctx, Node* n, RFlag fl) {
   return n->type;
 }
 
+
+
+// -----------------------------------------------------------------------------------------------
+// unit test
+
+#if W_UNIT_TEST_ENABLED
+
+// test_resolve_deep resolves a tree too deep to be resolved recursively with a typical C stack
+// size: (BinOp (Ident x) (BinOp (Ident x) ... (Ident x))) where x is an int constant.
+static void test_resolve_deep() {
+  CCtx cc = {0};
+  auto name = sdsnew("deep");
+  assert(CCtxInit(&cc, NULL, NULL, name, (const u8*)"", 0));
+  sdsfree(name);
+  auto scope = ScopeNew(GetGlobalScope(), cc.mem);
+  auto x = symgeth((const u8*)"x", 1);
+  auto let = NewNode(cc.mem, NLet);
+  let->type = Type_int;
+  let->field.name = x;
+  let->field.init = NewNode(cc.mem, NIntLit);
+  let->field.init->type = Type_int;
+  let->field.init->val.i = 1;
+  ScopeAssoc(scope, x, let);
+
+  const u32 depth = 200000;
+  Node* n = NewNode(cc.mem, NIdent);
+  n->ref.name = x;
+  for (u32 i = 0; i < depth; i++) {
+    auto op = NewNode(cc.mem, NBinOp);
+    op->op.op = TPlus;
+    op->op.left = NewNode(cc.mem, NIdent);
+    op->op.left->ref.name = x;
+    op->op.right = n;
+    n = op;
+  }
+
+  asserteq(ResolveSym(&cc, ParseFlagsDefault, n, scope), n);
+  ResolveType(&cc, n);
+  asserteq(n->type, Type_int);
+  for (u32 i = 0; i < depth; i++) {
+    asserteq(n->op.left->ref.target, let);
+    asserteq(n->type, Type_int);
+    n = n->op.right;
+  }
+  // the identifier on the right was replaced with the value of the constant x
+  asserteq(n, let->field.init);
+
+  CCtxFree(&cc);
+}
+
+W_UNIT_TEST(ResolveDeep, { test_resolve_deep(); })
+#endif
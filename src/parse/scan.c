@@ -1,6 +1,12 @@
 #include "scan.h"
 #include "../common/unicode.h"
+#include "../common/hash.h"
+#include "../common/test.h"
+#include "../common/simd.h"
+#include "../common/os.h"
 #include "token.h"
+#include "parsefloat.h"
+#include <stdlib.h>
 
 // Enable to print "D >> TOKEN VALUE at SOURCELOC" on each call to SNext
 // #define SCANNER_DEBUG_TOKEN_PRODUCTION
@@ -58,6 +64,100 @@ static u8 charflags[256] = {
 };
 
 
+// SIMD byte classification.
+// Most of the time spent in the scanner goes to runs of whitespace, identifier bytes and
+// comment text. The s*end functions below find the end of such a run, classifying 16 (SSE2)
+// or 32 (AVX2) bytes at a time and falling back to a charflags loop for the remaining tail.
+// Vector loads never extend past s->inend, so the input does not need any padding.
+#ifdef SIMD_WIDTH
+
+// Must match CH_IDENT of charflags; verified by the Scan unit test.
+inline static u32 svidentmask(svec v) {
+  svec m = svinrange(v, '0', '9');
+  m = svor(m, svinrange(svor(v, svset1(0x20)), 'a', 'z')); // A-Z a-z
+  m = svor(m, svinrange(v, '-', '.'));
+  m = svor(m, sveq(v, svset1('+')));
+  m = svor(m, sveq(v, svset1('_')));
+  return svmask(m);
+}
+
+// CH_WHITESPACE except for '\n' which the caller handles.
+inline static u32 svspacemask(svec v) {
+  svec m = sveq(v, svset1(' '));
+  m = svor(m, sveq(v, svset1('\t')));
+  m = svor(m, sveq(v, svset1('\r')));
+  return svmask(m);
+}
+
+#endif /* SIMD_WIDTH */
+
+
+// sidentend returns a pointer to the first byte at or after p which is not CH_IDENT
+inline static const u8* sidentend(const S* s, const u8* p) {
+  #ifdef SIMD_WIDTH
+  if (!(s->flags & ParseScalar)) {
+    while (s->inend - p >= SIMD_WIDTH) {
+      u32 stop = ~svidentmask(svload(p)) & SIMD_MASK_ALL;
+      if (stop) {
+        return p + __builtin_ctz(stop);
+      }
+      p += SIMD_WIDTH;
+    }
+  }
+  #endif
+  while (p < s->inend && charflags[*p] & CH_IDENT) {
+    p++;
+  }
+  return p;
+}
+
+
+// sspaceend returns a pointer to the first byte at or after p which is either a line feed
+// or not CH_WHITESPACE.
+inline static const u8* sspaceend(const S* s, const u8* p) {
+  #ifdef SIMD_WIDTH
+  // Most whitespace runs are a single space; skip the vector setup for those.
+  if (p < s->inend && (*p == ' ' || *p == '\t' || *p == '\r')) {
+    p++;
+    if (!(s->flags & ParseScalar)) {
+      while (s->inend - p >= SIMD_WIDTH) {
+        u32 stop = ~svspacemask(svload(p)) & SIMD_MASK_ALL;
+        if (stop) {
+          return p + __builtin_ctz(stop);
+        }
+        p += SIMD_WIDTH;
+      }
+    }
+  }
+  #endif
+  while (p < s->inend && *p != '\n' && charflags[*p] & CH_WHITESPACE) {
+    p++;
+  }
+  return p;
+}
+
+
+// slineend returns a pointer to the first '\n' at or after p, or s->inend if there is none.
+inline static const u8* slineend(const S* s, const u8* p) {
+  #ifdef SIMD_WIDTH
+  if (!(s->flags & ParseScalar)) {
+    svec lf = svset1('\n');
+    while (s->inend - p >= SIMD_WIDTH) {
+      u32 m = svmask(sveq(svload(p), lf));
+      if (m) {
+        return p + __builtin_ctz(m);
+      }
+      p += SIMD_WIDTH;
+    }
+  }
+  #endif
+  while (p < s->inend && *p != '\n') {
+    p++;
+  }
+  return p;
+}
+
+
 void SInit(S* s, Memory mem, Source* src, ParseFlags flags, ErrorHandler* errh, void* userdata) {
   memset(s, 0, sizeof(S));
 
@@ -75,20 +175,21 @@ void SInit(S* s, Memory mem, Source* src, ParseFlags flags, ErrorHandler* errh,
   s->lineno = 0;
   s->linestart = s->inp;
 
+  // The source is validated once, up front. Invalid UTF-8 is reported when a token
+  // (or the whitespace or comments before it) covers it; see sbadutf8.
+  auto enc = SourceCheckUTF8(src);
+  s->ascii = enc == SourceUTF8ASCII;
+  s->utf8end = enc == SourceUTF8Invalid ? src->buf + src->_utf8err : s->inend;
+
   s->errh = errh;
   s->userdata = userdata;
 }
 
 
-static void serr(S* s, const char* format, ...) {
-  auto pos = SSrcPos(s);
+static void serrv(S* s, SrcPos pos, const char* format, va_list ap) {
   auto msg = SrcPosFmt(sdsempty(), pos);
   msg = sdscatlen(msg, ": ", 2);
-
-  va_list ap;
-  va_start(ap, format);
   msg = sdscatvprintf(msg, format, ap);
-  va_end(ap);
 
   if (s->errh) {
     s->errh(s->src, pos, msg, s->userdata);
@@ -103,6 +204,24 @@ static void serr(S* s, const char* format, ...) {
 }
 
 
+// serr reports an error at the current token
+static void serr(S* s, const char* format, ...) {
+  va_list ap;
+  va_start(ap, format);
+  serrv(s, SSrcPos(s), format, ap);
+  va_end(ap);
+}
+
+
+// serrat reports an error at pos
+static void serrat(S* s, SrcPos pos, const char* format, ...) {
+  va_list ap;
+  va_start(ap, format);
+  serrv(s, pos, format, ap);
+  va_end(ap);
+}
+
+
 // // unreadrune sets the reading position to a previous reading position, usually the one of
 // // the most recently read rune, but possibly earlier (see unread below).
 // inline static void unreadrune(S* s) {
@@ -129,9 +248,7 @@ static void addComment(S* s) {
 static void scomment(S* s) {
   s->tokstart++; // exclude '#'
   // advance s->inp until next <LF> or EOF. Leave s->inp at \n or EOF.
-  while (s->inp < s->inend && *s->inp != '\n') {
-    s->inp++;
-  }
+  s->inp = slineend(s, s->inp);
   s->tokend = s->inp;
   if (s->flags & ParseComments) {
     addComment(s);
@@ -151,12 +268,10 @@ static void snameuni(S* s) {
       r = b;
       s->inp++;
     } else {
+      // Note: invalid UTF-8 is reported by SNext
       u32 w = 0;
       r = utf8decode(s->inp, s->inend - s->inp, &w);
-      s->inp += w;
-      if (r == RuneErr) {
-        serr(s, "invalid UTF-8 encoding");
-      }
+      s->inp += min((size_t)w, (size_t)(s->inend - s->inp));
     }
     if (r == 0) {
       serr(s, "invalid NUL character");
@@ -164,74 +279,308 @@ static void snameuni(S* s) {
   }
   s->tokend = s->inp;
   s->name = symgeth(s->tokstart, s->tokend - s->tokstart);
-  s->tok = symLangTok(s->name);
+  s->tok = TIdent; // keywords are ASCII
 }
 
 
 // read ASCII name (may switch over to snameuni)
 static void sname(S* s) {
-  // names are pre-hashed and then converted into interned Sym objects.
-  const u32 prime = 0x01000193; // FNV1a prime
-  u32 hash = 0x811C9DC5; // FNV1a seed
-  hash = (*(s->inp-1) ^ hash) * prime; // hash first byte (sname called after first byte)
+  s->inp = sidentend(s, s->inp); // sname is called after the first byte
 
-  while (s->inp < s->inend && charflags[*s->inp] & CH_IDENT) {
-    hash = (*s->inp ^ hash) * prime;
-    s->inp++;
-  }
-
-  if (*s->inp >= RuneSelf && s->inp < s->inend) {
-    // s->inp = s->tokstart;
+  if (!s->ascii && s->inp < s->inend && *s->inp >= RuneSelf) {
     return snameuni(s);
   }
 
   s->tokend = s->inp;
-  s->name = symget(s->tokstart, s->tokend - s->tokstart, hash);
-  s->tok = symLangTok(s->name);
+
+  // names are hashed (8 or 16 bytes at a time) and then converted into interned Sym objects
+  size_t len = (size_t)(s->tokend - s->tokstart);
+  u32 hash = hashWY(s->tokstart, len);
+
+  // Keywords are looked up in a perfect hash table of predefined symbols, without interning
+  Sym kw = symkeyword(s->tokstart, len, hash);
+  if (kw) {
+    s->name = kw;
+    s->tok = symLangTok(kw);
+    return;
+  }
+  s->name = symget(s->tokstart, len, hash);
+  s->tok = TIdent;
 
   // dlog("got name %s \t%p\t%s\thash=%u", sdscatrepr(sdsempty(), s->name, symlen(s->name)),
   //   s->name, TokName(s->tok), hash);
 }
 
 
-// scan a number
-void snumber(S* s) {
+// Numbers
+//
+// Integer literals are decimal, or hexadecimal, octal or binary with a "0x", "0o" or "0b"
+// prefix. Float literals are decimal with a fraction, an exponent or both, e.g. "1.5e-3".
+// "_" may separate digits, e.g. "1_000_000". The value is computed while scanning and stored
+// in s->val. Runs of 8 decimal digits are converted at once, in a 64-bit register (SWAR.)
+
+// isdigits8 returns true if all 8 bytes of v (as loaded from memory) are ASCII digits
+inline static bool isdigits8(u64 v) {
+  return ((v & 0xF0F0F0F0F0F0F0F0ull) |
+          (((v + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) == 0x3333333333333333ull;
+}
+
+// parsedigits8 returns the value of the 8 ASCII digits in v (as loaded from memory)
+inline static u32 parsedigits8(u64 v) {
+  // combine pairs of digits, then pairs of those, then the two halves
+  v -= 0x3030303030303030ull;
+  v = (v * 10) + (v >> 8);
+  v = (((v & 0x000000FF000000FFull) * (100 + (1000000ull << 32))) +
+       (((v >> 16) & 0x000000FF000000FFull) * (1 + (10000ull << 32)))) >> 32;
+  return (u32)v;
+}
+
+
+// snumsep checks an "_" at s->inp, which must be between two digits (or after a base prefix)
+static void snumsep(S* s, bool isdig(u8)) {
+  const u8* p = s->inp;
+  u8 prev = p[-1];
+  bool afterprefix = p - 2 == s->tokstart && (u8)((prev | 0x20) - 'a') < 26; // "0x_1"
+  if (!(isdig(prev) || afterprefix) || p + 1 == s->inend || !isdig(p[1]))
+  {
+    serr(s, "'_' must separate successive digits");
+  }
+}
+
+static bool isdecdigit(u8 c) { return (u8)(c - '0') < 10; }
+static bool isbindigit(u8 c) { return (u8)(c - '0') < 2; }
+static bool isoctdigit(u8 c) { return (u8)(c - '0') < 8; }
+static bool ishexdigit(u8 c) { return (u8)(c - '0') < 10 || (u8)((c | 0x20) - 'a') < 6; }
+
+
+// sdecdigits reads decimal digits and "_" at s->inp into *m. Digits which do not fit in *m are
+// not added to it and are counted in *ndropped instead. Returns the number of digits read.
+static u32 sdecdigits(S* s, u64* m, u32* ndropped) {
+  u64 v = *m;
+  u32 n = 0;
+  while (s->inp < s->inend) {
+    #if W_BYTE_ORDER_LE
+    if (*ndropped == 0 && (s->flags & ParseScalar) == 0) {
+      while (s->inend - s->inp >= 8 && v <= (UINT64_MAX - 99999999) / 100000000) {
+        u64 w;
+        memcpy(&w, s->inp, 8);
+        if (!isdigits8(w)) {
+          break;
+        }
+        v = v * 100000000 + parsedigits8(w);
+        s->inp += 8;
+        n += 8;
+      }
+      if (s->inp == s->inend) {
+        break;
+      }
+    }
+    #endif
+    u8 c = *s->inp;
+    if (isdecdigit(c)) {
+      u64 v2;
+      if (*ndropped == 0 &&
+          !__builtin_mul_overflow(v, 10, &v2) && !__builtin_add_overflow(v2, c - '0', &v2))
+      {
+        v = v2;
+      } else {
+        (*ndropped)++;
+      }
+      n++;
+    } else if (c == '_') {
+      snumsep(s, isdecdigit);
+    } else {
+      break;
+    }
+    s->inp++;
+  }
+  *m = v;
+  return n;
+}
+
+
+// snumberbase reads the digits of a "0x", "0o" or "0b" integer literal, after the prefix
+static void snumberbase(S* s, u32 bits, bool isdig(u8)) {
+  u64 v = 0;
+  u32 n = 0;
+  bool overflow = false;
   while (s->inp < s->inend) {
     u8 c = *s->inp;
-    if (c > '9' || c < '0') {
+    if (isdig(c)) {
+      u64 d = c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10;
+      overflow |= (v >> (64 - bits)) != 0;
+      v = (v << bits) | d;
+      n++;
+    } else if (c == '_') {
+      snumsep(s, isdig);
+    } else if (isdecdigit(c)) {
+      serr(s, "invalid digit '%c' in %s literal", c, bits == 1 ? "binary" : "octal");
+    } else {
       break;
     }
     s->inp++;
   }
-  s->tokend = s->inp; // XXX
+  s->tokend = s->inp;
+  if (n == 0) {
+    serr(s, "%s literal has no digits",
+      bits == 4 ? "hexadecimal" : bits == 3 ? "octal" : "binary");
+  } else if (overflow) {
+    serr(s, "integer literal too large");
+    v = 0;
+  }
+  s->val.i = v;
+}
+
+
+// sfloatval sets s->val.f to the value of the float literal of the current token.
+// m holds the significant digits and exp10 the power of ten to scale m by.
+static void sfloatval(S* s, u64 m, int exp10, bool truncated) {
+  if (!truncated && decimaltof64(m, exp10, &s->val.f)) {
+    return;
+  }
+  // Fall back to strtod, with any "_" removed from the literal
+  size_t len = (size_t)(s->tokend - s->tokstart);
+  char stackbuf[128];
+  char* buf = len < sizeof(stackbuf) ? stackbuf : (char*)memalloc(s->mem, len + 1);
+  size_t n = 0;
+  for (const u8* p = s->tokstart; p < s->tokend; p++) {
+    if (*p != '_') {
+      buf[n++] = (char)*p;
+    }
+  }
+  buf[n] = 0;
+  s->val.f = strtod(buf, NULL);
+  if (buf != stackbuf) {
+    memfree(s->mem, buf);
+  }
+  if (s->val.f > 1.7976931348623157e308) {
+    serr(s, "float literal too large");
+  }
+}
+
+
+// scan a number. s->inp is just after the first digit.
+static void snumber(S* s) {
   s->tok = TIntLit;
+  s->inp--;
+
+  if (*s->inp == '0' && s->inp + 1 < s->inend) {
+    switch (s->inp[1] | 0x20) { // lower case
+      case 'x': s->inp += 2; return snumberbase(s, 4, ishexdigit);
+      case 'o': s->inp += 2; return snumberbase(s, 3, isoctdigit);
+      case 'b': s->inp += 2; return snumberbase(s, 1, isbindigit);
+    }
+  }
+
+  // integer part
+  u64 m = 0;
+  u32 ndropped = 0;
+  sdecdigits(s, &m, &ndropped);
+  int exp10 = (int)ndropped;
+
+  // fraction; must start with a digit so that e.g. "1.foo" is not a float
+  if (s->inp + 1 < s->inend && *s->inp == '.' && isdecdigit(s->inp[1])) {
+    s->tok = TFloatLit;
+    s->inp++;
+    u32 ndropped0 = ndropped;
+    u32 n = sdecdigits(s, &m, &ndropped);
+    exp10 -= (int)(n - (ndropped - ndropped0));
+  }
+
+  // exponent
+  if (s->inp < s->inend && (*s->inp | 0x20) == 'e') {
+    s->tok = TFloatLit;
+    s->inp++;
+    bool neg = false;
+    if (s->inp < s->inend && (*s->inp == '+' || *s->inp == '-')) {
+      neg = *s->inp == '-';
+      s->inp++;
+    }
+    int e = 0;
+    const u8* start = s->inp;
+    while (s->inp < s->inend && isdecdigit(*s->inp)) {
+      if (e < 100000) { // large enough to make any mantissa zero or infinite
+        e = e * 10 + (*s->inp - '0');
+      }
+      s->inp++;
+    }
+    if (s->inp == start) {
+      s->tokend = s->inp;
+      serr(s, "exponent has no digits");
+    }
+    exp10 += neg ? -e : e;
+  }
+
+  s->tokend = s->inp;
+  if (s->tok == TFloatLit) {
+    sfloatval(s, m, exp10, ndropped > 0);
+  } else if (ndropped > 0) {
+    serr(s, "integer literal too large");
+    s->val.i = 0;
+  } else {
+    s->val.i = m;
+  }
 }
 
 
+// sbadutf8 reports invalid UTF-8 in the bytes from start to s->inp, which were consumed by
+// the current token, and finds the next invalid byte after them.
+static void __attribute__((noinline)) sbadutf8(S* s, const u8* start) {
+  const u8* p = max(start, s->utf8end);
+  while (1) {
+    p += utf8validate(p, (size_t)(s->inend - p), NULL);
+    if (p >= s->inp) {
+      break;
+    }
+    SrcPos pos = { s->src, (u32)(p - s->src->buf), 1 };
+    serrat(s, pos, "invalid UTF-8 encoding");
+    p++;
+  }
+  s->utf8end = p;
+}
+
+
+static Tok snext(S* s);
+
 Tok SNext(S* s) {
+  const u8* start = s->inp;
+  Tok t = snext(s);
+  if (s->inp > s->utf8end) {
+    sbadutf8(s, start);
+  }
+  return t;
+}
+
+
+inline static Tok snext(S* s) {
   scan_again:  // jumped to when comments are skipped
 
   // skip whitespace
-  while (s->inp < s->inend && charflags[*s->inp] & CH_WHITESPACE) {
-    if (*s->inp == '\n') {
-      s->lineno++;
-      s->linestart = s->inp;
-      if (s->insertSemi) {
-        s->insertSemi = false;
-        s->tokstart = s->inp;
-        s->tokend = s->tokstart;
-        s->inp++;
-        #ifdef SCANNER_DEBUG_TOKEN_PRODUCTION
-          dlog(">> %s\t\tat %s", TokName(TSemi), SrcPosFmt(sdsempty(), SSrcPos(s)));
-        #endif
-        return s->tok = TSemi;
-      }
+  while ((s->inp = sspaceend(s, s->inp)) < s->inend && *s->inp == '\n') {
+    s->lineno++;
+    s->linestart = s->inp;
+    // record line in the source's line table (unless it's already been recorded)
+    u32 nextline = (u32)(s->inp - s->src->buf) + 1;
+    if (nextline > s->src->_lineend) {
+      SourceAddLine(s->src, nextline);
+    }
+    if (s->insertSemi) {
+      s->insertSemi = false;
+      s->tokstart = s->inp;
+      s->tokend = s->tokstart;
+      s->inp++;
+      #ifdef SCANNER_DEBUG_TOKEN_PRODUCTION
+        dlog(">> %s\t\tat %s", TokName(TSemi), SrcPosFmt(sdsempty(), SSrcPos(s)));
+      #endif
+      return s->tok = TSemi;
     }
     s->inp++;
   }
 
   // EOF
   if (s->inp == s->inend) {
+    // every line has been visited and recorded
+    s->src->_lineend = s->src->len;
     s->tokstart = s->inp - 1;
     s->tokend = s->tokstart;
     if (s->insertSemi) {
@@ -259,7 +608,7 @@ Tok SNext(S* s) {
     (nextc == (c)) ? ({ CONSUME_CHAR(); insertSemi = true; (tok1); }) : (tok2)
 
   u8 c = *s->inp++; // current char
-  u8 nextc = (s->inp+1 < s->inend) ? *s->inp : 0; // next char
+  u8 nextc = (s->inp < s->inend) ? *s->inp : 0; // next char (buf is not NUL terminated)
 
   switch (c) {
 
@@ -309,7 +658,7 @@ Tok SNext(S* s) {
       case '=': s->tok = TLEq;  CONSUME_CHAR(); break;  // "<="
       case '<': // "<<" | "<<="
         CONSUME_CHAR();
-        if (s->inp+1 < s->inend && *s->inp == '=') { // "<<="
+        if (s->inp < s->inend && *s->inp == '=') { // "<<="
           s->tok = TShlAssign; CONSUME_CHAR();
         } else { // "<<"
           s->tok = TShl;
@@ -324,7 +673,7 @@ Tok SNext(S* s) {
       case '=': s->tok = TLEq;  CONSUME_CHAR(); break;  // ">="
       case '>': // ">>" | ">>="
         CONSUME_CHAR();
-        if (s->inp+1 < s->inend && *s->inp == '=') { // ">>="
+        if (s->inp < s->inend && *s->inp == '=') { // ">>="
           s->tok = TShrAssign; CONSUME_CHAR();
         } else { // ">>"
           s->tok = TShr;
@@ -407,6 +756,328 @@ Tok SNext(S* s) {
 
 
 
+void TokBufInit(TokBuf* b, Memory mem) {
+  memset(b, 0, sizeof(TokBuf));
+  b->mem = mem;
+}
+
+
+void TokBufFree(TokBuf* b) {
+  if (b->cap) {
+    memfree(b->mem, b->tok);
+    memfree(b->mem, b->start);
+    memfree(b->mem, b->tlen);
+    memfree(b->mem, b->val);
+  }
+  TokBufInit(b, b->mem);
+}
+
+
+void _TokBufResize(TokBuf* b, u32 cap) {
+  assert(cap >= b->len);
+  b->cap = cap;
+  b->tok   = (u8*) memrealloc(b->mem, b->tok,   sizeof(u8)  * b->cap);
+  b->start = (u32*)memrealloc(b->mem, b->start, sizeof(u32) * b->cap);
+  b->tlen  = (u32*)memrealloc(b->mem, b->tlen,  sizeof(u32) * b->cap);
+  b->val   = (TokVal*)memrealloc(b->mem, b->val, sizeof(TokVal) * b->cap);
+}
+
+
+void SLexAll(S* s, TokBuf* b) {
+  // Reserve space up front, assuming an average of 4 source bytes per token, which
+  // avoids most reallocations.
+  u32 guess = (u32)((s->inend - s->inp) / 4) + 1;
+  if (b->cap - b->len < guess) {
+    _TokBufResize(b, b->len + guess);
+  }
+  const u8* buf = s->src->buf;
+  while (1) {
+    Tok t = SNext(s);
+    // Note: tokstart is one byte before buf for the TNone of an empty source
+    u32 start = s->tokstart > buf ? (u32)(s->tokstart - buf) : 0;
+    TokBufPush(b, t, start, (u32)(s->tokend - s->tokstart), STokVal(s));
+    if (t == TNone) {
+      break;
+    }
+  }
+}
+
+
+
+#if W_UNIT_TEST_ENABLED
+#include <sys/mman.h>
+#include "../common/array.h"
+#include <math.h>
+
+// test_source_init initializes source for scanning buf in a test
+static void test_source_init(Source* source, const u8* buf, size_t len) {
+  auto name = sdsnew("scantest");
+  SourceInit(source, name, buf, len);
+  sdsfree(name);
+}
+
+static void test_scan_eof(const char* src, Tok lasttok) {
+  // Places src at the very end of a page which is followed by an inaccessible page, the
+  // way a memory-mapped file with a page-multiple size looks, and scans it. Any read past
+  // the end of the source faults.
+  size_t pagesize = os_mempagesize();
+  size_t len = strlen(src);
+  assert(len <= pagesize);
+  u8* pages = (u8*)mmap(NULL, pagesize * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+  assert(pages != MAP_FAILED);
+  mprotect(pages + pagesize, pagesize, PROT_NONE);
+  u8* buf = pages + pagesize - len;
+  memcpy(buf, src, len);
+  for (u32 i = 0; i < 2; i++) {
+    Source source;
+    test_source_init(&source, buf, len);
+    S s;
+    SInit(&s, NULL, &source, i == 0 ? ParseFlagsDefault : ParseScalar, NULL, NULL);
+    Tok t, last = TNone;
+    while ((t = SNext(&s)) != TNone) {
+      if (t != TSemi) {
+        last = t;
+      }
+    }
+    asserteq(last, lasttok);
+    SourceFree(&source);
+  }
+  munmap(pages, pagesize * 2);
+}
+
+static void test_count_errors(const Source* src, SrcPos pos, ConstStr msg, void* userdata) {
+  (*(u32*)userdata)++;
+}
+
+// test_scan_number scans src, which should be a single number literal of kind tok, and checks
+// its value (expect is the value of TIntLit, or the bits of the value of TFloatLit.)
+static void test_scan_number(const char* src, Tok tok, u64 expect, u32 expecterrors) {
+  for (u32 i = 0; i < 2; i++) {
+    Source source;
+    test_source_init(&source, (const u8*)src, strlen(src));
+    u32 nerrors = 0;
+    S s;
+    SInit(&s, NULL, &source, i == 0 ? ParseFlagsDefault : ParseScalar, test_count_errors, &nerrors);
+    Tok t = SNext(&s);
+    if (t != tok || s.val.i != expect || nerrors != expecterrors) {
+      fprintf(stderr, "%s => %s %llu (0x%llx, %g) %u errors\n", src, TokName(t),
+        s.val.i, s.val.i, s.val.f, nerrors);
+    }
+    asserteq(t, tok);
+    asserteq(s.val.i, expect);
+    asserteq(nerrors, expecterrors);
+    SourceFree(&source);
+  }
+}
+
+static u64 test_f64bits(double f) {
+  u64 bits;
+  memcpy(&bits, &f, sizeof(bits));
+  return bits;
+}
+
+static void test_record_error(const Source* src, SrcPos pos, ConstStr msg, void* userdata) {
+  auto offsets = (Array*)userdata;
+  ArrayPush(offsets, (void*)(uintptr_t)pos.offs, NULL);
+}
+
+// test_scan_utf8 scans src and checks that invalid UTF-8 is reported at exactly the offsets
+// in expect (terminated by -1), in both the SIMD and the scalar scanner.
+static void test_scan_utf8(const char* src, bool ascii, const int* expect) {
+  for (u32 i = 0; i < 2; i++) {
+    Source source;
+    test_source_init(&source, (const u8*)src, strlen(src));
+    Array offsets;
+    ArrayInit(&offsets);
+    S s;
+    SInit(&s, NULL, &source, i == 0 ? ParseFlagsDefault : ParseScalar, test_record_error, &offsets);
+    asserteq(s.ascii, ascii);
+    while (SNext(&s) != TNone || s.inp < s.inend) {
+    }
+    u32 n = 0;
+    while (expect[n] != -1) {
+      assert(n < offsets.len);
+      asserteq((int)(uintptr_t)offsets.v[n], expect[n]);
+      n++;
+    }
+    asserteq(offsets.len, n);
+    ArrayFree(&offsets, NULL);
+    SourceFree(&source);
+  }
+}
+
+static void test_scan_utf8s() {
+  const int none[] = {-1};
+  test_scan_utf8("x = y # only ASCII\n", true, none);
+  test_scan_utf8("x = \xC3\xB1" "and\xC3\xBA # and a comment with \xE2\x82\xAC\n", false, none);
+  test_scan_utf8("x = \xEF\xBF\xBD\n", false, none); // U+FFFD is valid, not an error
+
+  // invalid bytes in an identifier, a comment and at the end of the source
+  const int e1[] = {5, 13, 19, -1};
+  test_scan_utf8("x = a\xFF" "b # abc\xC0 d\ny\n\xE2", false, e1);
+  // invalid byte at the start of the source
+  const int e2[] = {0, -1};
+  test_scan_utf8("\x80", false, e2);
+}
+
+static void test_scan_numbers() {
+  test_scan_number("0", TIntLit, 0, 0);
+  test_scan_number("7", TIntLit, 7, 0);
+  test_scan_number("1234567890", TIntLit, 1234567890, 0);
+  test_scan_number("000000000000000000000000000042", TIntLit, 42, 0);
+  test_scan_number("12345678901234567", TIntLit, 12345678901234567ull, 0);
+  test_scan_number("18446744073709551615", TIntLit, 0xFFFFFFFFFFFFFFFFull, 0);
+  test_scan_number("18446744073709551616", TIntLit, 0, 1);
+  test_scan_number("1_000_000", TIntLit, 1000000, 0);
+  test_scan_number("1_2345_6789_0123", TIntLit, 1234567890123ull, 0);
+  test_scan_number("1__0", TIntLit, 10, 2);
+  test_scan_number("1_", TIntLit, 1, 1);
+  test_scan_number("1.foo", TIntLit, 1, 0);
+  test_scan_number("0xdead_BEEF", TIntLit, 0xdeadbeef, 0);
+  test_scan_number("0X_ff", TIntLit, 0xff, 0);
+  test_scan_number("0xFFFFFFFFFFFFFFFF", TIntLit, 0xFFFFFFFFFFFFFFFFull, 0);
+  test_scan_number("0x1FFFFFFFFFFFFFFFF", TIntLit, 0, 1);
+  test_scan_number("0x", TIntLit, 0, 1);
+  test_scan_number("0b1010", TIntLit, 10, 0);
+  test_scan_number("0b102", TIntLit, 2, 1); // invalid digit is skipped
+  test_scan_number("0o777", TIntLit, 0777, 0);
+  test_scan_number("0o8", TIntLit, 0, 2); // invalid digit, no digits
+
+  test_scan_number("1.5", TFloatLit, test_f64bits(1.5), 0);
+  test_scan_number("0.1", TFloatLit, test_f64bits(0.1), 0);
+  test_scan_number("1e10", TFloatLit, test_f64bits(1e10), 0);
+  test_scan_number("1E+2", TFloatLit, test_f64bits(100.0), 0);
+  test_scan_number("2.5e-3", TFloatLit, test_f64bits(2.5e-3), 0);
+  test_scan_number("1_000.000_5", TFloatLit, test_f64bits(1000.0005), 0);
+  test_scan_number("123456789.123456789e-5", TFloatLit, test_f64bits(123456789.123456789e-5), 0);
+  test_scan_number("3.14159265358979323846264338327950288", TFloatLit,
+    test_f64bits(3.14159265358979323846264338327950288), 0);
+  test_scan_number("12345678901234567890123.0", TFloatLit,
+    test_f64bits(12345678901234567890123.0), 0);
+  test_scan_number("2.2250738585072011e-308", TFloatLit, test_f64bits(2.2250738585072011e-308), 0);
+  test_scan_number("1e-400", TFloatLit, 0, 0);
+  test_scan_number("1e400", TFloatLit, test_f64bits(INFINITY), 1);
+  test_scan_number("1e", TFloatLit, test_f64bits(1.0), 1);
+  test_scan_number("1._5", TIntLit, 1, 0); // "1" "." "_5"
+}
+
+static void test_scan_tokens(const char* src) {
+  // scans src with and without SIMD and verifies that both produce the same token stream
+  Source source;
+  test_source_init(&source, (const u8*)src, strlen(src));
+  S s1, s2;
+  SInit(&s1, NULL, &source, ParseFlagsDefault, NULL, NULL);
+  SInit(&s2, NULL, &source, ParseScalar, NULL, NULL);
+  TokBuf toks;
+  TokBufInit(&toks, NULL);
+  SLexAll(&s2, &toks);
+  SInit(&s2, NULL, &source, ParseScalar, NULL, NULL);
+  u32 ntok = 0;
+  while (1) {
+    auto t1 = SNext(&s1);
+    auto t2 = SNext(&s2);
+    asserteq(t1, t2);
+    asserteq(s1.tokstart, s2.tokstart);
+    asserteq(s1.tokend, s2.tokend);
+    asserteq(s1.lineno, s2.lineno);
+    asserteq(s1.linestart, s2.linestart);
+    if (t1 == TIdent) {
+      asserteq(s1.name, s2.name);
+      asserteq(symhash(s1.name), hashWY((const u8*)s1.name, symlen(s1.name)));
+    }
+    // same token in the pre-lexed token buffer
+    assert(ntok < toks.len);
+    asserteq(TokUnpack(toks.tok[ntok]), t1);
+    if (source.len > 0) {
+      asserteq(source.buf + toks.start[ntok], s1.tokstart);
+    }
+    asserteq(toks.tlen[ntok], (u32)(s1.tokend - s1.tokstart));
+    // SourceSpan computes the length of the token from the text
+    if (s1.tokend > s1.tokstart) {
+      asserteq(SourceSpan(&source, (u32)(s1.tokstart - source.buf)), toks.tlen[ntok]);
+    }
+    if (t1 == TIdent || t1 > TKeywordsStart) {
+      asserteq(toks.val[ntok].name, s1.name);
+    }
+    ntok++;
+    if (t1 == TNone) {
+      break;
+    }
+  }
+  asserteq(ntok, toks.len);
+  TokBufFree(&toks);
+  // the line table was built while scanning
+  u32 nlines = 1;
+  for (size_t i = 0; i < source.len; i++) {
+    if (source.buf[i] == '\n') {
+      nlines++;
+    }
+  }
+  asserteq(source._lineend, source.len);
+  if (nlines > 1) {
+    asserteq(source._linecount, nlines);
+  }
+  SourceFree(&source);
+}
+
+static void test() {
+  #ifdef SIMD_WIDTH
+  { // vector classification must match charflags for every byte value
+    u8 buf[SIMD_WIDTH * 2];
+    Source source = { .buf = buf, .len = sizeof(buf) };
+    S s;
+    SInit(&s, NULL, &source, ParseFlagsDefault, NULL, NULL);
+    for (u32 c = 0; c < 256; c++) {
+      memset(buf, 'a', sizeof(buf));
+      buf[5] = (u8)c;
+      bool isident = charflags[c] & CH_IDENT;
+      asserteq(sidentend(&s, buf) == &buf[5], !isident);
+      memset(buf, ' ', sizeof(buf));
+      buf[5] = (u8)c;
+      bool isspace = c != '\n' && (charflags[c] & CH_WHITESPACE);
+      asserteq(sspaceend(&s, buf) == &buf[5], !isspace);
+      asserteq(slineend(&s, buf) == &buf[5], c == '\n');
+    }
+  }
+  #endif
+
+  test_scan_numbers();
+  test_scan_utf8s();
+
+  test_scan_tokens("");
+  test_scan_tokens("a");
+  test_scan_tokens("fun main() int {\n  x = 1 + y_2\n  return x\n}\n");
+  test_scan_tokens(
+    "a_rather_long_identifier_which_spans_more_than_one_vector = another_long_name_x\n"
+    "                                                 # indented comment\n"
+    "\t\t \r\n"
+    "#############################################################################\n"
+    "fun_with_ñandú_unicode = 12345678901234567890 + x\n"
+    "if is break continue return nil while for  \n"
+    "last_identifier_without_trailing_newline_abcdefgh");
+  test_scan_tokens(
+    "x <<= 1 << 2 >> 3 >>= 4 <= 5 >= 6 < y > z -> a-- + b++ - c -= d += e\n"
+    "f && g || h &= i |= j & k | l != m == n = !o % p %= q * r *= s / t /= u ^ v ^= ~w ~= x\n"
+    "(1e+5, 2.5e-3, 1_000.5, 0x1F_ff, 0o17, 0b101, 12e) {a[0]}; $y + z.w+v-u");
+
+  // tokens which end exactly at the end of the source (no trailing NUL or newline)
+  test_scan_eof("x = abcdefghijklmnopqrstuvwxyz_abcdefghijklmnopqrstuvwxyz", TIdent);
+  test_scan_eof("x = 1234567890", TIntLit);
+  test_scan_eof("x = 12345678", TIntLit);
+  test_scan_eof("x = 0x1234567890abcdef", TIntLit);
+  test_scan_eof("x = 1.2345678e9", TFloatLit);
+  test_scan_eof("x = 1_2", TIntLit);
+  test_scan_eof("x <<= 1\ny <<=", TShlAssign);
+  test_scan_eof("x >>=", TShrAssign);
+  test_scan_eof("x !=", TNEq);
+  test_scan_eof("x ñandú", TIdent);
+  test_scan_eof("x # comment                                    ", TIdent);
+  test_scan_eof("x    \t\t\t                                    ", TIdent);
+}
+W_UNIT_TEST(Scan, { test(); })
+#endif
+
+
 
 /*static Rune nextr(S* s) {
   if (s->inp >= s->inend) {
@@ -9,6 +9,9 @@ typedef enum {
   ParseFlagsDefault = 0,
   ParseComments     = 1 << 1, // parse comments, populating S.comments
   ParseOpt          = 1 << 2, // apply optimizations. might produce a non-1:1 AST/token stream
+  ParseScalar       = 1 << 3, // scan one byte at a time; disables SIMD (for testing & benchmarks)
+  ParseTokBuf       = 1 << 4, // lex the entire source into a TokBuf before parsing
+  ParseParallel     = 1 << 5, // with ParseTokBuf, lex on one thread per CPU (SLexAllParallel)
 } ParseFlags;
 
 // scanned comment
@@ -32,6 +35,10 @@ typedef struct S {
   const u8* tokstart;      // start of current token
   const u8* tokend;        // end of current token
   Sym       name;          // Current name (valid for TIdent and keywords)
+  union {
+    u64     i;             // value of current TIntLit
+    double  f;             // value of current TFloatLit
+  } val;
   bool      insertSemi;    // insert a semicolon before next newline
   Comment*  comments;      // linked list head of comments scanned so far
   Comment*  comments_tail; // linked list tail of comments scanned so far
@@ -39,6 +46,9 @@ typedef struct S {
   u32       lineno;     // source position line
   const u8* linestart;  // source position line start pointer (for column)
 
+  bool      ascii;      // the source is pure ASCII
+  const u8* utf8end;    // bytes between the start of scanning and utf8end are valid UTF-8
+
   ErrorHandler* errh;
   void*         userdata;
 } S;
@@ -49,6 +59,46 @@ void SInit(S*, Memory, Source*, ParseFlags, ErrorHandler*, void* userdata);
 // SNext scans the next token
 Tok SNext(S*);
 
+// TokVal is the value of a token in a TokBuf
+typedef union TokVal {
+  Sym    name; // TIdent and keywords
+  u64    i;    // TIntLit
+  double f;    // TFloatLit
+} TokVal;
+
+// TokBuf is a pre-lexed token stream, stored as a struct of arrays.
+// Token i spans source bytes [start[i], start[i]+tlen[i]). The last token is always TNone.
+typedef struct TokBuf {
+  Memory  mem;
+  u32     len;   // number of tokens
+  u32     cap;   // capacity of the arrays
+  u8*     tok;   // token kind, packed with TokPack
+  u32*    start; // byte offset into the source
+  u32*    tlen;  // byte length
+  TokVal* val;   // name or literal value; zero for other tokens
+} TokBuf;
+
+void TokBufInit(TokBuf*, Memory);
+void TokBufFree(TokBuf*);
+static void TokBufPush(TokBuf*, Tok, u32 start, u32 len, TokVal);
+
+// STokVal returns the value of the current token of a scanner, for TokBufPush
+static TokVal STokVal(const S*);
+
+// TokPack & TokUnpack convert between Tok and the u8 stored in TokBuf.tok.
+// Keywords (which start at TKeywordsStart) are packed right after the last other token.
+static u8 TokPack(Tok);
+static Tok TokUnpack(u8);
+
+// SLexAll scans tokens into b until TNone, which is either the end of input or invalid input.
+// In the latter case s->inp < s->inend and SLexAll can be called again to continue.
+void SLexAll(S*, TokBuf* b);
+
+// SLexAllParallel is like SLexAll but splits the source into chunks at line boundaries which
+// are lexed by up to nthreads threads. The result is identical to that of SLexAll.
+// Small sources, and sources with errors, are lexed by SLexAll on the calling thread.
+void SLexAllParallel(S*, TokBuf* b, u32 nthreads);
+
 // SSrcPos returns the source position of current token
 inline static SrcPos SSrcPos(S* s) {
   assert(s->tokstart >= s->src->buf);
@@ -59,3 +109,39 @@ inline static SrcPos SSrcPos(S* s) {
   SrcPos p = { s->src, offs, s->tokend - s->tokstart };
   return p;
 }
+
+// -----------------------------------------------------------------------------------------------
+// inline and internal implementations
+
+static_assert(TComment + (TKeywordsEnd - TKeywordsStart) <= 0xFF, "Tok does not fit in u8");
+
+inline static u8 TokPack(Tok t) {
+  return (u8)(t > TKeywordsStart ? t - TKeywordsStart + TComment : t);
+}
+
+inline static Tok TokUnpack(u8 v) {
+  return v > TComment ? (Tok)(v - TComment + TKeywordsStart) : (Tok)v;
+}
+
+void _TokBufResize(TokBuf*, u32 cap);
+
+inline static void TokBufPush(TokBuf* b, Tok t, u32 start, u32 len, TokVal v) {
+  if (b->len == b->cap) {
+    _TokBufResize(b, b->cap ? b->cap * 2 : 256);
+  }
+  b->tok[b->len] = TokPack(t);
+  b->start[b->len] = start;
+  b->tlen[b->len] = len;
+  b->val[b->len] = v;
+  b->len++;
+}
+
+inline static TokVal STokVal(const S* s) {
+  TokVal v = {0};
+  if (s->tok == TIdent || s->tok > TKeywordsStart) {
+    v.name = s->name;
+  } else if (s->tok == TIntLit || s->tok == TFloatLit) {
+    v.i = s->val.i;
+  }
+  return v;
+}
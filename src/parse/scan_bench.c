@@ -0,0 +1,160 @@
+#include "../common/bench.h"
+#include "scan.h"
+
+// benchSource returns about size bytes of source code, made up of a repeating sample.
+// The sample mixes the things the scanner spends most time on: names, whitespace runs,
+// comments and short operators.
+static Str benchSource(size_t size) {
+  const char* sample =
+    "# compute the sum of a sequence of values, which is a fairly long comment line\n"
+    "fun sum_of_values (first_value, second_value int, scale_factor int) int {\n"
+    "  intermediate_result = first_value + second_value\n"
+    "  if intermediate_result > 1000 {\n"
+    "    return intermediate_result * scale_factor  # scaled\n"
+    "  }\n"
+    "  another_temporary_name = intermediate_result / 2\n"
+    "  return another_temporary_name\n"
+    "}\n"
+    "\n";
+  auto s = sdsempty();
+  while (sdslen(s) < size) {
+    s = sdscat(s, sample);
+  }
+  return s;
+}
+
+
+// benchNumbers returns about size bytes of source code which is mostly number literals,
+// like a generated lookup table.
+static Str benchNumbers(size_t size) {
+  auto s = sdsnew("table = (\n");
+  u64 x = 0x9E3779B97F4A7C15ull;
+  while (sdslen(s) < size) {
+    x ^= x << 13; x ^= x >> 7; x ^= x << 17; // xorshift64
+    s = sdscatprintf(s, "  %llu, 0x%llx, %u_%03u, %.17g, %.6e,\n",
+      (unsigned long long)(x >> 20), (unsigned long long)x, (u32)(x >> 54), (u32)(x % 1000),
+      (double)(x >> 11) / 9007199254740992.0, (double)(x >> 30) * 1e-3);
+  }
+  return sdscat(s, ")\n");
+}
+
+
+static void benchScan(Bench* b, ParseFlags flags, Str(*gensource)(size_t)) {
+  BenchStopTimer(b);
+  auto text = gensource(1024 * 1024);
+  auto name = sdsnew("bench");
+  Source src;
+  SourceInit(&src, name, (const u8*)text, sdslen(text));
+  S s;
+  BenchStartTimer(b);
+
+  u64 ntokens = 0;
+  for (u64 i = 0; i < b->N; i++) {
+    SInit(&s, NULL, &src, flags, NULL, NULL);
+    ntokens = 0;
+    while (SNext(&s) != TNone) {
+      ntokens++;
+    }
+  }
+
+  b->bytes = src.len;
+  b->tokens = ntokens;
+  SourceFree(&src);
+  sdsfree(name);
+  sdsfree(text);
+}
+
+
+W_BENCHMARK(SNext, {
+  benchScan(b, ParseFlagsDefault, benchSource);
+})
+
+W_BENCHMARK(SNextScalar, {
+  benchScan(b, ParseScalar, benchSource);
+})
+
+W_BENCHMARK(SNextNumbers, {
+  benchScan(b, ParseFlagsDefault, benchNumbers);
+})
+
+W_BENCHMARK(SNextNumbersScalar, {
+  benchScan(b, ParseScalar, benchNumbers);
+})
+
+W_BENCHMARK(SourceCheckUTF8, {
+  BenchStopTimer(b);
+  auto text = benchSource(1024 * 1024);
+  auto name = sdsnew("bench");
+  Source src;
+  SourceInit(&src, name, (const u8*)text, sdslen(text));
+  BenchStartTimer(b);
+
+  for (u64 i = 0; i < b->N; i++) {
+    src._utf8 = SourceUTF8Unknown;
+    SourceCheckUTF8(&src);
+  }
+
+  b->bytes = src.len;
+  SourceFree(&src);
+  sdsfree(name);
+  sdsfree(text);
+})
+
+W_BENCHMARK(SLexAll, {
+  BenchStopTimer(b);
+  auto text = benchSource(1024 * 1024);
+  auto name = sdsnew("bench");
+  Source src;
+  SourceInit(&src, name, (const u8*)text, sdslen(text));
+  S s;
+  TokBuf toks;
+  TokBufInit(&toks, NULL);
+  BenchStartTimer(b);
+
+  for (u64 i = 0; i < b->N; i++) {
+    SInit(&s, NULL, &src, ParseFlagsDefault, NULL, NULL);
+    toks.len = 0;
+    SLexAll(&s, &toks);
+  }
+
+  b->bytes = src.len;
+  b->tokens = toks.len;
+  TokBufFree(&toks);
+  SourceFree(&src);
+  sdsfree(name);
+  sdsfree(text);
+})
+
+
+static void benchLexParallel(Bench* b, u32 nthreads) {
+  BenchStopTimer(b);
+  auto text = benchSource(16 * 1024 * 1024);
+  auto name = sdsnew("bench");
+  Source src;
+  SourceInit(&src, name, (const u8*)text, sdslen(text));
+  S s;
+  TokBuf toks;
+  TokBufInit(&toks, NULL);
+  BenchStartTimer(b);
+
+  for (u64 i = 0; i < b->N; i++) {
+    SourceFree(&src); // reset line table
+    SourceInit(&src, name, (const u8*)text, sdslen(text));
+    SInit(&s, NULL, &src, ParseFlagsDefault, NULL, NULL);
+    toks.len = 0;
+    SLexAllParallel(&s, &toks, nthreads);
+  }
+
+  b->bytes = src.len;
+  b->tokens = toks.len;
+  TokBufFree(&toks);
+  SourceFree(&src);
+  sdsfree(name);
+  sdsfree(text);
+}
+
+// Compare these to see the speedup per number of threads
+W_BENCHMARK(SLexAllParallel1, { benchLexParallel(b, 1); })
+W_BENCHMARK(SLexAllParallel2, { benchLexParallel(b, 2); })
+W_BENCHMARK(SLexAllParallel4, { benchLexParallel(b, 4); })
+W_BENCHMARK(SLexAllParallel8, { benchLexParallel(b, 8); })
@@ -0,0 +1,296 @@
+#include "scan.h"
+#include "../common/thread.h"
+#include "../common/test.h"
+
+// Parallel lexing
+//
+// The source is split into chunks at line boundaries, just after a '\n'. The scanner state
+// at the start of a line is always the same: the line feed consumed any pending semicolon
+// (S.insertSemi is false) and no token spans lines (comments end at the line feed.)
+// This means that each chunk can be scanned independently, without rescanning any overlap.
+// If tokens which span lines (like block comments) are ever added, the state at a split
+// point will need to be recovered by rescanning a few lines before it.
+//
+// Each chunk is lexed into a separate TokBuf by a separate scanner with a private copy of
+// the Source, which has its own line table. The results are then concatenated in order.
+// If any chunk has an error, everything is discarded and the source is lexed by SLexAll
+// instead, which keeps diagnostics identical to serial lexing (and in order.)
+
+// minimum number of source bytes per chunk. Smaller sources are lexed by SLexAll.
+#define MIN_CHUNK_SIZE (64 * 1024)
+
+typedef struct Chunk {
+  S       s;
+  Source  src;     // copy of the source with a separate line table
+  TokBuf  toks;
+  TokBuf* out;     // &toks, or the caller's TokBuf for the first chunk
+  Memory  mem;     // memory for toks and comments; only used by the chunk's thread
+  u32     nerrors; // number of errors reported by s
+  Thread  thread;
+  bool    spawned; // thread was started
+} Chunk;
+
+
+static void chunkErrorHandler(const Source* src, SrcPos pos, ConstStr msg, void* userdata) {
+  ((Chunk*)userdata)->nerrors++;
+}
+
+
+static int chunkLex(void* arg) {
+  auto c = (Chunk*)arg;
+  SLexAll(&c->s, c->out);
+  return 0;
+}
+
+
+static void chunkInit(Chunk* c, const S* s, const u8* start, const u8* end) {
+  c->mem = MemoryNew(0);
+  c->nerrors = 0;
+  c->spawned = false;
+
+  // Share name and buf with the original source, but not the line table.
+  // Lines starting at or before start are recorded by the previous chunk.
+  c->src = *s->src;
+  c->src._mapped = false;
+  c->src._lineoffsets = NULL;
+  c->src._linecount = 0;
+  c->src._linecap = 0;
+  c->src._lineend = (u32)(start - s->src->buf);
+
+  SInit(&c->s, c->mem, &c->src, s->flags, chunkErrorHandler, c);
+  c->s.inp = start;
+  c->s.inp0 = start;
+  c->s.inend = end;
+  c->s.linestart = start;
+  TokBufInit(&c->toks, c->mem);
+  c->out = &c->toks;
+}
+
+
+static void chunkFree(Chunk* c) {
+  if (c->src._lineoffsets) {
+    memfree(NULL, c->src._lineoffsets);
+  }
+  MemoryFree(c->mem);
+}
+
+
+// mergeLines appends the lines of chunk source src to the line table of dst
+static void mergeLines(Source* dst, const Source* src) {
+  u32 i = 1; // skip [0] which is the start of the first line of the file
+  while (i < src->_linecount && src->_lineoffsets[i] <= dst->_lineend) {
+    i++;
+  }
+  u32 n = src->_linecount - min(i, src->_linecount);
+  if (n == 0) {
+    return;
+  }
+  if (dst->_linecap - dst->_linecount < n) {
+    _SourceGrowLines(dst, n);
+  }
+  memcpy(&dst->_lineoffsets[dst->_linecount], &src->_lineoffsets[i], sizeof(u32) * n);
+  dst->_linecount += n;
+  dst->_lineend = dst->_lineoffsets[dst->_linecount - 1];
+}
+
+
+// mergeComments appends copies of the comments scanned by c to s
+static void mergeComments(S* s, const Chunk* c) {
+  for (auto c2 = c->s.comments; c2; c2 = c2->next) {
+    auto c3 = (Comment*)memalloc(s->mem, sizeof(Comment));
+    c3->src = s->src;
+    c3->ptr = c2->ptr;
+    c3->len = c2->len;
+    if (s->comments) {
+      s->comments_tail->next = c3;
+    } else {
+      s->comments = c3;
+    }
+    s->comments_tail = c3;
+  }
+}
+
+
+// splitSource divides [start,end) into at most nchunks ranges which each end just after a
+// line feed (except for the last.) Returns the number of ranges; ends[i] is the end of range i.
+static u32 splitSource(const u8* start, const u8* end, u32 nchunks, const u8** ends) {
+  size_t chunksize = (size_t)(end - start) / nchunks;
+  u32 n = 0;
+  const u8* p = start;
+  while (n < nchunks - 1 && (size_t)(end - p) > chunksize + MIN_CHUNK_SIZE / 2) {
+    const u8* lf = (const u8*)memchr(p + chunksize, '\n', (size_t)(end - p) - chunksize);
+    if (lf == NULL) {
+      break;
+    }
+    p = lf + 1;
+    ends[n++] = p;
+  }
+  ends[n++] = end;
+  return n;
+}
+
+
+void SLexAllParallel(S* s, TokBuf* b, u32 nthreads) {
+  size_t size = (size_t)(s->inend - s->inp);
+  u32 nchunks = (u32)min((size_t)nthreads, size / MIN_CHUNK_SIZE);
+  if (nchunks < 2) {
+    return SLexAll(s, b);
+  }
+
+  const u8* ends[nchunks];
+  nchunks = splitSource(s->inp, s->inend, nchunks, ends);
+  Chunk chunks[nchunks];
+
+  // Start threads for all chunks but the first, which we lex on this thread, directly into b
+  u32 blen = b->len;
+  const u8* start = s->inp;
+  for (u32 i = 0; i < nchunks; i++) {
+    auto c = &chunks[i];
+    chunkInit(c, s, start, ends[i]);
+    start = ends[i];
+    if (i > 0) {
+      c->spawned = ThreadStart(&c->thread, chunkLex, c) == ThreadSuccess;
+    }
+  }
+  // first chunk continues from the state of s
+  chunks[0].s.insertSemi = s->insertSemi;
+  chunks[0].s.lineno = s->lineno;
+  chunks[0].s.linestart = s->linestart;
+  chunks[0].out = b;
+  chunkLex(&chunks[0]);
+
+  u32 nerrors = 0;
+  u32 ntoks = 0;
+  for (u32 i = 0; i < nchunks; i++) {
+    auto c = &chunks[i];
+    if (c->spawned) {
+      ThreadAwait(c->thread);
+    } else if (i > 0) {
+      chunkLex(c); // failed to start a thread
+    }
+    nerrors += c->nerrors;
+    ntoks += c->toks.len;
+  }
+
+  if (nerrors > 0) {
+    // Start over, lexing serially, so that errors are reported as usual
+    for (u32 i = 0; i < nchunks; i++) {
+      chunkFree(&chunks[i]);
+    }
+    b->len = blen;
+    return SLexAll(s, b);
+  }
+
+  // concatenate tokens and source line tables.
+  // All but the last chunk end with a TNone which is not the end of the source.
+  b->len--; // first chunk's TNone
+  if (b->cap - b->len < ntoks) {
+    _TokBufResize(b, b->len + ntoks);
+  }
+  u32 lineno = 0;
+  for (u32 i = 0; i < nchunks; i++) {
+    auto c = &chunks[i];
+    if (i > 0) {
+      u32 n = i == nchunks - 1 ? c->toks.len : c->toks.len - 1;
+      memcpy(&b->tok[b->len],   c->toks.tok,   sizeof(u8)  * n);
+      memcpy(&b->start[b->len], c->toks.start, sizeof(u32) * n);
+      memcpy(&b->tlen[b->len],  c->toks.tlen,  sizeof(u32) * n);
+      memcpy(&b->val[b->len],   c->toks.val,   sizeof(TokVal) * n);
+      b->len += n;
+    }
+    mergeLines(s->src, &c->src);
+    mergeComments(s, c);
+    lineno += c->s.lineno;
+  }
+
+  // leave s in the state of the last chunk's scanner, which reached the end of the source
+  auto last = &chunks[nchunks - 1].s;
+  s->inp = last->inp;
+  s->inp0 = last->inp0;
+  s->tok = last->tok;
+  s->tokstart = last->tokstart;
+  s->tokend = last->tokend;
+  s->name = last->name;
+  s->val = last->val;
+  s->insertSemi = last->insertSemi;
+  s->lineno = lineno;
+  s->linestart = last->linestart;
+  s->src->_lineend = s->src->len; // every line has been recorded
+
+  for (u32 i = 0; i < nchunks; i++) {
+    chunkFree(&chunks[i]);
+  }
+}
+
+
+#if W_UNIT_TEST_ENABLED
+static void test_lex_parallel(Str text, u32 nthreads) {
+  auto name = sdsnew("lex");
+  Source src1, src2;
+  SourceInit(&src1, name, (const u8*)text, sdslen(text));
+  SourceInit(&src2, name, (const u8*)text, sdslen(text));
+  S s1, s2;
+  SInit(&s1, NULL, &src1, ParseComments, NULL, NULL);
+  SInit(&s2, NULL, &src2, ParseComments, NULL, NULL);
+  TokBuf toks1, toks2;
+  TokBufInit(&toks1, NULL);
+  TokBufInit(&toks2, NULL);
+
+  SLexAll(&s1, &toks1);
+  SLexAllParallel(&s2, &toks2, nthreads);
+
+  asserteq(toks1.len, toks2.len);
+  assert(memcmp(toks1.tok, toks2.tok, toks1.len) == 0);
+  assert(memcmp(toks1.start, toks2.start, sizeof(u32) * toks1.len) == 0);
+  assert(memcmp(toks1.tlen, toks2.tlen, sizeof(u32) * toks1.len) == 0);
+  assert(memcmp(toks1.val, toks2.val, sizeof(TokVal) * toks1.len) == 0);
+
+  asserteq(s1.lineno, s2.lineno);
+  asserteq(s1.inp, s2.inp);
+  asserteq(src1._linecount, src2._linecount);
+  asserteq(src1._lineend, src2._lineend);
+  assert(memcmp(src1._lineoffsets, src2._lineoffsets, sizeof(u32) * src1._linecount) == 0);
+
+  auto c1 = s1.comments;
+  auto c2 = s2.comments;
+  while (c1 && c2) {
+    asserteq(c1->ptr, c2->ptr);
+    asserteq(c1->len, c2->len);
+    c1 = c1->next;
+    c2 = c2->next;
+  }
+  assert(c1 == NULL && c2 == NULL);
+
+  TokBufFree(&toks1);
+  TokBufFree(&toks2);
+  SourceFree(&src1);
+  SourceFree(&src2);
+  sdsfree(name);
+}
+
+static void test() {
+  const char* sample =
+    "# a comment\n"
+    "fun add_values (a, b int) int {\n"
+    "  some_longer_name = a + b  # trailing comment\n"
+    "  return some_longer_name\n"
+    "}\n"
+    "x = add_values(1, 2)\n";
+  auto text = sdsempty();
+  while (sdslen(text) < MIN_CHUNK_SIZE * 5) {
+    text = sdscat(text, sample);
+  }
+  test_lex_parallel(text, 1);
+  test_lex_parallel(text, 2);
+  test_lex_parallel(text, 5);
+  test_lex_parallel(text, 16); // more threads than chunks
+
+  // no trailing newline and a source ending with a token which needs a semicolon
+  text = sdscat(text, "last_token");
+  test_lex_parallel(text, 4);
+
+  sdsfree(text);
+}
+
+W_UNIT_TEST(ScanParallel, { test(); })
+#endif
@@ -0,0 +1,61 @@
+#include "../common/bench.h"
+#include "ast.h"
+
+// Benchmarks of Scope, which the parser creates for every block and function
+
+
+// ScopeNewSmall creates a scope with 3 bindings (a typical block) and frees it
+W_BENCHMARK(ScopeNewSmall, {
+  Node nodes[3];
+  Sym names[3];
+  names[0] = sym_int;
+  names[1] = sym_bool;
+  names[2] = sym_str;
+  auto mem = MemoryNew(0);
+  auto global = GetGlobalScope();
+  for (u64 i = 0; i < b->N; i++) {
+    auto s = ScopeNew(global, mem);
+    for (u32 j = 0; j < countof(names); j++) {
+      ScopeAssoc(s, names[j], &nodes[j]);
+    }
+    ScopeFree(s, mem);
+  }
+  MemoryFree(mem);
+  b->unit = "scopes";
+  b->items = 1;
+})
+
+
+// ScopeLookupDeep looks up names from the innermost of 64 nested scopes with 2 bindings
+// each. Every name is visible, so on average a lookup visits 32 scopes.
+#define SCOPE_BENCH_DEPTH 64
+W_BENCHMARK(ScopeLookupDeep, {
+  BenchStopTimer(b);
+  auto mem = MemoryNew(0);
+  const Scope* s = GetGlobalScope();
+  Node nodes[SCOPE_BENCH_DEPTH * 2];
+  Sym names[SCOPE_BENCH_DEPTH * 2];
+  char buf[32];
+  for (u32 i = 0; i < countof(names); i++) {
+    int len = snprintf(buf, sizeof(buf), "scope_bench_%u", i);
+    names[i] = symgeth((const u8*)buf, (size_t)len);
+  }
+  for (u32 i = 0; i < SCOPE_BENCH_DEPTH; i++) {
+    auto s2 = ScopeNew(s, mem);
+    ScopeAssoc(s2, names[i * 2], &nodes[i * 2]);
+    ScopeAssoc(s2, names[i * 2 + 1], &nodes[i * 2 + 1]);
+    s = s2;
+  }
+  BenchStartTimer(b);
+  for (u64 i = 0; i < b->N; i++) {
+    for (u32 j = 0; j < countof(names); j++) {
+      if (ScopeLookup(s, names[j]) != &nodes[j]) {
+        die("ScopeLookupDeep: wrong result");
+      }
+    }
+  }
+  BenchStopTimer(b);
+  MemoryFree(mem);
+  b->unit = "lookups";
+  b->items = countof(names);
+})
@@ -0,0 +1,250 @@
+#include "common/bench.h"
+#include "parse/parse.h"
+#include "parse/ast_pack.h"
+#include "parse/ast_cache.h"
+#include "ir/builder.h"
+#include "common/os.h"
+
+// Benchmarks of each compiler stage in isolation, on the synthetic sources generated by
+// misc/gen_corpus.py. Each stage is timed on its own; earlier stages run with the timer
+// stopped. The corpus is read from the directory W_BENCH_CORPUS (defaults to build/corpus,
+// which is where the "bench" build target writes it.)
+//
+// Benchmarks are named <Stage><Shape>, e.g. "ParseDeep", so a stage or a shape can be
+// selected by name, e.g. "wp.bench Parse" or "wp.bench Unicode".
+
+typedef enum {
+  StageScan,
+  StageParse,
+  StageResolveSym,
+  StageResolveType,
+  StageIRBuilderAdd,
+  StageAstPack, // conversion of the resolved AST to an AstPack and back
+  StageAstCacheLoad, // loading the parsed AST from a cache file, compared with StageParse
+} Stage;
+
+typedef struct Corpus {
+  Str    filename;
+  u8*    buf;
+  size_t len;
+  u64    ntokens;
+} Corpus;
+
+
+static bool corpusOpen(Corpus* c, const char* shape) {
+  const char* dir = getenv("W_BENCH_CORPUS");
+  if (dir == NULL || *dir == 0) {
+    dir = "build/corpus";
+  }
+  c->filename = sdscatfmt(sdsempty(), "%s/%s.w", dir, shape);
+  c->len = 0;
+  c->buf = os_readfile(c->filename, &c->len, NULL);
+  if (c->buf == NULL) {
+    sdsfree(c->filename);
+    return false;
+  }
+
+  // count tokens once, to report tokens/s for stages which do not produce tokens
+  Source src;
+  if (!SourceInit(&src, c->filename, c->buf, c->len)) {
+    die("%s: %s", c->filename, strerror(errno));
+  }
+  S s;
+  SInit(&s, NULL, &src, ParseComments, NULL, NULL);
+  c->ntokens = 0;
+  while (SNext(&s) != TNone) {
+    c->ntokens++;
+  }
+  SourceFree(&src);
+  return true;
+}
+
+
+static void corpusClose(Corpus* c) {
+  memfree(NULL, c->buf);
+  sdsfree(c->filename);
+}
+
+
+// countNodes returns the number of nodes in the tree at n.
+// Types and call targets are shared with other parts of the tree and are not counted.
+static u64 countNodes(const Node* n) {
+  if (n == NULL) {
+    return 0;
+  }
+  u64 count = 1;
+  switch (n->kind) {
+    case NAssign:
+    case NBinOp:
+    case NPrefixOp:
+    case NPostfixOp:
+    case NReturn:
+      count += countNodes(n->op.left) + countNodes(n->op.right);
+      break;
+    case NBlock:
+    case NFile:
+    case NTuple:
+      NodeListForEach(&n->array.a, child, { count += countNodes(child); });
+      break;
+    case NFun:
+      count += countNodes(n->fun.params) + countNodes(n->fun.body);
+      break;
+    case NCall:
+    case NTypeCast:
+      if (n->call.receiver != NULL && n->call.receiver->kind == NIdent) {
+        count++;
+      }
+      count += countNodes(n->call.args);
+      break;
+    case NArg:
+    case NField:
+    case NLet:
+      count += countNodes(n->field.init);
+      break;
+    case NIf:
+      count += countNodes(n->cond.cond) + countNodes(n->cond.thenb) + countNodes(n->cond.elseb);
+      break;
+    default:
+      break;
+  }
+  return count;
+}
+
+
+static void errorHandler(const Source* src, SrcPos pos, ConstStr msg, void* userdata) {
+  auto s = SrcPosMsg(sdsempty(), pos, msg);
+  die("error in benchmark corpus: %s", s);
+}
+
+
+// benchStage runs the stages before stage with the timer stopped and then times stage
+static void benchStage(Bench* b, const char* shape, Stage stage) {
+  BenchStopTimer(b);
+  Corpus c;
+  if (!corpusOpen(&c, shape)) {
+    BenchSkip(b, "corpus not found; run misc/gen_corpus.py -dir build/corpus");
+    return;
+  }
+  static P parser;
+  u64 nnodes = 0;
+
+  Str cachefile = NULL;
+  if (stage == StageAstCacheLoad) {
+    const char* tmpdir = getenv("TMPDIR");
+    cachefile = sdscatprintf(sdsempty(), "%s/wp-bench-%s.wast",
+      tmpdir != NULL && *tmpdir != 0 ? tmpdir : "/tmp", shape);
+    CCtx cc = {0};
+    if (!CCtxInit(&cc, errorHandler, NULL, c.filename, c.buf, c.len)) {
+      die("%s: %s", c.filename, strerror(errno));
+    }
+    auto pkgscope = ScopeNew(GetGlobalScope(), cc.mem);
+    auto file = Parse(&parser, &cc, ParseComments, pkgscope);
+    AstCacheInfo info = { AstCacheParsed, parser.unresolved };
+    if (!AstCacheSave(cachefile, &cc, file, pkgscope, info)) {
+      die("failed to write %s", cachefile);
+    }
+    CCtxFree(&cc);
+  }
+
+  for (u64 i = 0; i < b->N; i++) {
+    if (stage == StageScan) {
+      Source src;
+      if (!SourceInit(&src, c.filename, c.buf, c.len)) {
+        die("%s: %s", c.filename, strerror(errno));
+      }
+      S s;
+      SInit(&s, NULL, &src, ParseComments, NULL, NULL);
+      BenchStartTimer(b);
+      while (SNext(&s) != TNone) {
+      }
+      BenchStopTimer(b);
+      SourceFree(&src);
+      continue;
+    }
+
+    CCtx cc = {0};
+    if (!CCtxInit(&cc, errorHandler, NULL, c.filename, c.buf, c.len)) {
+      die("%s: %s", c.filename, strerror(errno));
+    }
+    auto pkgscope = ScopeNew(GetGlobalScope(), cc.mem);
+
+    if (stage == StageAstCacheLoad) {
+      BenchStartTimer(b);
+      auto file = AstCacheLoad(cachefile, &cc, pkgscope, NULL);
+      BenchStopTimer(b);
+      if (file == NULL) {
+        die("failed to load %s", cachefile);
+      }
+      if (i == 0) {
+        nnodes = countNodes(file);
+      }
+      CCtxFree(&cc);
+      continue;
+    }
+
+    if (stage == StageParse) { BenchStartTimer(b); }
+    auto file = Parse(&parser, &cc, ParseComments, pkgscope);
+    if (stage == StageParse) { BenchStopTimer(b); }
+
+    if (stage >= StageResolveSym) {
+      if (stage == StageResolveSym) { BenchStartTimer(b); }
+      file = ResolveSym(&cc, parser.s.flags, file, pkgscope);
+      if (stage == StageResolveSym) { BenchStopTimer(b); }
+    }
+
+    if (stage >= StageResolveType) {
+      if (stage == StageResolveType) { BenchStartTimer(b); }
+      ResolveType(&cc, file);
+      if (stage == StageResolveType) { BenchStopTimer(b); }
+    }
+
+    if (stage == StageIRBuilderAdd) {
+      IRBuilder irbuilder = {};
+      IRBuilderInit(&irbuilder, IRBuilderDefault, "bench");
+      BenchStartTimer(b);
+      IRBuilderAdd(&irbuilder, &cc, file);
+      BenchStopTimer(b);
+      IRBuilderFree(&irbuilder);
+    }
+
+    if (stage == StageAstPack) {
+      AstPack pack;
+      BenchStartTimer(b);
+      AstPackInit(&pack, &cc.src, NULL);
+      NRef ref = AstPackAdd(&pack, file);
+      AstUnpack(&pack, ref, cc.mem);
+      AstPackFree(&pack);
+      BenchStopTimer(b);
+    }
+
+    if (i == 0) {
+      nnodes = countNodes(file);
+    }
+    CCtxFree(&cc);
+  }
+
+  b->bytes = c.len;
+  b->tokens = c.ntokens;
+  b->nodes = nnodes;
+  if (cachefile != NULL) {
+    unlink(cachefile);
+    sdsfree(cachefile);
+  }
+  corpusClose(&c);
+}
+
+
+#define BENCH_STAGES(SHAPENAME, shape)                                                       \
+  W_BENCHMARK(SNext##SHAPENAME,        { benchStage(b, shape, StageScan); })                \
+  W_BENCHMARK(Parse##SHAPENAME,        { benchStage(b, shape, StageParse); })               \
+  W_BENCHMARK(ResolveSym##SHAPENAME,   { benchStage(b, shape, StageResolveSym); })          \
+  W_BENCHMARK(ResolveType##SHAPENAME,  { benchStage(b, shape, StageResolveType); })         \
+  W_BENCHMARK(IRBuilderAdd##SHAPENAME, { benchStage(b, shape, StageIRBuilderAdd); })        \
+  W_BENCHMARK(AstPack##SHAPENAME,      { benchStage(b, shape, StageAstPack); })             \
+  W_BENCHMARK(AstCacheLoad##SHAPENAME, { benchStage(b, shape, StageAstCacheLoad); })
+
+BENCH_STAGES(Deep,     "deep")
+BENCH_STAGES(Funs,     "funs")
+BENCH_STAGES(Names,    "names")
+BENCH_STAGES(Comments, "comments")
+BENCH_STAGES(Unicode,  "unicode")
@@ -5,12 +5,16 @@
 #include "common/defs.h"
 #include "common/hash.h"
 #include "common/test.h"
+#include "common/thread.h"
 #include "parse/ast.h"
 #include "sym.h"
+#include <stdatomic.h>
 
-#define RBKEY Sym
-#define RBUSERDATA Memory
-#include "common/rbtree.c.h"
+// SymTabEntry is a slot in the interning table symTab. See symget.
+typedef struct SymTabEntry {
+  u32 hash; // == symhash(sym), stored here so that probing does not touch sym's memory
+  Sym sym;  // NULL for an empty slot
+} SymTabEntry;
 
 // -----------------------------------------------------------------------------------------
 // generated by gen_constants at the end of this file.
@@ -18,141 +22,171 @@
 // #define W_SYM_RUN_GENERATOR
 
 
-//-- BEGIN gen_constants() at src/sym.c:349
-
-const Sym sym_as = &"\0\0\0\0\0\0\0\x8D\x20\x25\x5E\x02\x00\x02\x00\x0A""as"[16];
-const Sym sym_break = &"\0\0\0\0\0\0\0\x78\x81\x64\xC9\x05\x00\x05\x00\x12""break"[16];
-const Sym sym_case = &"\0\0\0\0\0\0\0\xB1\x38\x25\x9B\x04\x00\x04\x00\x1A""case"[16];
-const Sym sym_continue = &"\0\0\0\0\0\0\0\x44\x7E\x72\xB1\x08\x00\x08\x00\x22""continue"[16];
-const Sym sym_default = &"\0\0\0\0\0\0\0\xDE\x5B\x3B\x93\x07\x00\x07\x00\x2A""default"[16];
-const Sym sym_defer = &"\0\0\0\0\0\0\0\x3B\xFB\x01\x1A\x05\x00\x05\x00\x32""defer"[16];
-const Sym sym_else = &"\0\0\0\0\0\0\0\xF0\x5B\xBF\xBD\x04\x00\x04\x00\x3A""else"[16];
-const Sym sym_enum = &"\0\0\0\0\0\0\0\x00\xB0\x6C\x81\x04\x00\x04\x00\x42""enum"[16];
-const Sym sym_for = &"\0\0\0\0\0\0\0\x90\x83\xF3\xAC\x03\x00\x03\x00\x4A""for"[16];
-const Sym sym_fun = &"\0\0\0\0\0\0\0\x5E\x78\xDB\xA8\x03\x00\x03\x00\x52""fun"[16];
-const Sym sym_if = &"\0\0\0\0\0\0\0\x06\x6E\x38\x39\x02\x00\x02\x00\x5A""if"[16];
-const Sym sym_import = &"\0\0\0\0\0\0\0\xD4\x90\x2A\x11\x06\x00\x06\x00\x62""import"[16];
-const Sym sym_in = &"\0\0\0\0\0\0\0\x9E\x7A\x38\x41\x02\x00\x02\x00\x6A""in"[16];
-const Sym sym_interface = &"\0\0\0\0\0\0\0\x30\x51\xEA\x84\x09\x00\x09\x00\x72""interface"[16];
-const Sym sym_is = &"\0\0\0\0\0\0\0\x15\x8F\x38\x4E\x02\x00\x02\x00\x7A""is"[16];
-const Sym sym_mutable = &"\0\0\0\0\0\0\0\xA9\x33\x03\x3B\x07\x00\x07\x00\x82""mutable"[16];
-const Sym sym_nil = &"\0\0\0\0\0\0\0\xEC\xF8\xA3\x0D\x03\x00\x03\x00\x8A""nil"[16];
-const Sym sym_return = &"\0\0\0\0\0\0\0\xBF\x37\xEE\x85\x06\x00\x06\x00\x92""return"[16];
-const Sym sym_select = &"\0\0\0\0\0\0\0\x2D\x66\xC2\x11\x06\x00\x06\x00\x9A""select"[16];
-const Sym sym_struct = &"\0\0\0\0\0\0\0\x20\xBE\xC2\x92\x06\x00\x06\x00\xA2""struct"[16];
-const Sym sym_switch = &"\0\0\0\0\0\0\0\x71\x5F\xE0\x93\x06\x00\x06\x00\xAA""switch"[16];
-const Sym sym_symbol = &"\0\0\0\0\0\0\0\xD1\x51\xFB\xF3\x06\x00\x06\x00\xB2""symbol"[16];
-const Sym sym_type = &"\0\0\0\0\0\0\0\x4D\xF1\x27\x51\x04\x00\x04\x00\xBA""type"[16];
-const Sym sym_while = &"\0\0\0\0\0\0\0\xCE\x28\xC6\x0D\x05\x00\x05\x00\xC2""while"[16];
-const Sym sym_bool = &"\0\0\0\0\0\0\0\x3D\x95\x94\xC8\x04\x00\x04\x00\x02""bool"[16];
-const Sym sym_int8 = &"\0\0\0\0\0\0\0\x92\xFA\x91\x64\x04\x00\x04\x00\x02""int8"[16];
-const Sym sym_uint8 = &"\0\0\0\0\0\0\0\xDB\xF2\x9D\x19\x05\x00\x05\x00\x02""uint8"[16];
-const Sym sym_int16 = &"\0\0\0\0\0\0\0\xD1\x72\xE3\x07\x05\x00\x05\x00\x02""int16"[16];
-const Sym sym_uint16 = &"\0\0\0\0\0\0\0\xF2\xBE\x8E\xAE\x06\x00\x06\x00\x02""uint16"[16];
-const Sym sym_int32 = &"\0\0\0\0\0\0\0\xBF\xE2\xDE\xFB\x05\x00\x05\x00\x02""int32"[16];
-const Sym sym_uint32 = &"\0\0\0\0\0\0\0\xEC\x0B\x94\x32\x06\x00\x06\x00\x02""uint32"[16];
-const Sym sym_int64 = &"\0\0\0\0\0\0\0\x64\x23\xD2\x03\x05\x00\x05\x00\x02""int64"[16];
-const Sym sym_uint64 = &"\0\0\0\0\0\0\0\x13\x08\xA0\xAE\x06\x00\x06\x00\x02""uint64"[16];
-const Sym sym_float32 = &"\0\0\0\0\0\0\0\x10\x74\x9F\xE8\x07\x00\x07\x00\x02""float32"[16];
-const Sym sym_float64 = &"\0\0\0\0\0\0\0\x47\x0E\x98\x7C\x07\x00\x07\x00\x02""float64"[16];
-const Sym sym_int = &"\0\0\0\0\0\0\0\x5E\x7E\xE9\x95\x03\x00\x03\x00\x02""int"[16];
-const Sym sym_uint = &"\0\0\0\0\0\0\0\xA1\x36\x98\xCB\x04\x00\x04\x00\x02""uint"[16];
-const Sym sym_str = &"\0\0\0\0\0\0\0\x90\xD1\x4B\xC2\x03\x00\x03\x00\x02""str"[16];
-const Sym sym__ = &"\0\0\0\0\0\0\0\x6E\x19\x0C\xDA\x01\x00\x01\x00\x02""_"[16];
-const Sym sym_true = &"\0\0\0\0\0\0\0\xE5\x11\xB2\x4D\x04\x00\x04\x00\x02""true"[16];
-const Sym sym_false = &"\0\0\0\0\0\0\0\x58\x99\x06\x0B\x05\x00\x05\x00\x02""false"[16];
-const Sym sym_b = &"\0\0\0\0\0\0\0\xE5\x2D\x0C\xE7\x01\x00\x01\x00\x02""b"[16];
-const Sym sym_1 = &"\0\0\0\0\0\0\0\x1C\xA7\x0C\x34\x01\x00\x01\x00\x02""1"[16];
-const Sym sym_2 = &"\0\0\0\0\0\0\0\xD5\xAB\x0C\x37\x01\x00\x01\x00\x02""2"[16];
-const Sym sym_3 = &"\0\0\0\0\0\0\0\x42\xAA\x0C\x36\x01\x00\x01\x00\x02""3"[16];
-const Sym sym_4 = &"\0\0\0\0\0\0\0\x63\xA2\x0C\x31\x01\x00\x01\x00\x02""4"[16];
-const Sym sym_5 = &"\0\0\0\0\0\0\0\xD0\xA0\x0C\x30\x01\x00\x01\x00\x02""5"[16];
-const Sym sym_6 = &"\0\0\0\0\0\0\0\x89\xA5\x0C\x33\x01\x00\x01\x00\x02""6"[16];
-const Sym sym_7 = &"\0\0\0\0\0\0\0\xF6\xA3\x0C\x32\x01\x00\x01\x00\x02""7"[16];
-const Sym sym_8 = &"\0\0\0\0\0\0\0\x47\xB5\x0C\x3D\x01\x00\x01\x00\x02""8"[16];
-const Sym sym_f = &"\0\0\0\0\0\0\0\x99\x27\x0C\xE3\x01\x00\x01\x00\x02""f"[16];
-const Sym sym_F = &"\0\0\0\0\0\0\0\x39\xF5\x0B\xC3\x01\x00\x01\x00\x02""F"[16];
-const Sym sym_i = &"\0\0\0\0\0\0\0\xC4\x35\x0C\xEC\x01\x00\x01\x00\x02""i"[16];
-const Sym sym_u = &"\0\0\0\0\0\0\0\x10\x3C\x0C\xF0\x01\x00\x01\x00\x02""u"[16];
-const Sym sym_s = &"\0\0\0\0\0\0\0\x82\x45\x0C\xF6\x01\x00\x01\x00\x02""s"[16];
-
-static const Node _Type_bool = {NBasicType,{0,0,0},NULL,{.t={sym_b,.basic={TypeCode_bool,sym_bool}}}};
+//-- BEGIN gen_constants() at src/sym.c:434
+
+const Sym sym_as = &"\0\0\0\0\0\0\0\xB9\xE1\x4F\x3A\x02\x00\x02\x00\x0A""as"[16];
+const Sym sym_break = &"\0\0\0\0\0\0\0\xD3\x93\xE3\x0E\x05\x00\x05\x00\x12""break"[16];
+const Sym sym_case = &"\0\0\0\0\0\0\0\xCE\xD9\x0A\x66\x04\x00\x04\x00\x1A""case"[16];
+const Sym sym_continue = &"\0\0\0\0\0\0\0\x10\x19\xC3\x06\x08\x00\x08\x00\x22""continue"[16];
+const Sym sym_default = &"\0\0\0\0\0\0\0\xA0\x02\x79\xDD\x07\x00\x07\x00\x2A""default"[16];
+const Sym sym_defer = &"\0\0\0\0\0\0\0\xEC\x37\xC4\xF8\x05\x00\x05\x00\x32""defer"[16];
+const Sym sym_else = &"\0\0\0\0\0\0\0\x18\x83\x69\x76\x04\x00\x04\x00\x3A""else"[16];
+const Sym sym_enum = &"\0\0\0\0\0\0\0\x6C\xA0\x66\x1C\x04\x00\x04\x00\x42""enum"[16];
+const Sym sym_for = &"\0\0\0\0\0\0\0\x5A\xD8\x94\xCB\x03\x00\x03\x00\x4A""for"[16];
+const Sym sym_fun = &"\0\0\0\0\0\0\0\xD2\xAC\x07\x75\x03\x00\x03\x00\x52""fun"[16];
+const Sym sym_if = &"\0\0\0\0\0\0\0\x92\x82\x24\x38\x02\x00\x02\x00\x5A""if"[16];
+const Sym sym_import = &"\0\0\0\0\0\0\0\xD3\x4A\x86\xDD\x06\x00\x06\x00\x62""import"[16];
+const Sym sym_in = &"\0\0\0\0\0\0\0\xB0\x62\x43\xBD\x02\x00\x02\x00\x6A""in"[16];
+const Sym sym_interface = &"\0\0\0\0\0\0\0\xEA\x36\xC6\x3C\x09\x00\x09\x00\x72""interface"[16];
+const Sym sym_is = &"\0\0\0\0\0\0\0\x4E\x76\x35\x78\x02\x00\x02\x00\x7A""is"[16];
+const Sym sym_mutable = &"\0\0\0\0\0\0\0\x7E\x88\x3C\x31\x07\x00\x07\x00\x82""mutable"[16];
+const Sym sym_nil = &"\0\0\0\0\0\0\0\xCA\x30\x25\x08\x03\x00\x03\x00\x8A""nil"[16];
+const Sym sym_return = &"\0\0\0\0\0\0\0\x8F\xA0\xB5\xA3\x06\x00\x06\x00\x92""return"[16];
+const Sym sym_select = &"\0\0\0\0\0\0\0\x9C\x90\x85\x15\x06\x00\x06\x00\x9A""select"[16];
+const Sym sym_struct = &"\0\0\0\0\0\0\0\x28\xC7\x2C\xFE\x06\x00\x06\x00\xA2""struct"[16];
+const Sym sym_switch = &"\0\0\0\0\0\0\0\xBA\x9B\x27\xA0\x06\x00\x06\x00\xAA""switch"[16];
+const Sym sym_symbol = &"\0\0\0\0\0\0\0\x0E\x2C\xF6\x56\x06\x00\x06\x00\xB2""symbol"[16];
+const Sym sym_type = &"\0\0\0\0\0\0\0\x8E\x05\xB6\x66\x04\x00\x04\x00\xBA""type"[16];
+const Sym sym_while = &"\0\0\0\0\0\0\0\x74\x8E\x46\x01\x05\x00\x05\x00\xC2""while"[16];
+const Sym sym_bool = &"\0\0\0\0\0\0\0\xCD\xB3\x35\xA5\x04\x00\x04\x00\x02""bool"[16];
+const Sym sym_int8 = &"\0\0\0\0\0\0\0\x3B\x39\x27\xA8\x04\x00\x04\x00\x02""int8"[16];
+const Sym sym_uint8 = &"\0\0\0\0\0\0\0\xED\x3C\x24\x03\x05\x00\x05\x00\x02""uint8"[16];
+const Sym sym_int16 = &"\0\0\0\0\0\0\0\xDF\xFE\x0F\x09\x05\x00\x05\x00\x02""int16"[16];
+const Sym sym_uint16 = &"\0\0\0\0\0\0\0\x1C\x68\x0C\x4F\x06\x00\x06\x00\x02""uint16"[16];
+const Sym sym_int32 = &"\0\0\0\0\0\0\0\x83\x52\xB1\x66\x05\x00\x05\x00\x02""int32"[16];
+const Sym sym_uint32 = &"\0\0\0\0\0\0\0\xAE\x75\x92\xB1\x06\x00\x06\x00\x02""uint32"[16];
+const Sym sym_int64 = &"\0\0\0\0\0\0\0\x03\x2D\x61\xF7\x05\x00\x05\x00\x02""int64"[16];
+const Sym sym_uint64 = &"\0\0\0\0\0\0\0\x58\x78\x99\x5D\x06\x00\x06\x00\x02""uint64"[16];
+const Sym sym_float32 = &"\0\0\0\0\0\0\0\x7C\x89\xCE\x6E\x07\x00\x07\x00\x02""float32"[16];
+const Sym sym_float64 = &"\0\0\0\0\0\0\0\xE8\x52\xC8\x44\x07\x00\x07\x00\x02""float64"[16];
+const Sym sym_int = &"\0\0\0\0\0\0\0\xE6\x13\x4A\x53\x03\x00\x03\x00\x02""int"[16];
+const Sym sym_uint = &"\0\0\0\0\0\0\0\x95\xCB\x43\xE7\x04\x00\x04\x00\x02""uint"[16];
+const Sym sym_str = &"\0\0\0\0\0\0\0\x33\x15\xC4\xFC\x03\x00\x03\x00\x02""str"[16];
+const Sym sym__ = &"\0\0\0\0\0\0\0\xDA\x52\xD5\x20\x01\x00\x01\x00\x02""_"[16];
+const Sym sym_true = &"\0\0\0\0\0\0\0\xEC\xB4\xFC\x3C\x04\x00\x04\x00\x02""true"[16];
+const Sym sym_false = &"\0\0\0\0\0\0\0\x25\x82\xE0\x0C\x05\x00\x05\x00\x02""false"[16];
+const Sym sym_b = &"\0\0\0\0\0\0\0\xD7\x51\x01\x5E\x01\x00\x01\x00\x02""b"[16];
+const Sym sym_1 = &"\0\0\0\0\0\0\0\xC0\x41\xE6\x7D\x01\x00\x01\x00\x02""1"[16];
+const Sym sym_2 = &"\0\0\0\0\0\0\0\xD2\xCF\x69\x5B\x01\x00\x01\x00\x02""2"[16];
+const Sym sym_3 = &"\0\0\0\0\0\0\0\xF9\x1F\xA8\xB7\x01\x00\x01\x00\x02""3"[16];
+const Sym sym_4 = &"\0\0\0\0\0\0\0\x86\x94\x85\x8D\x01\x00\x01\x00\x02""4"[16];
+const Sym sym_5 = &"\0\0\0\0\0\0\0\x8B\x0A\xD7\x18\x01\x00\x01\x00\x02""5"[16];
+const Sym sym_6 = &"\0\0\0\0\0\0\0\xC9\xC2\x8D\x2D\x01\x00\x01\x00\x02""6"[16];
+const Sym sym_7 = &"\0\0\0\0\0\0\0\x6A\x57\x59\x16\x01\x00\x01\x00\x02""7"[16];
+const Sym sym_8 = &"\0\0\0\0\0\0\0\xDB\xE4\xB9\x08\x01\x00\x01\x00\x02""8"[16];
+const Sym sym_f = &"\0\0\0\0\0\0\0\x44\xAB\x1F\xC8\x01\x00\x01\x00\x02""f"[16];
+const Sym sym_F = &"\0\0\0\0\0\0\0\xC8\xF1\x1C\xDF\x01\x00\x01\x00\x02""F"[16];
+const Sym sym_i = &"\0\0\0\0\0\0\0\xD0\xD6\x22\x21\x01\x00\x01\x00\x02""i"[16];
+const Sym sym_u = &"\0\0\0\0\0\0\0\xE7\xCD\x8C\x70\x01\x00\x01\x00\x02""u"[16];
+const Sym sym_s = &"\0\0\0\0\0\0\0\xFC\x50\x7F\xD1\x01\x00\x01\x00\x02""s"[16];
+
+static const Node _Type_bool = {NBasicType,NoPos,NULL,{.t={sym_b,.basic={TypeCode_bool,sym_bool}}}};
 Node* Type_bool = (Node*)&_Type_bool;
-static const Node _Type_int8 = {NBasicType,{0,0,0},NULL,{.t={sym_1,.basic={TypeCode_int8,sym_int8}}}};
+static const Node _Type_int8 = {NBasicType,NoPos,NULL,{.t={sym_1,.basic={TypeCode_int8,sym_int8}}}};
 Node* Type_int8 = (Node*)&_Type_int8;
-static const Node _Type_uint8 = {NBasicType,{0,0,0},NULL,{.t={sym_2,.basic={TypeCode_uint8,sym_uint8}}}};
+static const Node _Type_uint8 = {NBasicType,NoPos,NULL,{.t={sym_2,.basic={TypeCode_uint8,sym_uint8}}}};
 Node* Type_uint8 = (Node*)&_Type_uint8;
-static const Node _Type_int16 = {NBasicType,{0,0,0},NULL,{.t={sym_3,.basic={TypeCode_int16,sym_int16}}}};
+static const Node _Type_int16 = {NBasicType,NoPos,NULL,{.t={sym_3,.basic={TypeCode_int16,sym_int16}}}};
 Node* Type_int16 = (Node*)&_Type_int16;
-static const Node _Type_uint16 = {NBasicType,{0,0,0},NULL,{.t={sym_4,.basic={TypeCode_uint16,sym_uint16}}}};
+static const Node _Type_uint16 = {NBasicType,NoPos,NULL,{.t={sym_4,.basic={TypeCode_uint16,sym_uint16}}}};
 Node* Type_uint16 = (Node*)&_Type_uint16;
-static const Node _Type_int32 = {NBasicType,{0,0,0},NULL,{.t={sym_5,.basic={TypeCode_int32,sym_int32}}}};
+static const Node _Type_int32 = {NBasicType,NoPos,NULL,{.t={sym_5,.basic={TypeCode_int32,sym_int32}}}};
 Node* Type_int32 = (Node*)&_Type_int32;
-static const Node _Type_uint32 = {NBasicType,{0,0,0},NULL,{.t={sym_6,.basic={TypeCode_uint32,sym_uint32}}}};
+static const Node _Type_uint32 = {NBasicType,NoPos,NULL,{.t={sym_6,.basic={TypeCode_uint32,sym_uint32}}}};
 Node* Type_uint32 = (Node*)&_Type_uint32;
-static const Node _Type_int64 = {NBasicType,{0,0,0},NULL,{.t={sym_7,.basic={TypeCode_int64,sym_int64}}}};
+static const Node _Type_int64 = {NBasicType,NoPos,NULL,{.t={sym_7,.basic={TypeCode_int64,sym_int64}}}};
 Node* Type_int64 = (Node*)&_Type_int64;
-static const Node _Type_uint64 = {NBasicType,{0,0,0},NULL,{.t={sym_8,.basic={TypeCode_uint64,sym_uint64}}}};
+static const Node _Type_uint64 = {NBasicType,NoPos,NULL,{.t={sym_8,.basic={TypeCode_uint64,sym_uint64}}}};
 Node* Type_uint64 = (Node*)&_Type_uint64;
-static const Node _Type_float32 = {NBasicType,{0,0,0},NULL,{.t={sym_f,.basic={TypeCode_float32,sym_float32}}}};
+static const Node _Type_float32 = {NBasicType,NoPos,NULL,{.t={sym_f,.basic={TypeCode_float32,sym_float32}}}};
 Node* Type_float32 = (Node*)&_Type_float32;
-static const Node _Type_float64 = {NBasicType,{0,0,0},NULL,{.t={sym_F,.basic={TypeCode_float64,sym_float64}}}};
+static const Node _Type_float64 = {NBasicType,NoPos,NULL,{.t={sym_F,.basic={TypeCode_float64,sym_float64}}}};
 Node* Type_float64 = (Node*)&_Type_float64;
-static const Node _Type_int = {NBasicType,{0,0,0},NULL,{.t={sym_i,.basic={TypeCode_int,sym_int}}}};
+static const Node _Type_int = {NBasicType,NoPos,NULL,{.t={sym_i,.basic={TypeCode_int,sym_int}}}};
 Node* Type_int = (Node*)&_Type_int;
-static const Node _Type_uint = {NBasicType,{0,0,0},NULL,{.t={sym_u,.basic={TypeCode_uint,sym_uint}}}};
+static const Node _Type_uint = {NBasicType,NoPos,NULL,{.t={sym_u,.basic={TypeCode_uint,sym_uint}}}};
 Node* Type_uint = (Node*)&_Type_uint;
-static const Node _Type_str = {NBasicType,{0,0,0},NULL,{.t={sym_s,.basic={TypeCode_str,sym_str}}}};
+static const Node _Type_str = {NBasicType,NoPos,NULL,{.t={sym_s,.basic={TypeCode_str,sym_str}}}};
 Node* Type_str = (Node*)&_Type_str;
 
-static const Node _Const_true = {NBoolLit,{0,0,0},(Node*)&_Type_bool,{.val={CType_bool,.i=1}}};
+static const Node _Const_true = {NBoolLit,NoPos,(Node*)&_Type_bool,{.val={CType_bool,.i=1}}};
 Node* Const_true = (Node*)&_Const_true;
-static const Node _Const_false = {NBoolLit,{0,0,0},(Node*)&_Type_bool,{.val={CType_bool,.i=0}}};
+static const Node _Const_false = {NBoolLit,NoPos,(Node*)&_Type_bool,{.val={CType_bool,.i=0}}};
 Node* Const_false = (Node*)&_Const_false;
 
-static RBNode n_int64 = { sym_int64, true, null, null };
-static RBNode n_false = { sym_false, true, null, null };
-static RBNode n_int16 = { sym_int16, false, &n_int64, &n_false };
-static RBNode n_while = { sym_while, false, null, null };
-static RBNode n_nil = { sym_nil, false, &n_int16, &n_while };
-static RBNode n_select = { sym_select, true, null, null };
-static RBNode n_uint8 = { sym_uint8, false, &n_select, null };
-static RBNode n_uint32 = { sym_uint32, true, null, null };
-static RBNode n_mutable = { sym_mutable, true, null, null };
-static RBNode n_if = { sym_if, false, &n_uint32, &n_mutable };
-static RBNode n_defer = { sym_defer, false, &n_uint8, &n_if };
-static RBNode n_import = { sym_import, true, &n_nil, &n_defer };
-static RBNode n_true = { sym_true, true, null, null };
-static RBNode n_type = { sym_type, true, null, null };
-static RBNode n_is = { sym_is, false, &n_true, &n_type };
-static RBNode n_int8 = { sym_int8, true, null, null };
-static RBNode n_enum = { sym_enum, true, null, null };
-static RBNode n_float64 = { sym_float64, false, &n_int8, &n_enum };
-static RBNode n_as = { sym_as, false, &n_is, &n_float64 };
-static RBNode n_in = { sym_in, false, &n_import, &n_as };
-static RBNode n_return = { sym_return, false, null, null };
-static RBNode n_default = { sym_default, true, null, null };
-static RBNode n_int = { sym_int, true, null, null };
-static RBNode n_switch = { sym_switch, false, &n_default, &n_int };
-static RBNode n_struct = { sym_struct, false, &n_return, &n_switch };
-static RBNode n_fun = { sym_fun, false, null, null };
-static RBNode n_uint16 = { sym_uint16, true, null, null };
-static RBNode n_continue = { sym_continue, true, null, null };
-static RBNode n_uint64 = { sym_uint64, false, &n_uint16, &n_continue };
-static RBNode n_for = { sym_for, false, &n_fun, &n_uint64 };
-static RBNode n_case = { sym_case, true, &n_struct, &n_for };
-static RBNode n_str = { sym_str, true, null, null };
-static RBNode n_bool = { sym_bool, false, &n_str, null };
-static RBNode n_uint = { sym_uint, true, null, null };
-static RBNode n_float32 = { sym_float32, true, null, null };
-static RBNode n__ = { sym__, false, &n_uint, &n_float32 };
-static RBNode n_break = { sym_break, true, &n_bool, &n__ };
-static RBNode n_int32 = { sym_int32, false, null, null };
-static RBNode n_symbol = { sym_symbol, false, &n_break, &n_int32 };
-static RBNode n_else = { sym_else, false, &n_case, &n_symbol };
-static RBNode n_interface = { sym_interface, false, &n_in, &n_else };
-
-static RBNode* symRoot = &n_interface;
+static SymTabEntry symTabInit[128] = {
+  [3] = {0x66B15283, sym_int32},
+  [4] = {0xF7612D03, sym_int64},
+  [14] = {0x56F62C0E, sym_symbol},
+  [15] = {0xA3B5A08F, sym_return},
+  [16] = {0x06C31910, sym_continue},
+  [17] = {0x66B6058E, sym_type},
+  [18] = {0x38248292, sym_if},
+  [21] = {0xE743CB95, sym_uint},
+  [24] = {0x76698318, sym_else},
+  [28] = {0x1585909C, sym_select},
+  [29] = {0x4F0C681C, sym_uint16},
+  [32] = {0xDD7902A0, sym_default},
+  [37] = {0x0CE08225, sym_false},
+  [40] = {0xFE2CC728, sym_struct},
+  [46] = {0xB19275AE, sym_uint32},
+  [48] = {0xBD4362B0, sym_in},
+  [51] = {0xFCC41533, sym_str},
+  [57] = {0x3A4FE1B9, sym_as},
+  [58] = {0xA0279BBA, sym_switch},
+  [59] = {0xA827393B, sym_int8},
+  [74] = {0x082530CA, sym_nil},
+  [77] = {0xA535B3CD, sym_bool},
+  [78] = {0x660AD9CE, sym_case},
+  [79] = {0x7835764E, sym_is},
+  [82] = {0x7507ACD2, sym_fun},
+  [83] = {0x0EE393D3, sym_break},
+  [84] = {0xDD864AD3, sym_import},
+  [88] = {0x5D997858, sym_uint64},
+  [90] = {0xCB94D85A, sym_for},
+  [91] = {0x20D552DA, sym__},
+  [95] = {0x090FFEDF, sym_int16},
+  [102] = {0x534A13E6, sym_int},
+  [104] = {0x44C852E8, sym_float64},
+  [106] = {0x3CC636EA, sym_interface},
+  [108] = {0xF8C437EC, sym_defer},
+  [109] = {0x1C66A06C, sym_enum},
+  [110] = {0x03243CED, sym_uint8},
+  [111] = {0x3CFCB4EC, sym_true},
+  [116] = {0x01468E74, sym_while},
+  [124] = {0x6ECE897C, sym_float32},
+  [126] = {0x313C887E, sym_mutable},
+};
+enum { symTabInitLen = 41 };
+
+const u32 _symKeywordMul = 0x9E377CF7;
+const Sym _symKeywordTab[64] = {
+  [0] = sym_if,
+  [1] = sym_nil,
+  [4] = sym_in,
+  [5] = sym_import,
+  [6] = sym_type,
+  [14] = sym_enum,
+  [15] = sym_symbol,
+  [18] = sym_continue,
+  [21] = sym_else,
+  [23] = sym_fun,
+  [25] = sym_struct,
+  [27] = sym_is,
+  [35] = sym_for,
+  [37] = sym_break,
+  [38] = sym_while,
+  [39] = sym_default,
+  [40] = sym_as,
+  [41] = sym_case,
+  [43] = sym_return,
+  [47] = sym_defer,
+  [51] = sym_select,
+  [55] = sym_interface,
+  [58] = sym_mutable,
+  [61] = sym_switch,
+};
+
 #ifndef NDEBUG
 static const char* const debugSymCheck =
   "as#101 break#102 case#103 continue#104 default#105 defer#106 else#107 "
@@ -162,20 +196,20 @@ static const char* const debugSymCheck =
   "int64 uint64 float32 float64 int uint str true:bool=1 false:bool=0 _ ";
 #endif
 
-//-- END gen_constants() at src/sym.c:536
+//-- END gen_constants() at src/sym.c:665
 
 
 
 // nil is special and implemented without macros since its sym is defined by TOKEN_KEYWORDS
-static const Node _Type_nil = {NBasicType,{0,0,0},NULL,{.t={"0",.basic={TypeCode_nil,sym_nil}}}};
+static const Node _Type_nil = {NBasicType,NoPos,NULL,{.t={"0",.basic={TypeCode_nil,sym_nil}}}};
 Node* Type_nil = (Node*)&_Type_nil;
 
-static const Node _Const_nil = {NNil,{0,0,0},(Node*)&_Type_nil,{.val={CType_nil,.i=0}}};
+static const Node _Const_nil = {NNil,NoPos,(Node*)&_Type_nil,{.val={CType_nil,.i=0}}};
 Node* Const_nil = (Node*)&_Const_nil;
 
 // ideal
-const Sym sym_ideal = &"\0\0\0\0\0\0\0\x64\x23\xD2\x03\x05\x00\x05\x00\x02""ideal"[16];
-static const Node _Type_ideal = {NBasicType,{0,0,0},NULL,{
+const Sym sym_ideal = &"\0\0\0\0\0\0\0\x2F\x74\x73\xF5\x05\x00\x05\x00\x02""ideal"[16];
+static const Node _Type_ideal = {NBasicType,NoPos,NULL,{
   .t={"\0",.basic={TypeCode_ideal,sym_ideal}}
 }};
 Node* Type_ideal = (Node*)&_Type_ideal;
@@ -184,24 +218,35 @@ Node* Type_ideal = (Node*)&_Type_ideal;
 // -----------------------------------------------------------------------------------------
 
 
-// // dumpSymTree functionn
-// #if DEBUG
-// static Str dumpSymTreeFmtKey(Str s, Sym k) {
-//   s = sdscatrepr(s, k, sdslen(k));
-//   return sdscatprintf(s, " (flags %02X, hash %u)", SYM_HDR(k)->sh.flags, SYM_HDR(k)->hash);
-// }
-// static void dumpSymTree() {
-//   auto s = RBRepr(symRoot, sdsempty(), 0, &dumpSymTreeFmtKey);
-//   s[sdslen(s)] = '\n'; // replace NUL with ln
-//   fwrite(s, sdslen(s)+1, 1, stderr);
-//   sdsfree(s);
-// }
-// #endif
+// Symbols are never freed, so they are allocated from large slabs of memory by bumping a
+// pointer. This avoids the per-allocation overhead of memalloc and keeps symbols which are
+// interned together close to each other in memory. Symbols larger than SYM_SLAB_MAXSYM are
+// allocated individually. Only accessed with symLock held (or by the single-threaded generator.)
+#define SYM_SLAB_SIZE   (64 * 1024)
+#define SYM_SLAB_MAXSYM (SYM_SLAB_SIZE / 16)
+static u8*    symSlab = NULL;  // next free byte in the current slab
+static u8*    symSlabEnd = NULL;
+static size_t symMemSize = 0;  // total bytes allocated for symbols
 
 
 static Sym newsym(u32 hash, const u8* ptr, size_t len, u8 flags) {
   assert(len <= 0xFFFF);
-  auto hp = (SymHeader*)memalloc(NULL, sizeof(SymHeader) + len + 1);
+  // align to pointer size so that headers (and hash) are aligned
+  size_t size = align2(sizeof(SymHeader) + len + 1, sizeof(void*));
+  SymHeader* hp;
+  if (size > SYM_SLAB_MAXSYM) {
+    hp = (SymHeader*)memalloctag(NULL, size, MemTagSym);
+    symMemSize += size;
+  } else {
+    if (size > (size_t)(symSlabEnd - symSlab)) {
+      // the rest of the current slab, if any, is left unused
+      symSlab = (u8*)memalloctag(NULL, SYM_SLAB_SIZE, MemTagSym);
+      symSlabEnd = symSlab + SYM_SLAB_SIZE;
+      symMemSize += SYM_SLAB_SIZE;
+    }
+    hp = (SymHeader*)symSlab;
+    symSlab += size;
+  }
   hp->hash = hash;
   hp->sh.len = len;
   hp->sh.alloc = len;
@@ -213,77 +258,150 @@ static Sym newsym(u32 hash, const u8* ptr, size_t len, u8 flags) {
 }
 
 
-// RB functions
-inline static RBNode* RBAllocNode(Memory mem) {
-  return (RBNode*)memalloc(mem, sizeof(RBNode));
-}
-
-// syms are never removed from the interning tree
-inline static void RBFreeNode(RBNode* node, Memory mem) {
-  assert(!"sym deallocated");
+// SymTab is the interning table: a hash table with open addressing and linear probing.
+// Symbols are looked up without locking (see symget.) Entries are never removed.
+typedef struct SymTab {
+  u32          cap; // number of entries; a power of two
+  u32          len; // number of entries in use
+  SymTabEntry* entries;
+} SymTab;
+
+// symTab is the current table. It initially uses the static storage symTabInit, which is
+// seeded with the predefined symbols by gen_constants, and is replaced by a table twice the
+// size when it needs to grow. Replaced tables are not freed, since other threads may still be
+// reading them. As the size doubles every time they add up to less than the current table.
+static SymTab symTab0 = { countof(symTabInit), symTabInitLen, symTabInit };
+static SymTab* symTab = &symTab0;
+
+// symLock serializes insertions into symTab. Lookups do not take the lock.
+// It is rarely contended and held only briefly, so we spin.
+static atomic_flag symLock = ATOMIC_FLAG_INIT;
+
+
+// symTabFind returns the sym equal to data in t, or NULL with *slot set to the empty slot
+// where it should be inserted. It is safe to call while another thread inserts into t:
+// the sym of an entry is published after its hash (see symTabAdd.)
+inline static Sym symTabFind(const SymTab* t, u32 hash, const u8* data, u16 len, u32* slot) {
+  u32 mask = t->cap - 1;
+  u32 i = hash & mask;
+  while (1) {
+    const SymTabEntry* e = &t->entries[i];
+    Sym s = __atomic_load_n(&e->sym, __ATOMIC_ACQUIRE);
+    if (s == NULL) {
+      *slot = i;
+      return NULL;
+    }
+    if (e->hash == hash && symlen(s) == len && memcmp(s, data, len) == 0) {
+      return s;
+    }
+    i = (i + 1) & mask;
+  }
 }
 
 
-inline static int RBCmp(Sym a, Sym b, Memory mem) {
-  if (symhash(a) < symhash(b)) {
-    return -1;
-  }
-  if (symhash(a) > symhash(b)) {
-    return 1;
-  }
-  int cmp = (int)symlen(a) - (int)symlen(b);
-  if (cmp == 0) {
-    // hash is identical and length is identical; compare bytes.
-    cmp = memcmp(a, b, symlen(a));
+// symTabGrow returns a copy of t with twice the capacity
+static SymTab* symTabGrow(const SymTab* t) {
+  u32 cap = t->cap * 2;
+  u32 mask = cap - 1;
+  auto t2 = (SymTab*)memalloctag(NULL, sizeof(SymTab) + sizeof(SymTabEntry) * cap, MemTagSym);
+  symMemSize += sizeof(SymTab) + sizeof(SymTabEntry) * cap;
+  t2->cap = cap;
+  t2->len = t->len;
+  t2->entries = (SymTabEntry*)&t2[1];
+  for (u32 j = 0; j < t->cap; j++) {
+    const SymTabEntry* e = &t->entries[j];
+    if (e->sym != NULL) {
+      u32 i = e->hash & mask;
+      while (t2->entries[i].sym != NULL) {
+        i = (i + 1) & mask;
+      }
+      t2->entries[i] = *e;
+    }
   }
-  return cmp;
+  return t2;
 }
 
 
-inline static Sym symFind(u32 hash, const u8* aptr, u16 alen) {
-  RBNode* node = symRoot;
-  while (node) {
-    // IMPORTANT: The comparison here MUST match the comparison used for other
-    // operations on the tree. I.e. it must match RBCmp.
-    // int cmp = RBCmp(key, (RBKEY)node->key);
-
-    Sym b = (RBKEY)node->key;
-    if (hash < symhash(b)) {
-      node = node->left;
-    } else if (hash > symhash(b)) {
-      node = node->right;
-    } else {
-      int cmp = (int)alen - (int)symlen(b);
-      if (cmp == 0) {
-        cmp = memcmp(aptr, b, alen);
-        if (cmp == 0) {
-          return b;
-        }
-      }
-      node = cmp < 0 ? node->left : node->right;
-    }
+// symTabAdd interns data. Must be called with symLock held.
+static Sym symTabAdd(u32 hash, const u8* data, u16 len) {
+  auto t = symTab;
+  u32 slot;
+  // another thread may have added the symbol since our lookup
+  auto s = symTabFind(t, hash, data, len, &slot);
+  if (s != NULL) {
+    return s;
+  }
+  // Keep the load factor at or below 3/4 so that probe sequences stay short
+  if ((t->len + 1) * 4 > t->cap * 3) {
+    t = symTabGrow(t);
+    symTabFind(t, hash, data, len, &slot);
+    __atomic_store_n(&symTab, t, __ATOMIC_RELEASE);
   }
-  return NULL;
+  s = newsym(hash, data, len, SDS_TYPE_16);
+  t->entries[slot].hash = hash;
+  __atomic_store_n(&t->entries[slot].sym, s, __ATOMIC_RELEASE);
+  t->len++;
+  return s;
 }
 
 
 Sym symget(const u8* data, size_t _len, u32 hash) {
   assert(_len <= 0xFFFF);
   u16 len = (u16)_len;
-  auto s = symFind(hash, data, len);
+  u32 slot;
+  auto s = symTabFind(__atomic_load_n(&symTab, __ATOMIC_ACQUIRE), hash, data, len, &slot);
   if (s == NULL) {
     // intern miss
-    // auto key = newsym(hash, data, len, SDS_TYPE_16);
-    // bool rbhas = RBHas(symRoot, key);
-    s = newsym(hash, data, len, SDS_TYPE_16);
-    symRoot = RBInsert(symRoot, s, NULL);
+    while (atomic_flag_test_and_set_explicit(&symLock, memory_order_acquire)) {
+      thrd_yield();
+    }
+    s = symTabAdd(hash, data, len);
+    atomic_flag_clear_explicit(&symLock, memory_order_release);
   }
   return s;
 }
 
 
 Sym symgeth(const u8* data, size_t len) {
-  return symget(data, len, hashFNV1a(data, len));
+  return symget(data, len, hashWY(data, len));
+}
+
+
+void symstats(SymStats* st) {
+  memset(st, 0, sizeof(SymStats));
+  while (atomic_flag_test_and_set_explicit(&symLock, memory_order_acquire)) {
+    thrd_yield();
+  }
+  auto t = symTab;
+  u32 mask = t->cap - 1;
+  u64 nprobes = 0;
+  for (u32 i = 0; i < t->cap; i++) {
+    const SymTabEntry* e = &t->entries[i];
+    if (e->sym == NULL) {
+      continue;
+    }
+    st->count++;
+    st->bytes += symlen(e->sym);
+    // entries between the home slot of e and e itself were probed to find e.
+    // Entries with the same hash share the home slot, so they are among those.
+    u32 home = e->hash & mask;
+    u32 nprobe = ((i - home) & mask) + 1;
+    nprobes += nprobe;
+    st->maxprobe = max(st->maxprobe, nprobe);
+    for (u32 j = home; j != i; j = (j + 1) & mask) {
+      if (t->entries[j].hash == e->hash) {
+        st->hashcoll++;
+        break;
+      }
+    }
+  }
+  st->tabcap = t->cap;
+  st->memsize = symMemSize;
+  atomic_flag_clear_explicit(&symLock, memory_order_release);
+  if (st->count > 0) {
+    st->avglen = (double)st->bytes / (double)st->count;
+    st->avgprobe = (double)nprobes / (double)st->count;
+  }
 }
 
 
@@ -312,55 +430,20 @@ Node* const _TypeCodeToTypeNodeMap[TypeCode_CONCRETE_END] = {
 
 #if defined(W_SYM_RUN_GENERATOR)
 
-inline static Str fmt_nodes(const RBNode* n, Str s) {
-  // descent first
-  if (n->left) {
-    s = fmt_nodes(n->left, s);
-  }
-  if (n->right) {
-    s = fmt_nodes(n->right, s);
-  }
-
-  s = sdscat(s, "static RBNode n_");
-  s = sdscatsds(s, n->key);
-  s = sdscat(s, " = { ");
-
-  // { key, isred, left, right }
-
-  s = sdscatfmt(s, "sym_%S, ", n->key);
-  // s = sdscat(s, "null, ");
-
-  s = sdscat(s, n->isred ? "true, " : "false, ");
-  if (n->left) {
-    s = sdscatfmt(s, "&n_%S, ", n->left->key);
-  } else {
-    s = sdscat(s, "null, ");
-  }
-  if (n->right) {
-    s = sdscatfmt(s, "&n_%S ", n->right->key);
-  } else {
-    s = sdscat(s, "null ");
-  }
-  s = sdscat(s, "};\n");
-  return s;
-}
-
-static constsds fmtkey(Sym k) { return k; } // Sym is a type of Str :-)
-
 __attribute__((constructor)) static void gen_constants() {
   printf("//-- BEGIN gen_constants() at %s:%d\n\n", __FILE__, __LINE__);
 
   #define SYM_DEF(str, tok)                                             \
-    Sym sym_##str = newsym(hashFNV1a((const u8*)(#str), strlen(#str)),  \
+    Sym sym_##str = newsym(hashWY((const u8*)(#str), strlen(#str)),  \
       (const u8*)(#str), (u32)strlen(#str), SDS_TYPE_16);
   TOKEN_KEYWORDS(SYM_DEF)
   #undef SYM_DEF
 
   #define SYM_DEF(name)                                                   \
-    Sym sym_##name = newsym(hashFNV1a((const u8*)(#name), strlen(#name)), \
+    Sym sym_##name = newsym(hashWY((const u8*)(#name), strlen(#name)), \
       (const u8*)(#name), (u32)strlen(#name), SDS_TYPE_16);
   #define SYM_DEF_CONST(name, _t, _v)                                     \
-    Sym sym_##name = newsym(hashFNV1a((const u8*)(#name), strlen(#name)), \
+    Sym sym_##name = newsym(hashWY((const u8*)(#name), strlen(#name)), \
       (const u8*)(#name), (u32)strlen(#name), SDS_TYPE_16);
   TYPE_SYMS(SYM_DEF)
   PREDEFINED_CONSTANTS(SYM_DEF_CONST)
@@ -371,7 +454,7 @@ __attribute__((constructor)) static void gen_constants() {
   u8 buf1[1];
   #define SYM_DEF(name)                                                       \
     buf1[0] = TypeCodeEncoding[TypeCode_##name];                              \
-    Sym sym_typeid_##name = newsym(hashFNV1a(buf1, 1), buf1, 1, SDS_TYPE_16);
+    Sym sym_typeid_##name = newsym(hashWY(buf1, 1), buf1, 1, SDS_TYPE_16);
   TYPE_SYMS(SYM_DEF)
   #undef SYM_DEF
 
@@ -465,12 +548,12 @@ __attribute__((constructor)) static void gen_constants() {
   // const Node* type_NAME
   printf(
     "\n"
-    //"static const Node _badnode = {NBad,{0,0,0},NULL,{0}};\n"
+    //"static const Node _badnode = {NBad,NoPos,NULL,{0}};\n"
   );
   #define SYM_DEF(name)                                                         \
     printf(                                                                     \
       "static const Node _Type_%s = "                                           \
-      "{NBasicType,{0,0,0},NULL,{.t={sym_%c,.basic={TypeCode_%s,sym_%s}}}};\n"  \
+      "{NBasicType,NoPos,NULL,{.t={sym_%c,.basic={TypeCode_%s,sym_%s}}}};\n"    \
       "Node* Type_%s = (Node*)&_Type_%s;\n",                                    \
       #name, TypeCodeEncoding[TypeCode_##name], #name, #name, #name, #name      \
     );
@@ -482,7 +565,7 @@ __attribute__((constructor)) static void gen_constants() {
   printf("\n");
   #define SYM_DEF(name, type, value)                                             \
     printf(                                                                      \
-      "static const Node _Const_%s = {%s,{0,0,0},(Node*)&_Type_%s,{.val=%s}};\n" \
+      "static const Node _Const_%s = {%s,NoPos,(Node*)&_Type_%s,{.val=%s}};\n"   \
       "Node* Const_%s = (Node*)&_Const_%s;\n",                                   \
       #name,                                                                     \
       #type == "bool" ? "NBoolLit" : "NIntLit",                                  \
@@ -494,21 +577,65 @@ __attribute__((constructor)) static void gen_constants() {
   #undef SYM_DEF
 
 
-  RBNode* root = NULL;
-  #define KW(str, tok) root = RBInsert(root, sym_##str, NULL);
-  TOKEN_KEYWORDS(KW)
-  #undef KW
-  #define KW(name) root = RBInsert(root, sym_##name, NULL);
-  #define CONST(name, _type, _val) root = RBInsert(root, sym_##name, NULL);
-  TYPE_SYMS(KW)
-  PREDEFINED_CONSTANTS(CONST)
-  PREDEFINED_IDENTS(KW)
-  #undef CONST
-  #undef KW
-
-  printf("\n%s\n", fmt_nodes(root, sdsempty()));
-
-  printf("static RBNode* symRoot = &n_%s;\n", root->key);
+  // predefined symbols => symTabInit (see symget.)
+  // The table is sized for a load factor of at most 1/2 and filled the same way as symget.
+  Sym predefined[] = {
+    #define KW(str, tok) sym_##str,
+    #define NAME(name) sym_##name,
+    #define CONST(name, _type, _val) sym_##name,
+    TOKEN_KEYWORDS(KW)
+    TYPE_SYMS(NAME)
+    PREDEFINED_CONSTANTS(CONST)
+    PREDEFINED_IDENTS(NAME)
+    #undef KW
+    #undef NAME
+    #undef CONST
+  };
+  u32 tabcap = 8;
+  while (tabcap < countof(predefined) * 2) {
+    tabcap *= 2;
+  }
+  Sym tab[tabcap];
+  memset(tab, 0, sizeof(tab));
+  for (u32 j = 0; j < countof(predefined); j++) {
+    u32 i = symhash(predefined[j]) & (tabcap - 1);
+    while (tab[i] != NULL) {
+      i = (i + 1) & (tabcap - 1);
+    }
+    tab[i] = predefined[j];
+  }
+  printf("\nstatic SymTabEntry symTabInit[%u] = {\n", tabcap);
+  for (u32 i = 0; i < tabcap; i++) {
+    if (tab[i]) {
+      printf("  [%u] = {0x%08X, sym_%s},\n", i, symhash(tab[i]), tab[i]);
+    }
+  }
+  printf("};\nenum { symTabInitLen = %u };\n", (u32)countof(predefined));
+
+  // TOKEN_KEYWORDS => _symKeywordTab (see symkeyword.)
+  // Search for a multiplier which maps the hash of every keyword to a separate slot.
+  Sym kwtab[1 << SYM_KEYWORD_TAB_BITS];
+  u32 kwmul = 0x9E3779B1; // odd multipliers, starting at 2^32/phi
+  for (bool ok = false; !ok; kwmul += 2) {
+    memset(kwtab, 0, sizeof(kwtab));
+    ok = true;
+    #define KW(str, tok) {                                                     \
+      u32 i = (symhash(sym_##str) * kwmul) >> (32 - SYM_KEYWORD_TAB_BITS);     \
+      ok = ok && kwtab[i] == NULL;                                             \
+      kwtab[i] = sym_##str;                                                    \
+    }
+    TOKEN_KEYWORDS(KW)
+    #undef KW
+  }
+  kwmul -= 2;
+  printf("\nconst u32 _symKeywordMul = 0x%08X;\n", kwmul);
+  printf("const Sym _symKeywordTab[%u] = {\n", (u32)countof(kwtab));
+  for (u32 i = 0; i < countof(kwtab); i++) {
+    if (kwtab[i]) {
+      printf("  [%u] = sym_%s,\n", i, kwtab[i]);
+    }
+  }
+  printf("};\n\n");
 
   // generate a sort of checksum used in debug mode to make sure the generator is updated
   // when keywords change. See the function debug_check() below as well.
@@ -577,7 +704,7 @@ __attribute__((constructor)) static void debug_check() {
 #define HASHMAP_KEY      Sym
 #define HASHMAP_KEY_HASH symhash
 #define HASHMAP_VALUE    void*
-#include "common/hashmap.c.h"
+#include "common/hashmap_swiss.c.h"
 #undef HASHMAP_NAME
 #undef HASHMAP_KEY
 #undef HASHMAP_KEY_HASH
@@ -799,5 +926,149 @@ W_UNIT_TEST(SymMap, {;
 }) // W_UNIT_TEST
 
 
+#if W_UNIT_TEST_ENABLED
+static Sym testkw(const char* cstr) {
+  return symkeyword((const u8*)cstr, strlen(cstr), hashWY((const u8*)cstr, strlen(cstr)));
+}
+
+static void test_symkeyword() {
+  // every keyword is found, as its predefined symbol, with the right token
+  #define T(str, tok) assert(testkw(#str) == sym_##str); assert(symLangTok(testkw(#str)) == tok);
+  TOKEN_KEYWORDS(T)
+  #undef T
+
+  // names which are not keywords, including ones which share a prefix with a keyword
+  assert(testkw("int") == NULL);
+  assert(testkw("_") == NULL);
+  assert(testkw("a") == NULL);
+  assert(testkw("fu") == NULL);
+  assert(testkw("funx") == NULL);
+  assert(testkw("interfac") == NULL);
+  assert(testkw("While") == NULL);
+}
+
+W_UNIT_TEST(SymKeyword, { test_symkeyword(); })
+
+
+static Sym testsym(const char* cstr) {
+  return symgeth((const u8*)cstr, strlen(cstr));
+}
+
+static void test_symget() {
+  // predefined symbols are found without being interned again
+  #define T(str, tok) assert(testsym(#str) == sym_##str);
+  TOKEN_KEYWORDS(T)
+  #undef T
+  #define T(name) assert(testsym(#name) == sym_##name);
+  TYPE_SYMS(T)
+  PREDEFINED_IDENTS(T)
+  #undef T
+  assert(testsym("true") == sym_true);
+  assert(testsym("false") == sym_false);
+  // sym_ideal is not in the table, but its header holds the hash like the others
+  asserteq(symhash(sym_ideal), hashWY((const u8*)"ideal", strlen("ideal")));
+
+  // intern enough names for the table to grow a few times
+  const u32 n = 20000;
+  Sym syms[n];
+  char buf[32];
+  for (u32 i = 0; i < n; i++) {
+    int len = snprintf(buf, sizeof(buf), "symget_test_%u", i);
+    syms[i] = symget((const u8*)buf, (size_t)len, hashWY((const u8*)buf, (size_t)len));
+    asserteq(symlen(syms[i]), (u16)len);
+    assert(memcmp(syms[i], buf, (size_t)len) == 0);
+  }
+  for (u32 i = 0; i < n; i++) {
+    snprintf(buf, sizeof(buf), "symget_test_%u", i);
+    assert(testsym(buf) == syms[i]);
+  }
+  assert(testsym("int") == sym_int);
+
+  // names which differ only in length or content, and the empty name
+  auto a = testsym("symget_test_1");
+  auto b = symgeth((const u8*)"symget_test_12", strlen("symget_test_1"));
+  assert(a == b);
+  assert(testsym("") == testsym(""));
+  assert(symlen(testsym("")) == 0);
+}
+
+W_UNIT_TEST(SymGet, { test_symget(); })
+
+
+#define SYM_THREAD_TEST_NAMES 20000
+#define SYM_THREAD_TEST_THREADS 8
+
+typedef struct SymThreadTest {
+  Thread thread;
+  u32    offset;
+  Sym    syms[SYM_THREAD_TEST_NAMES]; // name i => syms[i]
+} SymThreadTest;
+
+static int symThreadTestRun(void* arg) {
+  auto t = (SymThreadTest*)arg;
+  char buf[32];
+  // visit all names in an order which is different for every thread (7919 is prime)
+  for (u32 j = 0; j < SYM_THREAD_TEST_NAMES; j++) {
+    u32 i = (t->offset + j * 7919) % SYM_THREAD_TEST_NAMES;
+    snprintf(buf, sizeof(buf), "symthread_%u", i);
+    t->syms[i] = testsym(buf);
+  }
+  return 0;
+}
+
+// test_symget_threads interns the same new names from several threads at once.
+// All threads must get the same Sym for a name.
+static void test_symget_threads() {
+  auto tests = (SymThreadTest*)memalloc(NULL, sizeof(SymThreadTest) * SYM_THREAD_TEST_THREADS);
+  for (u32 i = 0; i < SYM_THREAD_TEST_THREADS; i++) {
+    tests[i].offset = i * 1000;
+    assert(ThreadStart(&tests[i].thread, symThreadTestRun, &tests[i]) == ThreadSuccess);
+  }
+  for (u32 i = 0; i < SYM_THREAD_TEST_THREADS; i++) {
+    ThreadAwait(tests[i].thread);
+  }
+  char buf[32];
+  for (u32 i = 0; i < SYM_THREAD_TEST_NAMES; i++) {
+    snprintf(buf, sizeof(buf), "symthread_%u", i);
+    auto s = testsym(buf);
+    assert(strcmp(s, buf) == 0);
+    for (u32 j = 0; j < SYM_THREAD_TEST_THREADS; j++) {
+      assert(tests[j].syms[i] == s);
+    }
+  }
+  memfree(NULL, tests);
+}
+
+W_UNIT_TEST(SymGetThreads, { test_symget_threads(); })
+
+
+static void test_symstats() {
+  SymStats st1, st2;
+  symstats(&st1);
+  assert(st1.count >= symTabInitLen);
+  assert(st1.avgprobe >= 1.0);
+  assert(st1.maxprobe >= 1);
+
+  // a long name is allocated outside of the slabs
+  char buf[SYM_SLAB_MAXSYM + 1];
+  memset(buf, 'x', sizeof(buf));
+  auto big = symgeth((const u8*)buf, sizeof(buf));
+  asserteq(symlen(big), (u16)sizeof(buf));
+  auto small = testsym("symstats_test");
+  assert(((uintptr_t)small - sizeof(SymHeader)) % sizeof(void*) == 0); // header is aligned
+
+  symstats(&st2);
+  asserteq(st2.count, st1.count + 2);
+  asserteq(st2.bytes, st1.bytes + sizeof(buf) + strlen("symstats_test"));
+  assert(st2.memsize >= st1.memsize + sizeof(buf));
+  assert(st2.avglen == (double)st2.bytes / (double)st2.count);
+  assert(st2.count * 4 <= st2.tabcap * 3);
+  assert(st2.hashcoll < st2.count);
+}
+
+W_UNIT_TEST(SymStats, { test_symstats(); })
+#endif
+
+
 // -----------------------------------------------------------------------------------------------
 
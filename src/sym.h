@@ -4,18 +4,36 @@
 #include "types.h"
 
 // Sym is a type of sds string, compatible with sds functions, with an additional header
-// containing a precomputed FNV1a hash. Sym is immutable.
+// containing a precomputed hash (hashWY). Sym is immutable.
 typedef const char* Sym;
 
 // Predefinition of Node
 typedef struct Node Node;
 
-// Get a symbol (retrieves or interns)
+// Get a symbol (retrieves or interns.) Safe to call from any thread; a name always maps to
+// the same Sym, so syms can be compared by pointer across threads.
+// hash must be hashWY(data, len).
 Sym symget(const u8* data, size_t len, u32 hash);
 
 // Hashes data and then calls symget
 Sym symgeth(const u8* data, size_t len);
 
+// SymStats describes the interned symbols. See symstats.
+typedef struct SymStats {
+  u32    count;    // number of symbols
+  size_t bytes;    // total length of all symbols, excluding headers
+  double avglen;   // average length of a symbol
+  size_t memsize;  // memory allocated for symbols and the interning table, in bytes
+  u32    tabcap;   // capacity of the interning table
+  double avgprobe; // average number of table entries visited to find a symbol
+  u32    maxprobe; // largest number of table entries visited to find a symbol
+  u32    hashcoll; // number of symbols with the same hash as a symbol interned before it
+} SymStats;
+
+// symstats computes statistics of all interned symbols.
+// Visits every symbol, so it is meant for diagnostics rather than frequent use.
+void symstats(SymStats*);
+
 // Compare two Sym's string values.
 inline static int symcmp(Sym a, Sym b) { return a == b ? 0 : strcmp(a, b); }
 
@@ -27,7 +45,7 @@ typedef struct __attribute__((__packed__)) SymHeader {
 // access SymHeader from Sym/sds/const char*
 #define SYM_HDR(s) ((const SymHeader*)((s) - (sizeof(SymHeader))))
 
-// access FNV1a hash of s
+// access hash of s (hashWY of its bytes)
 inline static u32 symhash(Sym s) { return SYM_HDR(s)->hash; }
 
 // faster alternative to sdslen, without type lookup
@@ -41,6 +59,11 @@ inline static Tok symLangTok(Sym s) {
   return kwindex == 0 ? TIdent : kwindex + TKeywordsStart;
 }
 
+// symkeyword returns the predefined Sym of the language keyword data, or NULL if data is not
+// a keyword. hash is the hashWY hash of data. Unlike symget, this never interns and only
+// looks at one slot of a perfect hash table.
+static Sym symkeyword(const u8* data, size_t len, u32 hash);
+
 // SymMap maps Sym to pointers
 #define HASHMAP_NAME     SymMap
 #define HASHMAP_KEY      Sym
@@ -53,7 +76,7 @@ inline static Tok symLangTok(Sym s) {
 // Creates and initializes a new SymMap in mem, or global memory if mem is NULL.
 SymMap* SymMapNew(u32 initbuckets, Memory mem/*null*/);
 
-// SymMapInit initializes a map structure. initbuckets is the number of initial buckets.
+// SymMapInit initializes a map structure with room for initbuckets entries.
 void SymMapInit(SymMap*, u32 initbuckets, Memory mem/*null*/);
 
 // SymMapFree frees SymMap along with its data.
@@ -88,6 +111,21 @@ TOKEN_KEYWORDS(SYM_DEF)
 #undef SYM_DEF
 
 
+// perfect hash table of TOKEN_KEYWORDS, indexed by (hash * _symKeywordMul) >> (32 - BITS).
+// Generated by gen_constants in sym.c.
+#define SYM_KEYWORD_TAB_BITS 6
+const u32 _symKeywordMul;
+const Sym _symKeywordTab[1 << SYM_KEYWORD_TAB_BITS];
+
+inline static Sym symkeyword(const u8* data, size_t len, u32 hash) {
+  Sym s = _symKeywordTab[(hash * _symKeywordMul) >> (32 - SYM_KEYWORD_TAB_BITS)];
+  if (s && symhash(s) == hash && symlen(s) == len && memcmp(s, data, len) == 0) {
+    return s;
+  }
+  return NULL;
+}
+
+
 // symbols and AST nodes for predefined types (defined in types.h)
 #define SYM_DEF(name) \
   const Sym sym_##name; \
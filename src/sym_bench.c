@@ -0,0 +1,70 @@
+#include "common/bench.h"
+#include "common/hash.h"
+#include "sym.h"
+
+// benchNames returns n distinct names of 6-24 bytes, as a concatenation of NUL-terminated
+// strings which each start with prefix. The names look like the identifiers of generated code.
+static Str benchNames(const char* prefix, u32 n) {
+  static const char* const words[] = {
+    "value", "count", "index", "temp", "result", "node", "offset", "size", "buf", "len" };
+  auto s = sdsempty();
+  u64 x = 0x9E3779B97F4A7C15ull;
+  for (u32 i = 0; i < n; i++) {
+    x ^= x << 13; x ^= x >> 7; x ^= x << 17; // xorshift64
+    s = sdscatprintf(s, "%s%s_%u", prefix, words[x % countof(words)], i);
+    s = sdscatlen(s, "", 1);
+  }
+  return s;
+}
+
+
+static void benchSymget(Bench* b, Str names, u32 n) {
+  b->items = n;
+  b->unit = "syms";
+  for (u64 i = 0; i < b->N; i++) {
+    const char* p = names;
+    for (u32 j = 0; j < n; j++) {
+      size_t len = strlen(p);
+      symget((const u8*)p, len, hashWY((const u8*)p, len));
+      p += len + 1;
+    }
+  }
+}
+
+
+// SymgetHit1M looks up 1M distinct names which are all interned already
+W_BENCHMARK(SymgetHit1M, {
+  BenchStopTimer(b);
+  const u32 n = 1000000;
+  auto names = benchNames("", n);
+  // intern all names before timing
+  const char* p = names;
+  for (u32 j = 0; j < n; j++) {
+    size_t len = strlen(p);
+    symgeth((const u8*)p, len);
+    p += len + 1;
+  }
+  BenchStartTimer(b);
+  benchSymget(b, names, n);
+  sdsfree(names);
+})
+
+
+// SymgetMiss1M interns 1M new names per iteration.
+// Symbols are never freed, so this uses about 100 MB of memory per iteration.
+W_BENCHMARK(SymgetMiss1M, {
+  static u32 run = 0;
+  const u32 n = 1000000;
+  for (u64 i = 0; i < b->N; i++) {
+    BenchStopTimer(b);
+    char prefix[16];
+    snprintf(prefix, sizeof(prefix), "m%u_", run++);
+    auto names = benchNames(prefix, n);
+    BenchStartTimer(b);
+    Bench b1 = { .N = 1 };
+    benchSymget(&b1, names, n);
+    sdsfree(names);
+  }
+  b->items = n;
+  b->unit = "syms";
+})